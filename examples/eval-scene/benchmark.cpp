@@ -0,0 +1,197 @@
+#include "eval_scenes.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <string_view>
+
+// Benchmark runner for the evaluation scenes
+// Usage: Eval-Benchmark <scene> [--frames N] [--warmup N] [--out report.json] [--headless] [--width W] [--height H]
+//        [--capture dir] [--trace trace.json]
+// The camera follows a scripted path with a fixed timestep, per pass CPU and GPU timings are written as JSON.
+// Headless runs work with a software driver, e.g. VK_DRIVER_FILES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json
+
+namespace
+{
+	constexpr unsigned int RANDOM_SEED = 42;
+
+	/// @brief Path key at the location looking at the target
+	auto lookAt(glm::vec3 location, glm::vec3 target) -> Aegis::CameraPath::Key
+	{
+		glm::vec3 dir = glm::normalize(target - location);
+		float yaw = std::atan2(-dir.x, dir.y);
+		float pitch = std::atan2(dir.z, std::sqrt(dir.x * dir.x + dir.y * dir.y));
+		return Aegis::CameraPath::Key{ .location = location, .rotation = glm::vec3{ pitch, 0.0f, yaw } };
+	}
+
+	/// @brief Circle around the center looking at it
+	auto orbit(glm::vec3 center, float radius, float height, float duration, int keyCount = 9) -> Aegis::CameraPath
+	{
+		Aegis::CameraPath path{ .duration = duration };
+		for (int i = 0; i < keyCount; i++)
+		{
+			float angle = glm::two_pi<float>() * static_cast<float>(i) / static_cast<float>(keyCount - 1);
+			glm::vec3 location = center + glm::vec3{ radius * std::cos(angle), radius * std::sin(angle), height };
+			path.keys.emplace_back(lookAt(location, center));
+		}
+		return path;
+	}
+
+	struct BenchmarkScene
+	{
+		std::function<void(Aegis::Engine&)> load;
+		Aegis::CameraPath cameraPath;
+	};
+
+	auto benchmarkScenes() -> std::map<std::string, BenchmarkScene, std::less<>>
+	{
+		using Aegis::CameraPath;
+		auto key = [](glm::vec3 location, glm::vec3 rotationDegrees) {
+			return CameraPath::Key{ .location = location, .rotation = glm::radians(rotationDegrees) };
+			};
+
+		return {
+			{ "sponza", {
+				[](Aegis::Engine& engine) { engine.loadScene<Sponza>(); },
+				CameraPath{
+					.keys = {
+						key({ -9.75f, 1.2f, 5.25f }, { -12.0f, 0.0f, 263.0f }),
+						key({ -4.0f, 0.0f, 2.0f }, { -5.0f, 0.0f, 270.0f }),
+						key({ 4.0f, 0.0f, 2.0f }, { 0.0f, 0.0f, 300.0f }),
+						key({ 9.0f, -1.0f, 4.0f }, { -10.0f, 0.0f, 420.0f }),
+						key({ 0.0f, 0.0f, 8.0f }, { -30.0f, 0.0f, 450.0f }),
+					},
+					.duration = 20.0f,
+				} } },
+			{ "bistro", {
+				[](Aegis::Engine& engine) { engine.loadScene<Bistro>(); },
+				CameraPath{
+					.keys = {
+						key({ -24.5f, 2.75f, 5.25f }, { -1.5f, 0.0f, -90.0f }),
+						key({ -10.0f, 0.0f, 3.0f }, { 0.0f, 0.0f, -80.0f }),
+						key({ 5.0f, -5.0f, 3.0f }, { 0.0f, 0.0f, -45.0f }),
+						key({ 15.0f, -15.0f, 5.0f }, { -5.0f, 0.0f, 0.0f }),
+					},
+					.duration = 20.0f,
+				} } },
+			{ "highpoly-inside", { [](Aegis::Engine& engine) { engine.loadScene<HighPolyHighObj>(0); },
+				orbit({ 0.0f, 0.0f, 0.0f }, 40.0f, 5.0f, 20.0f) } },
+			{ "highpoly-outside", { [](Aegis::Engine& engine) { engine.loadScene<HighPolyHighObj>(1); },
+				orbit({ 0.0f, 0.0f, 0.0f }, 210.0f, 100.0f, 20.0f) } },
+			{ "lowpoly-inside", { [](Aegis::Engine& engine) { engine.loadScene<LowPolyHighObj>(0); },
+				orbit({ 0.0f, 0.0f, 0.0f }, 40.0f, 5.0f, 20.0f) } },
+			{ "lowpoly-outside", { [](Aegis::Engine& engine) { engine.loadScene<LowPolyHighObj>(1); },
+				orbit({ 0.0f, 0.0f, 0.0f }, 700.0f, 330.0f, 20.0f) } },
+			{ "dynamic", { [](Aegis::Engine& engine) { engine.loadScene<DynamicObjects>(); },
+				orbit({ 0.0f, 0.0f, 0.0f }, 280.0f, 150.0f, 20.0f) } },
+			{ "lucy", { [](Aegis::Engine& engine) { engine.loadScene<Lucy>(); },
+				orbit({ 0.0f, 0.0f, 8.0f }, 20.0f, 6.0f, 20.0f) } },
+		};
+	}
+
+	struct Options
+	{
+		std::string scene{ "sponza" };
+		uint32_t frames{ 1000 };
+		uint32_t warmup{ 120 };
+		uint32_t width{ Aegis::Core::DEFAULT_WIDTH };
+		uint32_t height{ Aegis::Core::DEFAULT_HEIGHT };
+		bool headless{ false };
+		std::filesystem::path report;
+		std::filesystem::path captureDirectory;
+		std::filesystem::path trace;
+	};
+
+	auto parseOptions(int argc, char* argv[]) -> Options
+	{
+		Options options;
+		for (int i = 1; i < argc; i++)
+		{
+			std::string_view arg = argv[i];
+			auto next = [&]() -> std::string_view {
+				if (i + 1 >= argc)
+				{
+					std::cerr << "Missing value for " << arg << "\n";
+					std::exit(EXIT_FAILURE);
+				}
+				return argv[++i];
+				};
+
+			if (arg == "--frames")
+				options.frames = static_cast<uint32_t>(std::stoul(std::string{ next() }));
+			else if (arg == "--warmup")
+				options.warmup = static_cast<uint32_t>(std::stoul(std::string{ next() }));
+			else if (arg == "--width")
+				options.width = static_cast<uint32_t>(std::stoul(std::string{ next() }));
+			else if (arg == "--height")
+				options.height = static_cast<uint32_t>(std::stoul(std::string{ next() }));
+			else if (arg == "--out")
+				options.report = next();
+			else if (arg == "--capture")
+				options.captureDirectory = next();
+			else if (arg == "--trace")
+				options.trace = next();
+			else if (arg == "--headless")
+				options.headless = true;
+			else if (!arg.starts_with("--"))
+				options.scene = arg;
+			else
+			{
+				std::cerr << "Unknown option " << arg << "\n";
+				std::exit(EXIT_FAILURE);
+			}
+		}
+
+		if (options.report.empty())
+			options.report = std::format("benchmark_{}.json", options.scene);
+
+		return options;
+	}
+}
+
+auto main(int argc, char* argv[]) -> int
+{
+	Options options = parseOptions(argc, argv);
+
+	auto scenes = benchmarkScenes();
+	auto it = scenes.find(options.scene);
+	if (it == scenes.end())
+	{
+		std::cerr << "Unknown scene '" << options.scene << "', available scenes:";
+		for (const auto& [name, scene] : scenes)
+			std::cerr << " " << name;
+		std::cerr << "\n";
+		return EXIT_FAILURE;
+	}
+
+	Aegis::BenchmarkSettings settings{
+		.name = options.scene,
+		.cameraPath = it->second.cameraPath,
+		.warmupFrames = options.warmup,
+		.frameCount = options.frames,
+		.reportPath = options.report,
+		.tracePath = options.trace,
+	};
+
+	Aegis::Engine engine{ Aegis::EngineConfig{
+		.headless = options.headless,
+		.width = options.width,
+		.height = options.height,
+		.frameCount = settings.totalFrames(),
+		.fixedFrameTime = settings.frameTime,
+		.captureDirectory = options.captureDirectory,
+	} };
+
+	// Scenes place their objects randomly
+	Aegis::Math::Random::seed(RANDOM_SEED);
+	it->second.load(engine);
+
+	auto& benchmark = Aegis::Engine::layers().push<Aegis::BenchmarkLayer>(Aegis::Engine::scene(), settings);
+	engine.run();
+
+	return benchmark.isFinished() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
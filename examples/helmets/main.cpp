@@ -37,9 +37,7 @@ public:
 
 		// SKYBOX
 		auto& env = registry.get<Graphics::Environment>(scene.environment());
-		env.skybox = Graphics::Texture::loadFromFile(Core::ASSETS_DIR / "Environments/KloppenheimSky.hdr");
-		env.irradiance = Graphics::Texture::irradianceMap(env.skybox);
-		env.prefiltered = Graphics::Texture::prefilteredMap(env.skybox);
+		env = Graphics::IBLCache::loadEnvironment(Core::ASSETS_DIR / "Environments/KloppenheimSky.hdr");
 
 		// LIGHTS
 		registry.get<AmbientLight>(scene.ambientLight()).intensity = 1.0f;
@@ -0,0 +1,225 @@
+module;
+
+#include "core/assert.h"
+
+#include <aegis-log/log.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <map>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+export module Aegis.Benchmark;
+
+import Aegis.Math;
+import Aegis.Core.Layer;
+import Aegis.Core.Profiler;
+import Aegis.Graphics.GPUTimer;
+import Aegis.Graphics.VulkanContext;
+import Aegis.Scene;
+import Aegis.Scene.Components;
+import Aegis.Utils.File;
+import Aegis.Utils.Json;
+
+export namespace Aegis
+{
+	/// @brief Camera keyframes played back over a fixed duration
+	/// @note Locations are interpolated with a Catmull-Rom spline through all keys, rotations are slerped between
+	///       neighbouring keys. The path restarts once the duration has passed.
+	struct CameraPath
+	{
+		struct Key
+		{
+			glm::vec3 location{ 0.0f };
+			glm::quat rotation{ 1.0f, 0.0f, 0.0f, 0.0f };
+		};
+
+		std::vector<Key> keys;
+		float duration{ 10.0f };
+
+		/// @brief Camera transform at the given time in seconds
+		[[nodiscard]] auto evaluate(float time) const -> Transform
+		{
+			AGX_ASSERT_X(!keys.empty(), "Camera path has no keys");
+			if (keys.size() == 1 || duration <= 0.0f)
+				return Transform{ .location = keys.front().location, .rotation = keys.front().rotation };
+
+			float t = std::fmod(time, duration) / duration;
+			float segmentPos = t * static_cast<float>(keys.size() - 1);
+			std::size_t segment = std::min(static_cast<std::size_t>(segmentPos), keys.size() - 2);
+			float localT = segmentPos - static_cast<float>(segment);
+
+			const auto& p0 = keys[segment == 0 ? 0 : segment - 1];
+			const auto& p1 = keys[segment];
+			const auto& p2 = keys[segment + 1];
+			const auto& p3 = keys[std::min(segment + 2, keys.size() - 1)];
+			return Transform{
+				.location = Math::catmullRom(p0.location, p1.location, p2.location, p3.location, localT),
+				.rotation = glm::slerp(p1.rotation, p2.rotation, localT),
+			};
+		}
+	};
+
+	/// @brief Summary of the samples of one timer in milliseconds
+	struct TimingStatistics
+	{
+		std::size_t count{ 0 };
+		double min{ 0.0 };
+		double max{ 0.0 };
+		double mean{ 0.0 };
+		double p50{ 0.0 };
+		double p95{ 0.0 };
+		double p99{ 0.0 };
+
+		[[nodiscard]] static auto compute(std::vector<double> samples) -> TimingStatistics
+		{
+			if (samples.empty())
+				return {};
+
+			std::ranges::sort(samples);
+			double sum = 0.0;
+			for (double sample : samples)
+				sum += sample;
+
+			// Nearest rank percentile
+			auto percentile = [&samples](double p) {
+				auto rank = static_cast<std::size_t>(std::ceil(p / 100.0 * static_cast<double>(samples.size())));
+				return samples[std::clamp<std::size_t>(rank, 1, samples.size()) - 1];
+				};
+
+			return TimingStatistics{
+				.count = samples.size(),
+				.min = samples.front(),
+				.max = samples.back(),
+				.mean = sum / static_cast<double>(samples.size()),
+				.p50 = percentile(50.0),
+				.p95 = percentile(95.0),
+				.p99 = percentile(99.0),
+			};
+		}
+	};
+
+	struct BenchmarkSettings
+	{
+		std::string name;
+		CameraPath cameraPath;
+		uint32_t warmupFrames{ 120 };
+		uint32_t frameCount{ 1000 };
+		float frameTime{ 1.0f / 60.0f };	///< Fixed timestep in seconds, the engine has to be run with the same value
+		std::filesystem::path reportPath;
+		std::filesystem::path tracePath;	///< Trace of the measured frames is written if not empty
+
+		/// @brief Frames the engine has to run until the report is written
+		[[nodiscard]] auto totalFrames() const -> uint32_t { return warmupFrames + frameCount + 1; }
+	};
+
+	/// @brief Moves the main camera along the path and records per pass CPU and GPU timings of every frame
+	/// @note Samples are taken after the warmup frames. The timings read in an update belong to earlier frames (the
+	///       last CPU frame, the GPU frame MAX_FRAMES_IN_FLIGHT frames back), which shifts but does not change the set
+	///       of measured frames. The report is written as JSON once all frames are recorded.
+	class BenchmarkLayer : public Core::Layer
+	{
+	public:
+		BenchmarkLayer(Scene::Scene& scene, BenchmarkSettings settings) :
+			m_scene{ scene },
+			m_settings{ std::move(settings) }
+		{
+		}
+
+		[[nodiscard]] auto isFinished() const -> bool { return m_finished; }
+
+		virtual void onUpdate(float deltaSeconds) override
+		{
+			if (m_finished)
+				return;
+
+			// Time is derived from the frame count so the path does not depend on the measured frame time
+			auto& camera = m_scene.registry().get<Transform>(m_scene.mainCamera());
+			Transform pathTransform = m_settings.cameraPath.evaluate(static_cast<float>(m_frame) * m_settings.frameTime);
+			camera.location = pathTransform.location;
+			camera.rotation = pathTransform.rotation;
+
+			if (m_frame > m_settings.warmupFrames)
+				recordFrame();
+			else if (m_frame == m_settings.warmupFrames && !m_settings.tracePath.empty())
+				Profiler::instance().beginCapture();
+
+			m_frame++;
+			if (m_frame >= m_settings.totalFrames())
+			{
+				m_finished = true;
+				writeReport();
+				if (!m_settings.tracePath.empty())
+					Profiler::instance().endCapture(m_settings.tracePath);
+			}
+		}
+
+	private:
+		using SampleMap = std::map<std::string, std::vector<double>>;
+
+		void recordFrame()
+		{
+			const auto& profiler = Profiler::instance();
+			for (const auto& scope : profiler.scopes())
+			{
+				if (profiler.recordedLastFrame(scope))
+					m_cpuSamples[std::string{ scope.name }].push_back(scope.times.last());
+			}
+
+			for (const auto& result : Graphics::GPUTimerManager::instance().timings())
+				m_gpuSamples[std::string{ result.name }].push_back(result.timeMs);
+		}
+
+		void writeReport() const
+		{
+			const auto& properties = Graphics::VulkanContext::device().properties();
+
+			std::string json = "{\n";
+			json += std::format("\t\"name\": \"{}\",\n", Utils::Json::escape(m_settings.name));
+			json += std::format("\t\"device\": \"{}\",\n", Utils::Json::escape(properties.deviceName));
+			json += std::format("\t\"warmupFrames\": {},\n", m_settings.warmupFrames);
+			json += std::format("\t\"frames\": {},\n", m_settings.frameCount);
+			json += std::format("\t\"frameTime\": {},\n", m_settings.frameTime);
+			json += std::format("\t\"cpu\": {},\n", formatSamples(m_cpuSamples));
+			json += std::format("\t\"gpu\": {}\n", formatSamples(m_gpuSamples));
+			json += "}\n";
+
+			if (!Utils::File::writeBinaryAtomic(m_settings.reportPath, std::as_bytes(std::span{ json })))
+			{
+				ALOG::warn("Failed to write benchmark report '{}'", m_settings.reportPath.string());
+				return;
+			}
+			ALOG::info("Benchmark '{}' finished, report written to '{}'", m_settings.name, m_settings.reportPath.string());
+		}
+
+		static auto formatSamples(const SampleMap& samples) -> std::string
+		{
+			std::string json = "{";
+			const char* separator = "\n";
+			for (const auto& [name, values] : samples)
+			{
+				auto stats = TimingStatistics::compute(values);
+				json += std::format("{}\t\t\"{}\": {{ \"count\": {}, \"min\": {:.4f}, \"mean\": {:.4f}, \"p50\": {:.4f}, "
+					"\"p95\": {:.4f}, \"p99\": {:.4f}, \"max\": {:.4f} }}", separator, Utils::Json::escape(name),
+					stats.count, stats.min, stats.mean, stats.p50, stats.p95, stats.p99, stats.max);
+				separator = ",\n";
+			}
+			json += samples.empty() ? "}" : "\n\t}";
+			return json;
+		}
+
+		Scene::Scene& m_scene;
+		BenchmarkSettings m_settings;
+		uint32_t m_frame{ 0 };
+		bool m_finished{ false };
+		SampleMap m_cpuSamples;
+		SampleMap m_gpuSamples;
+	};
+}
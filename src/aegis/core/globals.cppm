@@ -19,4 +19,5 @@ export namespace Aegis::Core
 	const std::filesystem::path ENGINE_DIR{ PROJECT_DIR "/"};
 	const std::filesystem::path SHADER_DIR{ BUILD_DIR "/shaders/" };
 	const std::filesystem::path ASSETS_DIR{ PROJECT_DIR "/modules/aegis-assets/" };
+	const std::filesystem::path CACHE_DIR{ BUILD_DIR "/cache/" };
 }
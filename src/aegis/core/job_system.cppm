@@ -0,0 +1,403 @@
+module;
+
+#include "core/assert.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <format>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+export module Aegis.Core.JobSystem;
+
+import Aegis.Core.Profiler;
+
+export namespace Aegis::Core
+{
+	using Job = std::function<void()>;
+
+	/// @brief Counts outstanding jobs, used to wait for a group of jobs to finish
+	class JobCounter
+	{
+	public:
+		JobCounter() = default;
+		JobCounter(const JobCounter&) = delete;
+		JobCounter(JobCounter&&) = delete;
+		~JobCounter() = default;
+
+		auto operator=(const JobCounter&) -> JobCounter & = delete;
+		auto operator=(JobCounter&&) -> JobCounter & = delete;
+
+		[[nodiscard]] auto isDone() const -> bool { return m_pending.load(std::memory_order_acquire) == 0; }
+		[[nodiscard]] auto pending() const -> uint32_t { return m_pending.load(std::memory_order_relaxed); }
+
+		void increment(uint32_t count = 1) { m_pending.fetch_add(count, std::memory_order_relaxed); }
+		void decrement() { m_pending.fetch_sub(1, std::memory_order_acq_rel); }
+
+	private:
+		std::atomic<uint32_t> m_pending{ 0 };
+	};
+
+
+	/// @brief Fixed pool of worker threads with one job queue per worker
+	/// @note Workers pop jobs from the back of their own queue and steal from the front of other queues when idle
+	class JobSystem
+	{
+	public:
+		static constexpr std::size_t DEFAULT_GRAIN_SIZE = 256;
+
+		explicit JobSystem(uint32_t workerCount = defaultWorkerCount())
+		{
+			AGX_ASSERT_X(!s_instance, "JobSystem instance already exists!");
+			s_instance = this;
+
+			// Queue 0 belongs to the thread that created the job system (usually the main thread)
+			m_queues.reserve(workerCount + 1);
+			for (uint32_t i = 0; i < workerCount + 1; i++)
+			{
+				m_queues.emplace_back(std::make_unique<WorkerQueue>());
+			}
+
+			m_workers.reserve(workerCount);
+			for (uint32_t i = 0; i < workerCount; i++)
+			{
+				m_workers.emplace_back([this, i]() { workerLoop(i + 1); });
+			}
+		}
+
+		JobSystem(const JobSystem&) = delete;
+		JobSystem(JobSystem&&) = delete;
+		~JobSystem()
+		{
+			// Queued jobs still run (they may own resources or signal counters), workers help until the queues are empty
+			while (m_queuedJobs.load(std::memory_order_acquire) > 0)
+			{
+				if (!executeNext(currentQueue()))
+				{
+					std::this_thread::yield();
+				}
+			}
+
+			{
+				std::lock_guard lock{ m_sleepMutex };
+				m_running = false;
+			}
+			m_wakeUp.notify_all();
+
+			for (auto& worker : m_workers)
+			{
+				worker.join();
+			}
+
+			s_instance = nullptr;
+		}
+
+		auto operator=(const JobSystem&) -> JobSystem & = delete;
+		auto operator=(JobSystem&&) -> JobSystem & = delete;
+
+		[[nodiscard]] static auto instance() -> JobSystem&
+		{
+			AGX_ASSERT_X(s_instance, "JobSystem instance not initialized!");
+			return *s_instance;
+		}
+
+		[[nodiscard]] static auto defaultWorkerCount() -> uint32_t
+		{
+			uint32_t threads = std::thread::hardware_concurrency();
+			return threads > 1 ? threads - 1 : 0;
+		}
+
+		/// @brief Number of worker threads (excluding the main thread)
+		[[nodiscard]] auto workerCount() const -> uint32_t { return static_cast<uint32_t>(m_workers.size()); }
+
+		/// @brief Number of threads executing jobs (including the waiting thread)
+		[[nodiscard]] auto threadCount() const -> uint32_t { return workerCount() + 1; }
+
+		/// @brief Queues a job, the counter (if any) is decremented once the job has finished
+		void submit(Job job, JobCounter* counter = nullptr)
+		{
+			if (counter)
+				counter->increment();
+
+			auto& queue = *m_queues[currentQueue()];
+			{
+				std::lock_guard lock{ queue.mutex };
+				queue.jobs.emplace_back(std::move(job), counter);
+			}
+
+			m_queuedJobs.fetch_add(1, std::memory_order_release);
+			{
+				std::lock_guard lock{ m_sleepMutex };
+			}
+			m_wakeUp.notify_one();
+		}
+
+		/// @brief Blocks until the counter reaches zero, the calling thread executes jobs while waiting
+		void wait(const JobCounter& counter)
+		{
+			while (!counter.isDone())
+			{
+				if (!executeNext(currentQueue()))
+				{
+					std::this_thread::yield();
+				}
+			}
+		}
+
+		/// @brief Executes one queued job on the calling thread, returns false if there was none
+		/// @note Lets a thread that waits for something other than a counter help out in the meantime
+		auto tryExecute() -> bool
+		{
+			return executeNext(currentQueue());
+		}
+
+		/// @brief Splits [0, count) into chunks of grainSize and calls func(begin, end) for each chunk in parallel
+		/// @note Blocks until all chunks have been processed
+		template<typename Func>
+		void parallelFor(std::size_t count, std::size_t grainSize, Func&& func)
+		{
+			if (count == 0)
+				return;
+
+			grainSize = std::max<std::size_t>(grainSize, 1);
+			if (count <= grainSize || m_workers.empty())
+			{
+				func(std::size_t{ 0 }, count);
+				return;
+			}
+
+			// Avoid creating more chunks than useful while still allowing stealing for uneven work
+			std::size_t maxChunks = static_cast<std::size_t>(threadCount()) * 4;
+			std::size_t chunkSize = std::max(grainSize, (count + maxChunks - 1) / maxChunks);
+
+			JobCounter counter;
+			for (std::size_t begin = chunkSize; begin < count; begin += chunkSize)
+			{
+				std::size_t end = std::min(begin + chunkSize, count);
+				submit([&func, begin, end]() { func(begin, end); }, &counter);
+			}
+
+			// The calling thread takes the first chunk itself
+			func(std::size_t{ 0 }, std::min(chunkSize, count));
+			wait(counter);
+		}
+
+		template<typename Func>
+		void parallelFor(std::size_t count, Func&& func)
+		{
+			parallelFor(count, DEFAULT_GRAIN_SIZE, std::forward<Func>(func));
+		}
+
+		/// @brief Calls func(entity, components...) for every entity of an entt view in parallel
+		/// @note The view is split by its leading storage, func must not add or remove components
+		template<typename View, typename Func>
+		void parallelEach(View& view, Func&& func, std::size_t grainSize = DEFAULT_GRAIN_SIZE)
+		{
+			auto* storage = view.handle();
+			if (!storage)
+				return;
+
+			parallelFor(storage->size(), grainSize, [&view, &func, storage](std::size_t begin, std::size_t end) {
+				for (std::size_t i = begin; i < end; i++)
+				{
+					auto entity = (*storage)[i];
+					if (!view.contains(entity))
+						continue;
+
+					std::apply(func, std::tuple_cat(std::make_tuple(entity), view.get(entity)));
+				}
+				});
+		}
+
+	private:
+		struct Entry
+		{
+			Job job;
+			JobCounter* counter{ nullptr };
+		};
+
+		struct WorkerQueue
+		{
+			std::mutex mutex;
+			std::deque<Entry> jobs;
+		};
+
+		auto currentQueue() const -> uint32_t
+		{
+			// Threads not owned by the job system share the first queue
+			return t_owner == this ? t_queueIndex : 0;
+		}
+
+		auto popLocal(uint32_t index, Entry& entry) -> bool
+		{
+			auto& queue = *m_queues[index];
+			std::lock_guard lock{ queue.mutex };
+			if (queue.jobs.empty())
+				return false;
+
+			entry = std::move(queue.jobs.back());
+			queue.jobs.pop_back();
+			return true;
+		}
+
+		auto steal(uint32_t thief, Entry& entry) -> bool
+		{
+			uint32_t queueCount = static_cast<uint32_t>(m_queues.size());
+			for (uint32_t offset = 1; offset < queueCount; offset++)
+			{
+				auto& queue = *m_queues[(thief + offset) % queueCount];
+				std::unique_lock lock{ queue.mutex, std::try_to_lock };
+				if (!lock.owns_lock() || queue.jobs.empty())
+					continue;
+
+				entry = std::move(queue.jobs.front());
+				queue.jobs.pop_front();
+				return true;
+			}
+			return false;
+		}
+
+		auto executeNext(uint32_t index) -> bool
+		{
+			Entry entry;
+			if (!popLocal(index, entry) && !steal(index, entry))
+				return false;
+
+			m_queuedJobs.fetch_sub(1, std::memory_order_acq_rel);
+			entry.job();
+			if (entry.counter)
+				entry.counter->decrement();
+
+			return true;
+		}
+
+		void workerLoop(uint32_t index)
+		{
+			t_owner = this;
+			t_queueIndex = index;
+			Profiler::instance().setThreadName(std::format("Worker {}", index));
+
+			while (true)
+			{
+				if (executeNext(index))
+					continue;
+
+				std::unique_lock lock{ m_sleepMutex };
+				m_wakeUp.wait(lock, [this]() {
+					return !m_running || m_queuedJobs.load(std::memory_order_acquire) > 0;
+					});
+
+				if (!m_running)
+					break;
+			}
+		}
+
+		inline static JobSystem* s_instance{ nullptr };
+		inline static thread_local const JobSystem* t_owner{ nullptr };
+		inline static thread_local uint32_t t_queueIndex{ 0 };
+
+		std::vector<std::unique_ptr<WorkerQueue>> m_queues;
+		std::vector<std::thread> m_workers;
+		std::atomic<int64_t> m_queuedJobs{ 0 };
+		std::mutex m_sleepMutex;
+		std::condition_variable m_wakeUp;
+		bool m_running{ true };
+	};
+
+
+	/// @brief Set of jobs with dependencies, a job is only started once all of its dependencies have finished
+	class JobGraph
+	{
+	public:
+		using NodeID = uint32_t;
+
+		JobGraph() = default;
+		JobGraph(const JobGraph&) = delete;
+		JobGraph(JobGraph&&) = default;
+		~JobGraph() = default;
+
+		auto operator=(const JobGraph&) -> JobGraph & = delete;
+		auto operator=(JobGraph&&) -> JobGraph & = default;
+
+		[[nodiscard]] auto size() const -> std::size_t { return m_nodes.size(); }
+		[[nodiscard]] auto empty() const -> bool { return m_nodes.empty(); }
+
+		auto add(Job job) -> NodeID
+		{
+			m_nodes.emplace_back(std::make_unique<Node>(std::move(job)));
+			return static_cast<NodeID>(m_nodes.size() - 1);
+		}
+
+		/// @brief The job 'after' is started once the job 'before' has finished
+		void addDependency(NodeID before, NodeID after)
+		{
+			AGX_ASSERT_X(before < m_nodes.size() && after < m_nodes.size(), "Invalid job graph node");
+			AGX_ASSERT_X(before != after, "Job cannot depend on itself");
+
+			m_nodes[before]->successors.emplace_back(after);
+			m_nodes[after]->dependencyCount++;
+		}
+
+		void clear()
+		{
+			m_nodes.clear();
+		}
+
+		/// @brief Executes all jobs of the graph and blocks until all of them have finished
+		/// @note The graph can be run multiple times
+		void run(JobSystem& jobSystem)
+		{
+			for (auto& node : m_nodes)
+			{
+				node->remaining.store(node->dependencyCount, std::memory_order_relaxed);
+			}
+
+			JobCounter counter;
+			for (NodeID id = 0; id < static_cast<NodeID>(m_nodes.size()); id++)
+			{
+				if (m_nodes[id]->dependencyCount == 0)
+				{
+					schedule(jobSystem, id, counter);
+				}
+			}
+			jobSystem.wait(counter);
+		}
+
+	private:
+		struct Node
+		{
+			explicit Node(Job j) : job{ std::move(j) } {}
+
+			Job job;
+			std::vector<NodeID> successors;
+			uint32_t dependencyCount{ 0 };
+			std::atomic<uint32_t> remaining{ 0 };
+		};
+
+		void schedule(JobSystem& jobSystem, NodeID id, JobCounter& counter)
+		{
+			jobSystem.submit([this, &jobSystem, &counter, id]() {
+				auto& node = *m_nodes[id];
+				node.job();
+
+				// Successors are queued before this job counts as finished, so the counter cannot reach zero early
+				for (NodeID successor : node.successors)
+				{
+					if (m_nodes[successor]->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+					{
+						schedule(jobSystem, successor, counter);
+					}
+				}
+				}, &counter);
+		}
+
+		std::vector<std::unique_ptr<Node>> m_nodes;
+	};
+}
@@ -1,26 +1,85 @@
 module;
 
-#include <unordered_map>
+#include <aegis-log/log.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <span>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define AGX_PROFILER_TSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define AGX_PROFILER_TSC 1
+#else
+#define AGX_PROFILER_TSC 0
+#endif
 
 export module Aegis.Core.Profiler;
 
+import Aegis.Utils.File;
+import Aegis.Utils.Json;
 import Aegis.Utils.RollingAverage;
-import Aegis.Utils.Timer;
-
-#define AGX_PROFILE_SCOPE(name) Aegis::ScopeProfiler profiler##__LINE__(name)
-#define AGX_PROFILE_FUNCTION() AGX_PROFILE_SCOPE(__FUNCTION__)
 
 export namespace Aegis
 {
-	/// @brief Utility class for profiling code execution
-	/// @note Uses a rolling average over 'AVERAGE_FRAME_COUNT' frames
+	/// @brief Interned scope name (see Profiler::registerScope and operator""_scope)
+	using ScopeID = uint32_t;
+
+	/// @brief String literal usable as template argument
+	template<std::size_t N>
+	struct ScopeName
+	{
+		consteval ScopeName(const char(&name)[N]) { std::copy_n(name, N, value); }
+
+		[[nodiscard]] constexpr auto view() const -> std::string_view { return { value, N - 1 }; }
+
+		char value[N]{};
+	};
+
+	/// @brief Low overhead profiler for the main thread and the job system workers
+	/// @note Scopes write complete events (id, begin, end) into a ring buffer owned by the recording thread, which
+	///       takes no lock. The main thread collects all events once per frame in beginFrame(), turns them into rolling
+	///       averages per scope (summed per frame) and appends them to a running trace capture. Timestamps are CPU ticks
+	///       (TSC on x86), they are converted to nanoseconds since the profiler was created when collected.
+	///       Statistics and captures may only be accessed from the main thread.
 	class Profiler
 	{
 	public:
 		static constexpr int AVERAGE_FRAME_COUNT = 50;
+		static constexpr std::size_t EVENT_BUFFER_SIZE = 1 << 13;
+		static constexpr uint32_t GPU_THREAD = UINT32_MAX;
 
-		using TimeMap = std::unordered_map<std::string, Utils::RollingAverage<AVERAGE_FRAME_COUNT>>;
+		/// @brief Event on the profiler timeline (nanoseconds since the profiler was created)
+		struct Event
+		{
+			ScopeID id;
+			uint32_t thread;
+			uint64_t begin;
+			uint64_t end;
+		};
+
+		struct ScopeStats
+		{
+			std::string_view name;
+			Utils::RollingAverage<AVERAGE_FRAME_COUNT> times;
+			uint64_t lastFrame{ 0 };	///< Frame of the latest events, only valid if recorded
+			bool recorded{ false };
+		};
 
 		Profiler(const Profiler&) = delete;
 		Profiler(Profiler&&) = delete;
@@ -35,56 +94,402 @@ export namespace Aegis
 			return instance;
 		}
 
+		/// @brief Cheap timestamp in profiler ticks (only meaningful relative to other ticks)
+		[[nodiscard]] static auto now() -> uint64_t
+		{
+#if AGX_PROFILER_TSC
+			return __rdtsc();
+#else
+			return steadyNanos();
+#endif
+		}
+
+		[[nodiscard]] static auto steadyNanos() -> uint64_t
+		{
+			using namespace std::chrono;
+			return static_cast<uint64_t>(duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count());
+		}
+
+		/// @brief Id of the scope name, the name is stored once and lives as long as the profiler
+		/// @note Takes a lock, names known at compile time should use operator""_scope, runtime names should be
+		///       registered once and the id reused
+		auto registerScope(std::string_view name) -> ScopeID
+		{
+			std::lock_guard lock{ m_scopeMutex };
+			if (auto it = m_scopeIDs.find(name); it != m_scopeIDs.end())
+				return it->second;
+
+			const auto& stored = m_scopeNames.emplace_back(name);
+			auto id = static_cast<ScopeID>(m_scopeNames.size() - 1);
+			m_scopeIDs.emplace(stored, id);
+			return id;
+		}
+
+		/// @brief Id of a compile time scope name, registered on first use
+		template<ScopeName Name>
+		[[nodiscard]] static auto scope() -> ScopeID
+		{
+			static const ScopeID id = instance().registerScope(Name.view());
+			return id;
+		}
+
+		[[nodiscard]] auto scopeName(ScopeID id) -> std::string_view
+		{
+			std::lock_guard lock{ m_scopeMutex };
+			return m_scopeNames[id];
+		}
+
+		/// @brief Name of the calling thread in traces
+		void setThreadName(std::string_view name)
+		{
+			auto& buffer = threadBuffer();
+			std::lock_guard lock{ m_threadMutex };
+			buffer.name = name;
+		}
+
+		/// @brief Records a CPU event of the calling thread, lock free
+		void record(ScopeID id, uint64_t begin, uint64_t end)
+		{
+			auto& buffer = threadBuffer();
+			uint64_t head = buffer.head.load(std::memory_order_relaxed);
+			buffer.events[head % EVENT_BUFFER_SIZE] = RawEvent{ id, begin, end };
+			buffer.head.store(head + 1, std::memory_order_release);
+		}
+
+		/// @brief Records a GPU event given in steady clock nanoseconds, only kept while capturing (main thread)
+		void recordGPU(ScopeID id, uint64_t beginSteadyNs, uint64_t endSteadyNs)
+		{
+			if (!m_capturing)
+				return;
+
+			m_gpuEvents.emplace_back(id, GPU_THREAD, fromSteady(beginSteadyNs), fromSteady(endSteadyNs));
+		}
+
+		/// @brief Collects the events recorded since the last call, has to be called once per frame on the main thread
+		void beginFrame()
+		{
+			// Workers may have registered their buffers first, frame markers go onto the timeline of this thread
+			m_mainThread = threadBuffer().index;
+			calibrate();
+			uint64_t frameBegin = fromSteady(steadyNanos());
+
+			m_frameEvents.clear();
+			{
+				std::lock_guard lock{ m_threadMutex };
+				for (auto& buffer : m_threads)
+					collect(*buffer);
+			}
+
+			updateStats();
+
+			if (m_capturing)
+			{
+				m_capture.insert(m_capture.end(), m_frameEvents.begin(), m_frameEvents.end());
+				m_capture.insert(m_capture.end(), m_gpuEvents.begin(), m_gpuEvents.end());
+				m_gpuEvents.clear();
+				m_captureFrames.emplace_back(m_frame, frameBegin);
+
+				if (m_captureFramesLeft > 0 && --m_captureFramesLeft == 0)
+					endCapture(m_capturePath);
+			}
+
+			m_frame++;
+		}
+
+		[[nodiscard]] auto frame() const -> uint64_t { return m_frame; }
+		[[nodiscard]] auto droppedEvents() const -> uint64_t { return m_droppedEvents; }
+		[[nodiscard]] auto isCapturing() const -> bool { return m_capturing; }
+
+		/// @brief Per scope times in milliseconds indexed by id, scopes that were never recorded are not set
+		[[nodiscard]] auto scopes() const -> const std::vector<ScopeStats>& { return m_stats; }
+
+		/// @brief Whether the scope has events in the frame collected by the last beginFrame
+		/// @note Scopes that were skipped keep their last time, which must not be sampled again
+		[[nodiscard]] auto recordedLastFrame(const ScopeStats& stats) const -> bool
+		{
+			return stats.recorded && stats.lastFrame + 1 == m_frame;
+		}
+
 		/// @brief Retrieve the average time for a given name or 0.0 if not found
-		[[nodiscard]] auto time(const std::string& name) const -> double
+		[[nodiscard]] auto time(std::string_view name) -> double
 		{
-			auto it = m_times.find(name);
-			if (it == m_times.end())
-				return 0.0;
-			return it->second.average();
+			auto stats = find(name);
+			return stats ? stats->times.average() : 0.0;
 		}
 
 		/// @brief Retrieve the last recorded time
-		[[nodiscard]] auto lastTime(const std::string& name) const -> double
+		[[nodiscard]] auto lastTime(std::string_view name) -> double
 		{
-			auto it = m_times.find(name);
-			if (it == m_times.end())
-				return 0.0;
-			return it->second.last();
+			auto stats = find(name);
+			return stats ? stats->times.last() : 0.0;
 		}
 
-		[[nodiscard]] auto times() const -> const TimeMap&
+		/// @brief Starts collecting events for a trace
+		void beginCapture()
 		{
-			return m_times;
+			if (m_capturing)
+				return;
+
+			m_capturing = true;
+			m_captureFramesLeft = 0;
+			m_capture.clear();
+			m_captureFrames.clear();
+			m_gpuEvents.clear();
 		}
 
-		void addTime(const std::string& name, double time)
+		/// @brief Captures the following frames and writes the trace once they are collected
+		void captureFrames(uint32_t count, const std::filesystem::path& path)
 		{
-			m_times[name].add(time);
+			beginCapture();
+			m_captureFramesLeft = std::max(count, 1u);
+			m_capturePath = path;
+		}
+
+		/// @brief Stops capturing and writes the trace in Chrome trace event format (chrome://tracing, Perfetto)
+		auto endCapture(const std::filesystem::path& path) -> bool
+		{
+			if (!m_capturing)
+				return false;
+
+			m_capturing = false;
+			bool written = writeTrace(path);
+			if (written)
+			{
+				ALOG::info("Wrote trace of {} frames to '{}'", m_captureFrames.size(), path.string());
+			}
+			else
+			{
+				ALOG::warn("Failed to write trace '{}'", path.string());
+			}
+
+			m_capture.clear();
+			m_captureFrames.clear();
+			return written;
 		}
 
 	private:
-		Profiler() = default;
+		struct RawEvent
+		{
+			ScopeID id;
+			uint64_t begin;
+			uint64_t end;
+		};
+
+		/// @brief Single producer (the owning thread), single consumer (beginFrame) ring buffer
+		struct ThreadBuffer
+		{
+			std::array<RawEvent, EVENT_BUFFER_SIZE> events;
+			std::atomic<uint64_t> head{ 0 };
+			uint64_t tail{ 0 };
+			uint32_t index{ 0 };
+			std::string name;
+		};
+
+		Profiler() :
+			m_startTicks{ now() },
+			m_startNs{ steadyNanos() }
+		{
+#if AGX_PROFILER_TSC
+			// Rough tick rate until enough time has passed for beginFrame to refine it
+			while (steadyNanos() - m_startNs < 1'000'000) {}
+			calibrate();
+#endif
+		}
+
+		auto threadBuffer() -> ThreadBuffer&
+		{
+			thread_local ThreadBuffer* t_buffer = nullptr;
+			if (!t_buffer) [[unlikely]]
+			{
+				std::lock_guard lock{ m_threadMutex };
+				auto& buffer = m_threads.emplace_back(std::make_unique<ThreadBuffer>());
+				buffer->index = static_cast<uint32_t>(m_threads.size() - 1);
+				buffer->name = std::format("Thread {}", buffer->index);
+				t_buffer = buffer.get();
+			}
+			return *t_buffer;
+		}
+
+		void calibrate()
+		{
+#if AGX_PROFILER_TSC
+			uint64_t ticks = now();
+			uint64_t ns = steadyNanos();
+			if (ticks > m_startTicks)
+				m_nsPerTick = static_cast<double>(ns - m_startNs) / static_cast<double>(ticks - m_startTicks);
+#endif
+		}
+
+		[[nodiscard]] auto toTimeline(uint64_t ticks) const -> uint64_t
+		{
+			if (ticks <= m_startTicks)
+				return 0;
+#if AGX_PROFILER_TSC
+			return static_cast<uint64_t>(static_cast<double>(ticks - m_startTicks) * m_nsPerTick);
+#else
+			return ticks - m_startTicks;
+#endif
+		}
+
+		[[nodiscard]] auto fromSteady(uint64_t steadyNs) const -> uint64_t
+		{
+			return steadyNs > m_startNs ? steadyNs - m_startNs : 0;
+		}
+
+		/// @brief Moves the new events of the buffer to the frame events
+		/// @note Events the thread overwrote before or while they were copied are dropped. record() writes slot
+		///       head % N before it publishes head + 1, so the slot of the oldest event may already be in use and only
+		///       N - 1 events are kept between two collects.
+		void collect(ThreadBuffer& buffer)
+		{
+			uint64_t head = buffer.head.load(std::memory_order_acquire);
+			uint64_t first = std::max(buffer.tail, head + 1 > EVENT_BUFFER_SIZE ? head + 1 - EVENT_BUFFER_SIZE : 0);
 
-		TimeMap m_times;
+			std::size_t offset = m_frameEvents.size();
+			for (uint64_t i = first; i < head; i++)
+			{
+				const auto& raw = buffer.events[i % EVENT_BUFFER_SIZE];
+				m_frameEvents.emplace_back(raw.id, buffer.index, toTimeline(raw.begin), toTimeline(raw.end));
+			}
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			uint64_t newHead = buffer.head.load(std::memory_order_relaxed);
+			uint64_t oldestValid = newHead + 1 > EVENT_BUFFER_SIZE ? newHead + 1 - EVENT_BUFFER_SIZE : 0;
+			uint64_t overwritten = oldestValid > first ? std::min(oldestValid, head) - first : 0;
+			m_frameEvents.erase(m_frameEvents.begin() + offset, m_frameEvents.begin() + offset + overwritten);
+
+			m_droppedEvents += (first - buffer.tail) + overwritten;
+			buffer.tail = head;
+		}
+
+		void updateStats()
+		{
+			{
+				std::lock_guard lock{ m_scopeMutex };
+				for (std::size_t id = m_stats.size(); id < m_scopeNames.size(); id++)
+					m_stats.emplace_back(m_scopeNames[id]);
+			}
+
+			m_frameTotals.assign(m_stats.size(), -1.0);
+			for (const auto& event : m_frameEvents)
+			{
+				double ms = static_cast<double>(event.end - event.begin) / 1'000'000.0;
+				double& total = m_frameTotals[event.id];
+				total = total < 0.0 ? ms : total + ms;
+			}
+
+			for (std::size_t id = 0; id < m_frameTotals.size(); id++)
+			{
+				if (m_frameTotals[id] < 0.0)
+					continue;
+
+				m_stats[id].times.add(m_frameTotals[id]);
+				m_stats[id].lastFrame = m_frame;
+				m_stats[id].recorded = true;
+			}
+		}
+
+		[[nodiscard]] auto find(std::string_view name) -> const ScopeStats*
+		{
+			std::lock_guard lock{ m_scopeMutex };
+			auto it = m_scopeIDs.find(name);
+			if (it == m_scopeIDs.end() || it->second >= m_stats.size())
+				return nullptr;
+			return &m_stats[it->second];
+		}
+
+		auto writeTrace(const std::filesystem::path& path) -> bool
+		{
+			std::string json;
+			json.reserve(m_capture.size() * 96);
+			json += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+			json += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"CPU\"}},\n";
+			json += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":2,\"args\":{\"name\":\"GPU\"}}";
+			{
+				std::lock_guard lock{ m_threadMutex };
+				for (const auto& buffer : m_threads)
+				{
+					json += std::format(",\n{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":{},\"args\":{{\"name\":\"{}\"}}}}",
+						buffer->index, Utils::Json::escape(buffer->name));
+				}
+			}
+
+			for (const auto& [frame, begin] : m_captureFrames)
+			{
+				json += std::format(",\n{{\"name\":\"Frame {}\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":{},\"ts\":{:.3f}}}",
+					frame, m_mainThread, static_cast<double>(begin) / 1000.0);
+			}
+
+			{
+				std::lock_guard lock{ m_scopeMutex };
+				for (const auto& event : m_capture)
+				{
+					bool gpu = event.thread == GPU_THREAD;
+					json += std::format(",\n{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":{},\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}}}",
+						Utils::Json::escape(m_scopeNames[event.id]), gpu ? 2 : 1, gpu ? 0 : event.thread,
+						static_cast<double>(event.begin) / 1000.0, static_cast<double>(event.end - event.begin) / 1000.0);
+				}
+			}
+			json += "\n]}\n";
+
+			return Utils::File::writeBinaryAtomic(path, std::as_bytes(std::span{ json }));
+		}
+
+		uint64_t m_startTicks;
+		uint64_t m_startNs;
+		double m_nsPerTick{ 1.0 };
+
+		std::mutex m_scopeMutex;
+		std::deque<std::string> m_scopeNames;
+		std::unordered_map<std::string_view, ScopeID> m_scopeIDs;
+
+		std::mutex m_threadMutex;
+		std::vector<std::unique_ptr<ThreadBuffer>> m_threads;
+
+		uint32_t m_mainThread{ 0 };
+		uint64_t m_frame{ 0 };
+		uint64_t m_droppedEvents{ 0 };
+		std::vector<Event> m_frameEvents;
+		std::vector<double> m_frameTotals;
+		std::vector<ScopeStats> m_stats;
+
+		bool m_capturing{ false };
+		uint32_t m_captureFramesLeft{ 0 };
+		std::filesystem::path m_capturePath;
+		std::vector<Event> m_capture;
+		std::vector<Event> m_gpuEvents;
+		std::vector<std::pair<uint64_t, uint64_t>> m_captureFrames;
 	};
 
+	/// @brief Id of a scope name known at compile time, e.g. ScopeProfiler profiler{ "Scene Update"_scope }
+	template<ScopeName Name>
+	[[nodiscard]] auto operator""_scope() -> ScopeID
+	{
+		return Profiler::scope<Name>();
+	}
 
-	/// @brief Times the current scope and adds the time to the profiler
+	/// @brief Times the current scope and records it in the profiler
 	class ScopeProfiler
 	{
 	public:
-		ScopeProfiler(std::string_view name)
-			: m_name(name)
+		explicit ScopeProfiler(ScopeID id) :
+			m_id{ id },
+			m_begin{ Profiler::now() }
 		{}
 
+		ScopeProfiler(const ScopeProfiler&) = delete;
+		ScopeProfiler(ScopeProfiler&&) = delete;
+
 		~ScopeProfiler()
 		{
-			Profiler::instance().addTime(m_name, m_timer.elapsedMillis());
+			Profiler::instance().record(m_id, m_begin, Profiler::now());
 		}
 
+		auto operator=(const ScopeProfiler&) -> ScopeProfiler & = delete;
+		auto operator=(ScopeProfiler&&) -> ScopeProfiler & = delete;
+
 	private:
-		Utils::Timer m_timer;
-		std::string m_name;
+		ScopeID m_id;
+		uint64_t m_begin;
 	};
 }
@@ -10,15 +10,23 @@ export module Aegis.Core.Window;
 
 export namespace Aegis::Core
 {
+	/// @note A headless window uses the GLFW null platform: Nothing is shown and no display connection is needed, but
+	///       input and UI code keep working. The renderer creates no surface for it (see OffscreenTarget).
 	class Window
 	{
 	public:
-		Window(int width, int height, std::string title)
-			: m_width(width), m_height(height), m_windowTitle(std::move(title))
+		Window(int width, int height, std::string title, bool headless = false)
+			: m_width(width), m_height(height), m_windowTitle(std::move(title)), m_headless{ headless }
 		{
+			if (m_headless)
+			{
+				glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+			}
+
 			glfwInit();
 			glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-			glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+			glfwWindowHint(GLFW_RESIZABLE, m_headless ? GLFW_FALSE : GLFW_TRUE);
+			glfwWindowHint(GLFW_VISIBLE, m_headless ? GLFW_FALSE : GLFW_TRUE);
 
 			m_window = glfwCreateWindow(m_width, m_height, m_windowTitle.c_str(), nullptr, nullptr);
 			AGX_ASSERT_X(m_window, "Failed to create GLFW window");
@@ -44,6 +52,7 @@ export namespace Aegis::Core
 		[[nodiscard]] auto width() const -> uint32_t { return m_width; }
 		[[nodiscard]] auto height() const -> uint32_t { return m_height; }
 		[[nodiscard]] auto wasResized() const -> bool { return m_windowResized; }
+		[[nodiscard]] auto isHeadless() const -> bool { return m_headless; }
 
 		void resetResizedFlag() { m_windowResized = false; }
 
@@ -60,6 +69,7 @@ export namespace Aegis::Core
 		std::string m_windowTitle;
 		uint32_t m_width;
 		uint32_t m_height;
+		bool m_headless;
 		bool m_windowResized = false;
 	};
 }
@@ -2,10 +2,12 @@ module;
 
 #include <imgui.h>
 
+#include <format>
 #include <string>
 
 export module Aegis.Editor.Panels:ProfilerPanel;
 
+import Aegis.Core.Globals;
 import Aegis.Core.Profiler;
 import Aegis.Graphics.GPUTimer;
 
@@ -14,6 +16,8 @@ export namespace Aegis::Editor
 	class ProfilerPanel
 	{
 	public:
+		static constexpr int MAX_CAPTURE_FRAMES = 1000;
+
 		void draw()
 		{
 			ImGui::SetNextWindowPos(ImVec2(10, ImGui::GetIO().DisplaySize.y - 10), ImGuiCond_FirstUseEver, ImVec2(0, 1));
@@ -31,6 +35,20 @@ export namespace Aegis::Editor
 
 			ImGui::Spacing();
 
+			// Trace in Chrome trace event format (open in chrome://tracing or ui.perfetto.dev)
+			ImGui::BeginDisabled(profiler.isCapturing());
+			ImGui::SetNextItemWidth(ImGui::GetFontSize() * 6.0f);
+			ImGui::DragInt("##CaptureFrames", &m_captureFrameCount, 1.0f, 1, MAX_CAPTURE_FRAMES, "%d frames");
+			ImGui::SameLine();
+			if (ImGui::Button("Capture Trace"))
+			{
+				auto path = Core::ENGINE_DIR / "temp/traces" / std::format("trace_{}.json", profiler.frame());
+				profiler.captureFrames(static_cast<uint32_t>(m_captureFrameCount), path);
+			}
+			ImGui::EndDisabled();
+
+			ImGui::Spacing();
+
 			const ImGuiTableFlags flags = ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_BordersOuterH;
 			const ImVec2 outer_size = ImVec2(0.0f, ImGui::GetTextLineHeightWithSpacing() * 10);
 			if (ImGui::BeginTable("CPU Times", 3, flags, outer_size))
@@ -41,15 +59,18 @@ export namespace Aegis::Editor
 				ImGui::TableSetupColumn("Frame Percent (%)", ImGuiTableColumnFlags_WidthFixed);
 				ImGui::TableHeadersRow();
 
-				for (const auto& [name, rolling] : profiler.times())
+				for (const auto& scope : profiler.scopes())
 				{
+					if (!scope.recorded)
+						continue;
+
 					ImGui::TableNextRow();
 					ImGui::TableSetColumnIndex(0);
-					ImGui::Text("%s", name.c_str());
+					ImGui::TextUnformatted(scope.name.data(), scope.name.data() + scope.name.size());
 					ImGui::TableSetColumnIndex(1);
-					ImGui::Text("%7.3f", rolling.average());
+					ImGui::Text("%7.3f", scope.times.average());
 					ImGui::TableSetColumnIndex(2);
-					ImGui::Text("%7.2f", rolling.average() / frameTime * 100.0);
+					ImGui::Text("%7.2f", scope.times.average() / frameTime * 100.0);
 				}
 
 				ImGui::EndTable();
@@ -69,7 +90,7 @@ export namespace Aegis::Editor
 				{
 					ImGui::TableNextRow();
 					ImGui::TableSetColumnIndex(0);
-					ImGui::Text("%s", timing.name.c_str());
+					ImGui::TextUnformatted(timing.name.data(), timing.name.data() + timing.name.size());
 					ImGui::TableSetColumnIndex(1);
 					ImGui::Text("%7.3f", timing.timeMs);
 					ImGui::TableSetColumnIndex(2);
@@ -80,5 +101,8 @@ export namespace Aegis::Editor
 
 			ImGui::End();
 		}
+
+	private:
+		int m_captureFrameCount{ 120 };
 	};
 }
\ No newline at end of file
@@ -69,7 +69,7 @@ export namespace Aegis::Editor
 			// Renderer info
 			ImGui::SeparatorText("Renderer Info");
 
-			ImGui::Text("Extent: %d x %d", renderer.swapChain().extent().width, renderer.swapChain().extent().height);
+			ImGui::Text("Extent: %d x %d", renderer.extent().width, renderer.extent().height);
 			ImGui::Text("Aspect Ratio: %.2f", renderer.aspectRatio());
 
 			ImGui::NewLine();
@@ -8,7 +8,10 @@ module;
 #include <GLFW/glfw3.h>
 
 #include <chrono>
+#include <cstdint>
+#include <filesystem>
 #include <format>
+#include <functional>
 #include <memory>
 
 export module Aegis.Engine;
@@ -16,20 +19,27 @@ export module Aegis.Engine;
 export import Aegis.Math;
 export import Aegis.UI;
 export import Aegis.Editor;
+export import Aegis.Benchmark;
 export import Aegis.Defaults;
 export import Aegis.SceneDescription;
 export import Aegis.Core.AssetManager;
 export import Aegis.Core.Globals;
 export import Aegis.Core.Input;
+export import Aegis.Core.JobSystem;
 export import Aegis.Core.LayerStack;
 export import Aegis.Core.Logging;
 export import Aegis.Core.Profiler;
 export import Aegis.Core.Window;
 export import Aegis.Graphics.Components;
+export import Aegis.Graphics.IBLCache;
 export import Aegis.Graphics.Loader;
 export import Aegis.Graphics.MaterialInstance;
+export import Aegis.Graphics.MaterialLayout;
 export import Aegis.Graphics.MaterialTemplate;
+export import Aegis.Graphics.OffscreenTarget;
+export import Aegis.Graphics.PBRMaterial;
 export import Aegis.Graphics.Pipeline;
+export import Aegis.Graphics.PipelineVariantCache;
 export import Aegis.Graphics.Renderer;
 export import Aegis.Graphics.StaticMesh;
 export import Aegis.Graphics.Texture;
@@ -41,16 +51,39 @@ export import Aegis.Scripting.ScriptManager;
 
 export namespace Aegis
 {
+	/// @brief Startup options of the engine
+	/// @note Headless runs have no window or swap chain and render into an offscreen target, they are meant for
+	///       benchmarks and CI. A software ICD like lavapipe is picked with VK_DRIVER_FILES (or VK_ICD_FILENAMES).
+	struct EngineConfig
+	{
+		bool headless{ false };
+		uint32_t width{ Core::DEFAULT_WIDTH };
+		uint32_t height{ Core::DEFAULT_HEIGHT };
+		uint32_t frameCount{ 0 };					///< Frames rendered by run() before it returns, 0 runs until the window is closed
+		float fixedFrameTime{ 0.0f };				///< Frame time in seconds passed to updates, 0 uses the measured time
+		std::filesystem::path captureDirectory{};	///< Headless only, every frame is written as PNG if not empty
+		std::function<void(const Graphics::OffscreenTarget::Readback&)> onReadback{}; ///< Headless only, called for every frame
+	};
+
 	class Engine
 	{
 	public:
-		Engine()
+		Engine(EngineConfig config = {}) :
+			m_config{ std::move(config) }
 		{
 			AGX_ASSERT_X(!s_instance, "Only one instance of Engine is allowed");
 			s_instance = this;
+			Profiler::instance().setThreadName("Main");
 
 			loadDefaultAssets();
-			m_layerStack.push<Editor::EditorLayer>(m_renderer, m_scene);
+			if (m_config.headless)
+			{
+				setupReadback();
+			}
+			else
+			{
+				m_layerStack.push<Editor::EditorLayer>(m_renderer, m_scene);
+			}
 
 			ALOG::info("Engine Initialized!");
 			Logging::logo();
@@ -71,23 +104,33 @@ export namespace Aegis
 		}
 
 		[[nodiscard]] static auto assets() -> Core::AssetManager& { return Engine::instance().m_assets; }
+		[[nodiscard]] static auto jobs() -> Core::JobSystem& { return Engine::instance().m_jobSystem; }
 		[[nodiscard]] static auto window() -> Core::Window& { return Engine::instance().m_window; }
 		[[nodiscard]] static auto renderer() -> Graphics::Renderer& { return Engine::instance().m_renderer; }
 		[[nodiscard]] static auto ui() -> UI::UI& { return Engine::instance().m_ui; }
 		[[nodiscard]] static auto scene() -> Scene::Scene& { return Engine::instance().m_scene; }
+		[[nodiscard]] static auto layers() -> Core::LayerStack& { return Engine::instance().m_layerStack; }
+		[[nodiscard]] static auto config() -> const EngineConfig& { return Engine::instance().m_config; }
 
 		void run()
 		{
 			// Main Update loop
 			auto lastFrameBegin = std::chrono::steady_clock::now();
-			while (!m_window.shouldClose())
+			for (uint32_t frame = 0; !m_window.shouldClose(); frame++)
 			{
-				ScopeProfiler frameTime("Frame Time");
+				if (m_config.frameCount > 0 && frame >= m_config.frameCount)
+					break;
+
+				// Collects the events of the previous frame
+				Profiler::instance().beginFrame();
+				ScopeProfiler frameTime{ "Frame Time"_scope };
 
 				// Calculate time
 				auto currentFrameBegin = std::chrono::steady_clock::now();
 				float frameTimeSec = std::chrono::duration<float, std::chrono::seconds::period>(currentFrameBegin - lastFrameBegin).count();
 				lastFrameBegin = currentFrameBegin;
+				if (m_config.fixedFrameTime > 0.0f)
+					frameTimeSec = m_config.fixedFrameTime;
 
 				glfwPollEvents();
 
@@ -99,10 +142,12 @@ export namespace Aegis
 				// Rendering
 				m_renderer.renderFrame(m_scene, m_ui);
 
-				applyFrameBrake(currentFrameBegin);
+				if (!m_config.headless)
+					applyFrameBrake(currentFrameBegin);
 			}
 
 			m_renderer.waitIdle();
+			m_jobSystem.wait(m_captureJobs);
 		}
 
 		/// @brief Creates a scene from a description
@@ -120,11 +165,32 @@ export namespace Aegis
 		}
 
 	private:
+		/// @brief Forwards offscreen frames to the config callback and writes captures on the job system
+		void setupReadback()
+		{
+			if (!m_config.onReadback && m_config.captureDirectory.empty())
+				return;
+
+			m_renderer.offscreenTarget().enableReadback([this](Graphics::OffscreenTarget::Readback&& readback) {
+				if (m_config.onReadback)
+					m_config.onReadback(readback);
+
+				if (m_config.captureDirectory.empty())
+					return;
+
+				auto capture = std::make_shared<Graphics::OffscreenTarget::Readback>(std::move(readback));
+				auto path = m_config.captureDirectory / std::format("frame_{:05}.png", capture->frame);
+				m_jobSystem.submit([capture, path]() {
+					Graphics::OffscreenTarget::writePNG(path, *capture);
+					}, &m_captureJobs);
+				});
+		}
+
 		void applyFrameBrake(std::chrono::steady_clock::time_point frameBegin)
 		{
 			using namespace std::chrono;
 
-			ScopeProfiler frameBrake("Wait for FPS limit");
+			ScopeProfiler frameBrake{ "Wait for FPS limit"_scope };
 
 			if constexpr (!Core::ENABLE_FPS_LIMIT)
 				return;
@@ -140,6 +206,64 @@ export namespace Aegis
 		{
 			using namespace Aegis::Graphics;
 
+			// Default PBR pipelines (compiled on the job system while the default textures are uploaded)
+			auto buildPBRPipeline = [](VkCullModeFlags cullMode) {
+				Pipeline::GraphicsBuilder builder{};
+				builder.addDescriptorSetLayout(Engine::renderer().bindlessDescriptorSet().layout())
+					.setCullMode(cullMode)
+					.addPushConstantRange(VK_SHADER_STAGE_ALL, 128)
+					.addColorAttachment(VK_FORMAT_R16G16B16A16_SFLOAT)
+					.addColorAttachment(VK_FORMAT_R16G16B16A16_SFLOAT)
+					.addColorAttachment(VK_FORMAT_R8G8B8A8_UNORM)
+					.addColorAttachment(VK_FORMAT_R8G8B8A8_UNORM)
+					.addColorAttachment(VK_FORMAT_R8G8B8A8_UNORM)
+					.setDepthAttachment(VK_FORMAT_D32_SFLOAT);
+				if (Renderer::useGPUDrivenRendering() && !Renderer::useMeshShaders())
+				{
+					// Vertices are pulled from the mesh buffers, the indices are compacted by the TriangleCullingPass
+					return builder
+						.addShaderStages(VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+							Core::SHADER_DIR / "gpu-driven/vertex_geometry_indirect.slang.spv")
+						.setVertexBindingDescriptions({})
+						.setVertexAttributeDescriptions({})
+						.buildAsync();
+				}
+				else if (Renderer::useGPUDrivenRendering())
+				{
+					return builder
+						.addShaderStages(VK_SHADER_STAGE_TASK_BIT_EXT,
+							Core::SHADER_DIR / "gpu-driven/task_meshlet_cull.slang.spv")
+						.addShaderStages(VK_SHADER_STAGE_MESH_BIT_EXT | VK_SHADER_STAGE_FRAGMENT_BIT,
+							Core::SHADER_DIR / "gpu-driven/mesh_geometry_indirect.slang.spv")
+						.addFlag(Pipeline::Flags::MeshShader)
+						.buildAsync();
+				}
+				else
+				{
+					// Vertex shader
+					return builder
+						.addShaderStages(VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+							Core::SHADER_DIR / "cpu-driven/vertex_geometry_bindless.slang.spv")
+						.buildAsync();
+
+					// Mesh shader
+					//return builder
+					//	.addShaderStages(VK_SHADER_STAGE_MESH_BIT_EXT | VK_SHADER_STAGE_FRAGMENT_BIT,
+					//		SHADER_DIR "cpu-driven/mesh_geometry_bindless.slang.spv")
+					//	.addFlag(Pipeline::Flags::MeshShader)
+					//	.buildAsync();
+
+					// Mesh shader + task shader culling (Need to adjust StaticMesh::drawMeshlets to use group size of 32)
+					//return builder
+					//	.addShaderStages(VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT | VK_SHADER_STAGE_FRAGMENT_BIT,
+					//		SHADER_DIR "cpu-driven/mesh_geometry_cull.slang.spv")
+					//	.addFlag(Pipeline::Flags::MeshShader)
+					//	.buildAsync();
+				}
+				};
+			auto pbrPipeline = buildPBRPipeline(VK_CULL_MODE_BACK_BIT);
+			auto pbrDoubleSidedPipeline = buildPBRPipeline(VK_CULL_MODE_NONE);
+
 			// Default Textures
 
 			m_assets.add("default/texture_black", Texture::solidColor(glm::vec4{ 0.0f }));
@@ -151,65 +275,28 @@ export namespace Aegis
 
 			// Default PBR Material
 			{
-				auto pipeline = []() {
-					Pipeline::GraphicsBuilder builder{};
-					builder.addDescriptorSetLayout(Engine::renderer().bindlessDescriptorSet().layout())
-						.addPushConstantRange(VK_SHADER_STAGE_ALL, 128)
-						.addColorAttachment(VK_FORMAT_R16G16B16A16_SFLOAT)
-						.addColorAttachment(VK_FORMAT_R16G16B16A16_SFLOAT)
-						.addColorAttachment(VK_FORMAT_R8G8B8A8_UNORM)
-						.addColorAttachment(VK_FORMAT_R8G8B8A8_UNORM)
-						.addColorAttachment(VK_FORMAT_R8G8B8A8_UNORM)
-						.setDepthAttachment(VK_FORMAT_D32_SFLOAT);
-					if (Renderer::useGPUDrivenRendering())
-					{
-						return builder
-							.addShaderStages(VK_SHADER_STAGE_TASK_BIT_EXT,
-								Core::SHADER_DIR / "gpu-driven/task_meshlet_cull.slang.spv")
-							.addShaderStages(VK_SHADER_STAGE_MESH_BIT_EXT | VK_SHADER_STAGE_FRAGMENT_BIT,
-								Core::SHADER_DIR / "gpu-driven/mesh_geometry_indirect.slang.spv")
-							.addFlag(Pipeline::Flags::MeshShader)
-							.build();
-					}
-					else
-					{
-						// Vertex shader
-						return builder
-							.addShaderStages(VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-								Core::SHADER_DIR / "cpu-driven/vertex_geometry_bindless.slang.spv")
-							.build();
-
-						// Mesh shader
-						//return builder
-						//	.addShaderStages(VK_SHADER_STAGE_MESH_BIT_EXT | VK_SHADER_STAGE_FRAGMENT_BIT,
-						//		SHADER_DIR "cpu-driven/mesh_geometry_bindless.slang.spv")
-						//	.addFlag(Pipeline::Flags::MeshShader)
-						//	.build();
-
-						// Mesh shader + task shader culling (Need to adjust StaticMesh::drawMeshlets to use group size of 32)
-						//return builder
-						//	.addShaderStages(VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT | VK_SHADER_STAGE_FRAGMENT_BIT,
-						//		SHADER_DIR "cpu-driven/mesh_geometry_cull.slang.spv")
-						//	.addFlag(Pipeline::Flags::MeshShader)
-						//	.build();
-					}
-					}();
-
-				auto pbrMatTemplate = std::make_shared<MaterialTemplate>(std::move(pipeline));
-				pbrMatTemplate->addParameter("albedo", glm::vec3{ 1.0f, 1.0f, 1.0f });
-				pbrMatTemplate->addParameter("emissive", glm::vec3{ 0.0f, 0.0f, 0.0f });
-				pbrMatTemplate->addParameter("metallic", 0.0f);
-				pbrMatTemplate->addParameter("roughness", 1.0f);
-				pbrMatTemplate->addParameter("ambientOcclusion", 1.0f);
-				pbrMatTemplate->addParameter("albedoMap", m_assets.get<Texture>("default/texture_white"));
-				pbrMatTemplate->addParameter("normalMap", m_assets.get<Texture>("default/texture_normal"));
-				pbrMatTemplate->addParameter("metalRoughnessMap", m_assets.get<Texture>("default/texture_white"));
-				pbrMatTemplate->addParameter("ambientOcclusionMap", m_assets.get<Texture>("default/texture_white"));
-				pbrMatTemplate->addParameter("emissiveMap", m_assets.get<Texture>("default/texture_white"));
+				PBRMaterialParameters pbrDefaults{
+					.albedo = glm::vec3{ 1.0f, 1.0f, 1.0f },
+					.emissive = glm::vec3{ 0.0f, 0.0f, 0.0f },
+					.metallic = 0.0f,
+					.roughness = 1.0f,
+					.ambientOcclusion = 1.0f,
+					.albedoMap = m_assets.get<Texture>("default/texture_white"),
+					.normalMap = m_assets.get<Texture>("default/texture_normal"),
+					.metalRoughnessMap = m_assets.get<Texture>("default/texture_white"),
+					.ambientOcclusionMap = m_assets.get<Texture>("default/texture_white"),
+					.emissiveMap = m_assets.get<Texture>("default/texture_white"),
+				};
+				auto pbrMatTemplate = MaterialTemplate::create(std::move(pbrPipeline.get()), pbrDefaults);
 				m_assets.add("default/PBR_template", pbrMatTemplate);
 
+				// Separate draw batch, so the GPU culling can skip the back face tests for it
+				auto pbrDoubleSidedTemplate = MaterialTemplate::create(std::move(pbrDoubleSidedPipeline.get()), pbrDefaults);
+				pbrDoubleSidedTemplate->setDoubleSided(true);
+				m_assets.add("default/PBR_template_double_sided", pbrDoubleSidedTemplate);
+
 				auto defaultPBRMaterial = Graphics::MaterialInstance::create(pbrMatTemplate);
-				defaultPBRMaterial->setParameter("albedo", glm::vec3{ 0.8f, 0.8f, 0.9f });
+				defaultPBRMaterial->set<&PBRMaterialParameters::albedo>(glm::vec3{ 0.8f, 0.8f, 0.9f });
 				m_assets.add("default/PBR_instance", defaultPBRMaterial);
 			}
 		}
@@ -217,10 +304,13 @@ export namespace Aegis
 
 		inline static Engine* s_instance{ nullptr };
 
+		EngineConfig m_config;
 		Logging m_logging{};
+		Core::JobSystem m_jobSystem{};
+		Core::JobCounter m_captureJobs{};
 		UI::UI m_ui{ m_layerStack };
 		Core::LayerStack m_layerStack{};
-		Core::Window m_window{ Core::DEFAULT_WIDTH,Core::DEFAULT_HEIGHT, "Aegis" };
+		Core::Window m_window{ static_cast<int>(m_config.width), static_cast<int>(m_config.height), "Aegis", m_config.headless };
 		Graphics::Renderer m_renderer{ m_window };
 		Input m_input{ m_window };
 		Core::AssetManager m_assets{};
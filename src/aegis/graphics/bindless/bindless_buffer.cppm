@@ -71,7 +71,7 @@ export namespace Aegis::Graphics::Bindless
 
 		~BindlessBuffer()
 		{
-			BindlessDescriptorSet::instance().freeHandle(m_handle);
+			BindlessDescriptorSet::instance().freeHandleDeferred(m_handle);
 		}
 
 		auto operator=(const BindlessBuffer&) -> BindlessBuffer & = delete;
@@ -79,7 +79,7 @@ export namespace Aegis::Graphics::Bindless
 		{
 			if (this != &other)
 			{
-				BindlessDescriptorSet::instance().freeHandle(m_handle);
+				BindlessDescriptorSet::instance().freeHandleDeferred(m_handle);
 				m_buffer = std::move(other.m_buffer);
 				m_handle = other.m_handle;
 				other.m_handle.invalidate();
@@ -128,7 +128,7 @@ export namespace Aegis::Graphics::Bindless
 			auto& bindlessSet = BindlessDescriptorSet::instance();
 			for (auto& handle : m_handles)
 			{
-				bindlessSet.freeHandle(handle);
+				bindlessSet.freeHandleDeferred(handle);
 			}
 		}
 
@@ -140,7 +140,7 @@ export namespace Aegis::Graphics::Bindless
 				auto& bindlessSet = BindlessDescriptorSet::instance();
 				for (auto& handle : m_handles)
 				{
-					bindlessSet.freeHandle(handle);
+					bindlessSet.freeHandleDeferred(handle);
 				}
 				m_buffer = std::move(other.m_buffer);
 				m_handles = std::move(other.m_handles);
@@ -182,14 +182,43 @@ export namespace Aegis::Graphics::Bindless
 		}
 
 		BindlessFrameBuffer(const BindlessFrameBuffer&) = delete;
-		BindlessFrameBuffer(BindlessFrameBuffer&&) = default;
+		BindlessFrameBuffer(BindlessFrameBuffer&& other) noexcept :
+			m_buffer{ std::move(other.m_buffer) },
+			m_handles{ other.m_handles }
+		{
+			for (auto& handle : other.m_handles)
+			{
+				handle.invalidate();
+			}
+		}
+
 		~BindlessFrameBuffer()
 		{
 			auto& bindlessSet = BindlessDescriptorSet::instance();
 			for (auto& handle : m_handles)
 			{
-				bindlessSet.freeHandle(handle);
+				bindlessSet.freeHandleDeferred(handle);
+			}
+		}
+
+		auto operator=(const BindlessFrameBuffer&) -> BindlessFrameBuffer & = delete;
+		auto operator=(BindlessFrameBuffer&& other) noexcept -> BindlessFrameBuffer&
+		{
+			if (this != &other)
+			{
+				auto& bindlessSet = BindlessDescriptorSet::instance();
+				for (auto& handle : m_handles)
+				{
+					bindlessSet.freeHandleDeferred(handle);
+				}
+				m_buffer = std::move(other.m_buffer);
+				m_handles = other.m_handles;
+				for (auto& handle : other.m_handles)
+				{
+					handle.invalidate();
+				}
 			}
+			return *this;
 		}
 
 		[[nodiscard]] auto buffer() -> Buffer& { return m_buffer; }
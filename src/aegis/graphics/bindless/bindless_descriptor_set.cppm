@@ -147,6 +147,20 @@ export namespace Aegis::Graphics::Bindless
 			}
 		}
 
+		/// @brief Frees the handle once the frames in flight (which might still access its descriptor) have finished
+		/// @note The handle is invalidated immediately, handles freed after the set was destroyed are dropped
+		void freeHandleDeferred(DescriptorHandle& handle)
+		{
+			if (!handle.isValid())
+				return;
+
+			VulkanContext::deletionQueue().schedule([handle]() mutable {
+				if (s_instance)
+					s_instance->freeHandle(handle);
+				});
+			handle.invalidate();
+		}
+
 	private:
 		auto createDescriptorPool() -> DescriptorPool
 		{
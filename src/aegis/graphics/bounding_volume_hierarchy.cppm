@@ -0,0 +1,443 @@
+module;
+
+#include "core/assert.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <span>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX2__)
+#define AGX_BVH_AVX2 1
+#include <immintrin.h>
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define AGX_BVH_SSE 1
+#include <xmmintrin.h>
+#endif
+
+export module Aegis.Graphics.BoundingVolumeHierarchy;
+
+import Aegis.Math;
+import Aegis.Graphics.Frustum;
+
+export namespace Aegis::Graphics
+{
+	/// @brief Wide bounding volume hierarchy over bounding spheres for frustum culling on the CPU
+	/// @note Nodes store the boxes of their children in SoA layout, so a node is tested against a frustum plane with a
+	///       single SIMD operation. Leaves reference up to WIDTH consecutive spheres which are tested the same way.
+	///       The tree is 8-wide with AVX2 (ENABLE_AVX2 in CMake) and 4-wide with SSE otherwise. Moving spheres only
+	///       refit the boxes (the tree has to be rebuilt to restore its quality).
+	class BoundingVolumeHierarchy
+	{
+	public:
+		static constexpr uint32_t INVALID_INDEX = std::numeric_limits<uint32_t>::max();
+#ifdef AGX_BVH_AVX2
+		static constexpr uint32_t WIDTH = 8;
+#else
+		static constexpr uint32_t WIDTH = 4;
+#endif
+		static constexpr uint32_t MAX_LEAF_SIZE = WIDTH;
+
+		struct Sphere
+		{
+			glm::vec3 center{ 0.0f };
+			float radius{ 0.0f };
+		};
+
+		BoundingVolumeHierarchy() = default;
+
+		/// @brief Number of spheres
+		[[nodiscard]] auto size() const -> uint32_t { return static_cast<uint32_t>(m_ids.size()); }
+		[[nodiscard]] auto nodeCount() const -> uint32_t { return static_cast<uint32_t>(m_nodes.size()); }
+
+		/// @brief Builds the tree from scratch, the index of each sphere is used as its id
+		void build(std::span<const Sphere> spheres)
+		{
+			uint32_t count = static_cast<uint32_t>(spheres.size());
+			m_ids.resize(count);
+			std::iota(m_ids.begin(), m_ids.end(), 0u);
+			m_nodes.clear();
+			m_leafNodes.assign(count, INVALID_INDEX);
+
+			// Sort the spheres into the leaves (m_ids is reordered in build order)
+			if (count > 0)
+			{
+				m_nodes.emplace_back();
+				buildNode(0, 0, count, spheres);
+			}
+
+			// SoA layout in build order, padded so WIDTH spheres can always be loaded at once
+			std::size_t padded = count + WIDTH - 1;
+			m_centerX.assign(padded, 0.0f);
+			m_centerY.assign(padded, 0.0f);
+			m_centerZ.assign(padded, 0.0f);
+			m_radius.assign(padded, 0.0f);
+			m_positions.resize(count);
+			for (uint32_t position = 0; position < count; position++)
+			{
+				uint32_t id = m_ids[position];
+				m_positions[id] = position;
+				writeSphere(position, spheres[id]);
+			}
+
+			// Children are always created after their parent -> update bottom up
+			m_dirty.assign(m_nodes.size(), true);
+			m_hasDirty = !m_nodes.empty();
+			refit();
+		}
+
+		/// @brief Changes the bounds of a sphere, the boxes are refit lazily before the next query
+		void update(uint32_t id, const Sphere& sphere)
+		{
+			AGX_ASSERT_X(id < m_positions.size(), "BVH: Invalid sphere id");
+			uint32_t position = m_positions[id];
+			writeSphere(position, sphere);
+
+			m_dirty[m_leafNodes[position]] = true;
+			m_hasDirty = true;
+		}
+
+		/// @brief Recomputes the boxes of all nodes containing updated spheres
+		void refit()
+		{
+			if (!m_hasDirty)
+				return;
+
+			for (uint32_t nodeIndex = nodeCount(); nodeIndex-- > 0;)
+			{
+				if (!m_dirty[nodeIndex])
+					continue;
+
+				computeBounds(nodeIndex);
+				m_dirty[nodeIndex] = false;
+
+				uint32_t parent = m_nodes[nodeIndex].parent;
+				if (parent != INVALID_INDEX)
+					m_dirty[parent] = true;
+			}
+			m_hasDirty = false;
+		}
+
+		/// @brief Calls func(id) for every sphere intersecting the frustum
+		template<typename Func>
+		void cull(const Frustum& frustum, Func&& func)
+		{
+			refit();
+			if (m_nodes.empty())
+				return;
+
+			// Subtrees completely inside the frustum are not tested any further
+			m_stack.clear();
+			m_stack.emplace_back(0, false);
+			while (!m_stack.empty())
+			{
+				auto [nodeIndex, inside] = m_stack.back();
+				m_stack.pop_back();
+
+				const auto& node = m_nodes[nodeIndex];
+				uint32_t visibleMask = laneMask(node.childCount);
+				uint32_t insideMask = visibleMask;
+				if (!inside)
+					visibleMask = testBoxes(node, frustum, insideMask);
+
+				for (uint32_t lanes = visibleMask; lanes != 0; lanes &= lanes - 1)
+				{
+					uint32_t slot = static_cast<uint32_t>(std::countr_zero(lanes));
+					bool slotInside = (insideMask >> slot) & 1u;
+					if (node.count[slot] == 0)
+					{
+						m_stack.emplace_back(node.child[slot], slotInside);
+						continue;
+					}
+
+					uint32_t first = node.child[slot];
+					uint32_t sphereMask = slotInside
+						? laneMask(node.count[slot])
+						: testSpheres(first, node.count[slot], frustum);
+
+					for (; sphereMask != 0; sphereMask &= sphereMask - 1)
+					{
+						func(m_ids[first + static_cast<uint32_t>(std::countr_zero(sphereMask))]);
+					}
+				}
+			}
+		}
+
+	private:
+		struct alignas(WIDTH * sizeof(float)) Node
+		{
+			std::array<float, WIDTH> minX{};
+			std::array<float, WIDTH> minY{};
+			std::array<float, WIDTH> minZ{};
+			std::array<float, WIDTH> maxX{};
+			std::array<float, WIDTH> maxY{};
+			std::array<float, WIDTH> maxZ{};
+			std::array<uint32_t, WIDTH> child{}; // Node index or first sphere of a leaf
+			std::array<uint32_t, WIDTH> count{}; // Spheres in a leaf (0 for inner nodes)
+			uint32_t parent{ INVALID_INDEX };
+			uint32_t childCount{ 0 };
+		};
+
+		static auto laneMask(uint32_t count) -> uint32_t { return (1u << count) - 1u; }
+
+		/// @brief Splits the range in up to WIDTH parts (the largest part is split at the median of the largest axis of
+		///        its centers until all parts fit into a leaf)
+		void buildNode(uint32_t nodeIndex, uint32_t first, uint32_t count, std::span<const Sphere> spheres)
+		{
+			std::array<std::pair<uint32_t, uint32_t>, WIDTH> parts;
+			parts[0] = { first, count };
+			uint32_t partCount = 1;
+			while (partCount < WIDTH)
+			{
+				auto used = std::span{ parts }.first(partCount);
+				auto largest = std::ranges::max_element(used, {}, &std::pair<uint32_t, uint32_t>::second);
+				auto [partFirst, partSize] = *largest;
+				if (partSize <= MAX_LEAF_SIZE)
+					break;
+
+				// Keep neighbouring parts next to each other
+				auto index = static_cast<uint32_t>(largest - used.begin());
+				std::move_backward(parts.begin() + index + 1, parts.begin() + partCount, parts.begin() + partCount + 1);
+				uint32_t half = splitRange(partFirst, partSize, spheres);
+				parts[index] = { partFirst, half };
+				parts[index + 1] = { partFirst + half, partSize - half };
+				partCount++;
+			}
+
+			m_nodes[nodeIndex].childCount = partCount;
+			for (uint32_t slot = 0; slot < partCount; slot++)
+			{
+				auto [partFirst, partSize] = parts[slot];
+				if (partSize <= MAX_LEAF_SIZE)
+				{
+					m_nodes[nodeIndex].child[slot] = partFirst;
+					m_nodes[nodeIndex].count[slot] = partSize;
+					std::fill_n(m_leafNodes.begin() + partFirst, partSize, nodeIndex);
+					continue;
+				}
+
+				// Recursion appends nodes -> do not keep references into m_nodes
+				uint32_t childIndex = nodeCount();
+				m_nodes.emplace_back().parent = nodeIndex;
+				m_nodes[nodeIndex].child[slot] = childIndex;
+				m_nodes[nodeIndex].count[slot] = 0;
+				buildNode(childIndex, partFirst, partSize, spheres);
+			}
+		}
+
+		/// @return Size of the first half
+		auto splitRange(uint32_t first, uint32_t count, std::span<const Sphere> spheres) -> uint32_t
+		{
+			glm::vec3 min{ std::numeric_limits<float>::max() };
+			glm::vec3 max{ std::numeric_limits<float>::lowest() };
+			for (uint32_t i = first; i < first + count; i++)
+			{
+				min = glm::min(min, spheres[m_ids[i]].center);
+				max = glm::max(max, spheres[m_ids[i]].center);
+			}
+
+			glm::vec3 extent = max - min;
+			int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+			uint32_t half = count / 2;
+			auto begin = m_ids.begin() + first;
+			std::nth_element(begin, begin + half, begin + count, [&spheres, axis](uint32_t a, uint32_t b) {
+				return spheres[a].center[axis] < spheres[b].center[axis];
+				});
+			return half;
+		}
+
+		void writeSphere(uint32_t position, const Sphere& sphere)
+		{
+			m_centerX[position] = sphere.center.x;
+			m_centerY[position] = sphere.center.y;
+			m_centerZ[position] = sphere.center.z;
+			m_radius[position] = sphere.radius;
+		}
+
+		void computeBounds(uint32_t nodeIndex)
+		{
+			auto& node = m_nodes[nodeIndex];
+			for (uint32_t slot = 0; slot < node.childCount; slot++)
+			{
+				glm::vec3 min{ std::numeric_limits<float>::max() };
+				glm::vec3 max{ std::numeric_limits<float>::lowest() };
+				if (node.count[slot] > 0)
+				{
+					for (uint32_t i = node.child[slot]; i < node.child[slot] + node.count[slot]; i++)
+					{
+						glm::vec3 center{ m_centerX[i], m_centerY[i], m_centerZ[i] };
+						min = glm::min(min, center - m_radius[i]);
+						max = glm::max(max, center + m_radius[i]);
+					}
+				}
+				else
+				{
+					const auto& child = m_nodes[node.child[slot]];
+					for (uint32_t i = 0; i < child.childCount; i++)
+					{
+						min = glm::min(min, glm::vec3{ child.minX[i], child.minY[i], child.minZ[i] });
+						max = glm::max(max, glm::vec3{ child.maxX[i], child.maxY[i], child.maxZ[i] });
+					}
+				}
+
+				node.minX[slot] = min.x;
+				node.minY[slot] = min.y;
+				node.minZ[slot] = min.z;
+				node.maxX[slot] = max.x;
+				node.maxY[slot] = max.y;
+				node.maxZ[slot] = max.z;
+			}
+		}
+
+		/// @brief A box is outside if its farthest corner along a plane normal is behind the plane and completely
+		///        inside if its nearest corner is in front of all planes
+		/// @return Mask of the children intersecting the frustum
+		static auto testBoxes(const Node& node, const Frustum& frustum, uint32_t& insideMask) -> uint32_t
+		{
+			uint32_t outsideBits = 0;
+			uint32_t intersectBits = 0;
+#if defined(AGX_BVH_AVX2)
+			__m256 minX = _mm256_load_ps(node.minX.data());
+			__m256 minY = _mm256_load_ps(node.minY.data());
+			__m256 minZ = _mm256_load_ps(node.minZ.data());
+			__m256 maxX = _mm256_load_ps(node.maxX.data());
+			__m256 maxY = _mm256_load_ps(node.maxY.data());
+			__m256 maxZ = _mm256_load_ps(node.maxZ.data());
+			__m256 zero = _mm256_setzero_ps();
+			__m256 outside = zero;
+			__m256 intersect = zero;
+			for (const auto& plane : frustum.planes)
+			{
+				__m256 nx = _mm256_set1_ps(plane.x);
+				__m256 ny = _mm256_set1_ps(plane.y);
+				__m256 nz = _mm256_set1_ps(plane.z);
+				__m256 d = _mm256_set1_ps(plane.w);
+
+				__m256 x0 = _mm256_mul_ps(nx, minX), x1 = _mm256_mul_ps(nx, maxX);
+				__m256 y0 = _mm256_mul_ps(ny, minY), y1 = _mm256_mul_ps(ny, maxY);
+				__m256 z0 = _mm256_mul_ps(nz, minZ), z1 = _mm256_mul_ps(nz, maxZ);
+
+				__m256 farDist = _mm256_add_ps(_mm256_add_ps(_mm256_max_ps(x0, x1), _mm256_max_ps(y0, y1)), _mm256_add_ps(_mm256_max_ps(z0, z1), d));
+				__m256 nearDist = _mm256_add_ps(_mm256_add_ps(_mm256_min_ps(x0, x1), _mm256_min_ps(y0, y1)), _mm256_add_ps(_mm256_min_ps(z0, z1), d));
+				outside = _mm256_or_ps(outside, _mm256_cmp_ps(farDist, zero, _CMP_LT_OQ));
+				intersect = _mm256_or_ps(intersect, _mm256_cmp_ps(nearDist, zero, _CMP_LT_OQ));
+			}
+			outsideBits = static_cast<uint32_t>(_mm256_movemask_ps(outside));
+			intersectBits = static_cast<uint32_t>(_mm256_movemask_ps(intersect));
+#elif defined(AGX_BVH_SSE)
+			__m128 minX = _mm_load_ps(node.minX.data());
+			__m128 minY = _mm_load_ps(node.minY.data());
+			__m128 minZ = _mm_load_ps(node.minZ.data());
+			__m128 maxX = _mm_load_ps(node.maxX.data());
+			__m128 maxY = _mm_load_ps(node.maxY.data());
+			__m128 maxZ = _mm_load_ps(node.maxZ.data());
+			__m128 zero = _mm_setzero_ps();
+			__m128 outside = zero;
+			__m128 intersect = zero;
+			for (const auto& plane : frustum.planes)
+			{
+				__m128 nx = _mm_set1_ps(plane.x);
+				__m128 ny = _mm_set1_ps(plane.y);
+				__m128 nz = _mm_set1_ps(plane.z);
+				__m128 d = _mm_set1_ps(plane.w);
+
+				__m128 x0 = _mm_mul_ps(nx, minX), x1 = _mm_mul_ps(nx, maxX);
+				__m128 y0 = _mm_mul_ps(ny, minY), y1 = _mm_mul_ps(ny, maxY);
+				__m128 z0 = _mm_mul_ps(nz, minZ), z1 = _mm_mul_ps(nz, maxZ);
+
+				__m128 farDist = _mm_add_ps(_mm_add_ps(_mm_max_ps(x0, x1), _mm_max_ps(y0, y1)), _mm_add_ps(_mm_max_ps(z0, z1), d));
+				__m128 nearDist = _mm_add_ps(_mm_add_ps(_mm_min_ps(x0, x1), _mm_min_ps(y0, y1)), _mm_add_ps(_mm_min_ps(z0, z1), d));
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(farDist, zero));
+				intersect = _mm_or_ps(intersect, _mm_cmplt_ps(nearDist, zero));
+			}
+			outsideBits = static_cast<uint32_t>(_mm_movemask_ps(outside));
+			intersectBits = static_cast<uint32_t>(_mm_movemask_ps(intersect));
+#else
+			for (uint32_t lane = 0; lane < WIDTH; lane++)
+			{
+				for (const auto& plane : frustum.planes)
+				{
+					float x0 = plane.x * node.minX[lane], x1 = plane.x * node.maxX[lane];
+					float y0 = plane.y * node.minY[lane], y1 = plane.y * node.maxY[lane];
+					float z0 = plane.z * node.minZ[lane], z1 = plane.z * node.maxZ[lane];
+					if (std::max(x0, x1) + std::max(y0, y1) + std::max(z0, z1) + plane.w < 0.0f)
+						outsideBits |= 1u << lane;
+					if (std::min(x0, x1) + std::min(y0, y1) + std::min(z0, z1) + plane.w < 0.0f)
+						intersectBits |= 1u << lane;
+				}
+			}
+#endif
+			uint32_t visibleMask = ~outsideBits & laneMask(node.childCount);
+			insideMask = ~intersectBits & visibleMask;
+			return visibleMask;
+		}
+
+		/// @return Mask of the spheres [first, first + count) intersecting the frustum
+		auto testSpheres(uint32_t first, uint32_t count, const Frustum& frustum) const -> uint32_t
+		{
+			uint32_t outsideBits = 0;
+#if defined(AGX_BVH_AVX2)
+			__m256 centerX = _mm256_loadu_ps(m_centerX.data() + first);
+			__m256 centerY = _mm256_loadu_ps(m_centerY.data() + first);
+			__m256 centerZ = _mm256_loadu_ps(m_centerZ.data() + first);
+			__m256 negRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(m_radius.data() + first));
+			__m256 outside = _mm256_setzero_ps();
+			for (const auto& plane : frustum.planes)
+			{
+				__m256 dist = _mm256_add_ps(
+					_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.x), centerX), _mm256_mul_ps(_mm256_set1_ps(plane.y), centerY)),
+					_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.z), centerZ), _mm256_set1_ps(plane.w)));
+				outside = _mm256_or_ps(outside, _mm256_cmp_ps(dist, negRadius, _CMP_LT_OQ));
+			}
+			outsideBits = static_cast<uint32_t>(_mm256_movemask_ps(outside));
+#elif defined(AGX_BVH_SSE)
+			__m128 centerX = _mm_loadu_ps(m_centerX.data() + first);
+			__m128 centerY = _mm_loadu_ps(m_centerY.data() + first);
+			__m128 centerZ = _mm_loadu_ps(m_centerZ.data() + first);
+			__m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(m_radius.data() + first));
+			__m128 outside = _mm_setzero_ps();
+			for (const auto& plane : frustum.planes)
+			{
+				__m128 dist = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), centerX), _mm_mul_ps(_mm_set1_ps(plane.y), centerY)),
+					_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), centerZ), _mm_set1_ps(plane.w)));
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(dist, negRadius));
+			}
+			outsideBits = static_cast<uint32_t>(_mm_movemask_ps(outside));
+#else
+			for (uint32_t lane = 0; lane < count; lane++)
+			{
+				uint32_t i = first + lane;
+				for (const auto& plane : frustum.planes)
+				{
+					float dist = plane.x * m_centerX[i] + plane.y * m_centerY[i] + plane.z * m_centerZ[i] + plane.w;
+					if (dist < -m_radius[i])
+						outsideBits |= 1u << lane;
+				}
+			}
+#endif
+			return ~outsideBits & laneMask(count);
+		}
+
+		std::vector<Node> m_nodes;
+		std::vector<bool> m_dirty;
+		bool m_hasDirty{ false };
+
+		// Spheres in build order (SoA)
+		std::vector<float> m_centerX;
+		std::vector<float> m_centerY;
+		std::vector<float> m_centerZ;
+		std::vector<float> m_radius;
+		std::vector<uint32_t> m_ids;       // Build order -> id
+		std::vector<uint32_t> m_positions; // Id -> build order
+		std::vector<uint32_t> m_leafNodes; // Build order -> node containing the leaf
+
+		std::vector<std::pair<uint32_t, bool>> m_stack;
+	};
+}
@@ -45,12 +45,15 @@ export namespace Aegis::Graphics
 			deletors.clear();
 		}
 
+		/// @note Only valid while the GPU is idle, the current frame index is kept
 		void flushAll()
 		{
+			uint32_t currentFrameIndex = m_currentFrameIndex;
 			for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
 			{
 				flush(i);
 			}
+			m_currentFrameIndex = currentFrameIndex;
 		}
 
 	private:
@@ -5,6 +5,7 @@ module;
 #include <aegis-log/log.h>
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
 #include <array>
 #include <optional>
 #include <set>
@@ -32,7 +33,9 @@ export namespace Aegis::Graphics
 	{
 		std::optional<uint32_t> graphicsFamily;
 		std::optional<uint32_t> presentFamily;
+		std::optional<uint32_t> transferFamily; // Dedicated transfer family (no graphics or compute support)
 		bool isComplete() const { return graphicsFamily.has_value() && presentFamily.has_value(); }
+		bool hasDedicatedTransfer() const { return transferFamily.has_value() && transferFamily != graphicsFamily; }
 	};
 
 	struct VulkanFeatures
@@ -42,6 +45,7 @@ export namespace Aegis::Graphics
 		VkPhysicalDeviceVulkan12Features v12{};
 		VkPhysicalDeviceVulkan13Features v13{};
 		VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderEXT{};
+		bool calibratedTimestamps{ false }; // VK_EXT_calibrated_timestamps with the device time domain
 	};
 
 	class VulkanDevice
@@ -50,6 +54,7 @@ export namespace Aegis::Graphics
 		static constexpr uint32_t API_VERSION = VK_API_VERSION_1_3;
 		static constexpr auto VALIDATION_LAYERS = std::array{ "VK_LAYER_KHRONOS_validation" };
 		static constexpr auto DEVICE_EXTENSIONS = std::array{ VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+		static constexpr auto HEADLESS_DEVICE_EXTENSIONS = std::array<const char*, 0>{};
 
 		VulkanDevice() = default;
 		VulkanDevice(const VulkanDevice&) = delete;
@@ -60,7 +65,8 @@ export namespace Aegis::Graphics
 			vma::vmaDestroyAllocator(m_allocator);
 			vkDestroyDevice(m_device, nullptr);
 			m_debugMessenger.destroy(m_instance);
-			vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
+			if (m_surface)
+				vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
 			vkDestroyInstance(m_instance, nullptr);
 		}
 
@@ -77,14 +83,21 @@ export namespace Aegis::Graphics
 		[[nodiscard]] auto surface() const -> VkSurfaceKHR { return m_surface; }
 		[[nodiscard]] auto graphicsQueue() const -> VkQueue { return m_graphicsQueue; }
 		[[nodiscard]] auto presentQueue() const -> VkQueue { return m_presentQueue; }
+		/// @brief Dedicated transfer queue if the device has one, the graphics queue otherwise
+		[[nodiscard]] auto transferQueue() const -> VkQueue { return m_transferQueue; }
+		[[nodiscard]] auto queueFamilies() const -> const QueueFamilyIndices& { return m_queueFamilies; }
 		[[nodiscard]] auto properties() const -> const VkPhysicalDeviceProperties& { return m_properties; }
 		[[nodiscard]] auto features() const -> const VulkanFeatures& { return m_features; }
+		/// @brief Headless devices have no surface and present queue (the graphics queue is returned instead)
+		[[nodiscard]] auto isHeadless() const -> bool { return m_headless; }
 
 		void initialize(Core::Window& window)
 		{
+			m_headless = window.isHeadless();
 			createInstance();
 			m_debugMessenger.create(m_instance);
-			createSurface(window);
+			if (!m_headless)
+				createSurface(window);
 			createPhysicalDevice();
 			createLogicalDevice();
 			createAllocator();
@@ -134,6 +147,16 @@ export namespace Aegis::Graphics
 			bufferInfo.usage = bufferUsage;
 			bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
+			// Buffers are filled on the transfer queue and read on the graphics queue (avoids ownership transfers)
+			std::array<uint32_t, 2> queueFamilyIndices;
+			if (m_queueFamilies.hasDedicatedTransfer())
+			{
+				queueFamilyIndices = { m_queueFamilies.graphicsFamily.value(), m_queueFamilies.transferFamily.value() };
+				bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+				bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilyIndices.size());
+				bufferInfo.pQueueFamilyIndices = queueFamilyIndices.data();
+			}
+
 			vma::AllocationCreateInfo allocInfo{};
 			allocInfo.usage = memoryUsage;
 			allocInfo.flags = allocFlags;
@@ -352,9 +375,12 @@ export namespace Aegis::Graphics
 				if (!checkDeviceFeatureSupport(device))
 					continue;
 
-				SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
-				if (swapChainSupport.formats.empty() || swapChainSupport.presentModes.empty())
-					continue;
+				if (!m_headless)
+				{
+					SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
+					if (swapChainSupport.formats.empty() || swapChainSupport.presentModes.empty())
+						continue;
+				}
 
 				// Found a suitable device
 				m_physicalDevice = device;
@@ -385,6 +411,16 @@ export namespace Aegis::Graphics
 
 			if (!m_features.meshShaderEXT.meshShader || !m_features.meshShaderEXT.taskShader)
 				ALOG::warn("Mesh shaders not supported");
+
+			if (!m_features.core.features.multiDrawIndirect || !m_features.v12.drawIndirectCount)
+				ALOG::warn("Indirect count draws not supported");
+
+			if (!m_features.core.features.textureCompressionBC)
+				ALOG::warn("BC texture compression not supported, BC compressed KTX2 textures are skipped");
+
+			m_features.calibratedTimestamps = checkCalibratedTimestampSupport(m_physicalDevice);
+			if (!m_features.calibratedTimestamps)
+				ALOG::warn("Calibrated timestamps not supported, GPU traces are aligned to the submit time");
 		}
 
 		void createLogicalDevice()
@@ -397,7 +433,10 @@ export namespace Aegis::Graphics
 			VkPhysicalDeviceFeatures2 features{
 				.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
 				.features = VkPhysicalDeviceFeatures{
+						.multiDrawIndirect = m_features.core.features.multiDrawIndirect,
+						.drawIndirectFirstInstance = VK_TRUE,
 						.samplerAnisotropy = VK_TRUE,
+						.textureCompressionBC = m_features.core.features.textureCompressionBC,
 					},
 			};
 
@@ -408,6 +447,7 @@ export namespace Aegis::Graphics
 
 			VkPhysicalDeviceVulkan12Features vulkan12Features{
 				.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+				.drawIndirectCount = m_features.v12.drawIndirectCount,
 				// 8-bit storage
 				.storageBuffer8BitAccess = VK_TRUE,
 				.uniformAndStorageBuffer8BitAccess = VK_TRUE,
@@ -430,6 +470,8 @@ export namespace Aegis::Graphics
 				// Misc
 				.scalarBlockLayout = VK_TRUE,
 				.uniformBufferStandardLayout = VK_TRUE,
+				// Upload synchronization
+				.timelineSemaphore = VK_TRUE,
 			};
 
 			VkPhysicalDeviceVulkan13Features vulkan13Features{
@@ -451,18 +493,24 @@ export namespace Aegis::Graphics
 			vulkan12Features.pNext = &vulkan13Features;
 			vulkan13Features.pNext = nullptr;
 
-			std::vector<const char*> enabledExtensions(DEVICE_EXTENSIONS.begin(), DEVICE_EXTENSIONS.end());
+			std::vector<const char*> enabledExtensions = requiredDeviceExtensions();
 			if (meshShader.taskShader && meshShader.meshShader)
 			{
 				vulkan13Features.pNext = &meshShader;
 				enabledExtensions.emplace_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
 			}
+			if (m_features.calibratedTimestamps)
+			{
+				enabledExtensions.emplace_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+			}
 
 			QueueFamilyIndices indices = findQueueFamilies(m_physicalDevice);
 			AGX_ASSERT_X(indices.isComplete(), "Queue family indices are not complete");
 
 			std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 			std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+			if (indices.hasDedicatedTransfer())
+				uniqueQueueFamilies.insert(indices.transferFamily.value());
 
 			float queuePriority = 1.0f;
 			for (uint32_t queueFamily : uniqueQueueFamilies)
@@ -501,6 +549,14 @@ export namespace Aegis::Graphics
 			AGX_ASSERT_X(indices.isComplete(), "Queue family indices are not complete");
 			vkGetDeviceQueue(m_device, indices.graphicsFamily.value(), 0, &m_graphicsQueue);
 			vkGetDeviceQueue(m_device, indices.presentFamily.value(), 0, &m_presentQueue);
+
+			m_transferQueue = m_graphicsQueue;
+			if (indices.hasDedicatedTransfer())
+			{
+				vkGetDeviceQueue(m_device, indices.transferFamily.value(), 0, &m_transferQueue);
+				ALOG::info("Using dedicated transfer queue (family {})", indices.transferFamily.value());
+			}
+			m_queueFamilies = indices;
 		}
 
 		void createAllocator()
@@ -534,12 +590,13 @@ export namespace Aegis::Graphics
 
 		auto queryRequiredInstanceExtensions() const -> std::vector<const char*>
 		{
-			uint32_t glfwExtensionCount = 0;
-			const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
 			std::vector<const char*> extensions;
-			extensions.reserve(glfwExtensionCount);
-			extensions.insert(extensions.end(), glfwExtensions, glfwExtensions + glfwExtensionCount);
+			if (!m_headless)
+			{
+				uint32_t glfwExtensionCount = 0;
+				const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+				extensions.insert(extensions.end(), glfwExtensions, glfwExtensions + glfwExtensionCount);
+			}
 
 			if constexpr (ENABLE_VALIDATION)
 			{
@@ -589,20 +646,34 @@ export namespace Aegis::Graphics
 			int i = 0;
 			for (const auto& queueFamily : queueFamilies)
 			{
+				if (indices.isComplete())
+					break;
+
 				if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
 					indices.graphicsFamily = i;
 
-				VkBool32 presentSupport = false;
-				vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_surface, &presentSupport);
+				// Headless devices present nothing, the graphics family stands in for the present family
+				VkBool32 presentSupport = m_headless && (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT);
+				if (!m_headless)
+					vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_surface, &presentSupport);
 				if (queueFamily.queueCount > 0 && presentSupport)
 					indices.presentFamily = i;
 
-				if (indices.isComplete())
-					break;
-
 				i++;
 			}
 
+			// Transfer only families are usually backed by the copy engines of the GPU
+			for (uint32_t family = 0; family < queueFamilyCount; family++)
+			{
+				auto flags = queueFamilies[family].queueFlags;
+				if (queueFamilies[family].queueCount > 0 && (flags & VK_QUEUE_TRANSFER_BIT)
+					&& !(flags & VK_QUEUE_GRAPHICS_BIT) && !(flags & VK_QUEUE_COMPUTE_BIT))
+				{
+					indices.transferFamily = family;
+					break;
+				}
+			}
+
 			return indices;
 		}
 
@@ -625,6 +696,33 @@ export namespace Aegis::Graphics
 			}
 		}
 
+		auto requiredDeviceExtensions() const -> std::vector<const char*>
+		{
+			if (m_headless)
+				return { HEADLESS_DEVICE_EXTENSIONS.begin(), HEADLESS_DEVICE_EXTENSIONS.end() };
+			return { DEVICE_EXTENSIONS.begin(), DEVICE_EXTENSIONS.end() };
+		}
+
+		auto checkCalibratedTimestampSupport(VkPhysicalDevice device) -> bool
+		{
+			uint32_t extensionCount;
+			vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+			std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+			vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+			bool supported = std::ranges::any_of(availableExtensions, [](const VkExtensionProperties& extension) {
+				return strcmp(extension.extensionName, VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME) == 0;
+				});
+			if (!supported || !vkGetPhysicalDeviceCalibrateableTimeDomainsEXT)
+				return false;
+
+			uint32_t domainCount = 0;
+			vkGetPhysicalDeviceCalibrateableTimeDomainsEXT(device, &domainCount, nullptr);
+			std::vector<VkTimeDomainEXT> domains(domainCount);
+			vkGetPhysicalDeviceCalibrateableTimeDomainsEXT(device, &domainCount, domains.data());
+			return std::ranges::find(domains, VK_TIME_DOMAIN_DEVICE_EXT) != domains.end();
+		}
+
 		auto checkDeviceExtensionSupport(VkPhysicalDevice device) -> bool
 		{
 			uint32_t extensionCount;
@@ -633,7 +731,8 @@ export namespace Aegis::Graphics
 			std::vector<VkExtensionProperties> availableExtensions(extensionCount);
 			vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
-			std::set<std::string> requiredExtensions(DEVICE_EXTENSIONS.begin(), DEVICE_EXTENSIONS.end());
+			auto required = requiredDeviceExtensions();
+			std::set<std::string> requiredExtensions(required.begin(), required.end());
 			for (const auto& extension : availableExtensions)
 			{
 				requiredExtensions.erase(extension.extensionName);
@@ -671,7 +770,8 @@ export namespace Aegis::Graphics
 
 			vkGetPhysicalDeviceFeatures2(device, &vulkan10);
 
-			if (!vulkan10.features.samplerAnisotropy)
+			if (!vulkan10.features.samplerAnisotropy ||
+				!vulkan10.features.drawIndirectFirstInstance)
 				return false;
 
 			if (!vulkan11Features.shaderDrawParameters)
@@ -697,6 +797,9 @@ export namespace Aegis::Graphics
 				!vulkan12Features.scalarBlockLayout)
 				return false;
 
+			if (!vulkan12Features.timelineSemaphore)
+				return false;
+
 			// 8-bit storage
 			if (!vulkan12Features.shaderInt8 ||
 				!vulkan12Features.storageBuffer8BitAccess ||
@@ -709,9 +812,7 @@ export namespace Aegis::Graphics
 				!vulkan13Features.shaderDemoteToHelperInvocation)
 				return false;
 
-			// TODO: Add mesh shader as optional feature
-			if (!meshShaderFeatures.meshShader || !meshShaderFeatures.taskShader)
-				return false;
+			// Optional: Mesh shaders, multi draw indirect and indirect count (see Renderer::useGPUDrivenRendering)
 
 			m_features = {
 				.core = vulkan10,
@@ -765,7 +866,10 @@ export namespace Aegis::Graphics
 		VulkanFeatures m_features{};
 
 		VkSurfaceKHR m_surface = VK_NULL_HANDLE;
+		bool m_headless = false;
 		VkQueue m_graphicsQueue = VK_NULL_HANDLE;
 		VkQueue m_presentQueue = VK_NULL_HANDLE;
+		VkQueue m_transferQueue = VK_NULL_HANDLE;
+		QueueFamilyIndices m_queueFamilies{};
 	};
 }
@@ -2,8 +2,9 @@ module;
 
 #include "core/assert.h"
 
-#include <vector>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
 export module Aegis.Graphics.DrawBatchRegistry;
 
@@ -22,34 +23,61 @@ export namespace Aegis::Graphics
 		std::shared_ptr<MaterialTemplate> materialTemplate;
 	};
 
+	/// @brief Groups all instances by material template, each batch owns a contiguous range of the instance draw list
+	/// @note Adding or removing instances only changes a counter, the batch offsets are recomputed lazily with a single
+	///       prefix sum when they are accessed (usually once per frame). The batch each entity is counted in is stored,
+	///       so replacing its material with one of another template moves the instance between the batches.
 	class DrawBatchRegistry
 	{
 	public:
-		static constexpr uint32_t MAX_DRAW_BATCHES = 256;
+		/// @brief Draw batch IDs are packed into 16 bits of the GPU instance data (see InstanceData)
+		static constexpr uint32_t MAX_DRAW_BATCHES = 0xFFFF;
 
 		DrawBatchRegistry() = default;
 		~DrawBatchRegistry() = default;
 
 		[[nodiscard]] auto isValid(uint32_t batchId) const -> bool { return batchId < static_cast<uint32_t>(m_batches.size()); }
-		[[nodiscard]] auto batches() const -> const std::vector<DrawBatch>& { return m_batches; }
-		[[nodiscard]] auto batch(uint32_t indexindex) const -> const DrawBatch& { return m_batches[indexindex]; }
 		[[nodiscard]] auto batchCount() const -> uint32_t { return static_cast<uint32_t>(m_batches.size()); }
+
+		[[nodiscard]] auto batches() const -> const std::vector<DrawBatch>&
+		{
+			updateOffsets();
+			return m_batches;
+		}
+
+		[[nodiscard]] auto batch(uint32_t batchId) const -> const DrawBatch&
+		{
+			AGX_ASSERT_X(isValid(batchId), "Invalid batch ID");
+			updateOffsets();
+			return m_batches[batchId];
+		}
+
 		[[nodiscard]] auto instanceCount() const -> uint32_t { return m_totalCount; }
 		[[nodiscard]] auto staticInstanceCount() const -> uint32_t { return m_staticCount; }
 		[[nodiscard]] auto dynamicInstanceCount() const -> uint32_t { return m_dynamicCount; }
 
-		auto registerDrawBatch(std::shared_ptr<MaterialTemplate> mat) -> const DrawBatch&
+		/// @brief Number of slots in the static/dynamic instance buffers the GPU has to process
+		/// @note Can be larger than the instance counts since the instance buffers may contain unused slots
+		[[nodiscard]] auto staticSlotCount() const -> uint32_t { return m_staticSlotCount; }
+		[[nodiscard]] auto dynamicSlotCount() const -> uint32_t { return m_dynamicSlotCount; }
+		[[nodiscard]] auto slotCount() const -> uint32_t { return m_staticSlotCount + m_dynamicSlotCount; }
+
+		void setSlotCounts(uint32_t staticSlots, uint32_t dynamicSlots)
+		{
+			m_staticSlotCount = staticSlots;
+			m_dynamicSlotCount = dynamicSlots;
+		}
+
+		/// @brief Entities whose Mesh, Material or DynamicTag was added, patched or removed since the last rendered frame
+		/// @note Entities can be listed multiple times and may already be destroyed
+		[[nodiscard]] auto instanceChanges() const -> const std::vector<Scene::Entity>& { return m_instanceChanges; }
+		void clearInstanceChanges() { m_instanceChanges.clear(); }
+
+		/// @brief Returns the batch of the template, a new batch is appended if the template is not registered yet
+		/// @note The batch ID is stored in the template (see MaterialTemplate::drawBatch)
+		auto registerDrawBatch(const std::shared_ptr<MaterialTemplate>& mat) -> const DrawBatch&
 		{
-			auto it = std::find_if(m_batches.begin(), m_batches.end(),
-				[&mat](const DrawBatch& batch) {
-					return batch.materialTemplate == mat;
-				});
-			if (it != m_batches.end())
-				return *it;
-
-			uint32_t nextId = static_cast<uint32_t>(m_batches.size());
-			m_batches.emplace_back(nextId, m_totalCount, 0, std::move(mat));
-			return m_batches.back();
+			return batch(batchID(mat));
 		}
 
 		void addInstance(uint32_t batchId)
@@ -57,16 +85,18 @@ export namespace Aegis::Graphics
 			AGX_ASSERT_X(isValid(batchId), "Invalid batch ID");
 
 			m_batches[batchId].instanceCount++;
-			updateOffsets(batchId);
+			m_totalCount++;
+			m_offsetsDirty = true;
 		}
 
 		void removeInstance(uint32_t batchId)
 		{
 			AGX_ASSERT_X(isValid(batchId), "Invalid batch ID");
-			AGX_ASSERT_X(m_batches[batchId].instanceCount > 0, "Batch count is already zero");
+			AGX_ASSERT_X(m_batches[batchId].instanceCount > 0, "Batch count would drop below zero");
 
 			m_batches[batchId].instanceCount--;
-			updateOffsets(batchId);
+			m_totalCount--;
+			m_offsetsDirty = true;
 		}
 
 		void sceneChanged(Scene::Scene& scene)
@@ -76,29 +106,56 @@ export namespace Aegis::Graphics
 			reg.onDestroy<Material>().connect<&DrawBatchRegistry::onMaterialRemoved>(this);
 			reg.onConstruct<DynamicTag>().connect<&DrawBatchRegistry::onDynamicTagCreated>(this);
 			reg.onDestroy<DynamicTag>().connect<&DrawBatchRegistry::onDynamicTagRemoved>(this);
+			reg.onUpdate<Material>().connect<&DrawBatchRegistry::onMaterialUpdated>(this);
+			reg.onConstruct<Mesh>().connect<&DrawBatchRegistry::onInstanceChanged>(this);
+			reg.onUpdate<Mesh>().connect<&DrawBatchRegistry::onInstanceChanged>(this);
+			reg.onDestroy<Mesh>().connect<&DrawBatchRegistry::onInstanceChanged>(this);
 		}
 
 	private:
-		void updateOffsets(uint32_t startBatchId = 0)
+		/// @brief Looks up (or registers) the batch of a template
+		auto batchID(const std::shared_ptr<MaterialTemplate>& mat) -> uint32_t
+		{
+			// Instances are usually created in runs sharing the same template
+			if (mat.get() == m_lastTemplate)
+				return m_lastBatchId;
+
+			auto [it, inserted] = m_batchLookup.try_emplace(mat.get(), static_cast<uint32_t>(m_batches.size()));
+			if (inserted)
+			{
+				AGX_ASSERT_X(it->second < MAX_DRAW_BATCHES, "Draw batch ID does not fit into 16 bits");
+				m_batches.emplace_back(it->second, m_totalCount, 0, mat);
+				mat->setDrawBatchId(it->second);
+			}
+
+			m_lastTemplate = mat.get();
+			m_lastBatchId = it->second;
+			return it->second;
+		}
+
+		/// @brief Prefix sum over the instance counts of all batches
+		void updateOffsets() const
 		{
-			if (!isValid(startBatchId))
+			if (!m_offsetsDirty)
 				return;
 
-			uint32_t baseOffset = m_batches[startBatchId].firstInstance + m_batches[startBatchId].instanceCount;
-			for (uint32_t i = startBatchId + 1; i < static_cast<uint32_t>(m_batches.size()); i++)
+			uint32_t offset = 0;
+			for (auto& batch : m_batches)
 			{
-				m_batches[i].firstInstance = baseOffset;
-				baseOffset += m_batches[i].instanceCount;
+				batch.firstInstance = offset;
+				offset += batch.instanceCount;
 			}
-			m_totalCount = baseOffset;
+			AGX_ASSERT_X(offset == m_totalCount, "Draw batch instance counts are out of sync");
+			m_offsetsDirty = false;
 		}
 
 		void onMaterialCreated(entt::registry& reg, entt::entity e)
 		{
 			const auto& material = reg.get<Material>(e);
-			const auto& matTemplate = material.instance->materialTemplate();
-			registerDrawBatch(matTemplate);
-			addInstance(matTemplate->drawBatch());
+			uint32_t batchId = batchID(material.instance->materialTemplate());
+			m_entityBatches[e] = batchId;
+			addInstance(batchId);
+			onInstanceChanged(reg, e);
 
 			if (reg.all_of<DynamicTag>(e))
 			{
@@ -110,11 +167,30 @@ export namespace Aegis::Graphics
 			}
 		}
 
-		void onMaterialRemoved(entt::registry& reg, entt::entity e)
+		/// @brief The instance might have been patched to a material of another template
+		void onMaterialUpdated(entt::registry& reg, entt::entity e)
 		{
 			const auto& material = reg.get<Material>(e);
-			const auto& matTemplate = material.instance->materialTemplate();
-			removeInstance(matTemplate->drawBatch());
+			uint32_t batchId = batchID(material.instance->materialTemplate());
+			auto it = m_entityBatches.find(e);
+			AGX_ASSERT_X(it != m_entityBatches.end(), "Material updated before it was created");
+			if (it->second != batchId)
+			{
+				removeInstance(it->second);
+				addInstance(batchId);
+				it->second = batchId;
+			}
+			onInstanceChanged(reg, e);
+		}
+
+		/// @brief The stored batch is used, the template of the material might not be the one it was counted in
+		void onMaterialRemoved(entt::registry& reg, entt::entity e)
+		{
+			auto it = m_entityBatches.find(e);
+			AGX_ASSERT_X(it != m_entityBatches.end(), "Material removed before it was created");
+			removeInstance(it->second);
+			m_entityBatches.erase(it);
+			onInstanceChanged(reg, e);
 
 			if (reg.all_of<DynamicTag>(e))
 			{
@@ -128,6 +204,7 @@ export namespace Aegis::Graphics
 
 		void onDynamicTagCreated(entt::registry& reg, entt::entity e)
 		{
+			onInstanceChanged(reg, e);
 			if (!reg.all_of<Material>(e))
 				return;
 
@@ -137,6 +214,7 @@ export namespace Aegis::Graphics
 
 		void onDynamicTagRemoved(entt::registry& reg, entt::entity e)
 		{
+			onInstanceChanged(reg, e);
 			if (!reg.all_of<Material>(e))
 				return;
 
@@ -144,9 +222,22 @@ export namespace Aegis::Graphics
 			m_dynamicCount--;
 		}
 
-		std::vector<DrawBatch> m_batches;
+		void onInstanceChanged(entt::registry& reg, entt::entity e)
+		{
+			m_instanceChanges.emplace_back(e);
+		}
+
+		mutable std::vector<DrawBatch> m_batches;
+		mutable bool m_offsetsDirty{ false };
+		std::unordered_map<const MaterialTemplate*, uint32_t> m_batchLookup;
+		std::unordered_map<entt::entity, uint32_t> m_entityBatches;
+		const MaterialTemplate* m_lastTemplate{ nullptr };
+		uint32_t m_lastBatchId{ 0 };
 		uint32_t m_staticCount{ 0 };
 		uint32_t m_dynamicCount{ 0 };
 		uint32_t m_totalCount{ 0 };
+		uint32_t m_staticSlotCount{ 0 };
+		uint32_t m_dynamicSlotCount{ 0 };
+		std::vector<Scene::Entity> m_instanceChanges;
 	};
 }
\ No newline at end of file
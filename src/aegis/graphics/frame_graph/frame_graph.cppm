@@ -65,9 +65,11 @@ export namespace Aegis::Graphics
 		{
 			auto nodeInfo = pass->info();
 			m_nodes.emplace_back(nodeInfo, std::move(pass));
+			m_nodes.back().profileScope = Profiler::instance().registerScope(nodeInfo.name);
 			return FGNodeHandle{ static_cast<uint32_t>(m_nodes.size() - 1) };
 		}
 
+		/// @brief Adds a render pass, passes writing the same resource have to be added in execution order
 		template<typename T, typename... Args>
 			requires std::is_base_of_v<FGRenderPass, T>&& std::constructible_from<T, FGResourcePool&, Args...>
 		auto add(Args&&... args) -> T&
@@ -114,13 +116,13 @@ export namespace Aegis::Graphics
 		/// @brief Executes the frame graph by executing each node in order
 		void execute(const FrameInfo& frameInfo)
 		{
-			ScopeProfiler execute("FrameGraph Execute");
+			ScopeProfiler execute{ "FrameGraph Execute"_scope };
 
 			for (auto nodeHandle : m_nodesSorted)
 			{
 				auto& node = queryNode(nodeHandle);
-				GPUScopeTimer gpuScope(frameInfo.cmd, node.info.name.c_str());
-				ScopeProfiler cpuScope(node.info.name.c_str());
+				GPUScopeTimer gpuScope(frameInfo.cmd, node.profileScope);
+				ScopeProfiler cpuScope{ node.profileScope };
 
 				Tools::vk::cmdBeginDebugUtilsLabel(frameInfo.cmd, node.info.name.c_str());
 				{
@@ -128,6 +130,10 @@ export namespace Aegis::Graphics
 					node.pass->execute(m_pool, frameInfo);
 				}
 				Tools::vk::cmdEndDebugUtilsLabel(frameInfo.cmd);
+
+				// Passes can grow buffers during execution, following barriers must use the new VkBuffer
+				if (m_pool.consumeBuffersResized())
+					updateBufferBarriers();
 			}
 		}
 
@@ -157,12 +163,33 @@ export namespace Aegis::Graphics
 		}
 
 	private:
+		void updateBufferBarriers()
+		{
+			for (auto& node : m_nodes)
+			{
+				AGX_ASSERT_X(node.bufferBarriers.size() == node.accessedBuffers.size(),
+					"Mismatched buffer barriers and accessed buffers count in FGNode");
+				for (std::size_t i = 0; i < node.accessedBuffers.size(); i++)
+				{
+					node.bufferBarriers[i].buffer = m_pool.buffer(node.accessedBuffers[i]).buffer();
+				}
+			}
+		}
+
 		using DependencyGraph = std::vector<std::vector<FGNodeHandle>>;
 
+		/// @brief Resources are versioned in the order passes were added: The owning pass creates the first version and
+		///        every pass writing a reference creates a new one. Reads depend on the latest version at that point.
 		auto buildDependencyGraph() -> DependencyGraph
 		{
-			// Register producers
-			std::unordered_map<FGResourceHandle, FGNodeHandle> producers;
+			struct ResourceVersion
+			{
+				FGNodeHandle producer;
+				std::vector<FGNodeHandle> readers;
+			};
+
+			// Owners always create the first version (independent of the order they were added)
+			std::unordered_map<FGResourceHandle, ResourceVersion> versions;
 			for (const auto& handle : m_nodesSorted)
 			{
 				auto& n = queryNode(handle);
@@ -171,57 +198,52 @@ export namespace Aegis::Graphics
 					const auto& resource = m_pool.resource(write);
 					if (!std::holds_alternative<FGReferenceInfo>(resource.info))
 					{
-						producers[write] = handle;
+						versions[write].producer = handle;
 					}
 				}
 			}
 
 			// Build adjacency list
 			std::vector<std::vector<FGNodeHandle>> adjacency(m_nodesSorted.size());
+			auto dependsOn = [&adjacency](FGNodeHandle node, FGNodeHandle dependency) {
+				if (node != dependency)
+					adjacency[node.handle].emplace_back(dependency);
+				};
 
-			// Link write -> write dependencies
-			for (const auto& FGNodeHandle : m_nodesSorted)
+			for (const auto& nodeHandle : m_nodesSorted)
 			{
-				auto& node = queryNode(FGNodeHandle);
+				auto& node = queryNode(nodeHandle);
 
-				for (auto& write : node.info.writes)
+				// Link write -> read dependencies
+				for (auto& read : node.info.reads)
 				{
-					const auto& resource = m_pool.resource(write);
-					if (!std::holds_alternative<FGReferenceInfo>(resource.info))
-						continue;
-
-					const auto& refInfo = std::get<FGReferenceInfo>(resource.info);
-					auto producer = producers.find(refInfo.handle);
-					if (producer == producers.end())
+					auto version = versions.find(m_pool.actualHandle(read));
+					if (version == versions.end())
 						continue;
 
-					if (FGNodeHandle != producer->second)
-					{
-						adjacency[FGNodeHandle.handle].emplace_back(producer->second);
-						producers[refInfo.handle] = FGNodeHandle; // Update producer to the latest writer
-					}
+					dependsOn(nodeHandle, version->second.producer);
+					version->second.readers.emplace_back(nodeHandle);
 				}
-			}
 
-			// Link write -> read dependencies
-			for (const auto& FGNodeHandle : m_nodesSorted)
-			{
-				auto& n = queryNode(FGNodeHandle);
-				for (auto& read : n.info.reads)
+				// Link write -> write and read -> write dependencies (readers of the previous version must finish first)
+				for (auto& write : node.info.writes)
 				{
-					const auto& resource = m_pool.resource(read);
+					const auto& resource = m_pool.resource(write);
 					if (!std::holds_alternative<FGReferenceInfo>(resource.info))
 						continue;
 
-					const auto& refInfo = std::get<FGReferenceInfo>(resource.info);
-					auto producer = producers.find(refInfo.handle);
-					if (producer == producers.end())
+					auto version = versions.find(m_pool.actualHandle(write));
+					if (version == versions.end())
 						continue;
 
-					if (FGNodeHandle != producer->second)
+					dependsOn(nodeHandle, version->second.producer);
+					for (auto reader : version->second.readers)
 					{
-						adjacency[FGNodeHandle.handle].emplace_back(producer->second);
+						dependsOn(nodeHandle, reader);
 					}
+
+					version->second.producer = nodeHandle;
+					version->second.readers.clear();
 				}
 			}
 
@@ -387,6 +409,7 @@ export namespace Aegis::Graphics
 					.size = VK_WHOLE_SIZE,
 				};
 				node.bufferBarriers.emplace_back(barrier);
+				node.accessedBuffers.emplace_back(bufferInfo.handle);
 			}
 			else if (std::holds_alternative<FGTextureInfo>(actualResource.info))
 			{
@@ -404,9 +427,9 @@ export namespace Aegis::Graphics
 					.subresourceRange = VkImageSubresourceRange{
 						.aspectMask = Tools::aspectFlags(texture.image().format()),
 						.baseMipLevel = 0,
-						.levelCount = texture.image().mipLevels(),
+						.levelCount = VK_REMAINING_MIP_LEVELS, // Mip count can change when resized
 						.baseArrayLayer = 0,
-						.layerCount = texture.image().layerCount(),
+						.layerCount = VK_REMAINING_ARRAY_LAYERS,
 					}
 				};
 				node.imageBarriers.emplace_back(barrier);
@@ -12,6 +12,8 @@ export import Aegis.Graphics.FrameGraph.Resource;
 export import Aegis.Graphics.FrameGraph.ResourceHandle;
 export import Aegis.Graphics.FrameGraph.RenderPass;
 
+import Aegis.Core.Profiler;
+
 export namespace Aegis::Graphics
 {
 	struct FGNode
@@ -22,6 +24,8 @@ export namespace Aegis::Graphics
 		VkPipelineStageFlags dstStage{ 0 };
 		std::vector<VkBufferMemoryBarrier> bufferBarriers;
 		std::vector<VkImageMemoryBarrier> imageBarriers;
+		std::vector<FGBufferHandle> accessedBuffers;
 		std::vector<FGTextureHandle> accessedTextures;
+		ScopeID profileScope{ 0 };	///< Pass name interned once for the CPU and GPU profilers
 	};
 }
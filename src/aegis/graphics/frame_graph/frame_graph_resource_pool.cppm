@@ -5,9 +5,11 @@ module;
 
 #include <aegis-log/log.h>
 
-#include <vector>
-#include <variant>
+#include <algorithm>
 #include <memory>
+#include <utility>
+#include <variant>
+#include <vector>
 
 export module Aegis.Graphics.FrameGraph.ResourcePool;
 
@@ -176,19 +178,7 @@ export namespace Aegis::Graphics
 
 		auto createBuffer(FGBufferInfo& info, const char* name) -> FGBufferHandle
 		{
-			// Typically uniform alignment is larger than storage buffer alignment -> prefer that
-			auto alignment = VulkanContext::device().properties().limits.minStorageBufferOffsetAlignment;
-			if (info.usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT)
-				alignment = VulkanContext::device().properties().limits.minUniformBufferOffsetAlignment;
-
-			auto bufferCreateInfo = Buffer::CreateInfo{
-				.instanceSize = info.size,
-				.instanceCount = info.instanceCount,
-				.usage = info.usage,
-				.allocFlags = info.allocFlags,
-				.minOffsetAlignment = alignment
-			};
-			m_buffers.emplace_back(bufferCreateInfo);
+			m_buffers.emplace_back(bufferCreateInfo(info));
 
 			Tools::setDebugUtilsObjectName(m_buffers.back().buffer(), name);
 			return FGBufferHandle{ static_cast<uint32_t>(m_buffers.size() - 1) };
@@ -196,11 +186,11 @@ export namespace Aegis::Graphics
 
 		auto createImage(FGTextureInfo& info, const char* name) -> FGTextureHandle
 		{
-			if (info.resizeMode == FGResizeMode::SwapChainRelative)
+			if (info.resizeMode != FGResizeMode::Fixed)
 			{
 				AGX_ASSERT_X(info.extent.width == 0 && info.extent.height == 0,
 					"SwapChainRelative images must have initial extent of { 0, 0 }");
-				info.extent = { Core::DEFAULT_WIDTH, Core::DEFAULT_HEIGHT };
+				info.extent = relativeExtent(info.resizeMode, Core::DEFAULT_WIDTH, Core::DEFAULT_HEIGHT);
 			}
 
 			auto textureCreateInfo = Texture::CreateInfo::texture2D(info.extent.width, info.extent.height, info.format);
@@ -212,6 +202,68 @@ export namespace Aegis::Graphics
 			return FGTextureHandle{ static_cast<uint32_t>(m_textures.size() - 1) };
 		}
 
+		/// @brief Recreates the buffer with a larger size per instance (buffers never shrink)
+		/// @note If a command buffer is given, the content of all instances is copied to the new buffer (requires transfer
+		///       src/dst usage). The bindless handles change, so passes have to query them every frame.
+		void growBuffer(FGResourceHandle handle, VkDeviceSize size, VkCommandBuffer cmd = VK_NULL_HANDLE)
+		{
+			auto& res = resource(actualHandle(handle));
+			AGX_ASSERT_X(std::holds_alternative<FGBufferInfo>(res.info), "Resource is not a buffer");
+
+			auto& info = std::get<FGBufferInfo>(res.info);
+			if (size <= info.size)
+				return;
+
+			info.size = size;
+			Bindless::BindlessMultiBuffer newBuffer{ bufferCreateInfo(info) };
+			auto& oldBuffer = m_buffers[info.handle.handle];
+			if (cmd != VK_NULL_HANDLE)
+			{
+				// Previous writes (also from frames still in flight) have to finish before copying
+				VkBufferMemoryBarrier readBarrier{
+					.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+					.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+					.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+					.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+					.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+					.buffer = oldBuffer.buffer(),
+					.offset = 0,
+					.size = VK_WHOLE_SIZE,
+				};
+				Tools::vk::cmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+					{ readBarrier }, {});
+
+				for (uint32_t i = 0; i < info.instanceCount; i++)
+				{
+					oldBuffer.buffer().copyTo(cmd, newBuffer.buffer(), i, i);
+				}
+
+				VkBufferMemoryBarrier writeBarrier{
+					.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+					.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+					.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+					.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+					.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+					.buffer = newBuffer.buffer(),
+					.offset = 0,
+					.size = VK_WHOLE_SIZE,
+				};
+				Tools::vk::cmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+					{ writeBarrier }, {});
+			}
+
+			// Old buffer is destroyed once the frames in flight are done with it
+			oldBuffer = std::move(newBuffer);
+			Tools::setDebugUtilsObjectName(oldBuffer.buffer(), res.name.c_str());
+			m_buffersResized = true;
+		}
+
+		/// @brief Returns true once after any buffer was grown
+		auto consumeBuffersResized() -> bool
+		{
+			return std::exchange(m_buffersResized, false);
+		}
+
 		void resizeImages(uint32_t width, uint32_t height)
 		{
 			// Resize all swapchain-relative images
@@ -222,13 +274,13 @@ export namespace Aegis::Graphics
 					continue;
 
 				auto& info = std::get<FGTextureInfo>(res.info);
-				if (info.resizeMode == FGResizeMode::SwapChainRelative)
+				if (info.resizeMode != FGResizeMode::Fixed)
 				{
 					auto& tex = m_textures[info.handle.handle];
 					auto oldLayout = tex.image().layout();
-					tex.resize({ width, height, 1 }, info.usage);
+					info.extent = relativeExtent(info.resizeMode, width, height);
+					tex.resize({ info.extent.width, info.extent.height, 1 }, info.usage, info.mipLevels);
 					tex.image().transitionLayout(cmd, oldLayout);
-					info.extent = { width, height };
 				}
 			}
 			VulkanContext::device().endSingleTimeCommands(cmd);
@@ -236,8 +288,33 @@ export namespace Aegis::Graphics
 		}
 
 	private:
+		static auto relativeExtent(FGResizeMode mode, uint32_t width, uint32_t height) -> VkExtent2D
+		{
+			if (mode == FGResizeMode::HalfSwapChainRelative)
+				return { std::max(width / 2, 1u), std::max(height / 2, 1u) };
+
+			return { width, height };
+		}
+
+		static auto bufferCreateInfo(const FGBufferInfo& info) -> Buffer::CreateInfo
+		{
+			// Typically uniform alignment is larger than storage buffer alignment -> prefer that
+			auto alignment = VulkanContext::device().properties().limits.minStorageBufferOffsetAlignment;
+			if (info.usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT)
+				alignment = VulkanContext::device().properties().limits.minUniformBufferOffsetAlignment;
+
+			return Buffer::CreateInfo{
+				.instanceSize = info.size,
+				.instanceCount = info.instanceCount,
+				.usage = info.usage,
+				.allocFlags = info.allocFlags,
+				.minOffsetAlignment = alignment
+			};
+		}
+
 		std::vector<FGResource> m_resources;
 		std::vector<Bindless::BindlessMultiBuffer> m_buffers;
 		std::vector<Texture> m_textures;
+		bool m_buffersResized{ false };
 	};
 }
@@ -33,6 +33,7 @@ export namespace Aegis::Graphics
 	{
 		Fixed,
 		SwapChainRelative,
+		HalfSwapChainRelative,	// Half the swap chain size in each dimension (rounded down, at least 1)
 	};
 
 	struct FGBufferInfo
@@ -50,7 +51,7 @@ export namespace Aegis::Graphics
 		VkFormat format;
 		VkExtent2D extent{ 0, 0 };
 		FGResizeMode resizeMode{ FGResizeMode::Fixed };
-		uint32_t mipLevels{ 1 };
+		uint32_t mipLevels{ 1 }; // 0 creates a full mip chain (also recalculated when resized)
 		VkImageUsageFlags usage{ 0 };
 
 		FGTextureHandle handle;
@@ -71,6 +72,7 @@ export namespace Aegis::Graphics
 			ColorAttachment,
 			DepthStencilAttachment,
 			FragmentReadSampled,
+			TaskReadSampled,
 			ComputeReadUniform,
 			ComputeReadStorage,
 			ComputeWriteStorage,
@@ -79,6 +81,7 @@ export namespace Aegis::Graphics
 			TransferDst,
 			Present,
 			IndirectBuffer,
+			IndexBuffer,
 		};
 
 		struct AccessInfo
@@ -123,6 +126,12 @@ export namespace Aegis::Graphics
 					.access = VK_ACCESS_SHADER_READ_BIT,
 					.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
 				};
+			case Usage::TaskReadSampled:
+				return AccessInfo{
+					.stage = VK_PIPELINE_STAGE_TASK_SHADER_BIT_EXT,
+					.access = VK_ACCESS_SHADER_READ_BIT,
+					.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+				};
 			case Usage::ComputeReadUniform:
 				return AccessInfo{
 					.stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
@@ -171,6 +180,12 @@ export namespace Aegis::Graphics
 					.access = VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
 					.layout = VK_IMAGE_LAYOUT_UNDEFINED
 				};
+			case Usage::IndexBuffer:
+				return AccessInfo{
+					.stage = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+					.access = VK_ACCESS_INDEX_READ_BIT,
+					.layout = VK_IMAGE_LAYOUT_UNDEFINED
+				};
 			}
 		}
 
@@ -182,7 +197,8 @@ export namespace Aegis::Graphics
 				return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 			case Usage::DepthStencilAttachment:
 				return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-			case Usage::FragmentReadSampled:
+			case Usage::FragmentReadSampled: [[fallthrough]];
+			case Usage::TaskReadSampled:
 				return VK_IMAGE_USAGE_SAMPLED_BIT;
 			case Usage::ComputeReadStorage:
 				return VK_IMAGE_USAGE_STORAGE_BIT;
@@ -198,6 +214,7 @@ export namespace Aegis::Graphics
 				return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT; // Typically also a color attachment
 
 			case Usage::IndirectBuffer: [[fallthrough]];
+			case Usage::IndexBuffer: [[fallthrough]];
 			case Usage::ComputeReadUniform:
 				AGX_UNREACHABLE("Buffer usage is not applicable for images");
 				return 0;
@@ -224,10 +241,13 @@ export namespace Aegis::Graphics
 				return VK_BUFFER_USAGE_TRANSFER_DST_BIT;
 			case Usage::IndirectBuffer:
 				return VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+			case Usage::IndexBuffer:
+				return VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
 
 			case Usage::ColorAttachment: [[fallthrough]];
 			case Usage::DepthStencilAttachment: [[fallthrough]];
 			case Usage::FragmentReadSampled: [[fallthrough]];
+			case Usage::TaskReadSampled: [[fallthrough]];
 			case Usage::ComputeReadSampled: [[fallthrough]];
 			case Usage::Present:
 				AGX_UNREACHABLE("Image usage is not applicable for buffers");
@@ -1,17 +1,16 @@
 module;
 
+#include "core/assert.h"
 #include "graphics/vulkan/vulkan_include.h"
 
-#include <vector>
 #include <array>
-#include <string>
+#include <cstdint>
 #include <string_view>
-
-#define AGX_GPU_PROFILE_SCOPE(cmd, name) Aegis::Graphics::GPUScopeTimer gpuTimer##__LINE__(cmd, name)
-#define AGX_GPU_PROFILE_FUNCTION(cmd) AGX_GPU_PROFILE_SCOPE(cmd, __FUNCTION__)
+#include <vector>
 
 export module Aegis.Graphics.GPUTimer;
 
+import Aegis.Core.Profiler;
 import Aegis.Graphics.Globals;
 import Aegis.Graphics.VulkanContext;
 
@@ -19,17 +18,22 @@ export namespace Aegis::Graphics
 {
 	struct GPUTimingResult
 	{
-		std::string name;
+		ScopeID id{ 0 };
+		std::string_view name;
 		double timeMs{ 0.0 };
 	};
 
+	/// @note Resolved timestamps are also passed to the Profiler (on the CPU timeline) while it captures a trace.
+	///       With VK_EXT_calibrated_timestamps the device clock is sampled between two CPU timestamps when the queries
+	///       are resolved, without it the first query of a frame is aligned to the time the frame was submitted.
 	class GPUTimerManager
 	{
 	public:
 		static constexpr uint32_t MAX_QUERY_COUNT = 128;
 
 		GPUTimerManager() :
-			m_timestampPeriod{ VulkanContext::device().properties().limits.timestampPeriod }
+			m_timestampPeriod{ VulkanContext::device().properties().limits.timestampPeriod },
+			m_calibrated{ VulkanContext::device().features().calibratedTimestamps }
 		{
 			VkQueryPoolCreateInfo queryPoolInfo{
 				.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
@@ -64,20 +68,27 @@ export namespace Aegis::Graphics
 		[[nodiscard]] auto queryPool() const -> VkQueryPool { return m_queryPools[m_frameIndex]; }
 		[[nodiscard]] auto timings() const -> const std::vector<GPUTimingResult>& { return m_results; }
 
-		auto aquireQueryIndices(std::string_view name) -> std::pair<uint32_t, uint32_t>
+		auto aquireQueryIndices(ScopeID id) -> std::pair<uint32_t, uint32_t>
 		{
 			auto& queryInfo = m_queries[m_frameIndex];
 			AGX_ASSERT_X(queryInfo.currentQuery + 2 <= MAX_QUERY_COUNT, "Exceeded maximum GPU query count");
-			queryInfo.names.emplace_back(name);
+			queryInfo.ids.emplace_back(id);
 			return { queryInfo.currentQuery++, queryInfo.currentQuery++ };
 		}
 
+		/// @brief Remembers the submit time of the frame (fallback alignment of GPU traces)
+		void submitted(uint32_t frameIndex)
+		{
+			m_queries[frameIndex].submitTime = Profiler::steadyNanos();
+		}
+
 		void resolveTimings(VkCommandBuffer cmd, uint32_t frameIndex)
 		{
 			m_frameIndex = frameIndex;
 
 			// Retrieve timestamps for previous frame N
-			auto queryCount = m_queries[m_frameIndex].currentQuery;
+			auto& queryInfo = m_queries[m_frameIndex];
+			auto queryCount = queryInfo.currentQuery;
 			if (queryCount > 0)
 			{
 				std::vector<uint64_t> timestamps(queryCount);
@@ -85,23 +96,36 @@ export namespace Aegis::Graphics
 					sizeof(uint64_t) * timestamps.size(), timestamps.data(), sizeof(uint64_t),
 					VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
 
-				std::size_t queryCount = m_queries[m_frameIndex].names.size();
-				AGX_ASSERT_X(queryCount * 2 == timestamps.size(), "Mismatch between query names and timestamps");
+				std::size_t timerCount = queryInfo.ids.size();
+				AGX_ASSERT_X(timerCount * 2 == timestamps.size(), "Mismatch between query names and timestamps");
 
+				auto& profiler = Profiler::instance();
 				m_results.clear();
-				for (std::size_t i = 0; i < queryCount; ++i)
+				for (std::size_t i = 0; i < timerCount; ++i)
 				{
 					uint64_t start = timestamps[i * 2];
 					uint64_t end = timestamps[i * 2 + 1];
 					double timeNs = static_cast<double>(end - start) * m_timestampPeriod;
-					m_results.emplace_back(m_queries[m_frameIndex].names[i], timeNs / 1'000'000.0);
+					m_results.emplace_back(queryInfo.ids[i], profiler.scopeName(queryInfo.ids[i]), timeNs / 1'000'000.0);
+				}
+
+				if (profiler.isCapturing())
+				{
+					auto [anchorTicks, anchorNs] = timelineAnchor(timestamps.front(), queryInfo.submitTime);
+					auto toSteady = [&](uint64_t ticks) {
+						double deltaNs = (static_cast<double>(ticks) - static_cast<double>(anchorTicks)) * m_timestampPeriod;
+						return static_cast<uint64_t>(static_cast<double>(anchorNs) + deltaNs);
+						};
+
+					for (std::size_t i = 0; i < timerCount; ++i)
+						profiler.recordGPU(queryInfo.ids[i], toSteady(timestamps[i * 2]), toSteady(timestamps[i * 2 + 1]));
 				}
 			}
 
 			// Reset for recording this frame N
-			m_queries[m_frameIndex].currentQuery = 0;
+			queryInfo.currentQuery = 0;
 			vkCmdResetQueryPool(cmd, m_queryPools[m_frameIndex], 0, MAX_QUERY_COUNT);
-			m_queries[m_frameIndex].names.clear();
+			queryInfo.ids.clear();
 		}
 
 	private:
@@ -109,13 +133,33 @@ export namespace Aegis::Graphics
 
 		struct QueryInfo
 		{
-			std::vector<std::string> names;
+			std::vector<ScopeID> ids;
 			uint32_t currentQuery{ 0 };
+			uint64_t submitTime{ 0 };
 		};
 
+		/// @brief Pair of device ticks and steady clock nanoseconds describing the same moment
+		auto timelineAnchor(uint64_t firstTimestamp, uint64_t submitTime) const -> std::pair<uint64_t, uint64_t>
+		{
+			if (!m_calibrated)
+				return { firstTimestamp, submitTime };
+
+			VkCalibratedTimestampInfoEXT info{
+				.sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT,
+				.timeDomain = VK_TIME_DOMAIN_DEVICE_EXT,
+			};
+			uint64_t deviceTicks = 0;
+			uint64_t maxDeviation = 0;
+			uint64_t before = Profiler::steadyNanos();
+			VK_CHECK(vkGetCalibratedTimestampsEXT(VulkanContext::device(), 1, &info, &deviceTicks, &maxDeviation));
+			uint64_t after = Profiler::steadyNanos();
+			return { deviceTicks, before + (after - before) / 2 };
+		}
+
 		std::array<VkQueryPool, MAX_FRAMES_IN_FLIGHT> m_queryPools{};
 		std::array<QueryInfo, MAX_FRAMES_IN_FLIGHT> m_queries{};
 		double m_timestampPeriod{ 0.0f };
+		bool m_calibrated{ false };
 		uint32_t m_frameIndex{ 0 };
 
 		std::vector<GPUTimingResult> m_results{};
@@ -128,9 +172,9 @@ export namespace Aegis::Graphics
 			: m_cmd(cmd)
 		{}
 
-		void start(std::string_view name)
+		void start(ScopeID id)
 		{
-			auto [start, end] = GPUTimerManager::instance().aquireQueryIndices(name);
+			auto [start, end] = GPUTimerManager::instance().aquireQueryIndices(id);
 			m_queryStart = start;
 			m_queryEnd = end;
 			vkCmdWriteTimestamp(m_cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, GPUTimerManager::instance().queryPool(), m_queryStart);
@@ -150,10 +194,10 @@ export namespace Aegis::Graphics
 	class GPUScopeTimer
 	{
 	public:
-		GPUScopeTimer(VkCommandBuffer cmd, std::string_view name) :
+		GPUScopeTimer(VkCommandBuffer cmd, ScopeID id) :
 			m_timer{ cmd }
 		{
-			m_timer.start(name);
+			m_timer.start(id);
 		}
 
 		~GPUScopeTimer()
@@ -0,0 +1,139 @@
+module;
+
+#include "core/assert.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <vector>
+
+export module Aegis.Graphics.InstanceSlotAllocator;
+
+export namespace Aegis::Graphics
+{
+	/// @brief Hands out stable slots in an instance buffer
+	/// @note Released slots are reused (lowest first) before the used range grows. Free slots at the end of the range
+	///       are trimmed immediately, holes inside the range can be closed over time with nextCompactionMove().
+	class InstanceSlotAllocator
+	{
+	public:
+		static constexpr uint32_t INVALID_SLOT = std::numeric_limits<uint32_t>::max();
+
+		struct Move
+		{
+			uint32_t from;
+			uint32_t to;
+		};
+
+		InstanceSlotAllocator() = default;
+		explicit InstanceSlotAllocator(uint32_t capacity) : m_capacity{ capacity } {}
+
+		[[nodiscard]] auto capacity() const -> uint32_t { return m_capacity; }
+
+		/// @brief Number of slots the GPU has to look at (highest used slot + 1)
+		[[nodiscard]] auto rangeSize() const -> uint32_t { return m_rangeSize; }
+		[[nodiscard]] auto usedCount() const -> uint32_t { return m_usedCount; }
+		[[nodiscard]] auto freeCount() const -> uint32_t { return m_rangeSize - m_usedCount; }
+
+		/// @brief Ratio of free slots inside the used range
+		[[nodiscard]] auto fragmentation() const -> float
+		{
+			return m_rangeSize > 0 ? static_cast<float>(freeCount()) / static_cast<float>(m_rangeSize) : 0.0f;
+		}
+
+		[[nodiscard]] auto isUsed(uint32_t slot) const -> bool { return slot < m_rangeSize && !m_free[slot]; }
+
+		void setCapacity(uint32_t capacity)
+		{
+			AGX_ASSERT_X(capacity >= m_rangeSize, "Cannot shrink instance slot capacity below the used range");
+			m_capacity = capacity;
+		}
+
+		/// @brief Returns INVALID_SLOT if the capacity is exhausted
+		auto allocate() -> uint32_t
+		{
+			discardStaleFreeSlots();
+			if (!m_freeSlots.empty())
+			{
+				std::ranges::pop_heap(m_freeSlots, std::greater{});
+				uint32_t slot = m_freeSlots.back();
+				m_freeSlots.pop_back();
+
+				m_free[slot] = false;
+				m_usedCount++;
+				return slot;
+			}
+
+			if (m_rangeSize >= m_capacity)
+				return INVALID_SLOT;
+
+			uint32_t slot = m_rangeSize++;
+			if (slot >= m_free.size())
+				m_free.resize(slot + 1, true);
+
+			m_free[slot] = false;
+			m_usedCount++;
+			return slot;
+		}
+
+		void free(uint32_t slot)
+		{
+			AGX_ASSERT_X(isUsed(slot), "Cannot free instance slot: Slot is not in use");
+
+			m_free[slot] = true;
+			m_usedCount--;
+			m_freeSlots.emplace_back(slot);
+			std::ranges::push_heap(m_freeSlots, std::greater{});
+
+			// Shrink the range so the GPU does not process trailing free slots
+			while (m_rangeSize > 0 && m_free[m_rangeSize - 1])
+			{
+				m_rangeSize--;
+			}
+		}
+
+		/// @brief Moves the highest used slot into the lowest free slot (the caller has to move the slot data)
+		/// @return Nothing if the used range has no holes
+		auto nextCompactionMove() -> std::optional<Move>
+		{
+			discardStaleFreeSlots();
+			if (m_freeSlots.empty())
+				return std::nullopt;
+
+			uint32_t to = allocate();
+			uint32_t from = m_rangeSize - 1;
+			AGX_ASSERT_X(to < from, "Instance slot compaction: Free slot is not below the last used slot");
+
+			free(from);
+			return Move{ from, to };
+		}
+
+		void clear()
+		{
+			m_free.clear();
+			m_freeSlots.clear();
+			m_rangeSize = 0;
+			m_usedCount = 0;
+		}
+
+	private:
+		/// @brief Slots trimmed from the end of the range stay in the heap (and might be reused by growing the range again)
+		///        -> drop them lazily once they reach the top
+		void discardStaleFreeSlots()
+		{
+			while (!m_freeSlots.empty() && (m_freeSlots.front() >= m_rangeSize || !m_free[m_freeSlots.front()]))
+			{
+				std::ranges::pop_heap(m_freeSlots, std::greater{});
+				m_freeSlots.pop_back();
+			}
+		}
+
+		std::vector<bool> m_free;
+		std::vector<uint32_t> m_freeSlots; // Min-heap
+		uint32_t m_capacity{ 0 };
+		uint32_t m_rangeSize{ 0 };
+		uint32_t m_usedCount{ 0 };
+	};
+}
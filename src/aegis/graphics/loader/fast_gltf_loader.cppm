@@ -4,20 +4,36 @@ module;
 #include "graphics/vulkan/vulkan_include.h"
 
 #include <fastgltf/core.hpp>
+#include <fastgltf/glm_element_traits.hpp>
 #include <fastgltf/tools.hpp>
 #include <fastgltf/types.hpp>
 
+#include <aegis-log/log.h>
+
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <variant>
+#include <vector>
+
 export module Aegis.Graphics.Loader:FastGLTFLoader;
 
 import Aegis.Math;
 import Aegis.Graphics.StaticMesh;
 import Aegis.Graphics.Texture;
+import Aegis.Graphics.TextureCooker;
+import Aegis.Graphics.TextureImporter;
 import Aegis.Graphics.MaterialTemplate;
 import Aegis.Graphics.MaterialInstance;
+import Aegis.Graphics.PBRMaterial;
 import Aegis.Graphics.MeshPreprocessor;
+import Aegis.Graphics.MeshCache;
 import Aegis.Graphics.Components;
 import Aegis.Scene.Registry;
 import Aegis.Core.AssetManager;
+import Aegis.Core.JobSystem;
+import Aegis.Utils.File;
 
 export namespace Aegis::Graphics
 {
@@ -44,10 +60,11 @@ export namespace Aegis::Graphics
 
 			// Get default assets
 			m_pbrTemplate = Core::AssetManager::instance().get<Graphics::MaterialTemplate>("default/PBR_template");
+			m_pbrDoubleSidedTemplate = Core::AssetManager::instance().get<Graphics::MaterialTemplate>("default/PBR_template_double_sided");
 			m_pbrDefaultMat = Core::AssetManager::instance().get<Graphics::MaterialInstance>("default/PBR_instance");
 
 			auto& gltf = asset.get();
-			loadMeshes(gltf);
+			loadMeshes(gltf, path);
 			loadTextures(gltf);
 			loadMaterials(gltf);
 
@@ -65,107 +82,157 @@ export namespace Aegis::Graphics
 		[[nodiscard]] auto rootEntity() const -> Scene::Entity { return m_rootEntity; }
 
 	private:
+		static constexpr std::size_t NO_TEXTURE = static_cast<std::size_t>(-1);
+
 		inline static fastgltf::Parser parser;
 
-		void loadMeshes(const fastgltf::Asset& gltf)
+		/// @brief Uploads the primitives from the mesh cache, on a miss they are preprocessed in parallel and cached
+		/// @note Only the GPU resources are created on the loading thread
+		void loadMeshes(const fastgltf::Asset& gltf, const std::filesystem::path& path)
 		{
-			m_meshCache.resize(gltf.meshes.size());
+			struct PrimitiveRef
+			{
+				std::size_t mesh;
+				std::size_t primitive;
+			};
 
+			m_meshCache.resize(gltf.meshes.size());
+			std::vector<PrimitiveRef> primitives;
 			for (std::size_t i = 0; i < gltf.meshes.size(); ++i)
 			{
-				auto& mesh = gltf.meshes[i];
-				m_meshCache[i].reserve(mesh.primitives.size());
+				m_meshCache[i].resize(gltf.meshes[i].primitives.size());
+				for (std::size_t j = 0; j < gltf.meshes[i].primitives.size(); ++j)
+					primitives.emplace_back(i, j);
+			}
 
-				for (const auto& primitive : mesh.primitives)
+			auto cachePath = MeshCache::cachePath(path);
+			auto sourceHash = hashSource(gltf, path);
+			auto optionsHash = MeshCache::optionsHash();
+			if (auto cache = MeshCache::open(cachePath, sourceHash, optionsHash); cache && cache->meshCount() == primitives.size())
+			{
+				for (std::size_t i = 0; i < primitives.size(); ++i)
 				{
-					Graphics::MeshPreprocessor::Input input{};
+					auto geometry = cache->mesh(static_cast<uint32_t>(i));
+					m_meshCache[primitives[i].mesh][primitives[i].primitive] = std::make_shared<Graphics::StaticMesh>(geometry);
+				}
+				return;
+			}
 
-					auto* posIt = primitive.findAttribute("POSITION");
-					AGX_ASSERT_X(posIt != primitive.attributes.end(), "GLTF primitive is missing POSITION attribute");
-					auto& positionAcc = gltf.accessors[posIt->accessorIndex];
-					input.positions.reserve(positionAcc.count);
-					fastgltf::iterateAccessor<fastgltf::math::fvec3>(gltf, positionAcc, [&](fastgltf::math::fvec3 pos)
-						{
-							input.positions.emplace_back(glm::vec3{ pos.x(), pos.y(), pos.z() });
-						});
-
-					auto* normIt = primitive.findAttribute("NORMAL");
-					AGX_ASSERT_X(normIt != primitive.attributes.end(), "GLTF primitive is missing NORMAL attribute");
-					auto& normalAcc = gltf.accessors[normIt->accessorIndex];
-					input.normals.reserve(normalAcc.count);
-					fastgltf::iterateAccessor<fastgltf::math::fvec3>(gltf, normalAcc, [&](fastgltf::math::fvec3 norm)
-						{
-							input.normals.emplace_back(glm::vec3{ norm.x(), norm.y(), norm.z() });
-						});
+			// Primitives differ a lot in size, one per job keeps the workers busy
+			std::vector<StaticMesh::CreateInfo> processed(primitives.size());
+			Core::JobSystem::instance().parallelFor(primitives.size(), 1, [&](std::size_t begin, std::size_t end) {
+				for (std::size_t i = begin; i < end; ++i)
+				{
+					const auto& primitive = gltf.meshes[primitives[i].mesh].primitives[primitives[i].primitive];
+					auto input = readPrimitive(gltf, primitive);
+					processed[i] = Graphics::MeshPreprocessor::process(input);
+				}
+				});
 
-					auto* uvIt = primitive.findAttribute("TEXCOORD_0");
-					if (uvIt != primitive.attributes.end())
-					{
-						auto& uvAcc = gltf.accessors[uvIt->accessorIndex];
-						input.uvs.reserve(uvAcc.count);
-						fastgltf::iterateAccessor<fastgltf::math::fvec2>(gltf, uvAcc, [&](fastgltf::math::fvec2 uv)
-							{
-								input.uvs.emplace_back(glm::vec2{ uv.x(), uv.y() });
-							});
-					}
+			MeshCache::write(cachePath, sourceHash, optionsHash, processed);
 
-					auto* colorIt = primitive.findAttribute("COLOR_0");
-					if (colorIt != primitive.attributes.end())
-					{
-						auto& colorAcc = gltf.accessors[colorIt->accessorIndex];
-						input.colors.reserve(colorAcc.count);
-						fastgltf::iterateAccessor<fastgltf::math::fvec3>(gltf, colorAcc, [&](fastgltf::math::fvec3 color)
-							{
-								input.colors.emplace_back(glm::vec3{ color.x(), color.y(), color.z() });
-							});
-					}
+			// The geometry arena and the upload context are only used from the loading thread
+			for (std::size_t i = 0; i < primitives.size(); ++i)
+			{
+				m_meshCache[primitives[i].mesh][primitives[i].primitive] = std::make_shared<Graphics::StaticMesh>(processed[i]);
+				processed[i] = {};
+			}
+		}
 
-					if (primitive.indicesAccessor.has_value())
-					{
-						auto& indexAcc = gltf.accessors[*primitive.indicesAccessor];
-						input.indices.reserve(indexAcc.count);
-						fastgltf::iterateAccessor<uint32_t>(gltf, indexAcc, [&](uint32_t index)
-							{
-								input.indices.emplace_back(index);
-							});
-					}
+		/// @brief Hash of the gltf file and its external buffers (a .glb already contains its binary chunk)
+		[[nodiscard]] static auto hashSource(const fastgltf::Asset& gltf, const std::filesystem::path& path) -> uint64_t
+		{
+			Utils::File::MappedFile file{ path };
+			uint64_t hash = Utils::File::hash(file.bytes());
+			if (path.extension() == ".glb")
+				return hash;
 
-					auto meshInfo = Graphics::MeshPreprocessor::process(input);
-					m_meshCache[i].emplace_back(std::make_shared<Graphics::StaticMesh>(meshInfo));
-				}
+			for (const auto& buffer : gltf.buffers)
+			{
+				std::visit(fastgltf::visitor{
+					[&](const fastgltf::sources::Array& array) {
+						hash = Utils::File::hash(std::as_bytes(std::span{ array.bytes.data(), array.bytes.size() }), hash);
+					},
+					[&](const fastgltf::sources::ByteView& view) {
+						hash = Utils::File::hash(std::as_bytes(std::span{ view.bytes.data(), view.bytes.size() }), hash);
+					},
+					[](const auto&) {},
+					}, buffer.data);
+			}
+			return hash;
+		}
+
+		[[nodiscard]] static auto readPrimitive(const fastgltf::Asset& gltf, const fastgltf::Primitive& primitive) -> Graphics::MeshPreprocessor::Input
+		{
+			Graphics::MeshPreprocessor::Input input{};
+
+			bool hasPositions = copyAttribute(gltf, primitive, "POSITION", input.positions);
+			AGX_ASSERT_X(hasPositions, "GLTF primitive is missing POSITION attribute");
+
+			bool hasNormals = copyAttribute(gltf, primitive, "NORMAL", input.normals);
+			AGX_ASSERT_X(hasNormals, "GLTF primitive is missing NORMAL attribute");
+
+			copyAttribute(gltf, primitive, "TEXCOORD_0", input.uvs);
+			copyAttribute(gltf, primitive, "COLOR_0", input.colors);
+
+			if (primitive.indicesAccessor.has_value())
+			{
+				auto& indexAcc = gltf.accessors[*primitive.indicesAccessor];
+				input.indices.resize(indexAcc.count);
+				fastgltf::copyFromAccessor<uint32_t>(gltf, indexAcc, input.indices.data());
 			}
+
+			return input;
+		}
+
+		/// @brief Copies the whole accessor at once (converts the component type if needed)
+		template<typename T>
+		static auto copyAttribute(const fastgltf::Asset& gltf, const fastgltf::Primitive& primitive, std::string_view name, std::vector<T>& dst) -> bool
+		{
+			auto* it = primitive.findAttribute(name);
+			if (it == primitive.attributes.end())
+				return false;
+
+			auto& accessor = gltf.accessors[it->accessorIndex];
+			dst.resize(accessor.count);
+			fastgltf::copyFromAccessor<T>(gltf, accessor, dst.data());
+			return true;
 		}
 
 		void loadTextures(const fastgltf::Asset& gltf)
 		{
-			// Pre-scan materials to determine texture formats
-			m_textureFormats.resize(gltf.textures.size(), VK_FORMAT_R8G8B8A8_UNORM);
+			// Pre-scan materials to determine how textures are compressed (occlusion can share the metallic roughness texture)
+			m_textureKinds.resize(gltf.textures.size(), TextureCooker::Kind::Packed);
+			for (const auto& material : gltf.materials)
+			{
+				if (material.occlusionTexture.has_value())
+				{
+					m_textureKinds[material.occlusionTexture->textureIndex] = TextureCooker::Kind::Grayscale;
+				}
+			}
 			for (const auto& material : gltf.materials)
 			{
 				if (material.pbrData.baseColorTexture.has_value())
 				{
-					m_textureFormats[material.pbrData.baseColorTexture->textureIndex] = VK_FORMAT_R8G8B8A8_SRGB;
+					m_textureKinds[material.pbrData.baseColorTexture->textureIndex] = TextureCooker::Kind::Color;
 				}
 				if (material.pbrData.metallicRoughnessTexture.has_value())
 				{
-					m_textureFormats[material.pbrData.metallicRoughnessTexture->textureIndex] = VK_FORMAT_R8G8B8A8_UNORM;
+					m_textureKinds[material.pbrData.metallicRoughnessTexture->textureIndex] = TextureCooker::Kind::Packed;
 				}
 				if (material.normalTexture.has_value())
 				{
-					m_textureFormats[material.normalTexture->textureIndex] = VK_FORMAT_R8G8B8A8_UNORM;
-				}
-				if (material.occlusionTexture.has_value())
-				{
-					m_textureFormats[material.occlusionTexture->textureIndex] = VK_FORMAT_R8G8B8A8_UNORM;
+					m_textureKinds[material.normalTexture->textureIndex] = TextureCooker::Kind::Normal;
 				}
 				if (material.emissiveTexture.has_value())
 				{
-					m_textureFormats[material.emissiveTexture->textureIndex] = VK_FORMAT_R8G8B8A8_SRGB;
+					m_textureKinds[material.emissiveTexture->textureIndex] = TextureCooker::Kind::Color;
 				}
 			}
 
-			// Load textures
-			m_textureCache.reserve(gltf.textures.size());
+			// Decode on the job system, textures without image stay null (materials keep their default)
+			Graphics::TextureImporter importer;
+			std::vector<std::size_t> importIndices(gltf.textures.size(), NO_TEXTURE);
 			for (std::size_t i = 0; i < gltf.textures.size(); ++i)
 			{
 				const auto& texture = gltf.textures[i];
@@ -177,20 +244,30 @@ export namespace Aegis::Graphics
 					[](auto&) { AGX_UNREACHABLE("Unsupported image data source");  },
 					[&](const fastgltf::sources::URI& uri)
 					{
-						m_textureCache.emplace_back(Graphics::Texture::loadFromFile(
-							m_basePath / uri.uri.path(), m_textureFormats[i]));
+						importIndices[i] = importer.add(m_basePath / uri.uri.path(), m_textureKinds[i]);
 					},
 					[&](const fastgltf::sources::BufferView& view)
 					{
 						const auto& bufferView = gltf.bufferViews[view.bufferViewIndex];
 						const auto& buffer = gltf.buffers[bufferView.bufferIndex];
 						const auto& data = std::get<fastgltf::sources::Array>(buffer.data);
-						const auto* imagePtr = data.bytes.data() + bufferView.byteOffset;
-						m_textureCache.emplace_back(Graphics::Texture::loadFromMemory(
-							imagePtr, bufferView.byteLength, m_textureFormats[i]));
+						importIndices[i] = importer.add(std::span{ data.bytes.data() + bufferView.byteOffset, bufferView.byteLength },
+							m_textureKinds[i]);
 					},
 					}, image.data);
 			}
+
+			auto textures = importer.import([](const Graphics::TextureImporter::Progress& progress) {
+				if (progress.uploaded == progress.total || progress.uploaded % 32 == 0)
+					ALOG::info("Loading textures: {}/{}", progress.uploaded, progress.total);
+				});
+
+			m_textureCache.resize(gltf.textures.size());
+			for (std::size_t i = 0; i < gltf.textures.size(); ++i)
+			{
+				if (importIndices[i] != NO_TEXTURE)
+					m_textureCache[i] = std::move(textures[importIndices[i]]);
+			}
 		}
 
 		void loadMaterials(const fastgltf::Asset& gltf)
@@ -200,36 +277,36 @@ export namespace Aegis::Graphics
 			{
 				const auto& gltfMat = gltf.materials[i];
 
-				auto materialInstance = Graphics::MaterialInstance::create(m_pbrTemplate);
-				materialInstance->setParameter("albedo", glm::make_vec3(gltfMat.pbrData.baseColorFactor.data()));
-				materialInstance->setParameter("metallic", gltfMat.pbrData.metallicFactor);
-				materialInstance->setParameter("roughness", gltfMat.pbrData.roughnessFactor);
-				materialInstance->setParameter("emissive", glm::make_vec3(gltfMat.emissiveFactor.data()));
+				auto materialInstance = Graphics::MaterialInstance::create(gltfMat.doubleSided ? m_pbrDoubleSidedTemplate : m_pbrTemplate);
+				materialInstance->set<&Graphics::PBRMaterialParameters::albedo>(glm::make_vec3(gltfMat.pbrData.baseColorFactor.data()));
+				materialInstance->set<&Graphics::PBRMaterialParameters::metallic>(gltfMat.pbrData.metallicFactor);
+				materialInstance->set<&Graphics::PBRMaterialParameters::roughness>(gltfMat.pbrData.roughnessFactor);
+				materialInstance->set<&Graphics::PBRMaterialParameters::emissive>(glm::make_vec3(gltfMat.emissiveFactor.data()));
 
-				if (gltfMat.pbrData.baseColorTexture.has_value())
+				if (gltfMat.pbrData.baseColorTexture.has_value() && m_textureCache[gltfMat.pbrData.baseColorTexture->textureIndex])
 				{
 					auto texIdx = gltfMat.pbrData.baseColorTexture->textureIndex;
-					materialInstance->setParameter("albedoMap", m_textureCache[texIdx]);
+					materialInstance->set<&Graphics::PBRMaterialParameters::albedoMap>(m_textureCache[texIdx]);
 				}
-				if (gltfMat.pbrData.metallicRoughnessTexture.has_value())
+				if (gltfMat.pbrData.metallicRoughnessTexture.has_value() && m_textureCache[gltfMat.pbrData.metallicRoughnessTexture->textureIndex])
 				{
 					auto texIdx = gltfMat.pbrData.metallicRoughnessTexture->textureIndex;
-					materialInstance->setParameter("metalRoughnessMap", m_textureCache[texIdx]);
+					materialInstance->set<&Graphics::PBRMaterialParameters::metalRoughnessMap>(m_textureCache[texIdx]);
 				}
-				if (gltfMat.normalTexture.has_value())
+				if (gltfMat.normalTexture.has_value() && m_textureCache[gltfMat.normalTexture->textureIndex])
 				{
 					auto texIdx = gltfMat.normalTexture->textureIndex;
-					materialInstance->setParameter("normalMap", m_textureCache[texIdx]);
+					materialInstance->set<&Graphics::PBRMaterialParameters::normalMap>(m_textureCache[texIdx]);
 				}
-				if (gltfMat.occlusionTexture.has_value())
+				if (gltfMat.occlusionTexture.has_value() && m_textureCache[gltfMat.occlusionTexture->textureIndex])
 				{
 					auto texIdx = gltfMat.occlusionTexture->textureIndex;
-					materialInstance->setParameter("ambientOcclusionMap", m_textureCache[texIdx]);
+					materialInstance->set<&Graphics::PBRMaterialParameters::ambientOcclusionMap>(m_textureCache[texIdx]);
 				}
-				if (gltfMat.emissiveTexture.has_value())
+				if (gltfMat.emissiveTexture.has_value() && m_textureCache[gltfMat.emissiveTexture->textureIndex])
 				{
 					auto texIdx = gltfMat.emissiveTexture->textureIndex;
-					materialInstance->setParameter("emissiveMap", m_textureCache[texIdx]);
+					materialInstance->set<&Graphics::PBRMaterialParameters::emissiveMap>(m_textureCache[texIdx]);
 				}
 
 				m_materialCache.emplace_back(materialInstance);
@@ -309,9 +386,10 @@ export namespace Aegis::Graphics
 
 		Scene::Entity m_rootEntity;
 		std::shared_ptr<Graphics::MaterialTemplate> m_pbrTemplate;
+		std::shared_ptr<Graphics::MaterialTemplate> m_pbrDoubleSidedTemplate;
 		std::shared_ptr<Graphics::MaterialInstance> m_pbrDefaultMat;
 		std::filesystem::path m_basePath;
-		std::vector<VkFormat> m_textureFormats;
+		std::vector<TextureCooker::Kind> m_textureKinds;
 		std::vector<std::shared_ptr<Graphics::Texture>> m_textureCache;
 		std::vector<std::shared_ptr<Graphics::MaterialInstance>> m_materialCache;
 		std::vector<std::vector<std::shared_ptr<Graphics::StaticMesh>>> m_meshCache;
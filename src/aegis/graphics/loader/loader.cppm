@@ -10,6 +10,7 @@ import :OBJLoader;
 import :GLTFLoader;
 import :FastGLTFLoader;
 import Aegis.Scene.Registry;
+import Aegis.Graphics.UploadContext;
 
 export namespace Aegis::Graphics
 {
@@ -18,8 +19,11 @@ export namespace Aegis::Graphics
 	public:
 		Loader() = delete;
 
+		/// @brief Loads the file into the scene, all mesh and texture uploads of the file are submitted as one batch
 		static auto load(Scene::Registry& scene, const std::filesystem::path& path) -> Scene::Entity
 		{
+			UploadContext::Batch uploads;
+
 			if (path.extension() == ".gltf" || path.extension() == ".glb")
 			{
 				//GLTFLoader loader{ *this, path };
@@ -6,17 +6,21 @@ module;
 #include <tiny_obj_loader.h>
 
 #include <filesystem>
+#include <memory>
+#include <span>
 
 export module Aegis.Graphics.Loader:OBJLoader;
 
 import Aegis.Math;
 import Aegis.Graphics.MeshPreprocessor;
+import Aegis.Graphics.MeshCache;
 import Aegis.Graphics.Components;
 import Aegis.Scene.Registry;
 import Aegis.Core.AssetManager;
 import Aegis.Graphics.StaticMesh;
 import Aegis.Graphics.MaterialTemplate;
 import Aegis.Graphics.MaterialInstance;
+import Aegis.Utils.File;
 
 export namespace Aegis::Graphics
 {
@@ -25,6 +29,23 @@ export namespace Aegis::Graphics
 	public:
 		OBJLoader(Scene::Registry& scene, const std::filesystem::path& path)
 		{
+			m_rootEntity = scene.create(path.stem().string());
+			scene.add<Mesh>(m_rootEntity, loadMesh(path));
+			scene.add<Material>(m_rootEntity, Core::AssetManager::instance().get<Graphics::MaterialInstance>("default/PBR_instance"));
+		}
+
+		[[nodiscard]] auto rootEntity() const -> Scene::Entity { return m_rootEntity; }
+
+	private:
+		/// @brief Uploads the mesh from the mesh cache, the OBJ file is only parsed and preprocessed on a miss
+		static auto loadMesh(const std::filesystem::path& path) -> std::shared_ptr<Graphics::StaticMesh>
+		{
+			auto cachePath = MeshCache::cachePath(path);
+			auto sourceHash = Utils::File::hash(Utils::File::MappedFile{ path }.bytes());
+			auto optionsHash = MeshCache::optionsHash();
+			if (auto cache = MeshCache::open(cachePath, sourceHash, optionsHash); cache && cache->meshCount() == 1)
+				return std::make_shared<Graphics::StaticMesh>(cache->mesh(0));
+
 			tinyobj::attrib_t attrib;
 			std::vector<tinyobj::shape_t> shapes;
 			std::vector<tinyobj::material_t> materials;
@@ -85,16 +106,10 @@ export namespace Aegis::Graphics
 			}
 
 			auto info = Graphics::MeshPreprocessor::process(raw);
-			auto mesh = std::make_shared<Graphics::StaticMesh>(info);
-
-			m_rootEntity = scene.create(path.stem().string());
-			scene.add<Mesh>(m_rootEntity, mesh);
-			scene.add<Material>(m_rootEntity, Core::AssetManager::instance().get<Graphics::MaterialInstance>("default/PBR_instance"));
+			MeshCache::write(cachePath, sourceHash, optionsHash, std::span{ &info, 1 });
+			return std::make_shared<Graphics::StaticMesh>(info);
 		}
 
-		[[nodiscard]] auto rootEntity() const -> Scene::Entity { return m_rootEntity; }
-
-	private:
 		Scene::Entity m_rootEntity;
 	};
 }
\ No newline at end of file
@@ -2,24 +2,29 @@ module;
 
 #include "core/assert.h"
 
-#include <array>
+#include <cstring>
 #include <memory>
 #include <string>
-#include <unordered_map>
+#include <type_traits>
 #include <variant>
+#include <vector>
 
 export module Aegis.Graphics.MaterialInstance;
 
 import Aegis.Graphics.Descriptors;
+import Aegis.Graphics.MaterialLayout;
+import Aegis.Graphics.MaterialTable;
 import Aegis.Graphics.MaterialTemplate;
-import Aegis.Graphics.Bindless;
-import Aegis.Graphics.Buffer;
 import Aegis.Graphics.Texture;
-import Aegis.Graphics.Globals;
 import Aegis.Core.Asset;
 
 export namespace Aegis::Graphics
 {
+	/// @brief Parameter overrides of a material template
+	/// @note The parameters live in a record of the material table of the template (see MaterialTable), which is
+	///       written directly when a parameter is set. Shaders address the record with the material index.
+	///       Templates created from a parameter struct can be written with set<&Params::member>(), which skips the
+	///       name lookup and copies the value to its compile time offset.
 	class MaterialInstance : public Core::Asset
 	{
 	public:
@@ -29,17 +34,21 @@ export namespace Aegis::Graphics
 		}
 
 		MaterialInstance(std::shared_ptr<MaterialTemplate> materialTemplate) :
-			m_template(std::move(materialTemplate)),
-			m_uniformBuffer{ Buffer::uniformBuffer(m_template->parameterSize(), MAX_FRAMES_IN_FLIGHT) }
+			m_template(std::move(materialTemplate))
 		{
 			AGX_ASSERT_X(m_template, "Material template cannot be null");
 
-			m_dirtyFlags.fill(true);
+			auto& table = m_template->materialTable();
+			m_materialIndex = table.allocate(m_template->defaultRecord().data());
+			m_textures.resize(m_template->textureCount());
 		}
 
 		MaterialInstance(const MaterialInstance&) = delete;
 		MaterialInstance(MaterialInstance&&) = delete;
-		~MaterialInstance() = default;
+		~MaterialInstance()
+		{
+			m_template->materialTable().free(m_materialIndex);
+		}
 
 		auto operator=(const MaterialInstance&) -> MaterialInstance & = delete;
 		auto operator=(MaterialInstance&&) noexcept -> MaterialInstance & = delete;
@@ -53,56 +62,70 @@ export namespace Aegis::Graphics
 		[[nodiscard]] auto materialTemplate() const -> std::shared_ptr<MaterialTemplate> { return m_template; }
 		[[nodiscard]] auto queryParameter(const std::string& name) const -> MaterialParameter::Value
 		{
-			auto it = m_overrides.find(name);
-			if (it != m_overrides.end())
-				return it->second;
+			const auto& param = m_template->parameter(name);
+			return std::visit([&](auto&& defaultValue) -> MaterialParameter::Value {
+				using T = std::decay_t<decltype(defaultValue)>;
+				if constexpr (std::is_same_v<T, std::shared_ptr<Texture>>)
+				{
+					const auto& texture = m_textures[param.binding - 1];
+					return texture ? texture : defaultValue;
+				}
+				else
+				{
+					T value;
+					std::memcpy(&value, m_template->materialTable().record(m_materialIndex) + param.offset, sizeof(T));
+					return value;
+				}
+				}, param.defaultValue);
+		}
+
+		/// @brief Reads a parameter of a template created from the parameter struct
+		template<auto Member>
+			requires (!std::is_same_v<typename MaterialField<Member>::ValueType, std::shared_ptr<Texture>>)
+		[[nodiscard]] auto get() const -> typename MaterialField<Member>::ValueType
+		{
+			using Params = typename MaterialField<Member>::ParamsType;
+			AGX_ASSERT_X(m_template->hasLayout<Params>(), "Material template was not created from this parameter struct");
 
-			return m_template->queryDefaultParameter(name);
+			return MaterialLayout<Params>::template read<Member>(m_template->materialTable().record(m_materialIndex));
 		}
 
-		[[nodiscard]] auto buffer() const -> const Bindless::BindlessFrameBuffer& { return m_uniformBuffer; }
+		/// @brief Index of the parameter record in the material table of the template
+		[[nodiscard]] auto materialIndex() const -> uint32_t { return m_materialIndex; }
 
 		void setParameter(const std::string& name, const MaterialParameter::Value& value)
 		{
-			AGX_ASSERT_X(m_template->hasParameter(name), "Material parameter not found");
-			m_overrides[name] = value;
-			m_dirtyFlags.fill(true);
+			const auto& param = m_template->parameter(name);
+			AGX_ASSERT_X(param.defaultValue.index() == value.index(), "Material parameter type mismatch");
+
+			auto& table = m_template->materialTable();
+			MaterialTemplate::writeParameter(table.record(m_materialIndex), param, value);
+			table.markDirty(m_materialIndex);
+
+			// Keeps the texture alive, other values are read back from the record
+			if (const auto* texture = std::get_if<std::shared_ptr<Texture>>(&value))
+				m_textures[param.binding - 1] = *texture;
 		}
 
-		void updateParameters(int index)
+		/// @brief Writes a parameter of a template created from the parameter struct
+		template<auto Member>
+		void set(const typename MaterialField<Member>::ValueType& value)
 		{
-			if (!m_dirtyFlags[index])
-				return;
-
-			// Update uniform buffer
-			for (const auto& [name, info] : m_template->parameters())
-			{
-				const MaterialParameter::Value* valuePtr = &info.defaultValue;
-				auto it = m_overrides.find(name);
-				if (it != m_overrides.end())
-				{
-					valuePtr = &it->second;
-				}
+			using Params = typename MaterialField<Member>::ParamsType;
+			using Layout = MaterialLayout<Params>;
+			AGX_ASSERT_X(m_template->hasLayout<Params>(), "Material template was not created from this parameter struct");
 
-				if (auto texture = std::get_if<std::shared_ptr<Texture>>(valuePtr))
-				{
-					auto handle = (*texture)->sampledDescriptorHandle();
-					AGX_ASSERT_X(handle.isValid(), "Invalid texture descriptor handle in MaterialInstance!");
-					m_uniformBuffer.write(&handle, info.size, info.offset, index);
-				}
-				else
-				{
-					m_uniformBuffer.write(valuePtr, info.size, info.offset, index);
-				}
-			}
+			auto& table = m_template->materialTable();
+			Layout::template write<Member>(table.record(m_materialIndex), value);
+			table.markDirty(m_materialIndex);
 
-			m_dirtyFlags[index] = false;
+			if constexpr (std::is_same_v<typename MaterialField<Member>::ValueType, std::shared_ptr<Texture>>)
+				m_textures[Layout::ENTRIES[Layout::template INDEX<Member>].textureIndex] = value;
 		}
 
 	private:
 		std::shared_ptr<MaterialTemplate> m_template;
-		std::unordered_map<std::string, MaterialParameter::Value> m_overrides;
-		Bindless::BindlessFrameBuffer m_uniformBuffer;
-		std::array<bool, MAX_FRAMES_IN_FLIGHT> m_dirtyFlags;
+		std::vector<std::shared_ptr<Texture>> m_textures;
+		uint32_t m_materialIndex{ MaterialTable::INVALID_INDEX };
 	};
 }
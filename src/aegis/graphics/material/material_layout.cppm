@@ -0,0 +1,198 @@
+module;
+
+#include "core/assert.h"
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+export module Aegis.Graphics.MaterialLayout;
+
+import Aegis.Math;
+import Aegis.Graphics.Texture;
+import Aegis.Graphics.Bindless.DescriptorHandle;
+
+export namespace Aegis::Graphics
+{
+	template<typename T>
+	concept MaterialParameterType =
+		std::same_as<T, int32_t> ||
+		std::same_as<T, uint32_t> ||
+		std::same_as<T, float> ||
+		std::same_as<T, glm::vec2> ||
+		std::same_as<T, glm::vec3> ||
+		std::same_as<T, glm::vec4> ||
+		std::same_as<T, std::shared_ptr<Texture>>;
+
+	/// @brief Alignment and size of a material parameter in a std430 struct
+	template<MaterialParameterType T>
+	struct Std430
+	{
+		static constexpr std::size_t ALIGNMENT = std::same_as<T, glm::vec3> ? 16 : sizeof(T);
+		static constexpr std::size_t SIZE = sizeof(T);
+	};
+
+	/// @brief Textures are stored as their sampled bindless handle
+	template<>
+	struct Std430<std::shared_ptr<Texture>>
+	{
+		static constexpr std::size_t ALIGNMENT = sizeof(Bindless::DescriptorHandle);
+		static constexpr std::size_t SIZE = sizeof(Bindless::DescriptorHandle);
+	};
+
+	[[nodiscard]] constexpr auto alignTo(std::size_t size, std::size_t alignment) -> std::size_t
+	{
+		return (size + alignment - 1) & ~(alignment - 1);
+	}
+
+	/// @brief Declares a member of a parameter struct as material parameter (see MaterialLayout)
+	template<auto Member>
+	struct MaterialField;
+
+	template<typename Params, MaterialParameterType T, T Params::* Member>
+	struct MaterialField<Member>
+	{
+		using ParamsType = Params;
+		using ValueType = T;
+
+		std::string_view name;
+	};
+
+	/// @brief Struct with a static constexpr tuple 'fields' of MaterialField, in the order of the shader struct
+	template<typename Params>
+	concept MaterialParameters = std::default_initializable<Params> && requires { std::tuple_size<std::remove_cvref_t<decltype(Params::fields)>>::value; };
+
+	/// @brief std430 layout of a material parameter struct, computed at compile time
+	/// @note The C++ layout of the struct is irrelevant, only the order of the fields is used. MaterialTemplate::create
+	///       takes its parameter table from these entries (textureIndex counts the texture fields in order).
+	template<MaterialParameters Params>
+	class MaterialLayout
+	{
+		using Fields = std::remove_cvref_t<decltype(Params::fields)>;
+
+		template<std::size_t I>
+		using Field = std::tuple_element_t<I, Fields>;
+
+	public:
+		struct Entry
+		{
+			std::size_t offset;
+			std::size_t size;
+			std::size_t alignment;
+			uint32_t textureIndex;
+		};
+
+		static constexpr std::size_t FIELD_COUNT = std::tuple_size_v<Fields>;
+
+	private:
+		static consteval auto computeEntries() -> std::array<Entry, FIELD_COUNT>
+		{
+			std::array<Entry, FIELD_COUNT> entries{};
+			std::size_t size = 0;
+			uint32_t textureCount = 0;
+			[&]<std::size_t... I>(std::index_sequence<I...>) {
+				([&] {
+					using T = typename Field<I>::ValueType;
+					static_assert(std::same_as<typename Field<I>::ParamsType, Params>, "Material field belongs to a different struct");
+
+					auto& entry = entries[I];
+					entry.offset = alignTo(size, Std430<T>::ALIGNMENT);
+					entry.size = Std430<T>::SIZE;
+					entry.alignment = Std430<T>::ALIGNMENT;
+					entry.textureIndex = std::same_as<T, std::shared_ptr<Texture>> ? textureCount++ : 0;
+					size = entry.offset + entry.size;
+					}(), ...);
+				}(std::make_index_sequence<FIELD_COUNT>{});
+			return entries;
+		}
+
+		static consteval auto computeAlignment() -> std::size_t
+		{
+			std::size_t alignment = 4;
+			for (const auto& entry : ENTRIES)
+				alignment = std::max(alignment, entry.alignment);
+			return alignment;
+		}
+
+		template<auto Member>
+		static consteval auto computeIndex() -> std::size_t
+		{
+			std::size_t index = FIELD_COUNT;
+			[&]<std::size_t... I>(std::index_sequence<I...>) {
+				((std::same_as<Field<I>, MaterialField<Member>> && index == FIELD_COUNT ? void(index = I) : void()), ...);
+			}(std::make_index_sequence<FIELD_COUNT>{});
+			return index;
+		}
+
+	public:
+		static constexpr std::array<Entry, FIELD_COUNT> ENTRIES = computeEntries();
+		static constexpr std::size_t SIZE = FIELD_COUNT > 0 ? ENTRIES.back().offset + ENTRIES.back().size : 0;
+		static constexpr std::size_t ALIGNMENT = computeAlignment();
+
+		/// @brief Size of one material record including the std430 struct padding
+		static constexpr std::size_t RECORD_SIZE = alignTo(SIZE, ALIGNMENT);
+
+		template<auto Member>
+		static constexpr std::size_t INDEX = computeIndex<Member>();
+
+		template<auto Member>
+		static constexpr std::size_t OFFSET = ENTRIES[INDEX<Member>].offset;
+
+		/// @brief Unique per parameter struct, used to check that a template was created from this layout
+		[[nodiscard]] static auto id() -> const void* { return &s_id; }
+
+		/// @brief Calls func(name, value, entry) for every field of the struct in order
+		template<typename Func>
+		static void forEachField(const Params& values, Func&& func)
+		{
+			[&]<std::size_t... I>(std::index_sequence<I...>) {
+				(func(std::get<I>(Params::fields).name, values.*memberOf<I>(), ENTRIES[I]), ...);
+			}(std::make_index_sequence<FIELD_COUNT>{});
+		}
+
+		/// @brief Writes the std430 representation of a value to its offset in the record
+		template<auto Member>
+		static void write(std::byte* record, const typename MaterialField<Member>::ValueType& value)
+		{
+			static_assert(INDEX<Member> < FIELD_COUNT, "Member is not a field of the material parameters");
+			using T = typename MaterialField<Member>::ValueType;
+			if constexpr (std::same_as<T, std::shared_ptr<Texture>>)
+			{
+				AGX_ASSERT_X(value, "Material texture parameter cannot be null");
+				auto handle = value->sampledDescriptorHandle();
+				AGX_ASSERT_X(handle.isValid(), "Invalid texture descriptor handle in material parameter");
+				std::memcpy(record + OFFSET<Member>, &handle, sizeof(handle));
+			}
+			else
+			{
+				std::memcpy(record + OFFSET<Member>, &value, sizeof(T));
+			}
+		}
+
+		template<auto Member>
+			requires (!std::same_as<typename MaterialField<Member>::ValueType, std::shared_ptr<Texture>>)
+		[[nodiscard]] static auto read(const std::byte* record) -> typename MaterialField<Member>::ValueType
+		{
+			static_assert(INDEX<Member> < FIELD_COUNT, "Member is not a field of the material parameters");
+			typename MaterialField<Member>::ValueType value;
+			std::memcpy(&value, record + OFFSET<Member>, sizeof(value));
+			return value;
+		}
+
+	private:
+		template<std::size_t I>
+		static consteval auto memberOf()
+		{
+			return []<auto Member>(const MaterialField<Member>&) { return Member; }(std::get<I>(Params::fields));
+		}
+
+		inline static char s_id{};
+	};
+}
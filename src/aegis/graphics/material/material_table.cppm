@@ -0,0 +1,188 @@
+module;
+
+#include "core/assert.h"
+#include "graphics/vulkan/vulkan_include.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+export module Aegis.Graphics.MaterialTable;
+
+import Aegis.Graphics.Bindless;
+import Aegis.Graphics.Buffer;
+import Aegis.Graphics.Globals;
+import Aegis.Graphics.Vulkan.Tools;
+
+export namespace Aegis::Graphics
+{
+	/// @brief Parameters of all instances of one material template, stored as fixed stride records in a single device
+	///        local storage buffer and addressed by material index
+	/// @note Records are written to a CPU copy and only changed records are uploaded (once, not per frame in flight).
+	///       The device buffer is replaced when it grows, so the handle has to be queried every frame.
+	class MaterialTable
+	{
+	public:
+		static constexpr uint32_t INVALID_INDEX = std::numeric_limits<uint32_t>::max();
+		static constexpr uint32_t MIN_CAPACITY = 64;
+
+		MaterialTable() = default;
+		explicit MaterialTable(std::size_t stride) : m_stride{ std::max(stride, sizeof(uint32_t)) } {}
+
+		MaterialTable(const MaterialTable&) = delete;
+		MaterialTable(MaterialTable&&) = default;
+		~MaterialTable() = default;
+
+		auto operator=(const MaterialTable&) -> MaterialTable & = delete;
+		auto operator=(MaterialTable&&) -> MaterialTable & = default;
+
+		[[nodiscard]] auto stride() const -> std::size_t { return m_stride; }
+		[[nodiscard]] auto size() const -> uint32_t { return static_cast<uint32_t>(m_used.size()); }
+		[[nodiscard]] auto handle() const -> Bindless::DescriptorHandle { return m_buffer.handle(); }
+
+		/// @brief Reserves a record initialized with the given data (has to be 'stride' bytes)
+		auto allocate(const std::byte* initialData) -> uint32_t
+		{
+			uint32_t index;
+			if (!m_freeIndices.empty())
+			{
+				index = m_freeIndices.back();
+				m_freeIndices.pop_back();
+			}
+			else
+			{
+				index = static_cast<uint32_t>(m_used.size());
+				m_used.emplace_back(false);
+				m_dirty.emplace_back(false);
+				m_records.resize(m_records.size() + m_stride);
+			}
+
+			m_used[index] = true;
+			write(index, 0, initialData, m_stride);
+			return index;
+		}
+
+		void free(uint32_t index)
+		{
+			AGX_ASSERT_X(index < m_used.size() && m_used[index], "Material table: Record is not in use");
+			m_used[index] = false;
+			m_freeIndices.emplace_back(index);
+		}
+
+		void write(uint32_t index, std::size_t offset, const void* data, std::size_t size)
+		{
+			AGX_ASSERT_X(offset + size <= m_stride, "Material table: Write exceeds record size");
+			std::memcpy(record(index) + offset, data, size);
+			markDirty(index);
+		}
+
+		/// @brief CPU copy of the record, call markDirty() after writing to it
+		[[nodiscard]] auto record(uint32_t index) -> std::byte*
+		{
+			AGX_ASSERT_X(index < m_used.size() && m_used[index], "Material table: Record is not in use");
+			return m_records.data() + index * m_stride;
+		}
+
+		void markDirty(uint32_t index)
+		{
+			if (m_dirty[index])
+				return;
+
+			m_dirty[index] = true;
+			m_dirtyIndices.emplace_back(index);
+		}
+
+		/// @brief Copies all changed records to the device buffer (grows the buffer if needed)
+		/// @note Has to be recorded before any draw of this frame reads the table
+		void upload(VkCommandBuffer cmd, uint32_t frameIndex)
+		{
+			if (m_used.size() > m_capacity)
+				grow();
+
+			if (m_dirtyIndices.empty())
+				return;
+
+			// Neighbouring records are copied in one region
+			std::ranges::sort(m_dirtyIndices);
+			auto& staging = m_staging[frameIndex];
+			VkDeviceSize stagingSize = m_dirtyIndices.size() * m_stride;
+			if (staging.bufferSize() < stagingSize)
+				staging = Buffer{ Buffer::stagingBuffer(std::max(stagingSize, staging.bufferSize() * 2)) };
+
+			m_regions.clear();
+			auto* mapped = staging.data<std::byte>();
+			VkDeviceSize stagingOffset = 0;
+			for (uint32_t index : m_dirtyIndices)
+			{
+				m_dirty[index] = false;
+				std::memcpy(mapped + stagingOffset, m_records.data() + index * m_stride, m_stride);
+
+				VkDeviceSize dstOffset = index * m_stride;
+				if (!m_regions.empty() && m_regions.back().dstOffset + m_regions.back().size == dstOffset)
+				{
+					m_regions.back().size += m_stride;
+				}
+				else
+				{
+					m_regions.emplace_back(stagingOffset, dstOffset, m_stride);
+				}
+				stagingOffset += m_stride;
+			}
+			m_dirtyIndices.clear();
+			staging.flush(stagingOffset, 0);
+
+			// Previous frames might still read the table
+			VkBufferMemoryBarrier barrier{
+				.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+				.srcAccessMask = VK_ACCESS_SHADER_READ_BIT,
+				.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.buffer = m_buffer.buffer(),
+				.offset = 0,
+				.size = VK_WHOLE_SIZE,
+			};
+			Tools::vk::cmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+				{ barrier }, {});
+
+			vkCmdCopyBuffer(cmd, staging, m_buffer.buffer(), static_cast<uint32_t>(m_regions.size()), m_regions.data());
+
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			Tools::vk::cmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+				{ barrier }, {});
+		}
+
+	private:
+		/// @brief The new buffer starts empty, so every record in use is uploaded again
+		void grow()
+		{
+			m_capacity = std::max({ static_cast<uint32_t>(m_used.size()), m_capacity * 2, MIN_CAPACITY });
+			m_buffer = Bindless::BindlessBuffer{ Buffer::storageBuffer(m_capacity * m_stride) };
+
+			for (uint32_t index = 0; index < static_cast<uint32_t>(m_used.size()); index++)
+			{
+				if (!m_used[index] || m_dirty[index])
+					continue;
+
+				m_dirty[index] = true;
+				m_dirtyIndices.emplace_back(index);
+			}
+		}
+
+		std::size_t m_stride{ sizeof(uint32_t) };
+		std::vector<std::byte> m_records;
+		std::vector<bool> m_used;
+		std::vector<bool> m_dirty;
+		std::vector<uint32_t> m_freeIndices;
+		std::vector<uint32_t> m_dirtyIndices;
+		std::vector<VkBufferCopy> m_regions;
+
+		Bindless::BindlessBuffer m_buffer;
+		std::array<Buffer, MAX_FRAMES_IN_FLIGHT> m_staging;
+		uint32_t m_capacity{ 0 };
+	};
+}
@@ -5,18 +5,26 @@ module;
 
 #include <aegis-log/log.h>
 
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <variant>
+#include <vector>
 
 export module Aegis.Graphics.MaterialTemplate;
 
 import Aegis.Math;
 import Aegis.Graphics.Descriptors;
+import Aegis.Graphics.MaterialLayout;
+import Aegis.Graphics.MaterialTable;
 import Aegis.Graphics.Pipeline;
 import Aegis.Graphics.StaticMesh;
 import Aegis.Graphics.Texture;
+import Aegis.Graphics.VulkanContext;
 import Aegis.Graphics.Bindless.DescriptorHandle;
 import Aegis.Graphics.Bindless.BindlessDescriptorSet;
 import Aegis.Core.Asset;
@@ -54,55 +62,115 @@ export namespace Aegis::Graphics
 			: m_pipeline{ std::move(pipeline) }
 		{}
 
-		[[nodiscard]] static auto alignTo(std::size_t size, std::size_t alignment) -> std::size_t
+		/// @brief Creates a template with the fields of a parameter struct (see MaterialLayout)
+		/// @note The parameter table is taken from the compile time layout. Instances of the template can be written with
+		///       MaterialInstance::set<&Params::member>() which copies the value to an offset known at compile time.
+		///       Texture fields have no fallback, the defaults have to set all of them.
+		template<MaterialParameters Params>
+		[[nodiscard]] static auto create(Pipeline pipeline, const Params& defaults) -> std::shared_ptr<MaterialTemplate>
 		{
-			return (size + alignment - 1) & ~(alignment - 1);
+			using Layout = MaterialLayout<Params>;
+
+			auto materialTemplate = std::make_shared<MaterialTemplate>(std::move(pipeline));
+			materialTemplate->m_parameterSize = Layout::SIZE;
+			materialTemplate->m_maxAlignment = Layout::ALIGNMENT;
+			materialTemplate->m_defaultRecord.resize(Layout::SIZE);
+			Layout::forEachField(defaults, [&](std::string_view name, const auto& value, const auto& entry) {
+				MaterialParameter param{
+					.offset = entry.offset,
+					.size = entry.size,
+					.defaultValue = value,
+				};
+
+				if constexpr (std::is_same_v<std::decay_t<decltype(value)>, std::shared_ptr<Texture>>)
+				{
+					AGX_ASSERT_X(value, "Material template default texture cannot be null");
+					param.binding = entry.textureIndex + 1;
+					materialTemplate->m_textureCount++;
+				}
+
+				writeParameter(materialTemplate->m_defaultRecord.data(), param, param.defaultValue);
+				materialTemplate->m_parameters.emplace(std::string{ name }, std::move(param));
+				});
+
+			materialTemplate->m_layoutId = Layout::id();
+			return materialTemplate;
 		}
 
 		[[nodiscard]] static auto std430Alignment(const MaterialParameter::Value& val) -> std::size_t
 		{
-			return std::visit([&](auto&& arg) -> std::size_t {
-				using T = std::decay_t<decltype(arg)>;
-				if constexpr (std::is_same_v<T, int32_t>)        return 4;
-				else if constexpr (std::is_same_v<T, uint32_t>)  return 4;
-				else if constexpr (std::is_same_v<T, float>)     return 4;
-				else if constexpr (std::is_same_v<T, glm::vec2>) return 8;
-				else if constexpr (std::is_same_v<T, glm::vec3>) return 16;
-				else if constexpr (std::is_same_v<T, glm::vec4>) return 16;
-				else if constexpr (std::is_same_v<T, std::shared_ptr<Texture>>) return sizeof(Bindless::DescriptorHandle);
-				else
-				{
-					AGX_ASSERT_X(false, "Unknown material parameter type");
-					return 16;
-				}
+			return std::visit([](auto&& arg) -> std::size_t {
+				return Std430<std::decay_t<decltype(arg)>>::ALIGNMENT;
 				}, val);
 		}
 
 		[[nodiscard]] static auto std430Size(const MaterialParameter::Value& val) -> std::size_t
 		{
-			return std::visit([&](auto&& arg) -> std::size_t {
+			return std::visit([](auto&& arg) -> std::size_t {
+				return Std430<std::decay_t<decltype(arg)>>::SIZE;
+				}, val);
+		}
+
+		/// @brief Writes the std430 representation of the value (textures are stored as their bindless handle)
+		static void writeParameter(std::byte* record, const MaterialParameter& param, const MaterialParameter::Value& value)
+		{
+			std::visit([&](auto&& arg) {
 				using T = std::decay_t<decltype(arg)>;
-				if constexpr (std::is_same_v<T, int32_t>)        return 4;
-				else if constexpr (std::is_same_v<T, uint32_t>)  return 4;
-				else if constexpr (std::is_same_v<T, float>)     return 4;
-				else if constexpr (std::is_same_v<T, glm::vec2>) return 8;
-				else if constexpr (std::is_same_v<T, glm::vec3>) return 12;
-				else if constexpr (std::is_same_v<T, glm::vec4>) return 16;
-				else if constexpr (std::is_same_v<T, std::shared_ptr<Texture>>) return sizeof(Bindless::DescriptorHandle);
+				if constexpr (std::is_same_v<T, std::shared_ptr<Texture>>)
+				{
+					AGX_ASSERT_X(arg, "Material texture parameter cannot be null");
+					auto handle = arg->sampledDescriptorHandle();
+					AGX_ASSERT_X(handle.isValid(), "Invalid texture descriptor handle in material parameter");
+					std::memcpy(record + param.offset, &handle, param.size);
+				}
 				else
 				{
-					AGX_ASSERT_X(false, "Unknown material parameter type");
-					return 16;
+					std::memcpy(record + param.offset, &arg, param.size);
 				}
-				}, val);
+				}, value);
 		}
 
 		[[nodiscard]] auto pipeline() const -> const Pipeline& { return m_pipeline; }
 		[[nodiscard]] auto parameterSize() const -> std::size_t { return m_parameterSize; }
+
+		/// @brief Size of one material record including the std430 struct padding
+		[[nodiscard]] auto recordSize() const -> std::size_t { return alignTo(m_parameterSize, m_maxAlignment); }
+
+		/// @brief Record holding the default value of every parameter (used to initialize new instances)
+		[[nodiscard]] auto defaultRecord() const -> const std::vector<std::byte>& { return m_defaultRecord; }
+
+		/// @brief Parameters of all instances of this template (created with the first instance)
+		[[nodiscard]] auto materialTable() -> MaterialTable&
+		{
+			if (!m_materialTable)
+			{
+				m_materialTable = std::make_unique<MaterialTable>(recordSize());
+				m_defaultRecord.resize(m_materialTable->stride());
+			}
+			return *m_materialTable;
+		}
+
+		[[nodiscard]] auto parameter(const std::string& name) const -> const MaterialParameter&
+		{
+			auto it = m_parameters.find(name);
+			AGX_ASSERT_X(it != m_parameters.end(), "Material parameter not found");
+			return it->second;
+		}
+
 		[[nodiscard]] auto parameters() const -> const std::unordered_map<std::string, MaterialParameter>& { return m_parameters; }
+		[[nodiscard]] auto textureCount() const -> uint32_t { return m_textureCount; }
 		[[nodiscard]] auto drawBatch() const -> uint32_t { return m_drawBatchId; }
 		[[nodiscard]] auto type() const -> MaterialType { return m_materialType; }
 
+		/// @brief Double sided templates skip the back face culling of the GPU driven path (the pipeline has to be
+		///        created without back face culling as well)
+		[[nodiscard]] auto isDoubleSided() const -> bool { return m_doubleSided; }
+		void setDoubleSided(bool doubleSided) { m_doubleSided = doubleSided; }
+
+		/// @brief Whether the template was created from the parameter struct
+		template<MaterialParameters Params>
+		[[nodiscard]] auto hasLayout() const -> bool { return m_layoutId == MaterialLayout<Params>::id(); }
+
 		[[nodiscard]] auto hasParameter(const std::string& name) const -> bool
 		{
 			return m_parameters.contains(name);
@@ -121,6 +189,7 @@ export namespace Aegis::Graphics
 		void addParameter(const std::string& name, const MaterialParameter::Value& defaultValue)
 		{
 			AGX_ASSERT_X(!m_parameters.contains(name), "Material parameter already exists");
+			AGX_ASSERT_X(!m_materialTable, "Cannot add material parameters after instances have been created");
 
 			MaterialParameter param{
 				.offset = alignTo(m_parameterSize, std430Alignment(defaultValue)),
@@ -132,11 +201,12 @@ export namespace Aegis::Graphics
 			{
 				m_textureCount++;
 				param.binding = m_textureCount;
-
-
 			}
 
 			m_parameterSize = param.offset + param.size;
+			m_maxAlignment = std::max(m_maxAlignment, std430Alignment(defaultValue));
+			m_defaultRecord.resize(m_parameterSize);
+			writeParameter(m_defaultRecord.data(), param, defaultValue);
 			m_parameters.emplace(name, std::move(param));
 		}
 
@@ -175,6 +245,24 @@ export namespace Aegis::Graphics
 			vkCmdDrawMeshTasksEXT(cmd, instanceCount, 1, 1);
 		}
 
+		/// @brief Draws drawCount consecutive indexed indirect commands starting at offset in buffer
+		/// @note The commands have to contain the firstIndex and vertexOffset of their mesh in the GeometryArena, whose
+		///       buffers have to be bound already. Falls back to one draw per command without multiDrawIndirect.
+		void drawIndirect(VkCommandBuffer cmd, VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount)
+		{
+			AGX_ASSERT_X(!m_pipeline.hasFlag(Pipeline::Flags::MeshShader), "Indexed indirect draw is not supported for mesh shader pipelines");
+			constexpr VkDeviceSize STRIDE = sizeof(VkDrawIndexedIndirectCommand);
+			const auto& device = VulkanContext::device();
+			uint32_t maxDrawCount = device.features().core.features.multiDrawIndirect
+				? device.properties().limits.maxDrawIndirectCount
+				: 1;
+			for (uint32_t first = 0; first < drawCount; first += maxDrawCount)
+			{
+				uint32_t count = std::min(drawCount - first, maxDrawCount);
+				vkCmdDrawIndexedIndirect(cmd, buffer, offset + first * STRIDE, count, static_cast<uint32_t>(STRIDE));
+			}
+		}
+
 		void printInfo() const
 		{
 			ALOG::info("Material Template Info:");
@@ -194,8 +282,13 @@ export namespace Aegis::Graphics
 
 		std::unordered_map<std::string, MaterialParameter> m_parameters;
 		std::size_t m_parameterSize{ 0 };
+		std::size_t m_maxAlignment{ 4 };
+		std::vector<std::byte> m_defaultRecord;
+		std::unique_ptr<MaterialTable> m_materialTable;
+		const void* m_layoutId{ nullptr };
 		uint32_t m_textureCount{ 0 };
 		uint32_t m_drawBatchId{ 0 };
 		MaterialType m_materialType{ MaterialType::Opaque };
+		bool m_doubleSided{ false };
 	};
 }
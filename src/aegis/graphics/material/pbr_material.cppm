@@ -0,0 +1,49 @@
+module;
+
+#include <memory>
+#include <tuple>
+
+export module Aegis.Graphics.PBRMaterial;
+
+import Aegis.Math;
+import Aegis.Graphics.MaterialLayout;
+import Aegis.Graphics.Texture;
+
+export namespace Aegis::Graphics
+{
+	/// @brief Parameters of the default PBR material template (mirrors 'Material' in the geometry shaders)
+	/// @note Texture maps are null by default, the template defaults have to provide all of them
+	struct PBRMaterialParameters
+	{
+		glm::vec3 albedo{ 1.0f };
+		glm::vec3 emissive{ 0.0f };
+		float metallic{ 0.0f };
+		float roughness{ 1.0f };
+		float ambientOcclusion{ 1.0f };
+		std::shared_ptr<Texture> albedoMap;
+		std::shared_ptr<Texture> normalMap;
+		std::shared_ptr<Texture> metalRoughnessMap;
+		std::shared_ptr<Texture> ambientOcclusionMap;
+		std::shared_ptr<Texture> emissiveMap;
+
+		static constexpr auto fields = std::tuple{
+			MaterialField<&PBRMaterialParameters::albedo>{ "albedo" },
+			MaterialField<&PBRMaterialParameters::emissive>{ "emissive" },
+			MaterialField<&PBRMaterialParameters::metallic>{ "metallic" },
+			MaterialField<&PBRMaterialParameters::roughness>{ "roughness" },
+			MaterialField<&PBRMaterialParameters::ambientOcclusion>{ "ambientOcclusion" },
+			MaterialField<&PBRMaterialParameters::albedoMap>{ "albedoMap" },
+			MaterialField<&PBRMaterialParameters::normalMap>{ "normalMap" },
+			MaterialField<&PBRMaterialParameters::metalRoughnessMap>{ "metalRoughnessMap" },
+			MaterialField<&PBRMaterialParameters::ambientOcclusionMap>{ "ambientOcclusionMap" },
+			MaterialField<&PBRMaterialParameters::emissiveMap>{ "emissiveMap" },
+		};
+	};
+
+	using PBRMaterialLayout = MaterialLayout<PBRMaterialParameters>;
+
+	static_assert(PBRMaterialLayout::OFFSET<&PBRMaterialParameters::emissive> == 16);
+	static_assert(PBRMaterialLayout::OFFSET<&PBRMaterialParameters::metallic> == 28);
+	static_assert(PBRMaterialLayout::OFFSET<&PBRMaterialParameters::albedoMap> == 40);
+	static_assert(PBRMaterialLayout::RECORD_SIZE == 64);
+}
@@ -0,0 +1,178 @@
+module;
+
+#include "core/assert.h"
+#include "graphics/vulkan/vulkan_include.h"
+
+#include <aegis-log/log.h>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb/stb_image_write.h>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <vector>
+
+export module Aegis.Graphics.OffscreenTarget;
+
+import Aegis.Graphics.Buffer;
+import Aegis.Graphics.Globals;
+
+export namespace Aegis::Graphics
+{
+	/// @brief Fixed resolution render target of the headless renderer, takes the place of the swap chain
+	/// @note Readback copies the final image into a host visible buffer per frame in flight. The copy of a frame is
+	///       collected once its fence was waited for (MAX_FRAMES_IN_FLIGHT frames later), so reading back never stalls
+	///       the GPU. Call flush() after waiting for the device to collect the remaining frames.
+	class OffscreenTarget
+	{
+	public:
+		static constexpr VkFormat FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+		static constexpr uint32_t BYTES_PER_PIXEL = 4;
+
+		struct Readback
+		{
+			uint64_t frame{ 0 };
+			uint32_t width{ 0 };
+			uint32_t height{ 0 };
+			std::vector<std::byte> pixels; ///< Tightly packed RGBA8 rows, top to bottom
+		};
+
+		using ReadbackCallback = std::function<void(Readback&&)>;
+
+		explicit OffscreenTarget(VkExtent2D extent) :
+			m_extent{ extent }
+		{
+			AGX_ASSERT_X(extent.width > 0 && extent.height > 0, "Offscreen target extent must not be zero");
+		}
+
+		OffscreenTarget(const OffscreenTarget&) = delete;
+		OffscreenTarget(OffscreenTarget&&) = delete;
+		~OffscreenTarget() = default;
+
+		auto operator=(const OffscreenTarget&) -> OffscreenTarget & = delete;
+		auto operator=(OffscreenTarget&&) -> OffscreenTarget & = delete;
+
+		[[nodiscard]] auto extent() const -> VkExtent2D { return m_extent; }
+		[[nodiscard]] auto width() const -> uint32_t { return m_extent.width; }
+		[[nodiscard]] auto height() const -> uint32_t { return m_extent.height; }
+		[[nodiscard]] auto aspectRatio() const -> float { return static_cast<float>(m_extent.width) / static_cast<float>(m_extent.height); }
+		[[nodiscard]] auto imageSize() const -> VkDeviceSize { return VkDeviceSize{ m_extent.width } * m_extent.height * BYTES_PER_PIXEL; }
+		[[nodiscard]] auto isReadbackEnabled() const -> bool { return static_cast<bool>(m_callback); }
+
+		/// @brief Copies every following frame back to the host and passes it to the callback (on the render thread)
+		void enableReadback(ReadbackCallback callback)
+		{
+			AGX_ASSERT_X(callback, "Readback callback must not be empty");
+			m_callback = std::move(callback);
+			for (auto& slot : m_slots)
+			{
+				if (!slot.buffer.buffer())
+					slot.buffer = Buffer{ Buffer::readbackBuffer(imageSize()) };
+			}
+		}
+
+		/// @brief Records the copy of the image (in TRANSFER_SRC_OPTIMAL layout) into the readback buffer of the frame
+		void recordReadback(VkCommandBuffer cmd, VkImage image, uint32_t frameIndex)
+		{
+			AGX_ASSERT_X(isReadbackEnabled(), "Readback is not enabled");
+			auto& slot = m_slots[frameIndex];
+			AGX_ASSERT_X(!slot.pendingFrame, "Readback of the previous frame in this slot was not collected");
+
+			VkBufferImageCopy region{
+				.bufferOffset = 0,
+				.bufferRowLength = 0,
+				.bufferImageHeight = 0,
+				.imageSubresource = {
+					.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+					.mipLevel = 0,
+					.baseArrayLayer = 0,
+					.layerCount = 1,
+				},
+				.imageOffset = { 0, 0, 0 },
+				.imageExtent = { m_extent.width, m_extent.height, 1 },
+			};
+			vkCmdCopyImageToBuffer(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer, 1, &region);
+
+			VkBufferMemoryBarrier barrier{
+				.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+				.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+				.dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.buffer = slot.buffer,
+				.offset = 0,
+				.size = VK_WHOLE_SIZE,
+			};
+			vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+				0, nullptr, 1, &barrier, 0, nullptr);
+
+			slot.pendingFrame = m_nextFrame++;
+		}
+
+		/// @brief Hands the readback of the frame slot to the callback
+		/// @note The fence of the frame slot has to be signaled
+		void collect(uint32_t frameIndex)
+		{
+			auto& slot = m_slots[frameIndex];
+			if (!slot.pendingFrame)
+				return;
+
+			Readback readback{
+				.frame = *slot.pendingFrame,
+				.width = m_extent.width,
+				.height = m_extent.height,
+				.pixels = std::vector<std::byte>(imageSize()),
+			};
+			slot.buffer.read(readback.pixels.data(), readback.pixels.size());
+			slot.pendingFrame.reset();
+			m_callback(std::move(readback));
+		}
+
+		/// @brief Collects all pending readbacks in frame order
+		/// @note The device has to be idle
+		void flush()
+		{
+			std::array<uint32_t, MAX_FRAMES_IN_FLIGHT> order;
+			for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+				order[i] = i;
+
+			std::ranges::sort(order, {}, [this](uint32_t i) { return m_slots[i].pendingFrame.value_or(0); });
+			for (uint32_t i : order)
+				collect(i);
+		}
+
+		/// @brief Writes the readback as an 8 bit RGBA PNG, missing directories are created
+		static auto writePNG(const std::filesystem::path& path, const Readback& readback) -> bool
+		{
+			std::error_code ec;
+			if (path.has_parent_path())
+				std::filesystem::create_directories(path.parent_path(), ec);
+
+			int stride = static_cast<int>(readback.width * BYTES_PER_PIXEL);
+			if (!stbi_write_png(path.string().c_str(), static_cast<int>(readback.width), static_cast<int>(readback.height),
+				BYTES_PER_PIXEL, readback.pixels.data(), stride))
+			{
+				ALOG::warn("Failed to write frame capture '{}'", path.string());
+				return false;
+			}
+			return true;
+		}
+
+	private:
+		struct Slot
+		{
+			Buffer buffer;
+			std::optional<uint64_t> pendingFrame;
+		};
+
+		VkExtent2D m_extent;
+		ReadbackCallback m_callback;
+		std::array<Slot, MAX_FRAMES_IN_FLIGHT> m_slots;
+		uint64_t m_nextFrame{ 0 };
+	};
+}
@@ -0,0 +1,157 @@
+module;
+
+#include "core/assert.h"
+
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <map>
+
+export module Aegis.Graphics.OffsetAllocator;
+
+export namespace Aegis::Graphics
+{
+	/// @brief Hands out ranges of a linear address space (e.g. elements of a buffer)
+	/// @note Best fit allocation, free ranges are merged with their neighbours on release. The allocator only does the
+	///       bookkeeping, moving the data of live ranges (compaction) is up to the owner of the address space.
+	class OffsetAllocator
+	{
+	public:
+		static constexpr uint32_t INVALID_OFFSET = std::numeric_limits<uint32_t>::max();
+
+		struct Allocation
+		{
+			uint32_t offset{ INVALID_OFFSET };
+			uint32_t size{ 0 };
+
+			[[nodiscard]] auto isValid() const -> bool { return offset != INVALID_OFFSET; }
+		};
+
+		OffsetAllocator() = default;
+		explicit OffsetAllocator(uint32_t capacity)
+		{
+			grow(capacity);
+		}
+
+		[[nodiscard]] auto capacity() const -> uint32_t { return m_capacity; }
+		[[nodiscard]] auto usedSize() const -> uint32_t { return m_usedSize; }
+		[[nodiscard]] auto freeSize() const -> uint32_t { return m_capacity - m_usedSize; }
+		[[nodiscard]] auto freeRangeCount() const -> uint32_t { return static_cast<uint32_t>(m_freeByOffset.size()); }
+
+		[[nodiscard]] auto largestFreeRange() const -> uint32_t
+		{
+			return m_freeBySize.empty() ? 0 : std::prev(m_freeBySize.end())->first;
+		}
+
+		/// @brief Ratio of free space that is not part of the largest free range
+		[[nodiscard]] auto fragmentation() const -> float
+		{
+			uint32_t free = freeSize();
+			return free > 0 ? 1.0f - static_cast<float>(largestFreeRange()) / static_cast<float>(free) : 0.0f;
+		}
+
+		/// @brief Returns an invalid allocation if no free range is large enough
+		auto allocate(uint32_t size) -> Allocation
+		{
+			AGX_ASSERT_X(size > 0, "Cannot allocate an empty range");
+
+			auto it = m_freeBySize.lower_bound(size);
+			if (it == m_freeBySize.end())
+				return Allocation{};
+
+			auto [rangeSize, offset] = *it;
+			m_freeBySize.erase(it);
+			m_freeByOffset.erase(offset);
+
+			if (rangeSize > size)
+				insertFreeRange(offset + size, rangeSize - size);
+
+			m_usedSize += size;
+			return Allocation{ offset, size };
+		}
+
+		void free(const Allocation& allocation)
+		{
+			AGX_ASSERT_X(allocation.isValid() && allocation.offset + allocation.size <= m_capacity, "Cannot free invalid range");
+
+			uint32_t offset = allocation.offset;
+			uint32_t size = allocation.size;
+
+			// Merge with the following range
+			auto next = m_freeByOffset.lower_bound(offset);
+			AGX_ASSERT_X(next == m_freeByOffset.end() || next->first >= offset + size, "Range is already free");
+			if (next != m_freeByOffset.end() && next->first == offset + size)
+			{
+				size += next->second;
+				eraseFreeRange(next);
+			}
+
+			// Merge with the preceding range
+			auto prev = m_freeByOffset.lower_bound(offset);
+			if (prev != m_freeByOffset.begin())
+			{
+				prev = std::prev(prev);
+				AGX_ASSERT_X(prev->first + prev->second <= offset, "Range is already free");
+				if (prev->first + prev->second == offset)
+				{
+					offset = prev->first;
+					size += prev->second;
+					eraseFreeRange(prev);
+				}
+			}
+
+			insertFreeRange(offset, size);
+			m_usedSize -= allocation.size;
+		}
+
+		/// @brief Appends free space at the end of the address space
+		void grow(uint32_t capacity)
+		{
+			AGX_ASSERT_X(capacity >= m_capacity, "Offset allocator cannot shrink");
+			if (capacity == m_capacity)
+				return;
+
+			uint32_t oldCapacity = m_capacity;
+			m_capacity = capacity;
+			m_usedSize += capacity - oldCapacity;
+			free(Allocation{ oldCapacity, capacity - oldCapacity });
+		}
+
+		/// @brief Marks everything as used up to 'usedSize' and the rest as one free range (after compacting the data)
+		void reset(uint32_t usedSize)
+		{
+			AGX_ASSERT_X(usedSize <= m_capacity, "Used size exceeds the capacity");
+			m_freeByOffset.clear();
+			m_freeBySize.clear();
+			m_usedSize = usedSize;
+			if (usedSize < m_capacity)
+				insertFreeRange(usedSize, m_capacity - usedSize);
+		}
+
+	private:
+		void insertFreeRange(uint32_t offset, uint32_t size)
+		{
+			m_freeByOffset.emplace(offset, size);
+			m_freeBySize.emplace(size, offset);
+		}
+
+		void eraseFreeRange(std::map<uint32_t, uint32_t>::iterator it)
+		{
+			auto [first, last] = m_freeBySize.equal_range(it->second);
+			for (auto sizeIt = first; sizeIt != last; ++sizeIt)
+			{
+				if (sizeIt->second == it->first)
+				{
+					m_freeBySize.erase(sizeIt);
+					break;
+				}
+			}
+			m_freeByOffset.erase(it);
+		}
+
+		std::map<uint32_t, uint32_t> m_freeByOffset;		// offset -> size
+		std::multimap<uint32_t, uint32_t> m_freeBySize;		// size -> offset
+		uint32_t m_capacity{ 0 };
+		uint32_t m_usedSize{ 0 };
+	};
+}
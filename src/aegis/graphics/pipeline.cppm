@@ -4,13 +4,22 @@ module;
 #include "graphics/vulkan/vulkan_include.h"
 
 #include <vector>
+#include <cstddef>
+#include <cstring>
 #include <filesystem>
+#include <memory>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <utility>
 
 export module Aegis.Graphics.Pipeline;
 
+import Aegis.Core.JobSystem;
 import Aegis.Graphics.VulkanContext;
 import Aegis.Graphics.Vulkan.Tools;
 import Aegis.Graphics.Vertex;
+import Aegis.Utils.File;
 
 export namespace Aegis::Graphics
 {
@@ -23,6 +32,121 @@ export namespace Aegis::Graphics
 			MeshShader = 1 << 0,
 		};
 
+		/// @brief Pipeline compiled on the job system (see buildAsync), accessing it waits for the compilation
+		/// @note The waiting thread executes other jobs in the meantime, destroying a pending future waits as well
+		class Future
+		{
+		public:
+			Future() = default;
+			Future(const Future&) = delete;
+			Future(Future&&) noexcept = default;
+			~Future()
+			{
+				wait();
+			}
+
+			auto operator=(const Future&) -> Future & = delete;
+			auto operator=(Future&& other) noexcept -> Future&
+			{
+				if (this != &other)
+				{
+					wait();
+					m_pipeline = std::move(other.m_pipeline);
+					m_counter = std::move(other.m_counter);
+				}
+				return *this;
+			}
+
+			/// @brief Compiles the pipeline returned by func on a worker thread
+			template<typename Func>
+			[[nodiscard]] static auto launch(Func&& func) -> Future
+			{
+				Future future;
+				future.m_pipeline = std::make_unique<Pipeline>();
+				future.m_counter = std::make_unique<Core::JobCounter>();
+				Core::JobSystem::instance().submit([pipeline = future.m_pipeline.get(), func = std::forward<Func>(func)]() mutable {
+					*pipeline = func();
+					}, future.m_counter.get());
+				return future;
+			}
+
+			[[nodiscard]] auto isValid() const -> bool { return m_pipeline != nullptr; }
+			[[nodiscard]] auto isReady() const -> bool { return !m_counter || m_counter->isDone(); }
+
+			void wait() const
+			{
+				if (m_counter && !m_counter->isDone())
+				{
+					Core::JobSystem::instance().wait(*m_counter);
+				}
+			}
+
+			[[nodiscard]] auto get() -> Pipeline&
+			{
+				AGX_ASSERT_X(m_pipeline, "Pipeline future is empty");
+				wait();
+				return *m_pipeline;
+			}
+
+			auto operator->() -> Pipeline* { return &get(); }
+
+		private:
+			std::unique_ptr<Pipeline> m_pipeline;
+			std::unique_ptr<Core::JobCounter> m_counter;
+		};
+
+		/// @brief Specialization constant values, applied to every shader stage of a pipeline
+		/// @note Constants are declared in Slang with [vk::constant_id(id)], the driver folds them like literals so
+		///       branches on them are removed from the compiled pipeline. Bools are stored as VkBool32.
+		class Specialization
+		{
+		public:
+			template<typename T>
+				requires std::is_arithmetic_v<T> || std::is_enum_v<T>
+			auto set(uint32_t id, T value) -> Specialization&
+			{
+				if constexpr (std::is_same_v<T, bool>)
+				{
+					return set(id, static_cast<VkBool32>(value));
+				}
+				else
+				{
+					static_assert(sizeof(T) == 4, "Specialization constants have to be 32 bit");
+					m_entries.emplace_back(VkSpecializationMapEntry{
+						.constantID = id,
+						.offset = static_cast<uint32_t>(m_data.size()),
+						.size = sizeof(T),
+						});
+					m_data.resize(m_data.size() + sizeof(T));
+					std::memcpy(m_data.data() + m_entries.back().offset, &value, sizeof(T));
+					return *this;
+				}
+			}
+
+			[[nodiscard]] auto empty() const -> bool { return m_entries.empty(); }
+
+			/// @brief Points into the specialization, it has to outlive the returned info
+			[[nodiscard]] auto info() const -> VkSpecializationInfo
+			{
+				return VkSpecializationInfo{
+					.mapEntryCount = static_cast<uint32_t>(m_entries.size()),
+					.pMapEntries = m_entries.data(),
+					.dataSize = m_data.size(),
+					.pData = m_data.data(),
+				};
+			}
+
+			[[nodiscard]] auto hash(uint64_t seed) const -> uint64_t
+			{
+				seed = Utils::File::hash(std::as_bytes(std::span{ m_entries }), seed);
+				return Utils::File::hash(m_data, seed);
+			}
+
+		private:
+			std::vector<VkSpecializationMapEntry> m_entries;
+			std::vector<std::byte> m_data;
+		};
+
 		struct LayoutConfig
 		{
 			std::vector<VkDescriptorSetLayout> descriptorSetLayouts;
@@ -33,7 +157,9 @@ export namespace Aegis::Graphics
 		{
 			GraphicsConfig() = default;
 			GraphicsConfig(const GraphicsConfig&) = delete;
+			GraphicsConfig(GraphicsConfig&&) = default;
 			GraphicsConfig& operator=(const GraphicsConfig&) = delete;
+			GraphicsConfig& operator=(GraphicsConfig&&) = default;
 
 			std::vector<VkVertexInputBindingDescription> bindingDescriptions{};
 			std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
@@ -61,13 +187,10 @@ export namespace Aegis::Graphics
 				Pipeline::defaultGraphicsPipelineConfig(m_graphicsConfig);
 			}
 
-			~GraphicsBuilder()
-			{
-				for (const auto& module : m_shaderModules)
-				{
-					vkDestroyShaderModule(VulkanContext::device(), module, nullptr);
-				}
-			}
+			// Pointers in the config point into its vectors, moving keeps them valid
+			GraphicsBuilder(const GraphicsBuilder&) = delete;
+			GraphicsBuilder(GraphicsBuilder&&) noexcept = default;
+			~GraphicsBuilder() = default;
 
 			auto addDescriptorSetLayout(VkDescriptorSetLayout descriptorSetLayout) -> GraphicsBuilder&
 			{
@@ -87,33 +210,35 @@ export namespace Aegis::Graphics
 
 			auto addShaderStage(VkShaderStageFlagBits stage, const std::filesystem::path& shaderPath) -> GraphicsBuilder&
 			{
-				VkShaderModule shaderModule = Tools::createShaderModule(VulkanContext::device(), shaderPath);
-				m_shaderModules.emplace_back(shaderModule);
-				addShaderStage(stage, shaderModule, "main");
+				addShaderStage(stage, shaderPath, "main");
 				return *this;
 			}
 
 			auto addShaderStages(VkShaderStageFlags stages, const std::filesystem::path& shaderPath) -> GraphicsBuilder&
 			{
-				VkShaderModule shaderModule = Tools::createShaderModule(VulkanContext::device(), shaderPath);
-				m_shaderModules.emplace_back(shaderModule);
-
 				if (stages & VK_SHADER_STAGE_VERTEX_BIT)
-					addShaderStage(VK_SHADER_STAGE_VERTEX_BIT, shaderModule, "vertexMain");
+					addShaderStage(VK_SHADER_STAGE_VERTEX_BIT, shaderPath, "vertexMain");
 				if (stages & VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT)
-					addShaderStage(VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT, shaderModule, "tessControlMain");
+					addShaderStage(VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT, shaderPath, "tessControlMain");
 				if (stages & VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT)
-					addShaderStage(VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT, shaderModule, "tessEvalMain");
+					addShaderStage(VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT, shaderPath, "tessEvalMain");
 				if (stages & VK_SHADER_STAGE_GEOMETRY_BIT)
-					addShaderStage(VK_SHADER_STAGE_GEOMETRY_BIT, shaderModule, "geometryMain");
+					addShaderStage(VK_SHADER_STAGE_GEOMETRY_BIT, shaderPath, "geometryMain");
 				if (stages & VK_SHADER_STAGE_FRAGMENT_BIT)
-					addShaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, shaderModule, "fragmentMain");
+					addShaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, shaderPath, "fragmentMain");
 				if (stages & VK_SHADER_STAGE_COMPUTE_BIT)
-					addShaderStage(VK_SHADER_STAGE_COMPUTE_BIT, shaderModule, "computeMain");
+					addShaderStage(VK_SHADER_STAGE_COMPUTE_BIT, shaderPath, "computeMain");
 				if (stages & VK_SHADER_STAGE_TASK_BIT_EXT)
-					addShaderStage(VK_SHADER_STAGE_TASK_BIT_EXT, shaderModule, "taskMain");
+					addShaderStage(VK_SHADER_STAGE_TASK_BIT_EXT, shaderPath, "taskMain");
 				if (stages & VK_SHADER_STAGE_MESH_BIT_EXT)
-					addShaderStage(VK_SHADER_STAGE_MESH_BIT_EXT, shaderModule, "meshMain");
+					addShaderStage(VK_SHADER_STAGE_MESH_BIT_EXT, shaderPath, "meshMain");
+				return *this;
+			}
+
+			template<typename T>
+			auto addSpecializationConstant(uint32_t id, T value) -> GraphicsBuilder&
+			{
+				m_specialization.set(id, value);
 				return *this;
 			}
 
@@ -194,46 +319,79 @@ export namespace Aegis::Graphics
 
 			auto buildUnique() -> std::unique_ptr<Pipeline>
 			{
-				return std::make_unique<Pipeline>(m_layoutConfig, m_graphicsConfig);
+				return std::make_unique<Pipeline>(build());
 			}
 
+			/// @brief Shader modules are only created for the duration of the pipeline creation
 			auto build() -> Pipeline
 			{
-				return Pipeline{ m_layoutConfig, m_graphicsConfig };
+				std::vector<VkShaderModule> modules;
+				VkSpecializationInfo specializationInfo = m_specialization.info();
+				m_graphicsConfig.shaderStges.clear();
+				for (std::size_t i = 0; i < m_shaderStages.size(); i++)
+				{
+					// Stages added with addShaderStages share one module
+					const auto& shaderStage = m_shaderStages[i];
+					if (i == 0 || shaderStage.path != m_shaderStages[i - 1].path)
+					{
+						modules.emplace_back(Tools::createShaderModule(VulkanContext::device(), shaderStage.path));
+					}
+
+					auto& stageInfo = m_graphicsConfig.shaderStges.emplace_back(
+						Tools::createShaderStage(shaderStage.stage, modules.back(), shaderStage.entryPoint));
+					stageInfo.pSpecializationInfo = m_specialization.empty() ? nullptr : &specializationInfo;
+				}
+
+				Pipeline pipeline{ m_layoutConfig, m_graphicsConfig };
+
+				for (VkShaderModule module : modules)
+				{
+					vkDestroyShaderModule(VulkanContext::device(), module, nullptr);
+				}
+				m_graphicsConfig.shaderStges.clear();
+				return pipeline;
 			}
 
-		private:
-			void addShaderStage(VkShaderStageFlagBits stage, VkShaderModule shaderModule, const char* entryPoint)
+			/// @brief Compiles the pipeline on the job system, the builder state is moved into the job
+			/// @note Descriptor set layouts have to outlive the returned future
+			auto buildAsync() -> Future
 			{
-				m_graphicsConfig.shaderStges.emplace_back(VkPipelineShaderStageCreateInfo{
-					.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-					.stage = stage,
-					.module = shaderModule,
-					.pName = entryPoint,
+				return Future::launch([builder = std::make_shared<GraphicsBuilder>(std::move(*this))]() {
+					return builder->build();
 					});
 			}
 
+		private:
+			struct ShaderStage
+			{
+				VkShaderStageFlagBits stage;
+				std::filesystem::path path;
+				const char* entryPoint;
+			};
+
+			void addShaderStage(VkShaderStageFlagBits stage, const std::filesystem::path& shaderPath, const char* entryPoint)
+			{
+				m_shaderStages.emplace_back(ShaderStage{ stage, shaderPath, entryPoint });
+			}
+
 			LayoutConfig m_layoutConfig;
 			GraphicsConfig m_graphicsConfig;
-			std::vector<VkShaderModule> m_shaderModules;
+			std::vector<ShaderStage> m_shaderStages;
+			Specialization m_specialization;
 		};
 
 		struct ComputeConfig
 		{
-			VkPipelineShaderStageCreateInfo shaderStage;
+			VkPipelineShaderStageCreateInfo shaderStage{};
 		};
 
 		class ComputeBuilder
 		{
 		public:
 			ComputeBuilder() = default;
-			~ComputeBuilder()
-			{
-				if (m_computeConfig.shaderStage.module)
-				{
-					vkDestroyShaderModule(VulkanContext::device(), m_computeConfig.shaderStage.module, nullptr);
-				}
-			}
+			ComputeBuilder(const ComputeBuilder&) = delete;
+			ComputeBuilder(ComputeBuilder&&) noexcept = default;
+			~ComputeBuilder() = default;
 
 			auto addDescriptorSetLayout(VkDescriptorSetLayout descriptorSetLayout) -> ComputeBuilder&
 			{
@@ -255,24 +413,66 @@ export namespace Aegis::Graphics
 
 			auto setShaderStage(const std::filesystem::path& shaderPath, const char* entry = "main") -> ComputeBuilder&
 			{
-				VkShaderModule shaderModule = Tools::createShaderModule(VulkanContext::device(), shaderPath);
-				m_computeConfig.shaderStage = Tools::createShaderStage(VK_SHADER_STAGE_COMPUTE_BIT, shaderModule, entry);
+				m_shaderPath = shaderPath;
+				m_entryPoint = entry;
 				return *this;
 			}
 
+			template<typename T>
+			auto addSpecializationConstant(uint32_t id, T value) -> ComputeBuilder&
+			{
+				m_specialization.set(id, value);
+				return *this;
+			}
+
+			/// @brief Identifies the pipeline this builder creates (shader, entry point, specialization and layout)
+			/// @note Layouts are compared by handle, keys are only meaningful while the descriptor set layouts are alive
+			[[nodiscard]] auto variantKey() const -> uint64_t
+			{
+				const auto& path = m_shaderPath.native();
+				uint64_t key = Utils::File::hash(std::as_bytes(std::span{ path }));
+				key = Utils::File::hash(std::as_bytes(std::span{ m_entryPoint }), key);
+				key = m_specialization.hash(key);
+				key = Utils::File::hash(std::as_bytes(std::span{ m_layoutConfig.descriptorSetLayouts }), key);
+				return Utils::File::hash(std::as_bytes(std::span{ m_layoutConfig.pushConstantRanges }), key);
+			}
+
 			auto buildUnique() -> std::unique_ptr<Pipeline>
 			{
-				return std::make_unique<Pipeline>(m_layoutConfig, m_computeConfig);
+				return std::make_unique<Pipeline>(build());
 			}
 
+			/// @brief The shader module is only created for the duration of the pipeline creation
 			auto build() -> Pipeline
 			{
-				return Pipeline{ m_layoutConfig, m_computeConfig };
+				AGX_ASSERT_X(!m_shaderPath.empty(), "Cannot create pipeline: no shader provided");
+
+				VkSpecializationInfo specializationInfo = m_specialization.info();
+				VkShaderModule shaderModule = Tools::createShaderModule(VulkanContext::device(), m_shaderPath);
+				ComputeConfig config{
+					.shaderStage = Tools::createShaderStage(VK_SHADER_STAGE_COMPUTE_BIT, shaderModule, m_entryPoint.c_str()),
+				};
+				config.shaderStage.pSpecializationInfo = m_specialization.empty() ? nullptr : &specializationInfo;
+
+				Pipeline pipeline{ m_layoutConfig, config };
+				vkDestroyShaderModule(VulkanContext::device(), shaderModule, nullptr);
+				return pipeline;
+			}
+
+			/// @brief Compiles the pipeline on the job system, the builder state is moved into the job
+			/// @note Descriptor set layouts have to outlive the returned future
+			auto buildAsync() -> Future
+			{
+				return Future::launch([builder = std::make_shared<ComputeBuilder>(std::move(*this))]() {
+					return builder->build();
+					});
 			}
 
 		private:
 			LayoutConfig m_layoutConfig;
-			ComputeConfig m_computeConfig;
+			std::filesystem::path m_shaderPath;
+			std::string m_entryPoint{ "main" };
+			Specialization m_specialization;
 		};
 
 		Pipeline() = default;
@@ -460,7 +660,7 @@ export namespace Aegis::Graphics
 				.basePipelineIndex = -1,
 			};
 
-			VK_CHECK(vkCreateGraphicsPipelines(VulkanContext::device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_pipeline));
+			VK_CHECK(vkCreateGraphicsPipelines(VulkanContext::device(), VulkanContext::pipelineCache(), 1, &pipelineInfo, nullptr, &m_pipeline));
 		}
 
 		void createComputePipeline(const ComputeConfig& config)
@@ -475,7 +675,7 @@ export namespace Aegis::Graphics
 				.basePipelineIndex = -1,
 			};
 
-			VK_CHECK(vkCreateComputePipelines(VulkanContext::device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_pipeline));
+			VK_CHECK(vkCreateComputePipelines(VulkanContext::device(), VulkanContext::pipelineCache(), 1, &pipelineInfo, nullptr, &m_pipeline));
 		}
 
 		void destroy()
@@ -0,0 +1,183 @@
+module;
+
+#include "core/assert.h"
+#include "graphics/vulkan/vulkan_include.h"
+
+#include <aegis-log/log.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+export module Aegis.Graphics.PipelineCache;
+
+import Aegis.Utils.File;
+
+export namespace Aegis::Graphics
+{
+	/// @brief Engine wide VkPipelineCache, loaded on startup and written back on shutdown
+	/// @note The driver data is prefixed with a header to validate it against the device (vendor, device, driver version
+	///       and cache UUID) and to detect truncated files, mismatching data is discarded and the cache starts empty.
+	///       Pipelines can be created with the cache from any thread (the cache is internally synchronized).
+	class PipelineCache
+	{
+	public:
+		static constexpr uint32_t MAGIC = 0x43504741; // "AGPC"
+		static constexpr uint32_t VERSION = 1;
+
+		struct Header
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint32_t vendorID;
+			uint32_t deviceID;
+			uint32_t driverVersion;
+			uint32_t reserved;
+			uint8_t uuid[VK_UUID_SIZE];
+			uint64_t dataSize;
+			uint64_t dataHash;
+		};
+
+		enum class Validation
+		{
+			Valid,
+			OtherDevice,	///< Written for another device, driver or cache format
+			Corrupt,		///< Truncated or the data does not match its hash
+		};
+
+		PipelineCache() = default;
+		PipelineCache(const PipelineCache&) = delete;
+		PipelineCache(PipelineCache&&) = delete;
+		~PipelineCache() = default;
+
+		auto operator=(const PipelineCache&) -> PipelineCache & = delete;
+		auto operator=(PipelineCache&&) -> PipelineCache & = delete;
+
+		operator VkPipelineCache() const { return m_cache; }
+
+		[[nodiscard]] auto cache() const -> VkPipelineCache { return m_cache; }
+
+		/// @brief Creates the cache with the contents of the file (if it is valid for the device)
+		void initialize(VkDevice device, const VkPhysicalDeviceProperties& properties, const std::filesystem::path& path)
+		{
+			AGX_ASSERT_X(!m_cache, "Pipeline cache is already initialized");
+			m_path = path;
+			m_header = deviceHeader(properties);
+
+			Utils::File::MappedFile file{ m_path };
+			auto data = validData(file);
+			if (!data.empty())
+			{
+				ALOG::info("Loaded pipeline cache ({} KiB)", data.size() / 1024);
+			}
+
+			VkPipelineCacheCreateInfo createInfo{
+				.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+				.initialDataSize = data.size(),
+				.pInitialData = data.empty() ? nullptr : data.data(),
+			};
+			VK_CHECK(vkCreatePipelineCache(device, &createInfo, nullptr, &m_cache));
+		}
+
+		/// @brief Writes the cache to disk, skipped if nothing was added since it was loaded or last saved
+		void save(VkDevice device)
+		{
+			if (!m_cache)
+				return;
+
+			std::size_t size = 0;
+			VK_CHECK(vkGetPipelineCacheData(device, m_cache, &size, nullptr));
+			std::vector<std::byte> file(sizeof(Header) + size);
+			VK_CHECK(vkGetPipelineCacheData(device, m_cache, &size, file.data() + sizeof(Header)));
+			file.resize(sizeof(Header) + size);
+
+			auto data = std::span{ file }.subspan(sizeof(Header));
+			auto dataHash = Utils::File::hash(data);
+			if (dataHash == m_header.dataHash)
+				return;
+
+			m_header.dataSize = size;
+			m_header.dataHash = dataHash;
+			std::memcpy(file.data(), &m_header, sizeof(Header));
+			if (!Utils::File::writeBinaryAtomic(m_path, file))
+			{
+				ALOG::warn("Failed to write pipeline cache '{}'", m_path.string());
+			}
+		}
+
+		/// @brief Header of cache files written for the device (data size and hash are set when saving)
+		[[nodiscard]] static auto deviceHeader(const VkPhysicalDeviceProperties& properties) -> Header
+		{
+			Header header{
+				.magic = MAGIC,
+				.version = VERSION,
+				.vendorID = properties.vendorID,
+				.deviceID = properties.deviceID,
+				.driverVersion = properties.driverVersion,
+			};
+			std::memcpy(header.uuid, properties.pipelineCacheUUID, VK_UUID_SIZE);
+			return header;
+		}
+
+		/// @brief Checks a cache file (header and driver data) against the header of the device
+		[[nodiscard]] static auto validate(std::span<const std::byte> file, const Header& device) -> Validation
+		{
+			if (file.size() < sizeof(Header))
+				return Validation::Corrupt;
+
+			Header header;
+			std::memcpy(&header, file.data(), sizeof(Header));
+			if (header.magic != MAGIC || header.version != VERSION || header.vendorID != device.vendorID
+				|| header.deviceID != device.deviceID || header.driverVersion != device.driverVersion
+				|| std::memcmp(header.uuid, device.uuid, VK_UUID_SIZE) != 0)
+				return Validation::OtherDevice;
+
+			auto data = file.subspan(sizeof(Header));
+			if (header.dataSize != data.size() || header.dataHash != Utils::File::hash(data))
+				return Validation::Corrupt;
+
+			return Validation::Valid;
+		}
+
+		/// @brief Saves and destroys the cache
+		void destroy(VkDevice device)
+		{
+			save(device);
+			vkDestroyPipelineCache(device, m_cache, nullptr);
+			m_cache = VK_NULL_HANDLE;
+		}
+
+	private:
+		/// @brief Driver data of the file, empty if it is missing or was written for another device or driver
+		/// @note Remembers the hash of valid data to skip saving an unchanged cache
+		[[nodiscard]] auto validData(const Utils::File::MappedFile& file) -> std::span<const std::byte>
+		{
+			if (!file.isValid())
+				return {};
+
+			switch (validate(file.bytes(), m_header))
+			{
+			case Validation::OtherDevice:
+				ALOG::info("Pipeline cache was created for another device or driver, starting empty");
+				return {};
+			case Validation::Corrupt:
+				ALOG::warn("Pipeline cache '{}' is corrupt", m_path.string());
+				return {};
+			default:
+				break;
+			}
+
+			Header header;
+			std::memcpy(&header, file.data(), sizeof(Header));
+			m_header.dataHash = header.dataHash;
+			return file.bytes().subspan(sizeof(Header));
+		}
+
+		VkPipelineCache m_cache{ VK_NULL_HANDLE };
+		Header m_header{};
+		std::filesystem::path m_path;
+	};
+}
@@ -0,0 +1,49 @@
+module;
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+export module Aegis.Graphics.PipelineVariantCache;
+
+import Aegis.Graphics.Pipeline;
+
+export namespace Aegis::Graphics
+{
+	/// @brief Specialized compute pipelines of one owner, keyed by shader, specialization values and layout
+	/// @note Variants are compiled on the job system the first time they are requested and kept until the cache is
+	///       destroyed, so switching back to a setting is free. Keys compare descriptor set layouts by handle, the cache
+	///       has to be owned next to (and declared after) the layouts its pipelines use.
+	class PipelineVariantCache
+	{
+	public:
+		PipelineVariantCache() = default;
+		PipelineVariantCache(const PipelineVariantCache&) = delete;
+		PipelineVariantCache(PipelineVariantCache&&) = default;
+		~PipelineVariantCache() = default;
+
+		auto operator=(const PipelineVariantCache&) -> PipelineVariantCache & = delete;
+		auto operator=(PipelineVariantCache&&) -> PipelineVariantCache & = default;
+
+		/// @brief Pipeline created by the builder, compilation starts on the first request
+		/// @note The builder only describes the variant, no Vulkan objects are created on a cache hit. On a miss the
+		///       builder state is moved into the compile job.
+		auto get(Pipeline::ComputeBuilder& builder) -> Pipeline::Future&
+		{
+			uint64_t key = builder.variantKey();
+			auto it = m_variants.find(key);
+			if (it == m_variants.end())
+			{
+				it = m_variants.emplace(key, builder.buildAsync()).first;
+			}
+			return it->second;
+		}
+
+		[[nodiscard]] auto size() const -> std::size_t { return m_variants.size(); }
+
+		void clear() { m_variants.clear(); }
+
+	private:
+		std::unordered_map<uint64_t, Pipeline::Future> m_variants;
+	};
+}
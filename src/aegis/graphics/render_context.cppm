@@ -7,6 +7,8 @@ export module Aegis.Graphics.RenderContext;
 import Aegis.Scene;
 import Aegis.UI;
 import Aegis.Graphics.Bindless.DescriptorHandle;
+import Aegis.Graphics.DrawBatchRegistry;
+import Aegis.Graphics.Frustum;
 
 export namespace Aegis::Graphics
 {
@@ -14,9 +16,11 @@ export namespace Aegis::Graphics
 	{
 		Scene::Scene& scene;
 		UI::UI& ui;
+		DrawBatchRegistry& drawBatcher;
 		uint32_t frameIndex{ 0 };
 		VkCommandBuffer cmd{ VK_NULL_HANDLE };
 		VkDescriptorSet globalSet{ VK_NULL_HANDLE };
 		Bindless::DescriptorHandle globalHandle;
+		Frustum frustum{}; // Frustum of the main camera (all planes zero if nothing should be culled)
 	};
 }
\ No newline at end of file
@@ -14,6 +14,7 @@ import Aegis.Core.Globals;
 import Aegis.Graphics.Descriptors;
 import Aegis.Graphics.FrameGraph.RenderPass;
 import Aegis.Graphics.Pipeline;
+import Aegis.Graphics.PipelineVariantCache;
 import Aegis.Graphics.ImageView;
 import Aegis.Graphics.Sampler;
 import Aegis.Graphics.Texture;
@@ -30,7 +31,6 @@ export namespace Aegis::Graphics
 
 	struct BloomDownsample
 	{
-		int mipLevel = 0;
 		float filterScale = 1.0f;
 	};
 
@@ -41,6 +41,7 @@ export namespace Aegis::Graphics
 
 	/// @brief Bloom post-processing effect using a threshold, downsample, and upsample pass
 	/// @note Based on: https://www.iryoku.com/next-generation-post-processing-in-call-of-duty-advanced-warfare/
+	///       The soft threshold and the Karis average of the first downsample are specialization constants.
 	class BloomPass : public FGRenderPass
 	{
 	public:
@@ -58,12 +59,8 @@ export namespace Aegis::Graphics
 			};
 			m_sampler = Sampler{ samplerInfo };
 
-			// Descriptor sets
-			m_thresholdPipeline = Pipeline::ComputeBuilder{}
-				.addDescriptorSetLayout(m_thresholdSetLayout)
-				.addPushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(BloomThreshold))
-				.setShaderStage(Core::SHADER_DIR / "bloom/bloom_threshold.slang.spv")
-				.buildUnique();
+			// Threshold
+			thresholdPipeline(m_threshold.softThreshold > 0.0f);
 
 			// Downsample
 			for (uint32_t i = 0; i < BLOOM_MIP_LEVELS - 1; i++)
@@ -71,24 +68,16 @@ export namespace Aegis::Graphics
 				m_downsampleSets.emplace_back(m_downsampleSetLayout);
 			}
 
-			m_downsamplePipeline = Pipeline::ComputeBuilder{}
-				.addDescriptorSetLayout(m_downsampleSetLayout)
-				.addPushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(BloomDownsample))
-				.setShaderStage(Core::SHADER_DIR / "bloom/bloom_downsample.slang.spv")
-				.buildUnique();
+			downsamplePipeline(true);
+			downsamplePipeline(false);
 
 			// Upsample
-
 			for (uint32_t i = 0; i < BLOOM_MIP_LEVELS - 1; i++)
 			{
 				m_upsampleSets.emplace_back(m_upsampleSetLayout);
 			}
 
-			m_upsamplePipeline = Pipeline::ComputeBuilder{}
-				.addDescriptorSetLayout(m_upsampleSetLayout)
-				.addPushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(BloomUpsample))
-				.setShaderStage(Core::SHADER_DIR / "bloom/bloom_upsample.slang.spv")
-				.buildUnique();
+			upsamplePipeline();
 
 			m_sceneColor = pool.addReference("SceneColor",
 				FGResource::Usage::ComputeReadStorage);
@@ -189,11 +178,38 @@ export namespace Aegis::Graphics
 				.build();
 		}
 
+		auto thresholdPipeline(bool softThreshold) -> Pipeline::Future&
+		{
+			return m_pipelines.get(Pipeline::ComputeBuilder{}
+				.addDescriptorSetLayout(m_thresholdSetLayout)
+				.addPushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(BloomThreshold))
+				.setShaderStage(Core::SHADER_DIR / "bloom/bloom_threshold.slang.spv")
+				.addSpecializationConstant(0, softThreshold));
+		}
+
+		auto downsamplePipeline(bool karisAverage) -> Pipeline::Future&
+		{
+			return m_pipelines.get(Pipeline::ComputeBuilder{}
+				.addDescriptorSetLayout(m_downsampleSetLayout)
+				.addPushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(BloomDownsample))
+				.setShaderStage(Core::SHADER_DIR / "bloom/bloom_downsample.slang.spv")
+				.addSpecializationConstant(0, karisAverage));
+		}
+
+		auto upsamplePipeline() -> Pipeline::Future&
+		{
+			return m_pipelines.get(Pipeline::ComputeBuilder{}
+				.addDescriptorSetLayout(m_upsampleSetLayout)
+				.addPushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(BloomUpsample))
+				.setShaderStage(Core::SHADER_DIR / "bloom/bloom_upsample.slang.spv"));
+		}
+
 		void extractBrightRegions(VkCommandBuffer cmd, const FrameInfo& frameInfo)
 		{
-			m_thresholdPipeline->bind(cmd);
-			m_thresholdPipeline->bindDescriptorSet(cmd, 0, m_thresholdSet);
-			m_thresholdPipeline->pushConstants(cmd, VK_SHADER_STAGE_COMPUTE_BIT, m_threshold);
+			auto& pipeline = thresholdPipeline(m_threshold.softThreshold > 0.0f).get();
+			pipeline.bind(cmd);
+			pipeline.bindDescriptorSet(cmd, 0, m_thresholdSet);
+			pipeline.pushConstants(cmd, VK_SHADER_STAGE_COMPUTE_BIT, m_threshold);
 
 			Tools::vk::cmdDispatch(cmd, frameInfo.swapChainExtent, { 16, 16 });
 		}
@@ -202,7 +218,9 @@ export namespace Aegis::Graphics
 		{
 			AGX_ASSERT(bloom.image().layout() == VK_IMAGE_LAYOUT_GENERAL);
 
-			m_downsamplePipeline->bind(cmd);
+			// The first downsample filters fireflies with the Karis average, the others use the plain filter
+			auto& karisPipeline = downsamplePipeline(true).get();
+			auto& filterPipeline = downsamplePipeline(false).get();
 
 			VkImageMemoryBarrier barrier{};
 			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -232,10 +250,10 @@ export namespace Aegis::Graphics
 					1, &barrier
 				);
 
-				m_downsample.mipLevel = srcMip;
-
-				m_downsamplePipeline->bindDescriptorSet(cmd, 0, m_downsampleSets[srcMip]);
-				m_downsamplePipeline->pushConstants(cmd, VK_SHADER_STAGE_COMPUTE_BIT, m_downsample);
+				auto& pipeline = srcMip == 0 ? karisPipeline : filterPipeline;
+				pipeline.bind(cmd);
+				pipeline.bindDescriptorSet(cmd, 0, m_downsampleSets[srcMip]);
+				pipeline.pushConstants(cmd, VK_SHADER_STAGE_COMPUTE_BIT, m_downsample);
 
 				VkExtent2D mipExtent = { bloom.image().width() >> dstMip, bloom.image().height() >> dstMip };
 				Tools::vk::cmdDispatch(cmd, mipExtent, { 16, 16 });
@@ -257,7 +275,8 @@ export namespace Aegis::Graphics
 
 		void upSample(VkCommandBuffer cmd, Texture& bloom)
 		{
-			m_upsamplePipeline->bind(cmd);
+			auto& pipeline = upsamplePipeline().get();
+			pipeline.bind(cmd);
 
 			VkImageMemoryBarrier barrier{};
 			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -289,8 +308,8 @@ export namespace Aegis::Graphics
 				);
 
 				// Upsample the mip level
-				m_upsamplePipeline->bindDescriptorSet(cmd, 0, m_upsampleSets[dstMip]);
-				m_upsamplePipeline->pushConstants(cmd, VK_SHADER_STAGE_COMPUTE_BIT, m_upsample);
+				pipeline.bindDescriptorSet(cmd, 0, m_upsampleSets[dstMip]);
+				pipeline.pushConstants(cmd, VK_SHADER_STAGE_COMPUTE_BIT, m_upsample);
 
 				VkExtent2D mipExtent = { bloom.image().width() >> dstMip, bloom.image().height() >> dstMip };
 				Tools::vk::cmdDispatch(cmd, mipExtent, { 16, 16 });
@@ -338,14 +357,13 @@ export namespace Aegis::Graphics
 
 		DescriptorSetLayout m_thresholdSetLayout;
 		DescriptorSet m_thresholdSet;
-		std::unique_ptr<Pipeline> m_thresholdPipeline;
 
 		DescriptorSetLayout m_downsampleSetLayout;
 		std::vector<DescriptorSet> m_downsampleSets;
-		std::unique_ptr<Pipeline> m_downsamplePipeline;
 
 		DescriptorSetLayout m_upsampleSetLayout;
 		std::vector<DescriptorSet> m_upsampleSets;
-		std::unique_ptr<Pipeline> m_upsamplePipeline;
+
+		PipelineVariantCache m_pipelines;
 	};
 }
\ No newline at end of file
@@ -3,23 +3,59 @@ module;
 #include "core/assert.h"
 #include "graphics/vulkan/vulkan_include.h"
 
+#include <aegis-log/log.h>
+
 #include <algorithm>
+#include <vector>
 
 export module Aegis.Graphics.RenderPasses.CullingPass;
 
 import Aegis.Core.Globals;
 import Aegis.Graphics.Bindless;
+import Aegis.Graphics.Buffer;
 import Aegis.Graphics.DrawBatchRegistry;
 import Aegis.Graphics.FrameGraph.RenderPass;
+import Aegis.Graphics.GeometryArena;
 import Aegis.Graphics.Pipeline;
 import Aegis.Graphics.Vulkan.Tools;
+import Aegis.Graphics.VulkanContext;
 
 export namespace Aegis::Graphics
 {
+	/// @brief Two-phase occlusion culling: The early phase draws the instances visible last frame, the late phase tests all
+	///        remaining instances against a depth pyramid built from the early phase and draws the newly visible ones
+	enum class CullingPhase : uint32_t
+	{
+		Early = 0,
+		Late = 1,
+	};
+
+	/// @brief How the visible instances are drawn (has to match the draw modes in indirect_draw.slang)
+	enum class IndirectDrawMode : uint32_t
+	{
+		MeshTasks = 0,	// One task shader dispatch per instance, meshlets are culled in the task shader
+		Indexed = 1,	// One indexed draw per instance, meshlets and triangles are culled by the TriangleCullingPass
+	};
+
+	/// @brief Counters of the meshlet work list in indexed draw mode (has to match indirect_draw.slang)
+	struct MeshletWorkArgs
+	{
+		VkDispatchIndirectCommand dispatch; // Written by the TriangleCullingPass
+		uint32_t workCount;
+		uint32_t indexCount;
+	};
+
+	/// @brief Culls all instances and writes one indirect draw per visible instance, grouped by draw batch
+	/// @note In indexed draw mode every visible instance additionally reserves the index range of its mesh in the
+	///       CompactedIndices buffer and queues all of its meshlets for the TriangleCullingPass. Both buffers are sized
+	///       from a fixed visible triangle budget, instances that do not fit anymore are written to the
+	///       OverflowDrawCommands instead and drawn unculled from the index buffer of the geometry arena.
 	class CullingPass : public FGRenderPass
 	{
 	public:
 		static constexpr uint32_t WORKGROUP_SIZE = 64;
+		static constexpr uint32_t DEFAULT_VISIBLE_TRIANGLE_BUDGET = 1 << 22;
+		static constexpr uint32_t MIN_AVERAGE_MESHLET_TRIANGLES = 32;	///< Sizes the meshlet work list from the budget
 
 		struct CullingPushConstants
 		{
@@ -30,19 +66,33 @@ export namespace Aegis::Graphics
 			Bindless::DescriptorHandle visibilityInstances;
 			Bindless::DescriptorHandle indirectDrawCommands;
 			Bindless::DescriptorHandle indirectDrawCounts;
+			Bindless::DescriptorHandle instanceVisibility;
+			Bindless::DescriptorHandle depthPyramid;
+			Bindless::DescriptorHandle meshletWork;
+			Bindless::DescriptorHandle meshletWorkArgs;
 			uint32_t staticInstanceCount;
 			uint32_t dynamicInstanceCount;
+			CullingPhase phase;
+			IndirectDrawMode drawMode;
+			uint32_t meshletWorkCapacity;
+			uint32_t indexCapacity;
+			Bindless::DescriptorHandle meshes;
+			Bindless::DescriptorHandle overflowDrawCommands;
+			uint32_t overflowCountOffset;
 		};
 
-		CullingPass(FGResourcePool& pool, DrawBatchRegistry& batcher)
-			: m_drawBatcher{ batcher }
+		/// @param visibleTriangleBudget Triangles of all instances that can be culled per triangle in one phase (indexed
+		///        draw mode), clamped to the storage buffer range of the device
+		CullingPass(FGResourcePool& pool, DrawBatchRegistry& batcher, CullingPhase phase = CullingPhase::Early,
+			IndirectDrawMode drawMode = IndirectDrawMode::MeshTasks, uint32_t visibleTriangleBudget = DEFAULT_VISIBLE_TRIANGLE_BUDGET)
+			: m_drawBatcher{ batcher }, m_phase{ phase }, m_drawMode{ drawMode }
 		{
 			m_pipeline = Pipeline::ComputeBuilder{}
 				// TODO: Maybe add convienience method to add bindless layout
 				.addDescriptorSetLayout(Bindless::BindlessDescriptorSet::instance().layout())
 				.addPushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(CullingPushConstants))
 				.setShaderStage(Core::SHADER_DIR / "gpu-driven/culling.slang.spv")
-				.build();
+				.buildAsync();
 
 			m_staticInstances = pool.addReference("StaticInstanceData",
 				FGResource::Usage::ComputeReadStorage);
@@ -53,6 +103,44 @@ export namespace Aegis::Graphics
 			m_drawBatchBuffer = pool.addReference("DrawBatches",
 				FGResource::Usage::ComputeReadStorage);
 
+			m_cameraData = pool.addReference("CameraData",
+				FGResource::Usage::ComputeReadUniform);
+
+			if (m_phase == CullingPhase::Late)
+			{
+				// The late phase reuses the draw buffers of the early phase (after they have been drawn)
+				m_visibleIndices = pool.addReference("VisibleInstances",
+					FGResource::Usage::ComputeWriteStorage);
+
+				m_indirectDrawCommands = pool.addReference("IndirectDrawCommands",
+					FGResource::Usage::ComputeWriteStorage);
+
+				m_indirectDrawCounts = pool.addReference("IndirectDrawCounts",
+					FGResource::Usage::ComputeWriteStorage);
+
+				m_instanceVisibility = pool.addReference("InstanceVisibility",
+					FGResource::Usage::ComputeWriteStorage);
+
+				m_depthPyramid = pool.addReference("DepthPyramid",
+					FGResource::Usage::ComputeReadSampled);
+
+				if (m_drawMode == IndirectDrawMode::Indexed)
+				{
+					m_meshletWork = pool.addReference("MeshletWork",
+						FGResource::Usage::ComputeWriteStorage);
+
+					m_meshletWorkArgs = pool.addReference("MeshletWorkArgs",
+						FGResource::Usage::ComputeWriteStorage);
+
+					m_compactedIndices = pool.addReference("CompactedIndices",
+						FGResource::Usage::ComputeWriteStorage);
+
+					m_overflowDrawCommands = pool.addReference("OverflowDrawCommands",
+						FGResource::Usage::ComputeWriteStorage);
+				}
+				return;
+			}
+
 			m_visibleIndices = pool.addBuffer("VisibleInstances",
 				FGResource::Usage::ComputeWriteStorage,
 				FGBufferInfo{
@@ -62,34 +150,114 @@ export namespace Aegis::Graphics
 			m_indirectDrawCommands = pool.addBuffer("IndirectDrawCommands",
 				FGResource::Usage::ComputeWriteStorage,
 				FGBufferInfo{
-					.size = sizeof(VkDrawMeshTasksIndirectCommandEXT) * std::max(m_drawBatcher.instanceCount(), 1u),
+					.size = commandSize() * std::max(m_drawBatcher.instanceCount(), 1u),
 				});
 
 			m_indirectDrawCounts = pool.addBuffer("IndirectDrawCounts",
 				FGResource::Usage::ComputeWriteStorage,
 				FGBufferInfo{
-					.size = sizeof(uint32_t) * std::max(m_drawBatcher.batchCount(), 1u),
+					.size = countsSize(std::max(m_drawBatcher.batchCount(), 1u)),
 					.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT
 				});
 
-			m_cameraData = pool.addReference("CameraData",
-				FGResource::Usage::ComputeReadUniform);
+			// Visibility of each instance slot in the previous frame (written by the late phase, kept when growing)
+			m_instanceVisibility = pool.addBuffer("InstanceVisibility",
+				FGResource::Usage::ComputeReadStorage,
+				FGBufferInfo{
+					.size = sizeof(uint32_t) * std::max(m_drawBatcher.instanceCount(), 1u),
+					.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				});
+
+			if (m_drawMode == IndirectDrawMode::Indexed)
+			{
+				auto maxTriangles = static_cast<uint32_t>(VulkanContext::device().properties().limits.maxStorageBufferRange / (sizeof(uint32_t) * 3));
+				uint32_t triangleBudget = std::clamp(visibleTriangleBudget, 1u, maxTriangles);
+				if (triangleBudget < visibleTriangleBudget)
+					ALOG::warn("Visible triangle budget clamped to {} (maxStorageBufferRange)", triangleBudget);
+
+				// The content is rewritten every frame, the size does not depend on the scene
+				m_meshletWork = pool.addBuffer("MeshletWork",
+					FGResource::Usage::ComputeWriteStorage,
+					FGBufferInfo{
+						.size = sizeof(uint32_t) * 2 * std::max(triangleBudget / MIN_AVERAGE_MESHLET_TRIANGLES, 1u),
+					});
+
+				m_meshletWorkArgs = pool.addBuffer("MeshletWorkArgs",
+					FGResource::Usage::ComputeWriteStorage,
+					FGBufferInfo{
+						.size = sizeof(MeshletWorkArgs),
+						.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+					});
+
+				m_compactedIndices = pool.addBuffer("CompactedIndices",
+					FGResource::Usage::ComputeWriteStorage,
+					FGBufferInfo{
+						.size = sizeof(uint32_t) * 3 * static_cast<VkDeviceSize>(triangleBudget),
+					});
+
+				// Instances exceeding the budget, indexed like the IndirectDrawCommands
+				m_overflowDrawCommands = pool.addBuffer("OverflowDrawCommands",
+					FGResource::Usage::ComputeWriteStorage,
+					FGBufferInfo{
+						.size = commandSize() * std::max(m_drawBatcher.instanceCount(), 1u),
+					});
+			}
 		}
 
 		virtual auto info() -> Info override
 		{
-			return Info{
-				.name = "Culling",
-				.reads = { m_cameraData, m_staticInstances, m_dynamicInstances },
+			if (m_phase == CullingPhase::Late)
+			{
+				Info info{
+					.name = "Culling (Late)",
+					.reads = { m_cameraData, m_staticInstances, m_dynamicInstances, m_depthPyramid },
+					.writes = { m_visibleIndices, m_indirectDrawCommands, m_indirectDrawCounts, m_instanceVisibility },
+				};
+				addMeshletWork(info);
+				return info;
+			}
+
+			Info info{
+				.name = "Culling (Early)",
+				.reads = { m_cameraData, m_staticInstances, m_dynamicInstances, m_instanceVisibility },
 				.writes = { m_visibleIndices, m_indirectDrawCommands, m_indirectDrawCounts },
 			};
+			addMeshletWork(info);
+			return info;
 		}
 
 		virtual void execute(FGResourcePool& pool, const FrameInfo& frameInfo) override
 		{
-			// Clear visible counts buffer
-			auto& indirectDrawCounts = pool.buffer(m_indirectDrawCounts);
-			vkCmdFillBuffer(frameInfo.cmd, indirectDrawCounts.buffer(), 0, indirectDrawCounts.buffer().bufferSize(), 0);
+			if (m_phase == CullingPhase::Early)
+			{
+				// Instances and batches can be added at runtime, the content is rewritten every frame so no copy is needed
+				pool.growBuffer(m_visibleIndices, sizeof(uint32_t) * m_drawBatcher.instanceCount());
+				pool.growBuffer(m_indirectDrawCommands, commandSize() * m_drawBatcher.instanceCount());
+				pool.growBuffer(m_indirectDrawCounts, countsSize(m_drawBatcher.batchCount()));
+
+				if (m_drawMode == IndirectDrawMode::Indexed)
+					pool.growBuffer(m_overflowDrawCommands, commandSize() * m_drawBatcher.instanceCount());
+
+				// New slots start out visible, so new instances are drawn in the early phase right away
+				pool.growBuffer(m_instanceVisibility, sizeof(uint32_t) * m_drawBatcher.slotCount(), frameInfo.cmd);
+				auto& visibility = pool.buffer(m_instanceVisibility).buffer();
+				if (m_initializedVisibilitySize < visibility.instanceSize())
+				{
+					fillBuffer(frameInfo.cmd, visibility, 1, m_initializedVisibilitySize);
+					m_initializedVisibilitySize = visibility.instanceSize();
+				}
+			}
+
+			fillBuffer(frameInfo.cmd, pool.buffer(m_indirectDrawCounts).buffer());
+
+			uint32_t meshletWorkCapacity = 0;
+			uint32_t indexCapacity = 0;
+			if (m_drawMode == IndirectDrawMode::Indexed)
+			{
+				fillBuffer(frameInfo.cmd, pool.buffer(m_meshletWorkArgs).buffer());
+				meshletWorkCapacity = static_cast<uint32_t>(pool.buffer(m_meshletWork).buffer().bufferSize() / (sizeof(uint32_t) * 2));
+				indexCapacity = static_cast<uint32_t>(pool.buffer(m_compactedIndices).buffer().bufferSize() / sizeof(uint32_t));
+			}
 
 			CullingPushConstants push{
 				.cameraData = pool.buffer(m_cameraData).handle(frameInfo.frameIndex),
@@ -99,19 +267,78 @@ export namespace Aegis::Graphics
 				.visibilityInstances = pool.buffer(m_visibleIndices).handle(),
 				.indirectDrawCommands = pool.buffer(m_indirectDrawCommands).handle(),
 				.indirectDrawCounts = pool.buffer(m_indirectDrawCounts).handle(),
-				.staticInstanceCount = m_drawBatcher.staticInstanceCount(),
-				.dynamicInstanceCount = m_drawBatcher.dynamicInstanceCount(),
+				.instanceVisibility = pool.buffer(m_instanceVisibility).handle(),
+				.depthPyramid = m_depthPyramid.isValid() ? pool.texture(m_depthPyramid).sampledDescriptorHandle() : Bindless::DescriptorHandle{},
+				.meshletWork = m_meshletWork.isValid() ? pool.buffer(m_meshletWork).handle() : Bindless::DescriptorHandle{},
+				.meshletWorkArgs = m_meshletWorkArgs.isValid() ? pool.buffer(m_meshletWorkArgs).handle() : Bindless::DescriptorHandle{},
+				.staticInstanceCount = m_drawBatcher.staticSlotCount(),
+				.dynamicInstanceCount = m_drawBatcher.dynamicSlotCount(),
+				.phase = m_phase,
+				.drawMode = m_drawMode,
+				.meshletWorkCapacity = meshletWorkCapacity,
+				.indexCapacity = indexCapacity,
+				.meshes = GeometryArena::instance().meshDataHandle(),
+				.overflowDrawCommands = m_overflowDrawCommands.isValid() ? pool.buffer(m_overflowDrawCommands).handle() : Bindless::DescriptorHandle{},
+				.overflowCountOffset = m_drawBatcher.batchCount(),
 			};
 
-			m_pipeline.bind(frameInfo.cmd);
-			m_pipeline.bindDescriptorSet(frameInfo.cmd, 0, Bindless::BindlessDescriptorSet::instance());
-			m_pipeline.pushConstants(frameInfo.cmd, VK_SHADER_STAGE_COMPUTE_BIT, push);
+			m_pipeline->bind(frameInfo.cmd);
+			m_pipeline->bindDescriptorSet(frameInfo.cmd, 0, Bindless::BindlessDescriptorSet::instance());
+			m_pipeline->pushConstants(frameInfo.cmd, VK_SHADER_STAGE_COMPUTE_BIT, push);
 
-			Tools::vk::cmdDispatch(frameInfo.cmd, m_drawBatcher.instanceCount(), WORKGROUP_SIZE);
+			Tools::vk::cmdDispatch(frameInfo.cmd, m_drawBatcher.slotCount(), WORKGROUP_SIZE);
 		}
 
 	private:
+		[[nodiscard]] auto commandSize() const -> VkDeviceSize
+		{
+			return m_drawMode == IndirectDrawMode::Indexed
+				? sizeof(VkDrawIndexedIndirectCommand)
+				: sizeof(VkDrawMeshTasksIndirectCommandEXT);
+		}
+
+		/// @brief In indexed draw mode the overflow counts of all batches follow the draw counts
+		[[nodiscard]] auto countsSize(uint32_t batchCount) const -> VkDeviceSize
+		{
+			return sizeof(uint32_t) * batchCount * (m_drawMode == IndirectDrawMode::Indexed ? 2 : 1);
+		}
+
+		void addMeshletWork(Info& info) const
+		{
+			if (m_drawMode != IndirectDrawMode::Indexed)
+				return;
+
+			info.writes.insert(info.writes.end(), { m_meshletWork, m_meshletWorkArgs, m_compactedIndices, m_overflowDrawCommands });
+		}
+
+		/// @brief Fills the buffer from offset to its end with value
+		/// @note Uses a transfer command, which is not covered by the frame graph barriers
+		void fillBuffer(VkCommandBuffer cmd, Buffer& buffer, uint32_t value = 0, VkDeviceSize offset = 0)
+		{
+			VkBufferMemoryBarrier barrier{
+				.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+				.srcAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+				.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.buffer = buffer,
+				.offset = offset,
+				.size = VK_WHOLE_SIZE,
+			};
+			Tools::vk::cmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, { barrier }, {});
+
+			vkCmdFillBuffer(cmd, buffer, offset, VK_WHOLE_SIZE, value);
+
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			Tools::vk::cmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				{ barrier }, {});
+		}
+
 		DrawBatchRegistry& m_drawBatcher;
+		CullingPhase m_phase;
+		IndirectDrawMode m_drawMode;
 		FGResourceHandle m_cameraData;
 		FGResourceHandle m_staticInstances;
 		FGResourceHandle m_dynamicInstances;
@@ -119,6 +346,13 @@ export namespace Aegis::Graphics
 		FGResourceHandle m_visibleIndices;
 		FGResourceHandle m_indirectDrawCommands;
 		FGResourceHandle m_indirectDrawCounts;
-		Pipeline m_pipeline;
+		FGResourceHandle m_instanceVisibility;
+		FGResourceHandle m_depthPyramid;
+		FGResourceHandle m_meshletWork;
+		FGResourceHandle m_meshletWorkArgs;
+		FGResourceHandle m_compactedIndices;
+		FGResourceHandle m_overflowDrawCommands;
+		VkDeviceSize m_initializedVisibilitySize{ 0 };
+		Pipeline::Future m_pipeline;
 	};
-}
\ No newline at end of file
+}
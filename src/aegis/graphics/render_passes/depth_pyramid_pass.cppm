@@ -0,0 +1,164 @@
+module;
+
+#include "core/assert.h"
+#include "graphics/vulkan/vulkan_include.h"
+
+#include <algorithm>
+#include <vector>
+
+export module Aegis.Graphics.RenderPasses.DepthPyramidPass;
+
+import Aegis.Core.Globals;
+import Aegis.Graphics.Bindless;
+import Aegis.Graphics.FrameGraph.RenderPass;
+import Aegis.Graphics.Image;
+import Aegis.Graphics.ImageView;
+import Aegis.Graphics.Pipeline;
+import Aegis.Graphics.Texture;
+import Aegis.Graphics.Vulkan.Tools;
+
+export namespace Aegis::Graphics
+{
+	/// @brief Builds a hierarchical depth buffer (Hi-Z) storing the farthest depth of each texel in a full mip chain
+	/// @note Used for occlusion culling in the late culling phase. Level 0 has half the resolution of the depth buffer
+	///       and is reduced from it directly, levels are not rounded to a power of two.
+	class DepthPyramidPass : public FGRenderPass
+	{
+	public:
+		static constexpr VkExtent2D WORKGROUP_SIZE = { 16, 16 };
+
+		struct PushConstant
+		{
+			Bindless::DescriptorHandle depth;
+			Bindless::DescriptorHandle source;
+			Bindless::DescriptorHandle destination;
+			VkExtent2D sourceSize;
+			VkExtent2D destinationSize;
+			uint32_t firstLevel;
+		};
+
+		DepthPyramidPass(FGResourcePool& pool)
+		{
+			m_pipeline = Pipeline::ComputeBuilder{}
+				.addDescriptorSetLayout(Bindless::BindlessDescriptorSet::instance().layout())
+				.addPushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstant))
+				.setShaderStage(Core::SHADER_DIR / "gpu-driven/depth_pyramid.slang.spv")
+				.buildAsync();
+
+			m_depth = pool.addReference("Depth",
+				FGResource::Usage::ComputeReadSampled);
+
+			m_depthPyramid = pool.addImage("DepthPyramid",
+				FGResource::Usage::ComputeWriteStorage,
+				FGTextureInfo{
+					.format = VK_FORMAT_R32_SFLOAT,
+					.resizeMode = FGResizeMode::HalfSwapChainRelative,
+					.mipLevels = Image::CreateInfo::CALCULATE_MIP_LEVELS,
+				});
+		}
+
+		~DepthPyramidPass()
+		{
+			freeLevelHandles();
+		}
+
+		virtual auto info() -> Info override
+		{
+			return Info{
+				.name = "Depth Pyramid",
+				.reads = { m_depth },
+				.writes = { m_depthPyramid },
+			};
+		}
+
+		virtual void createResources(FGResourcePool& pool) override
+		{
+			auto& pyramid = pool.texture(m_depthPyramid);
+
+			// Each level is written as a storage image and read by the next level
+			freeLevelHandles();
+			m_levelViews.clear();
+			for (uint32_t level = 0; level < pyramid.image().mipLevels(); level++)
+			{
+				ImageView::CreateInfo viewInfo{
+					.baseMipLevel = level,
+					.levelCount = 1,
+				};
+				auto& view = m_levelViews.emplace_back(viewInfo, pyramid.image());
+				m_levelHandles.emplace_back(Bindless::BindlessDescriptorSet::instance().allocateStorageImage(
+					VkDescriptorImageInfo{ VK_NULL_HANDLE, view, VK_IMAGE_LAYOUT_GENERAL }));
+			}
+		}
+
+		virtual void execute(FGResourcePool& pool, const FrameInfo& frameInfo) override
+		{
+			auto& depth = pool.texture(m_depth);
+			auto& pyramid = pool.texture(m_depthPyramid);
+			AGX_ASSERT_X(pyramid.image().layout() == VK_IMAGE_LAYOUT_GENERAL, "Depth Pyramid Pass: Pyramid has to be in general layout");
+
+			m_pipeline->bind(frameInfo.cmd);
+			m_pipeline->bindDescriptorSet(frameInfo.cmd, 0, Bindless::BindlessDescriptorSet::instance());
+
+			VkImageMemoryBarrier barrier{
+				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+				.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+				.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+				.oldLayout = VK_IMAGE_LAYOUT_GENERAL,
+				.newLayout = VK_IMAGE_LAYOUT_GENERAL,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.image = pyramid.image(),
+				.subresourceRange = VkImageSubresourceRange{
+					.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+					.levelCount = 1,
+					.baseArrayLayer = 0,
+					.layerCount = 1,
+				}
+			};
+
+			VkExtent2D sourceSize = depth.extent2D();
+			for (uint32_t level = 0; level < static_cast<uint32_t>(m_levelHandles.size()); level++)
+			{
+				VkExtent2D levelSize{
+					std::max(pyramid.image().width() >> level, 1u),
+					std::max(pyramid.image().height() >> level, 1u)
+				};
+
+				PushConstant push{
+					.depth = depth.sampledDescriptorHandle(),
+					.source = level > 0 ? m_levelHandles[level - 1] : Bindless::DescriptorHandle{},
+					.destination = m_levelHandles[level],
+					.sourceSize = sourceSize,
+					.destinationSize = levelSize,
+					.firstLevel = level == 0 ? 1u : 0u,
+				};
+				m_pipeline->pushConstants(frameInfo.cmd, VK_SHADER_STAGE_COMPUTE_BIT, push);
+				Tools::vk::cmdDispatch(frameInfo.cmd, levelSize, WORKGROUP_SIZE);
+
+				// Next level reads this one
+				barrier.subresourceRange.baseMipLevel = level;
+				Tools::vk::cmdPipelineBarrier(frameInfo.cmd,
+					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, { barrier });
+
+				sourceSize = levelSize;
+			}
+		}
+
+	private:
+		void freeLevelHandles()
+		{
+			for (auto& handle : m_levelHandles)
+			{
+				Bindless::BindlessDescriptorSet::instance().freeHandleDeferred(handle);
+			}
+			m_levelHandles.clear();
+		}
+
+		FGResourceHandle m_depth;
+		FGResourceHandle m_depthPyramid;
+
+		std::vector<ImageView> m_levelViews;
+		std::vector<Bindless::DescriptorHandle> m_levelHandles;
+		Pipeline::Future m_pipeline;
+	};
+}
@@ -105,7 +105,7 @@ export namespace Aegis::Graphics
 
 		virtual void execute(FGResourcePool& pool, const FrameInfo& frameInfo) override
 		{
-			updateUBO(frameInfo);
+			Frustum frustum = updateUBO(frameInfo);
 
 			auto& position = pool.texture(m_position);
 			auto& normal = pool.texture(m_normal);
@@ -145,10 +145,12 @@ export namespace Aegis::Graphics
 				RenderContext ctx{
 					.scene = frameInfo.scene,
 					.ui = frameInfo.ui,
+					.drawBatcher = frameInfo.drawBatcher,
 					.frameIndex = frameInfo.frameIndex,
 					.cmd = cmd,
 					.globalSet = m_globalSets[frameInfo.frameIndex],
-					.globalHandle = m_globalUbo.handle(frameInfo.frameIndex)
+					.globalHandle = m_globalUbo.handle(frameInfo.frameIndex),
+					.frustum = frustum
 				};
 
 				for (const auto& system : m_renderSystems)
@@ -176,12 +178,13 @@ export namespace Aegis::Graphics
 				.build();
 		}
 
-		void updateUBO(const FrameInfo& frameInfo)
+		/// @return View frustum of the main camera
+		auto updateUBO(const FrameInfo& frameInfo) -> Frustum
 		{
 			auto& registry = frameInfo.scene.registry();
 			Scene::Entity mainCamera = frameInfo.scene.mainCamera();
 			if (!mainCamera)
-				return;
+				return Frustum{};
 
 			// TODO: Don't update this here (move to renderer or similar)
 			auto& camera = registry.get<Camera>(mainCamera);
@@ -196,6 +199,7 @@ export namespace Aegis::Graphics
 			};
 
 			m_globalUbo.buffer().writeToIndex(&ubo, frameInfo.frameIndex);
+			return ubo.frustum;
 		}
 
 		FGResourceHandle m_position;
@@ -10,6 +10,8 @@ export module Aegis.Graphics.RenderPasses.GPUDrivenGeometry;
 import Aegis.Graphics.FrameGraph.RenderPass;
 import Aegis.Graphics.Bindless;
 import Aegis.Graphics.Descriptors;
+import Aegis.Graphics.GeometryArena;
+import Aegis.Graphics.RenderPasses.CullingPass;
 import Aegis.Graphics.Vulkan.Tools;
 import Aegis.Graphics.Vulkan.ResourceTools;
 
@@ -24,55 +26,41 @@ export namespace Aegis::Graphics
 			Bindless::DescriptorHandle staticInstances;
 			Bindless::DescriptorHandle dynamicInstances;
 			Bindless::DescriptorHandle visibility;
+			Bindless::DescriptorHandle depthPyramid;
 			uint32_t batchFirstID;
 			uint32_t batchSize;
 			uint32_t staticCount;
 			uint32_t dynamicCount;
+			uint32_t occlusionCulling;
+			Bindless::DescriptorHandle materials;
+			Bindless::DescriptorHandle meshes;
+			uint32_t doubleSided;
 		};
 
-		GPUDrivenGeometry(FGResourcePool& pool)
+		/// @brief The early phase clears the G-Buffer, the late phase draws on top of it (see CullingPhase)
+		/// @note In indexed draw mode the triangles are already culled and compacted by the TriangleCullingPass, the
+		///       overflow draws of the CullingPass are drawn unculled from the geometry arena
+		GPUDrivenGeometry(FGResourcePool& pool, CullingPhase phase = CullingPhase::Early,
+			IndirectDrawMode drawMode = IndirectDrawMode::MeshTasks)
+			: m_phase{ phase }, m_drawMode{ drawMode }
 		{
-			m_position = pool.addImage("Position",
-				FGResource::Usage::ColorAttachment,
-				FGTextureInfo{
-					.format = VK_FORMAT_R16G16B16A16_SFLOAT,
-					.resizeMode = FGResizeMode::SwapChainRelative
-				});
-
-			m_normal = pool.addImage("Normal",
-				FGResource::Usage::ColorAttachment,
-				FGTextureInfo{
-					.format = VK_FORMAT_R16G16B16A16_SFLOAT,
-					.resizeMode = FGResizeMode::SwapChainRelative
-				});
-
-			m_albedo = pool.addImage("Albedo",
-				FGResource::Usage::ColorAttachment,
-				FGTextureInfo{
-					.format = VK_FORMAT_R8G8B8A8_UNORM,
-					.resizeMode = FGResizeMode::SwapChainRelative
-				});
-
-			m_arm = pool.addImage("ARM",
-				FGResource::Usage::ColorAttachment,
-				FGTextureInfo{
-					.format = VK_FORMAT_R8G8B8A8_UNORM,
-					.resizeMode = FGResizeMode::SwapChainRelative
-				});
-
-			m_emissive = pool.addImage("Emissive",
-				FGResource::Usage::ColorAttachment,
-				FGTextureInfo{
-					.format = VK_FORMAT_R8G8B8A8_UNORM,
-					.resizeMode = FGResizeMode::SwapChainRelative
-				});
-
-			m_depth = pool.addImage("Depth",
-				FGResource::Usage::DepthStencilAttachment,
-				FGTextureInfo{
-					.format = VK_FORMAT_D32_SFLOAT,
-					.resizeMode = FGResizeMode::SwapChainRelative
-				});
+			auto attachment = [&pool, phase](const char* name, FGResource::Usage usage, VkFormat format) {
+				if (phase == CullingPhase::Late)
+					return pool.addReference(name, usage);
+
+				return pool.addImage(name, usage,
+					FGTextureInfo{
+						.format = format,
+						.resizeMode = FGResizeMode::SwapChainRelative
+					});
+				};
+
+			m_position = attachment("Position", FGResource::Usage::ColorAttachment, VK_FORMAT_R16G16B16A16_SFLOAT);
+			m_normal = attachment("Normal", FGResource::Usage::ColorAttachment, VK_FORMAT_R16G16B16A16_SFLOAT);
+			m_albedo = attachment("Albedo", FGResource::Usage::ColorAttachment, VK_FORMAT_R8G8B8A8_UNORM);
+			m_arm = attachment("ARM", FGResource::Usage::ColorAttachment, VK_FORMAT_R8G8B8A8_UNORM);
+			m_emissive = attachment("Emissive", FGResource::Usage::ColorAttachment, VK_FORMAT_R8G8B8A8_UNORM);
+			m_depth = attachment("Depth", FGResource::Usage::DepthStencilAttachment, VK_FORMAT_D32_SFLOAT);
 
 			m_visibleInstances = pool.addReference("VisibleInstances",
 				FGResource::Usage::ComputeReadStorage);
@@ -94,16 +82,37 @@ export namespace Aegis::Graphics
 
 			m_cameraData = pool.addReference("CameraData",
 				FGResource::Usage::ComputeReadUniform);
+
+			if (m_drawMode == IndirectDrawMode::Indexed)
+			{
+				m_compactedIndices = pool.addReference("CompactedIndices",
+					FGResource::Usage::IndexBuffer);
+
+				m_overflowDrawCommands = pool.addReference("OverflowDrawCommands",
+					FGResource::Usage::IndirectBuffer);
+			}
+			// Meshlets are occlusion culled in the task shader
+			else if (m_phase == CullingPhase::Late)
+			{
+				m_depthPyramid = pool.addReference("DepthPyramid",
+					FGResource::Usage::TaskReadSampled);
+			}
 		}
 
 		virtual auto info() -> Info override
 		{
-			return Info{
-				.name = "GPU Driven Geometry",
+			Info info{
+				.name = m_phase == CullingPhase::Late ? "GPU Driven Geometry (Late)" : "GPU Driven Geometry (Early)",
 				.reads = { m_staticInstanceData, m_dynamicInstanceData, m_visibleInstances,
 					m_indirectDrawCommands, m_indirectDrawCounts, m_cameraData },
 				.writes = { m_position, m_normal, m_albedo, m_arm, m_emissive, m_depth }
 			};
+			if (m_depthPyramid.isValid())
+				info.reads.emplace_back(m_depthPyramid);
+			if (m_compactedIndices.isValid())
+				info.reads.insert(info.reads.end(), { m_compactedIndices, m_overflowDrawCommands });
+
+			return info;
 		}
 
 		virtual void execute(FGResourcePool& pool, const FrameInfo& frameInfo) override
@@ -113,14 +122,15 @@ export namespace Aegis::Graphics
 				.extent = frameInfo.swapChainExtent
 			};
 
+			auto loadOp = m_phase == CullingPhase::Late ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
 			auto colorAttachments = std::array{
-				Tools::renderingAttachmentInfo(pool.texture(m_position), VK_ATTACHMENT_LOAD_OP_CLEAR),
-				Tools::renderingAttachmentInfo(pool.texture(m_normal), VK_ATTACHMENT_LOAD_OP_CLEAR),
-				Tools::renderingAttachmentInfo(pool.texture(m_albedo), VK_ATTACHMENT_LOAD_OP_CLEAR),
-				Tools::renderingAttachmentInfo(pool.texture(m_arm), VK_ATTACHMENT_LOAD_OP_CLEAR),
-				Tools::renderingAttachmentInfo(pool.texture(m_emissive), VK_ATTACHMENT_LOAD_OP_CLEAR)
+				Tools::renderingAttachmentInfo(pool.texture(m_position), loadOp),
+				Tools::renderingAttachmentInfo(pool.texture(m_normal), loadOp),
+				Tools::renderingAttachmentInfo(pool.texture(m_albedo), loadOp),
+				Tools::renderingAttachmentInfo(pool.texture(m_arm), loadOp),
+				Tools::renderingAttachmentInfo(pool.texture(m_emissive), loadOp)
 			};
-			auto depthAttachment = Tools::renderingAttachmentInfo(pool.texture(m_depth), VK_ATTACHMENT_LOAD_OP_CLEAR, { 1.0f, 0 });
+			auto depthAttachment = Tools::renderingAttachmentInfo(pool.texture(m_depth), loadOp, { 1.0f, 0 });
 
 			VkRenderingInfo renderInfo{
 				.sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
@@ -142,6 +152,10 @@ export namespace Aegis::Graphics
 				auto& visibleInstances = pool.buffer(m_visibleInstances);
 				auto& indirectDrawCommands = pool.buffer(m_indirectDrawCommands);
 				auto& indirectDrawCounts = pool.buffer(m_indirectDrawCounts);
+				auto depthPyramid = m_depthPyramid.isValid()
+					? pool.texture(m_depthPyramid).sampledDescriptorHandle()
+					: Bindless::DescriptorHandle{};
+
 				for (const auto& batch : frameInfo.drawBatcher.batches())
 				{
 					PushConstant pushConstants{
@@ -149,16 +163,47 @@ export namespace Aegis::Graphics
 						.staticInstances = staticInstanceData.handle(),
 						.dynamicInstances = dynamicInstanceData.handle(frameInfo.frameIndex),
 						.visibility = visibleInstances.handle(),
+						.depthPyramid = depthPyramid,
 						.batchFirstID = batch.firstInstance,
 						.batchSize = batch.instanceCount,
-						.staticCount = frameInfo.drawBatcher.staticInstanceCount(),
-						.dynamicCount = frameInfo.drawBatcher.dynamicInstanceCount()
+						.staticCount = frameInfo.drawBatcher.staticSlotCount(),
+						.dynamicCount = frameInfo.drawBatcher.dynamicSlotCount(),
+						.occlusionCulling = depthPyramid.isValid() ? 1u : 0u,
+						.materials = batch.materialTemplate->materialTable().handle(),
+						.meshes = GeometryArena::instance().meshDataHandle(),
+						.doubleSided = batch.materialTemplate->isDoubleSided() ? 1u : 0u,
 					};
 					AGX_ASSERT_X(pushConstants.cameraData.isValid(), "GPU Driven Geometry Pass: Invalid camera data handle in push constants");
 					batch.materialTemplate->bind(frameInfo.cmd);
 					batch.materialTemplate->bindBindlessSet(frameInfo.cmd);
 					batch.materialTemplate->pushConstants(frameInfo.cmd, &pushConstants, sizeof(PushConstant));
 
+					if (m_drawMode == IndirectDrawMode::Indexed)
+					{
+						// Indices are relative to the mesh, the vertices are pulled in the vertex shader
+						vkCmdBindIndexBuffer(frameInfo.cmd, pool.buffer(m_compactedIndices).buffer(), 0, VK_INDEX_TYPE_UINT32);
+						vkCmdDrawIndexedIndirectCount(frameInfo.cmd,
+							indirectDrawCommands.buffer(),
+							sizeof(VkDrawIndexedIndirectCommand) * batch.firstInstance,
+							indirectDrawCounts.buffer(),
+							sizeof(uint32_t) * batch.batchID,
+							batch.instanceCount,
+							sizeof(VkDrawIndexedIndirectCommand)
+						);
+
+						// Instances exceeding the visible triangle budget of the CullingPass (counts follow the draw counts)
+						GeometryArena::instance().bindBuffers(frameInfo.cmd);
+						vkCmdDrawIndexedIndirectCount(frameInfo.cmd,
+							pool.buffer(m_overflowDrawCommands).buffer(),
+							sizeof(VkDrawIndexedIndirectCommand) * batch.firstInstance,
+							indirectDrawCounts.buffer(),
+							sizeof(uint32_t) * (frameInfo.drawBatcher.batchCount() + batch.batchID),
+							batch.instanceCount,
+							sizeof(VkDrawIndexedIndirectCommand)
+						);
+						continue;
+					}
+
 					vkCmdDrawMeshTasksIndirectCountEXT(frameInfo.cmd,
 						indirectDrawCommands.buffer(),
 						sizeof(VkDrawMeshTasksIndirectCommandEXT) * batch.firstInstance,
@@ -173,6 +218,8 @@ export namespace Aegis::Graphics
 		}
 
 	private:
+		CullingPhase m_phase;
+		IndirectDrawMode m_drawMode;
 		FGResourceHandle m_position;
 		FGResourceHandle m_normal;
 		FGResourceHandle m_albedo;
@@ -186,5 +233,8 @@ export namespace Aegis::Graphics
 		FGResourceHandle m_indirectDrawCommands;
 		FGResourceHandle m_indirectDrawCounts;
 		FGResourceHandle m_cameraData;
+		FGResourceHandle m_depthPyramid;
+		FGResourceHandle m_compactedIndices;
+		FGResourceHandle m_overflowDrawCommands;
 	};
 }
\ No newline at end of file
@@ -15,6 +15,7 @@ import Aegis.Math;
 import Aegis.Core.Globals;
 import Aegis.Graphics.FrameGraph.RenderPass;
 import Aegis.Graphics.Pipeline;
+import Aegis.Graphics.PipelineVariantCache;
 import Aegis.Graphics.Descriptors;
 import Aegis.Graphics.Globals;
 import Aegis.Graphics.Vulkan.Tools;
@@ -60,9 +61,11 @@ export namespace Aegis::Graphics
 		std::array<PointLight, MAX_POINT_LIGHTS> pointLights{};
 		int32_t pointLightCount{ 0 };
 		float ambientOcclusionFactor{ 0.5f };
-		LightingViewMode viewMode{ LightingViewMode::SceneColor };
 	};
 
+	/// @note The view mode and whether there are any point lights are specialization constants, the scene color
+	///       pipeline does not evaluate debug views and skips the point light loop in scenes without point lights.
+	///       Variants compile in the background, the previous one is used until the requested one is ready.
 	class LightingPass : public FGRenderPass
 	{
 	public:
@@ -79,11 +82,9 @@ export namespace Aegis::Graphics
 				m_iblSets.emplace_back(m_iblSetLayout);
 			}
 
-			m_pipeline = Pipeline::ComputeBuilder{}
-				.addDescriptorSetLayout(m_gbufferSetLayout)
-				.addDescriptorSetLayout(m_iblSetLayout)
-				.setShaderStage(Core::SHADER_DIR / "pbr_lighting.slang.spv", "computeMain")
-				.buildUnique();
+			// Start compiling the variants a scene is most likely to use
+			pipelineVariant(LightingViewMode::SceneColor, true);
+			pipelineVariant(LightingViewMode::SceneColor, false);
 
 			m_position = pool.addReference("Position",
 				FGResource::Usage::ComputeReadStorage);
@@ -124,7 +125,7 @@ export namespace Aegis::Graphics
 		{
 			VkCommandBuffer cmd = frameInfo.cmd;
 
-			updateLightingUBO(frameInfo);
+			int32_t pointLightCount = updateLightingUBO(frameInfo);
 			auto& registry = frameInfo.scene.registry();
 			auto& environment = registry.get<Environment>(frameInfo.scene.environment());
 			AGX_ASSERT_X(environment.irradiance, "Environment irradiance map is not set");
@@ -146,9 +147,15 @@ export namespace Aegis::Graphics
 				.writeImage(2, environment.brdfLUT->descriptorImageInfo())
 				.update(m_iblSets[frameInfo.frameIndex]);
 
-			m_pipeline->bind(cmd);
-			m_pipeline->bindDescriptorSet(cmd, 0, m_gbufferSets[frameInfo.frameIndex]);
-			m_pipeline->bindDescriptorSet(cmd, 1, m_iblSets[frameInfo.frameIndex]);
+			// Keep drawing with the last variant until a newly requested one has finished compiling
+			auto& variant = pipelineVariant(m_viewMode, pointLightCount > 0);
+			if (!m_activePipeline || variant.isReady())
+				m_activePipeline = &variant.get();
+
+			auto& pipeline = *m_activePipeline;
+			pipeline.bind(cmd);
+			pipeline.bindDescriptorSet(cmd, 0, m_gbufferSets[frameInfo.frameIndex]);
+			pipeline.bindDescriptorSet(cmd, 1, m_iblSets[frameInfo.frameIndex]);
 
 			Tools::vk::cmdDispatch(cmd, frameInfo.swapChainExtent, { 16, 16 });
 		}
@@ -190,7 +197,18 @@ export namespace Aegis::Graphics
 				.build();
 		}
 
-		void updateLightingUBO(const FrameInfo& frameInfo)
+		auto pipelineVariant(LightingViewMode viewMode, bool pointLights) -> Pipeline::Future&
+		{
+			return m_pipelines.get(Pipeline::ComputeBuilder{}
+				.addDescriptorSetLayout(m_gbufferSetLayout)
+				.addDescriptorSetLayout(m_iblSetLayout)
+				.setShaderStage(Core::SHADER_DIR / "pbr_lighting.slang.spv", "computeMain")
+				.addSpecializationConstant(0, viewMode)
+				.addSpecializationConstant(1, pointLights));
+		}
+
+		/// @brief Returns the number of point lights written to the UBO
+		auto updateLightingUBO(const FrameInfo& frameInfo) -> int32_t
 		{
 			auto& registry = frameInfo.scene.registry();
 			LightingUniforms lighting;
@@ -232,9 +250,9 @@ export namespace Aegis::Graphics
 			lighting.pointLightCount = lighIndex;
 
 			lighting.ambientOcclusionFactor = m_ambientOcclusionFactor;
-			lighting.viewMode = m_viewMode;
 
 			m_ubo.writeToIndex(&lighting, frameInfo.frameIndex);
+			return lighting.pointLightCount;
 		}
 
 		FGResourceHandle m_sceneColor;
@@ -248,10 +266,10 @@ export namespace Aegis::Graphics
 		LightingViewMode m_viewMode{ LightingViewMode::SceneColor };
 		float m_ambientOcclusionFactor{ 1.0f };
 
-		std::unique_ptr<Pipeline> m_pipeline;
-
 		DescriptorSetLayout m_gbufferSetLayout;
 		DescriptorSetLayout m_iblSetLayout;
+		PipelineVariantCache m_pipelines;
+		Pipeline* m_activePipeline{ nullptr };
 		std::vector<DescriptorSet> m_gbufferSets;
 		std::vector<DescriptorSet> m_iblSets;
 		Buffer m_ubo;
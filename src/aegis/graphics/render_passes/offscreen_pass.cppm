@@ -0,0 +1,50 @@
+module;
+
+#include "core/assert.h"
+#include "graphics/vulkan/vulkan_include.h"
+
+export module Aegis.Graphics.RenderPasses.OffscreenPass;
+
+import Aegis.Graphics.FrameGraph.RenderPass;
+import Aegis.Graphics.OffscreenTarget;
+
+export namespace Aegis::Graphics
+{
+	/// @brief Final pass of the headless renderer, copies the final image back to the host if readback is enabled
+	class OffscreenPass : public FGRenderPass
+	{
+	public:
+		OffscreenPass(FGResourcePool& pool, OffscreenTarget& target)
+			: m_target{ target }
+		{
+			m_final = pool.addReference("Final",
+				FGResource::Usage::TransferSrc);
+		}
+
+		virtual auto info() -> Info override
+		{
+			return Info{
+				.name = "Offscreen",
+				.reads = { m_final },
+				.writes = {}
+			};
+		}
+
+		virtual void execute(FGResourcePool& pool, const FrameInfo& frameInfo) override
+		{
+			if (!m_target.isReadbackEnabled())
+				return;
+
+			auto& srcTexture = pool.texture(m_final);
+			AGX_ASSERT_X(m_target.width() == srcTexture.image().width(), "Offscreen extent does not match source texture extent");
+			AGX_ASSERT_X(m_target.height() == srcTexture.image().height(), "Offscreen extent does not match source texture extent");
+			AGX_ASSERT_X(srcTexture.image().format() == OffscreenTarget::FORMAT, "Final image format does not match readback format");
+
+			m_target.recordReadback(frameInfo.cmd, srcTexture.image(), frameInfo.frameIndex);
+		}
+
+	private:
+		OffscreenTarget& m_target;
+		FGResourceHandle m_final;
+	};
+}
@@ -14,6 +14,7 @@ import Aegis.Core.Globals;
 import Aegis.Graphics.Descriptors;
 import Aegis.Graphics.FrameGraph.RenderPass;
 import Aegis.Graphics.Pipeline;
+import Aegis.Graphics.PipelineVariantCache;
 import Aegis.Graphics.Vulkan.Tools;
 import Aegis.Graphics.Globals;
 
@@ -34,13 +35,16 @@ export namespace Aegis::Graphics
 		float gamma = 2.2f;
 	};
 
+	/// @note The tone mapping mode and whether bloom is applied are specialization constants, the remaining
+	///       settings are push constants so dragging a slider does not compile a new pipeline
 	class PostProcessingPass : public FGRenderPass
 	{
 	public:
 		PostProcessingPass(FGResourcePool& pool) :
-			m_descriptorSetLayout{ createDescriptorSetLayout() },
-			m_pipeline{ createPipeline() }
+			m_descriptorSetLayout{ createDescriptorSetLayout() }
 		{
+			pipelineVariant(m_settings.toneMappingMode, m_settings.bloomIntensity > 0.0f);
+
 			m_descriptorSets.reserve(MAX_FRAMES_IN_FLIGHT);
 			for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
 			{
@@ -81,9 +85,16 @@ export namespace Aegis::Graphics
 
 			VkCommandBuffer cmd = frameInfo.cmd;
 
-			m_pipeline.bind(cmd);
-			m_pipeline.bindDescriptorSet(cmd, 0, m_descriptorSets[frameInfo.frameIndex]);
-			m_pipeline.pushConstants(cmd, VK_SHADER_STAGE_COMPUTE_BIT, m_settings);
+			PushConstants push{
+				.bloomIntensity = m_settings.bloomIntensity,
+				.exposure = m_settings.exposure,
+				.gamma = m_settings.gamma,
+			};
+
+			auto& pipeline = pipelineVariant(m_settings.toneMappingMode, m_settings.bloomIntensity > 0.0f).get();
+			pipeline.bind(cmd);
+			pipeline.bindDescriptorSet(cmd, 0, m_descriptorSets[frameInfo.frameIndex]);
+			pipeline.pushConstants(cmd, VK_SHADER_STAGE_COMPUTE_BIT, push);
 
 			Tools::vk::cmdDispatch(cmd, frameInfo.swapChainExtent, { 16, 16 });
 		}
@@ -103,6 +114,13 @@ export namespace Aegis::Graphics
 		}
 
 	private:
+		struct PushConstants
+		{
+			float bloomIntensity;
+			float exposure;
+			float gamma;
+		};
+
 		auto createDescriptorSetLayout() -> DescriptorSetLayout
 		{
 			return DescriptorSetLayout::Builder{}
@@ -112,13 +130,14 @@ export namespace Aegis::Graphics
 				.build();
 		}
 
-		auto createPipeline() -> Pipeline
+		auto pipelineVariant(ToneMappingMode toneMappingMode, bool bloom) -> Pipeline::Future&
 		{
-			return Pipeline::ComputeBuilder{}
+			return m_pipelines.get(Pipeline::ComputeBuilder{}
 				.addDescriptorSetLayout(m_descriptorSetLayout)
-				.addPushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PostProcessingSettings))
+				.addPushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstants))
 				.setShaderStage(Core::SHADER_DIR / "post_process.slang.spv")
-				.build();
+				.addSpecializationConstant(0, toneMappingMode)
+				.addSpecializationConstant(1, bloom));
 		}
 
 		FGResourceHandle m_sceneColor;
@@ -129,6 +148,6 @@ export namespace Aegis::Graphics
 
 		DescriptorSetLayout m_descriptorSetLayout;
 		std::vector<DescriptorSet> m_descriptorSets;
-		Pipeline m_pipeline;
+		PipelineVariantCache m_pipelines;
 	};
 }
\ No newline at end of file
@@ -5,38 +5,85 @@ module;
 
 #include <aegis-log/log.h>
 
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 
 export module Aegis.Graphics.RenderPasses.SceneUpdatePass;
 
 import Aegis.Math;
+import Aegis.Core.Globals;
 import Aegis.Graphics.Bindless;
+import Aegis.Graphics.Buffer;
 import Aegis.Graphics.FrameGraph.RenderPass;
 import Aegis.Graphics.Frustum;
 import Aegis.Graphics.Components;
 import Aegis.Graphics.Globals;
 import Aegis.Graphics.DrawBatchRegistry;
+import Aegis.Graphics.InstanceSlotAllocator;
+import Aegis.Graphics.MaterialInstance;
+import Aegis.Graphics.Pipeline;
+import Aegis.Graphics.Vulkan.Tools;
 import Aegis.Graphics.Vulkan.VulkanMemory;
+import Aegis.Graphics.VulkanContext;
 import Aegis.Scene;
 
 export namespace Aegis::Graphics
 {
-	// TODO: Maybe use SoA for better cache use (instead of packed AoS)
+	/// @brief Marks unused slots in the instance buffers (skipped by the culling shader)
+	constexpr uint32_t INVALID_DRAW_BATCH_ID = std::numeric_limits<uint16_t>::max();
+
+	/// @brief Compact per instance data (32 bytes), model and normal matrix are reconstructed on the GPU
+	/// @note This has to match the indirectDraw::Instance struct on the slang side
+	/// @see shaders/modules/indirect_draw.slang
 	struct alignas(16) InstanceData
 	{
-		glm::mat3x4 modelMatrix;
-		glm::vec3 normalRow0;
-		Bindless::DescriptorHandle meshHandle;
-		glm::vec3 normalRow1;
-		Bindless::DescriptorHandle materialHandle;
-		glm::vec3 normalRow2;
-		uint32_t drawBatchID;
+		glm::vec3 location;
+		uint32_t rotation;			// Math::packQuaternion
+		uint32_t scaleXY;			// 2 x half
+		uint32_t scaleZDrawBatch;	// half | 16 bit draw batch ID
+		uint32_t meshIndex;			// MeshData record in the geometry arena
+		uint32_t materialIndex;		// Record in the material table of the draw batch template
+
+		static auto create(const GlobalTransform& transform, uint32_t meshIndex,
+			uint32_t materialIndex, uint32_t drawBatchID) -> InstanceData
+		{
+			AGX_ASSERT_X(drawBatchID < INVALID_DRAW_BATCH_ID, "Draw batch ID does not fit into 16 bits");
+			return InstanceData{
+				.location = transform.location,
+				.rotation = Math::packQuaternion(transform.rotation),
+				.scaleXY = glm::packHalf2x16(glm::vec2{ transform.scale.x, transform.scale.y }),
+				.scaleZDrawBatch = glm::packHalf1x16(transform.scale.z) | (drawBatchID << 16),
+				.meshIndex = meshIndex,
+				.materialIndex = materialIndex,
+			};
+		}
+
+		static auto invalid() -> InstanceData
+		{
+			return InstanceData{ .scaleZDrawBatch = INVALID_DRAW_BATCH_ID << 16 };
+		}
 	};
+	static_assert(sizeof(InstanceData) == 32, "Shader expects InstanceData to be 32 bytes");
 
+	/// @brief Instance data written to a slot of an instance buffer by the scatter shader
+	struct alignas(16) InstanceUpdate
+	{
+		uint32_t slot;
+		InstanceData instance;
+	};
+
+	/// @note Has to match indirectDraw::DrawBatch in indirect_draw.slang
 	struct DrawBatchData
 	{
+		static constexpr uint32_t DOUBLE_SIDED = 1 << 0;
+
 		uint32_t instanceOffset;
 		uint32_t instanceCount;
+		uint32_t flags;
 	};
 
 	struct CameraData
@@ -48,38 +95,64 @@ export namespace Aegis::Graphics
 		glm::vec3 cameraPosition;
 	};
 
+	/// @brief Keeps the GPU instance buffers in sync with the scene
+	/// @note Every instance owns a persistent slot in the static or dynamic instance buffer. Only slots whose transform,
+	///       mesh or material changed are uploaded each frame and scattered into the buffers by a compute shader.
+	///       Entities can move between the static and dynamic buffer at runtime, holes left behind are compacted over time.
 	class SceneUpdatePass : public FGRenderPass
 	{
 	public:
-		static constexpr std::size_t MAX_STATIC_INSTANCES = 1'000'000;
-		static constexpr std::size_t MAX_DYNAMIC_INSTANCES = 10'000;
+		static constexpr uint32_t MIN_INSTANCE_CAPACITY = 1024;
+		static constexpr uint32_t INITIAL_UPDATE_CAPACITY = 1024;
+		static constexpr uint32_t MIN_DRAW_BATCH_CAPACITY = 64;
+		static constexpr uint32_t WORKGROUP_SIZE = 64;
+
+		/// @brief Compaction starts once this ratio of slots in the used range is free
+		static constexpr float COMPACTION_THRESHOLD = 0.25f;
+		static constexpr uint32_t MAX_COMPACTION_MOVES_PER_FRAME = 256;
+
+		struct ScatterPushConstants
+		{
+			Bindless::DescriptorHandle updates;
+			Bindless::DescriptorHandle instances;
+			uint32_t firstUpdate;
+			uint32_t updateCount;
+		};
 
-		SceneUpdatePass(FGResourcePool& pool)
+		SceneUpdatePass(FGResourcePool& pool, DrawBatchRegistry& batcher)
 		{
+			m_scatterPipeline = Pipeline::ComputeBuilder{}
+				.addDescriptorSetLayout(Bindless::BindlessDescriptorSet::instance().layout())
+				.addPushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(ScatterPushConstants))
+				.setShaderStage(Core::SHADER_DIR / "gpu-driven/instance_scatter.slang.spv")
+				.buildAsync();
+
+			createUpdateBuffer(INITIAL_UPDATE_CAPACITY);
+
+			// Instance buffers are device local and sized for the current scene, they grow when instances are added
+			// (transfer usage is needed to keep the content when growing)
 			m_staticInstances = pool.addBuffer("StaticInstanceData",
-				FGResource::Usage::TransferDst,
+				FGResource::Usage::ComputeWriteStorage,
 				FGBufferInfo{
-					.size = sizeof(InstanceData) * MAX_STATIC_INSTANCES,
-					.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-					// TODO: Remove the host visible flag and use staging buffer for upload instead
-					.allocFlags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
-								  VMA_ALLOCATION_CREATE_MAPPED_BIT,
+					.size = instanceBufferSize(batcher.staticInstanceCount()),
+					.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+							 VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 				});
 
 			m_dynamicInstances = pool.addBuffer("DynamicInstanceData",
-				FGResource::Usage::TransferDst,
+				FGResource::Usage::ComputeWriteStorage,
 				FGBufferInfo{
-					.size = sizeof(InstanceData) * MAX_DYNAMIC_INSTANCES,
+					.size = instanceBufferSize(batcher.dynamicInstanceCount()),
 					.instanceCount = MAX_FRAMES_IN_FLIGHT,
-					.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-					.allocFlags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
-								  VMA_ALLOCATION_CREATE_MAPPED_BIT,
+					.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+							 VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 				});
 
+			// Grows with the number of batches (rewritten every frame)
 			m_drawBatchBuffer = pool.addBuffer("DrawBatches",
 				FGResource::Usage::TransferDst,
 				FGBufferInfo{
-					.size = sizeof(DrawBatchData) * DrawBatchRegistry::MAX_DRAW_BATCHES,
+					.size = sizeof(DrawBatchData) * std::max(batcher.batchCount(), MIN_DRAW_BATCH_CAPACITY),
 					.instanceCount = MAX_FRAMES_IN_FLIGHT,
 					.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
 					.allocFlags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
@@ -108,105 +181,364 @@ export namespace Aegis::Graphics
 
 		virtual void sceneInitialized(FGResourcePool& resources, Scene::Scene& scene) override
 		{
+			// Only limited by the maximum range a single storage buffer descriptor can cover
+			uint32_t maxInstances = VulkanContext::device().properties().limits.maxStorageBufferRange / sizeof(InstanceData);
+			m_static = InstanceSet{ .allocator = InstanceSlotAllocator{ maxInstances }, .bufferCount = 1 };
+			m_dynamic = InstanceSet{ .allocator = InstanceSlotAllocator{ maxInstances }, .bufferCount = MAX_FRAMES_IN_FLIGHT };
+			m_slotLookup.clear();
+
+			auto& registry = scene.registry();
+
+			// Initial static instances are uploaded in one go (instead of scattering the whole buffer)
 			std::vector<InstanceData> staticInstances;
-			staticInstances.reserve(MAX_STATIC_INSTANCES); // TODO: use draw batcher for actual count
+			staticInstances.reserve(registry.view<Mesh>().size());
 
-			uint32_t instanceID = 0;
-			auto view = scene.registry().view<GlobalTransform, Mesh, Material>(entt::exclude<DynamicTag>);
-			for (const auto& [entity, transform, mesh, material] : view.each())
+			auto view = registry.view<GlobalTransform, Mesh, Material>(entt::exclude<DynamicTag>);
+			for (auto entity : view)
 			{
-				if (instanceID >= MAX_STATIC_INSTANCES)
-				{
-					ALOG::warn("Instance Update: Reached maximum static instance count of {}", MAX_STATIC_INSTANCES);
-					break;
-				}
-
-				if (!mesh.staticMesh || !material.instance || !material.instance->materialTemplate())
+				if (instanceType(registry, Scene::Entity{ entity }) != InstanceType::Static)
 					continue;
 
-				const auto& matInstance = material.instance;
-				const auto& matTemplate = matInstance->materialTemplate();
-
-				// Update instance data (if needed)
-				matInstance->updateParameters(0);
+				uint32_t slot = assignSlot(registry, Scene::Entity{ entity }, InstanceType::Static);
+				if (slot == InstanceSlotAllocator::INVALID_SLOT)
+					break;
 
-				// Shader needs both in row major (better packing)
-				glm::mat4 modelMatrix = transform.matrix();
-				glm::mat3 normalMatrix = glm::inverse(modelMatrix);
-				staticInstances.emplace_back(glm::rowMajor4(modelMatrix),
-					normalMatrix[0], mesh.staticMesh->meshDataBuffer().handle(),
-					normalMatrix[1], matInstance->buffer().handle(0),  // TODO: Would normal use frame index but data is static so its fine i guess?
-					normalMatrix[2], matTemplate->drawBatch());
+				m_static.slots[slot].dirty.fill(false);
+				staticInstances.emplace_back(createInstanceData(registry, m_static.slots[slot]));
+			}
+			m_static.dirtySlots[0].clear();
 
-				instanceID++;
+			if (!staticInstances.empty())
+			{
+				resources.growBuffer(m_staticInstances, instanceBufferSize(static_cast<uint32_t>(staticInstances.size())));
+				resources.buffer(m_staticInstances).buffer().upload(staticInstances);
 			}
 
-			// Copy instance data to mapped buffer
-			auto& staticBuffer = resources.buffer(m_staticInstances);
-			staticBuffer.buffer().copy(staticInstances, 0);
+			for (auto entity : registry.view<GlobalTransform, Mesh, Material, DynamicTag>())
+			{
+				refreshSlot(registry, Scene::Entity{ entity });
+			}
 		}
 
 		virtual void execute(FGResourcePool& pool, const FrameInfo& frameInfo) override
 		{
-			updateDynamicInstances(pool, frameInfo);
+			updateInstances(pool, frameInfo);
 			updateDrawBatches(pool, frameInfo);
 			updateCameraData(pool, frameInfo);
 		}
 
+		[[nodiscard]] auto staticSlotAllocator() const -> const InstanceSlotAllocator& { return m_static.allocator; }
+		[[nodiscard]] auto dynamicSlotAllocator() const -> const InstanceSlotAllocator& { return m_dynamic.allocator; }
+
 	private:
-		void updateDynamicInstances(FGResourcePool& pool, const FrameInfo& frameInfo)
+		enum class InstanceType
+		{
+			None,
+			Static,
+			Dynamic
+		};
+
+		struct InstanceSlot
+		{
+			Scene::Entity entity;
+			std::shared_ptr<MaterialInstance> material;
+			std::array<bool, MAX_FRAMES_IN_FLIGHT> dirty{};
+		};
+
+		/// @brief Slots of one instance buffer
+		/// @note The dynamic buffer exists once per frame in flight, so each copy tracks its own dirty slots
+		struct InstanceSet
+		{
+			InstanceSlotAllocator allocator;
+			std::vector<InstanceSlot> slots;
+			std::array<std::vector<uint32_t>, MAX_FRAMES_IN_FLIGHT> dirtySlots;
+			uint32_t bufferCount{ 1 };
+		};
+
+		struct SlotLocation
+		{
+			InstanceType type;
+			uint32_t slot;
+		};
+
+		static auto instanceType(Scene::Registry& registry, Scene::Entity entity) -> InstanceType
+		{
+			if (!registry.isValid(entity) || !registry.has<GlobalTransform, Mesh, Material>(entity))
+				return InstanceType::None;
+
+			const auto& mesh = registry.get<Mesh>(entity);
+			const auto& material = registry.get<Material>(entity);
+			if (!mesh.staticMesh || !material.instance || !material.instance->materialTemplate())
+				return InstanceType::None;
+
+			return registry.has<DynamicTag>(entity) ? InstanceType::Dynamic : InstanceType::Static;
+		}
+
+		static auto createInstanceData(Scene::Registry& registry, const InstanceSlot& slot) -> InstanceData
+		{
+			const auto& transform = registry.get<GlobalTransform>(slot.entity);
+			const auto& mesh = registry.get<Mesh>(slot.entity);
+			return InstanceData::create(transform, mesh.staticMesh->meshIndex(),
+				slot.material->materialIndex(), slot.material->materialTemplate()->drawBatch());
+		}
+
+		static auto instanceBufferSize(uint32_t instanceCount) -> VkDeviceSize
 		{
-			// TODO: Update static instance data on demand (when scene changes)
+			return sizeof(InstanceData) * std::max(instanceCount, MIN_INSTANCE_CAPACITY);
+		}
 
-			std::vector<InstanceData> dynamicInstances;
-			dynamicInstances.reserve(frameInfo.drawBatcher.instanceCount()); // TODO: Differentiate static/dynamic counts
+		/// @brief Grows the instance buffer (at least doubling it) if the slot range does not fit anymore
+		static void reserveInstances(FGResourcePool& pool, VkCommandBuffer cmd, FGResourceHandle handle, uint32_t instanceCount)
+		{
+			VkDeviceSize capacity = pool.buffer(handle).buffer().instanceSize() / sizeof(InstanceData);
+			if (instanceCount <= capacity)
+				return;
+
+			VkDeviceSize maxSize = VulkanContext::device().properties().limits.maxStorageBufferRange;
+			VkDeviceSize size = std::min(std::max(instanceBufferSize(instanceCount), capacity * 2 * sizeof(InstanceData)), maxSize);
+			pool.growBuffer(handle, size, cmd);
+		}
 
-			uint32_t instanceID = 0;
-			auto view = frameInfo.scene.registry().view<GlobalTransform, Mesh, Material, DynamicTag>();
-			for (const auto& [entity, transform, mesh, material] : view.each())
+		auto instanceSet(InstanceType type) -> InstanceSet&
+		{
+			AGX_ASSERT_X(type != InstanceType::None, "Instance Update: Invalid instance type");
+			return type == InstanceType::Static ? m_static : m_dynamic;
+		}
+
+		void updateInstances(FGResourcePool& pool, const FrameInfo& frameInfo)
+		{
+			auto& registry = frameInfo.scene.registry();
+
+			for (auto entity : frameInfo.drawBatcher.instanceChanges())
+			{
+				refreshSlot(registry, entity);
+			}
+
+			// Static instances can still be moved by hierarchy changes (e.g. reparenting), so both sets are rewritten
+			if (registry.allTransformsChanged())
+			{
+				markAllSlotsDirty(m_static);
+				markAllSlotsDirty(m_dynamic);
+			}
+			else
 			{
-				if (instanceID >= MAX_DYNAMIC_INSTANCES)
+				for (auto entity : registry.transformChanges())
 				{
-					ALOG::warn("Instance Update: Reached maximum instance count of {}", MAX_DYNAMIC_INSTANCES);
-					break;
+					auto it = m_slotLookup.find(entity.id());
+					if (it != m_slotLookup.end())
+						markSlotDirty(instanceSet(it->second.type), it->second.slot);
 				}
+			}
+
+			compact(m_static, InstanceType::Static);
+			compact(m_dynamic, InstanceType::Dynamic);
+
+			reserveInstances(pool, frameInfo.cmd, m_staticInstances, m_static.allocator.rangeSize());
+			reserveInstances(pool, frameInfo.cmd, m_dynamicInstances, m_dynamic.allocator.rangeSize());
+
+			// The static buffer exists only once, its changes are written by whichever frame comes first
+			auto& staticDirty = m_static.dirtySlots[0];
+			auto& dynamicDirty = m_dynamic.dirtySlots[frameInfo.frameIndex];
+			std::size_t maxUpdates = staticDirty.size() + dynamicDirty.size();
+			if (maxUpdates > m_updateCapacity)
+				createUpdateBuffer(static_cast<uint32_t>(std::max<std::size_t>(maxUpdates, m_updateCapacity * 2)));
+
+			auto* updates = m_updateBuffer.buffer().data<InstanceUpdate>(frameInfo.frameIndex);
+			uint32_t staticCount = gatherUpdates(registry, m_static, 0, updates);
+			uint32_t dynamicCount = gatherUpdates(registry, m_dynamic, frameInfo.frameIndex, updates + staticCount);
 
-				if (!mesh.staticMesh || !material.instance || !material.instance->materialTemplate())
+			if (staticCount > 0 || dynamicCount > 0)
+			{
+				m_scatterPipeline->bind(frameInfo.cmd);
+				m_scatterPipeline->bindDescriptorSet(frameInfo.cmd, 0, Bindless::BindlessDescriptorSet::instance());
+				scatter(frameInfo, pool.buffer(m_staticInstances).handle(), 0, staticCount);
+				scatter(frameInfo, pool.buffer(m_dynamicInstances).handle(frameInfo.frameIndex), staticCount, dynamicCount);
+			}
+
+			frameInfo.drawBatcher.setSlotCounts(m_static.allocator.rangeSize(), m_dynamic.allocator.rangeSize());
+		}
+
+		/// @brief Writes the data of all dirty slots of the buffer copy to the update buffer
+		/// @return Number of written updates
+		auto gatherUpdates(Scene::Registry& registry, InstanceSet& set, uint32_t frameIndex, InstanceUpdate* updates) -> uint32_t
+		{
+			auto& dirtySlots = set.dirtySlots[frameIndex];
+			uint32_t updateCount = 0;
+			for (uint32_t slot : dirtySlots)
+			{
+				// Slots might be listed twice after being reassigned
+				auto& instanceSlot = set.slots[slot];
+				if (!instanceSlot.dirty[frameIndex])
+					continue;
+
+				instanceSlot.dirty[frameIndex] = false;
+
+				// Trimmed slots are never read by the GPU
+				if (slot >= set.allocator.rangeSize())
 					continue;
 
-				const auto& matInstance = material.instance;
-				const auto& matTemplate = matInstance->materialTemplate();
+				InstanceData data = InstanceData::invalid();
+				if (set.allocator.isUsed(slot))
+					data = createInstanceData(registry, instanceSlot);
+
+				updates[updateCount++] = InstanceUpdate{ .slot = slot, .instance = data };
+			}
+			dirtySlots.clear();
+			return updateCount;
+		}
+
+		void scatter(const FrameInfo& frameInfo, Bindless::DescriptorHandle instances, uint32_t firstUpdate, uint32_t updateCount)
+		{
+			if (updateCount == 0)
+				return;
+
+			ScatterPushConstants push{
+				.updates = m_updateBuffer.handle(frameInfo.frameIndex),
+				.instances = instances,
+				.firstUpdate = firstUpdate,
+				.updateCount = updateCount,
+			};
+			m_scatterPipeline->pushConstants(frameInfo.cmd, VK_SHADER_STAGE_COMPUTE_BIT, push);
 
-				// Update instance data (if needed)
-				matInstance->updateParameters(frameInfo.frameIndex);
+			Tools::vk::cmdDispatch(frameInfo.cmd, updateCount, WORKGROUP_SIZE);
+		}
 
-				// Shader needs both in row major (better packing)
-				glm::mat4 modelMatrix = transform.matrix();
-				glm::mat3 normalMatrix = glm::inverse(modelMatrix);
+		/// @brief Allocates, moves or releases the slot of an entity depending on its current components
+		void refreshSlot(Scene::Registry& registry, Scene::Entity entity)
+		{
+			auto type = instanceType(registry, entity);
+
+			auto it = m_slotLookup.find(entity.id());
+			if (it != m_slotLookup.end() && it->second.type != type)
+			{
+				// Removed or migrated between the static and dynamic buffer
+				releaseSlot(it->second);
+				m_slotLookup.erase(it);
+				it = m_slotLookup.end();
+			}
 
-				dynamicInstances.emplace_back(glm::rowMajor4(modelMatrix),
-					normalMatrix[0], mesh.staticMesh->meshDataBuffer().handle(),
-					normalMatrix[1], matInstance->buffer().handle(frameInfo.frameIndex),
-					normalMatrix[2], matTemplate->drawBatch());
+			if (type == InstanceType::None)
+				return;
 
-				instanceID++;
+			if (it == m_slotLookup.end())
+			{
+				assignSlot(registry, entity, type);
+				return;
 			}
 
-			// Copy instance data to mapped buffer
-			auto& instanceBuffer = pool.buffer(m_dynamicInstances);
-			instanceBuffer.buffer().copy(dynamicInstances, frameInfo.frameIndex);
+			auto& set = instanceSet(type);
+			auto& instanceSlot = set.slots[it->second.slot];
+			instanceSlot.material = registry.get<Material>(entity).instance;
+			markSlotDirty(set, it->second.slot);
 		}
 
-		void updateDrawBatches(FGResourcePool& pool, const FrameInfo& frameInfo)
+		auto assignSlot(Scene::Registry& registry, Scene::Entity entity, InstanceType type) -> uint32_t
+		{
+			auto& set = instanceSet(type);
+			uint32_t slot = set.allocator.allocate();
+			if (slot == InstanceSlotAllocator::INVALID_SLOT)
+			{
+				ALOG::warn("Instance Update: Reached maximum {} instance count of {}",
+					type == InstanceType::Static ? "static" : "dynamic", set.allocator.capacity());
+				return slot;
+			}
+
+			if (slot >= set.slots.size())
+				set.slots.resize(slot + 1);
+
+			// Keep the dirty flags, the slot might still be waiting for its invalidation upload
+			auto& instanceSlot = set.slots[slot];
+			instanceSlot.entity = entity;
+			instanceSlot.material = registry.get<Material>(entity).instance;
+
+			m_slotLookup[entity.id()] = SlotLocation{ type, slot };
+			markSlotDirty(set, slot);
+			return slot;
+		}
+
+		/// @brief Frees the slot, it is uploaded as invalid instance until it is reused or trimmed
+		void releaseSlot(const SlotLocation& location)
+		{
+			auto& set = instanceSet(location.type);
+			auto& instanceSlot = set.slots[location.slot];
+			instanceSlot.entity = Scene::Entity{};
+			instanceSlot.material.reset();
+			set.allocator.free(location.slot);
+			markSlotDirty(set, location.slot);
+		}
+
+		/// @brief Moves instances from the end of the used range into free slots (limited per frame)
+		void compact(InstanceSet& set, InstanceType type)
+		{
+			if (set.allocator.fragmentation() < COMPACTION_THRESHOLD)
+				return;
+
+			for (uint32_t i = 0; i < MAX_COMPACTION_MOVES_PER_FRAME; i++)
+			{
+				auto move = set.allocator.nextCompactionMove();
+				if (!move)
+					break;
+
+				auto& from = set.slots[move->from];
+				auto& to = set.slots[move->to];
+				to.entity = from.entity;
+				to.material = std::move(from.material);
+				from.entity = Scene::Entity{};
+
+				m_slotLookup[to.entity.id()] = SlotLocation{ type, move->to };
+				markSlotDirty(set, move->to);
+			}
+		}
+
+		void markAllSlotsDirty(InstanceSet& set)
+		{
+			for (uint32_t slot = 0; slot < set.allocator.rangeSize(); slot++)
+			{
+				if (set.allocator.isUsed(slot))
+					markSlotDirty(set, slot);
+			}
+		}
+
+		/// @brief Marks the slot for upload to every copy of the instance buffer
+		void markSlotDirty(InstanceSet& set, uint32_t slot)
 		{
-			std::vector<DrawBatchData> drawBatchData;
-			drawBatchData.reserve(frameInfo.drawBatcher.batchCount());
-			for (const auto& batch : frameInfo.drawBatcher.batches())
+			auto& dirty = set.slots[slot].dirty;
+			for (uint32_t i = 0; i < set.bufferCount; i++)
 			{
-				drawBatchData.emplace_back(batch.firstInstance, batch.instanceCount);
+				if (dirty[i])
+					continue;
+
+				dirty[i] = true;
+				set.dirtySlots[i].emplace_back(slot);
 			}
+		}
+
+		void createUpdateBuffer(uint32_t capacity)
+		{
+			auto bufferInfo = Buffer::storageBuffer(sizeof(InstanceUpdate) * capacity, MAX_FRAMES_IN_FLIGHT);
+			bufferInfo.allocFlags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+			m_updateBuffer = Bindless::BindlessFrameBuffer{ bufferInfo };
+			m_updateCapacity = capacity;
+		}
+
+		void updateDrawBatches(FGResourcePool& pool, const FrameInfo& frameInfo)
+		{
+			const auto& batches = frameInfo.drawBatcher.batches();
+			if (batches.empty())
+				return;
+
+			// No copy needed when growing, all batches are written below
 			auto& drawBatchBuffer = pool.buffer(m_drawBatchBuffer);
-			drawBatchBuffer.buffer().copy(drawBatchData, frameInfo.frameIndex);
+			VkDeviceSize capacity = drawBatchBuffer.buffer().instanceSize() / sizeof(DrawBatchData);
+			if (batches.size() > capacity)
+				pool.growBuffer(m_drawBatchBuffer, sizeof(DrawBatchData) * std::max<VkDeviceSize>(batches.size(), capacity * 2));
+
+			auto* data = pool.buffer(m_drawBatchBuffer).buffer().data<DrawBatchData>(frameInfo.frameIndex);
+			for (const auto& batch : batches)
+			{
+				uint32_t flags = batch.materialTemplate->isDoubleSided() ? DrawBatchData::DOUBLE_SIDED : 0;
+				*data++ = DrawBatchData{ batch.firstInstance, batch.instanceCount, flags };
+			}
 		}
 
 		void updateCameraData(FGResourcePool& pool, const FrameInfo& frameInfo)
@@ -236,5 +568,13 @@ export namespace Aegis::Graphics
 		FGResourceHandle m_dynamicInstances;
 		FGResourceHandle m_drawBatchBuffer;
 		FGResourceHandle m_cameraData;
+
+		Pipeline::Future m_scatterPipeline;
+		Bindless::BindlessFrameBuffer m_updateBuffer;
+		uint32_t m_updateCapacity{ 0 };
+
+		InstanceSet m_static;
+		InstanceSet m_dynamic;
+		std::unordered_map<entt::entity, SlotLocation> m_slotLookup;
 	};
 }
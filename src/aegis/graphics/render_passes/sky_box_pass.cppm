@@ -49,7 +49,7 @@ export namespace Aegis::Graphics
 				.setCullMode(VK_CULL_MODE_FRONT_BIT)
 				.setVertexBindingDescriptions({ { 0, sizeof(glm::vec3), VK_VERTEX_INPUT_RATE_VERTEX } })
 				.setVertexAttributeDescriptions({ { 0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0 } })
-				.buildUnique();
+				.buildAsync();
 
 			// Create vertex buffer
 			{
@@ -166,7 +166,7 @@ export namespace Aegis::Graphics
 
 		DescriptorSetLayout m_descriptorSetLayout;
 		std::vector<DescriptorSet> m_descriptorSets;
-		std::unique_ptr<Pipeline> m_pipeline;
+		Pipeline::Future m_pipeline;
 
 		Buffer m_vertexBuffer;
 		Buffer m_indexBuffer;
@@ -84,6 +84,7 @@ export namespace Aegis::Graphics
 				RenderContext ctx{
 					.scene = frameInfo.scene,
 					.ui = frameInfo.ui,
+					.drawBatcher = frameInfo.drawBatcher,
 					.frameIndex = frameInfo.frameIndex,
 					.cmd = cmd,
 					.globalSet = m_globalSets[frameInfo.frameIndex]
@@ -0,0 +1,157 @@
+module;
+
+#include "core/assert.h"
+#include "graphics/vulkan/vulkan_include.h"
+
+export module Aegis.Graphics.RenderPasses.TriangleCullingPass;
+
+import Aegis.Core.Globals;
+import Aegis.Graphics.Bindless;
+import Aegis.Graphics.DrawBatchRegistry;
+import Aegis.Graphics.GeometryArena;
+import Aegis.Graphics.FrameGraph.RenderPass;
+import Aegis.Graphics.Pipeline;
+import Aegis.Graphics.RenderPasses.CullingPass;
+import Aegis.Graphics.Vulkan.Tools;
+
+export namespace Aegis::Graphics
+{
+	/// @brief Culls the meshlets and triangles queued by the CullingPass and compacts the visible triangles into the
+	///        index range reserved for each draw (used by the GPU driven path without mesh shaders)
+	/// @note The first dispatch turns the meshlet work count into indirect dispatch arguments, the second one processes
+	///       one meshlet per workgroup and increments the index count of its draw
+	class TriangleCullingPass : public FGRenderPass
+	{
+	public:
+		struct PushConstant
+		{
+			Bindless::DescriptorHandle cameraData;
+			Bindless::DescriptorHandle staticInstances;
+			Bindless::DescriptorHandle dynamicInstances;
+			Bindless::DescriptorHandle meshletWork;
+			Bindless::DescriptorHandle meshletWorkArgs;
+			Bindless::DescriptorHandle indirectDrawCommands;
+			Bindless::DescriptorHandle indices;
+			Bindless::DescriptorHandle depthPyramid;
+			uint32_t staticCount;
+			uint32_t meshletWorkCapacity;
+			uint32_t prepare;
+			uint32_t occlusionCulling;
+			Bindless::DescriptorHandle meshes;
+			Bindless::DescriptorHandle drawBatches;
+		};
+
+		TriangleCullingPass(FGResourcePool& pool, DrawBatchRegistry& batcher, CullingPhase phase = CullingPhase::Early)
+			: m_drawBatcher{ batcher }, m_phase{ phase }
+		{
+			m_pipeline = Pipeline::ComputeBuilder{}
+				.addDescriptorSetLayout(Bindless::BindlessDescriptorSet::instance().layout())
+				.addPushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstant))
+				.setShaderStage(Core::SHADER_DIR / "gpu-driven/triangle_cull.slang.spv")
+				.buildAsync();
+
+			m_cameraData = pool.addReference("CameraData",
+				FGResource::Usage::ComputeReadUniform);
+
+			m_staticInstances = pool.addReference("StaticInstanceData",
+				FGResource::Usage::ComputeReadStorage);
+
+			m_dynamicInstances = pool.addReference("DynamicInstanceData",
+				FGResource::Usage::ComputeReadStorage);
+
+			m_drawBatches = pool.addReference("DrawBatches",
+				FGResource::Usage::ComputeReadStorage);
+
+			m_meshletWork = pool.addReference("MeshletWork",
+				FGResource::Usage::ComputeReadStorage);
+
+			m_meshletWorkArgs = pool.addReference("MeshletWorkArgs",
+				FGResource::Usage::ComputeWriteStorage);
+
+			m_indirectDrawCommands = pool.addReference("IndirectDrawCommands",
+				FGResource::Usage::ComputeWriteStorage);
+
+			m_compactedIndices = pool.addReference("CompactedIndices",
+				FGResource::Usage::ComputeWriteStorage);
+
+			if (m_phase == CullingPhase::Late)
+			{
+				m_depthPyramid = pool.addReference("DepthPyramid",
+					FGResource::Usage::ComputeReadSampled);
+			}
+		}
+
+		virtual auto info() -> Info override
+		{
+			Info info{
+				.name = m_phase == CullingPhase::Late ? "Triangle Culling (Late)" : "Triangle Culling (Early)",
+				.reads = { m_cameraData, m_staticInstances, m_dynamicInstances, m_drawBatches, m_meshletWork },
+				.writes = { m_meshletWorkArgs, m_indirectDrawCommands, m_compactedIndices },
+			};
+			if (m_depthPyramid.isValid())
+				info.reads.emplace_back(m_depthPyramid);
+
+			return info;
+		}
+
+		virtual void execute(FGResourcePool& pool, const FrameInfo& frameInfo) override
+		{
+			auto& meshletWork = pool.buffer(m_meshletWork);
+			auto& meshletWorkArgs = pool.buffer(m_meshletWorkArgs);
+
+			PushConstant push{
+				.cameraData = pool.buffer(m_cameraData).handle(frameInfo.frameIndex),
+				.staticInstances = pool.buffer(m_staticInstances).handle(),
+				.dynamicInstances = pool.buffer(m_dynamicInstances).handle(frameInfo.frameIndex),
+				.meshletWork = meshletWork.handle(),
+				.meshletWorkArgs = meshletWorkArgs.handle(),
+				.indirectDrawCommands = pool.buffer(m_indirectDrawCommands).handle(),
+				.indices = pool.buffer(m_compactedIndices).handle(),
+				.depthPyramid = m_depthPyramid.isValid() ? pool.texture(m_depthPyramid).sampledDescriptorHandle() : Bindless::DescriptorHandle{},
+				.staticCount = m_drawBatcher.staticSlotCount(),
+				.meshletWorkCapacity = static_cast<uint32_t>(meshletWork.buffer().bufferSize() / (sizeof(uint32_t) * 2)),
+				.prepare = 1,
+				.occlusionCulling = m_depthPyramid.isValid() ? 1u : 0u,
+				.meshes = GeometryArena::instance().meshDataHandle(),
+				.drawBatches = pool.buffer(m_drawBatches).handle(frameInfo.frameIndex),
+			};
+
+			m_pipeline->bind(frameInfo.cmd);
+			m_pipeline->bindDescriptorSet(frameInfo.cmd, 0, Bindless::BindlessDescriptorSet::instance());
+			m_pipeline->pushConstants(frameInfo.cmd, VK_SHADER_STAGE_COMPUTE_BIT, push);
+			vkCmdDispatch(frameInfo.cmd, 1, 1, 1);
+
+			// The dispatch arguments are written and consumed within this pass, so the frame graph does not cover them
+			VkBufferMemoryBarrier barrier{
+				.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+				.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+				.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.buffer = meshletWorkArgs.buffer(),
+				.offset = 0,
+				.size = VK_WHOLE_SIZE,
+			};
+			Tools::vk::cmdPipelineBarrier(frameInfo.cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, { barrier }, {});
+
+			push.prepare = 0;
+			m_pipeline->pushConstants(frameInfo.cmd, VK_SHADER_STAGE_COMPUTE_BIT, push);
+			vkCmdDispatchIndirect(frameInfo.cmd, meshletWorkArgs.buffer(), 0);
+		}
+
+	private:
+		DrawBatchRegistry& m_drawBatcher;
+		CullingPhase m_phase;
+		FGResourceHandle m_cameraData;
+		FGResourceHandle m_staticInstances;
+		FGResourceHandle m_dynamicInstances;
+		FGResourceHandle m_drawBatches;
+		FGResourceHandle m_meshletWork;
+		FGResourceHandle m_meshletWorkArgs;
+		FGResourceHandle m_indirectDrawCommands;
+		FGResourceHandle m_compactedIndices;
+		FGResourceHandle m_depthPyramid;
+		Pipeline::Future m_pipeline;
+	};
+}
@@ -1,35 +1,65 @@
 module;
 
 #include "core/assert.h"
+#include "graphics/vulkan/vulkan_include.h"
+
+#include <entt/entt.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
 
 export module Aegis.Graphics.RenderSystems.BindlessStaticMeshRenderSystem;
 
 import Aegis.Math;
 import Aegis.Graphics.Bindless;
+import Aegis.Graphics.BoundingVolumeHierarchy;
+import Aegis.Graphics.Buffer;
+import Aegis.Graphics.Globals;
 import Aegis.Graphics.RenderSystem;
 import Aegis.Graphics.MaterialTemplate;
 import Aegis.Graphics.MaterialInstance;
 import Aegis.Graphics.StaticMesh;
 import Aegis.Graphics.Components;
+import Aegis.Graphics.Vulkan.VulkanMemory;
+import Aegis.Scene;
 import Aegis.Scene.Components;
 
 export namespace Aegis::Graphics
 {
+	/// @brief Draws all static meshes of one material type (CPU-driven path)
+	/// @note Entities are frustum culled with a bounding volume hierarchy, which is refit when dynamic entities move and
+	///       rebuilt when entities are added or removed. Visible entities are sorted by material template and mesh, each
+	///       mesh gets one instanced indirect command reading the per-frame instance buffer and all commands of a
+	///       template are issued with a single multi-draw. Model and normal matrices are cached per entity and only
+	///       recomputed for entities whose transform changed.
 	class BindlessStaticMeshRenderSystem : public RenderSystem
 	{
 	public:
-		struct alignas(16) PushConstantData
+		static constexpr uint32_t MIN_INSTANCE_CAPACITY = 256;
+
+		struct alignas(16) InstanceData
 		{
 			glm::mat3x4 modelMatrix;
-			glm::vec3 normalRow0; Bindless::DescriptorHandle globalBuffer;
-			glm::vec3 normalRow1; Bindless::DescriptorHandle meshBuffer;
-			glm::vec3 normalRow2; Bindless::DescriptorHandle materialBuffer;
+			glm::vec3 normalRow0; uint32_t materialIndex;
+			glm::vec3 normalRow1; uint32_t padding0;
+			glm::vec3 normalRow2; uint32_t padding1;
+		};
+
+		struct PushConstantData
+		{
+			Bindless::DescriptorHandle globalBuffer;
+			Bindless::DescriptorHandle instanceBuffer;
+			Bindless::DescriptorHandle materialTable;
 		};
 
 		BindlessStaticMeshRenderSystem(MaterialType type = MaterialType::Opaque) :
 			m_type(type)
 		{
-			static_assert(sizeof(PushConstantData) <= 128, "Vulkan only guarantees a minimum of 128 bytes of push constant");
+			static_assert(sizeof(InstanceData) == 96, "InstanceData has to match the shader layout");
 		}
 
 		virtual void render(const RenderContext& ctx) override
@@ -37,57 +67,266 @@ export namespace Aegis::Graphics
 			// TODO: Sort for transparent materials back to front
 			// TODO: Maybe also for opaque materials but front to back (avoid overdraw)
 
-			MaterialTemplate* lastMatTemplate = nullptr;
-			MaterialInstance* lastMatInstance = nullptr;
-			uint32_t objectIndex = 0;
-			auto view = ctx.scene.registry().view<GlobalTransform, Mesh, Material>();
-			view.use<Material>();
-			for (const auto& [entity, transform, mesh, material] : view.each())
+			updateBounds(ctx);
+
+			m_visible.clear();
+			m_draws.clear();
+			m_bvh.cull(ctx.frustum, [this](uint32_t id) { m_visible.emplace_back(id); });
+			if (m_visible.empty())
+				return;
+
+			buildDrawList(ctx);
+
+			auto& frame = m_frames[ctx.frameIndex];
+			PushConstantData push{
+				.globalBuffer = ctx.globalHandle,
+				.instanceBuffer = frame.instances.handle(),
+			};
+			AGX_ASSERT_X(push.globalBuffer.isValid(), "Global buffer handle is invalid");
+			AGX_ASSERT_X(push.instanceBuffer.isValid(), "Instance buffer handle is invalid");
+
+			// Commands are sorted by material template, so each template draws all its meshes with one multi-draw
+			GeometryArena::instance().bindBuffers(ctx.cmd);
+			uint32_t drawCount = static_cast<uint32_t>(m_draws.size());
+			for (uint32_t first = 0; first < drawCount;)
 			{
-				if (!mesh.staticMesh || !material.instance)
-					continue;
+				MaterialTemplate* matTemplate = m_draws[first].matTemplate;
+				uint32_t last = first + 1;
+				while (last < drawCount && m_draws[last].matTemplate == matTemplate)
+					last++;
 
-				auto currentMatTemplate = material.instance->materialTemplate().get();
-				if (!currentMatTemplate || currentMatTemplate->type() != m_type)
-					continue;
+				push.materialTable = matTemplate->materialTable().handle();
+				matTemplate->bind(ctx.cmd);
+				matTemplate->bindBindlessSet(ctx.cmd);
+				matTemplate->pushConstants(ctx.cmd, &push, sizeof(push));
+				matTemplate->drawIndirect(ctx.cmd, frame.commands.buffer(), first * sizeof(VkDrawIndexedIndirectCommand),
+					last - first);
+				first = last;
+			}
+		}
+
+		[[nodiscard]] auto visibleCount() const -> uint32_t { return static_cast<uint32_t>(m_visible.size()); }
+		[[nodiscard]] auto instanceCount() const -> uint32_t { return m_bvh.size(); }
+		[[nodiscard]] auto drawCount() const -> uint32_t { return static_cast<uint32_t>(m_draws.size()); }
 
-				// Bind Pipeline
-				if (lastMatTemplate != currentMatTemplate)
+	private:
+		struct DrawItem
+		{
+			MaterialTemplate* matTemplate;
+			const StaticMesh* mesh;
+			MaterialInstance* matInstance;
+			uint32_t id;
+		};
+
+		struct Draw
+		{
+			MaterialTemplate* matTemplate;
+			const StaticMesh* mesh;
+		};
+
+		struct FrameBuffers
+		{
+			Bindless::BindlessBuffer instances;
+			Buffer commands;
+			uint32_t instanceCapacity{ 0 };
+			uint32_t commandCapacity{ 0 };
+		};
+
+		/// @brief Writes the instance data and one indirect command per material template and mesh
+		void buildDrawList(const RenderContext& ctx)
+		{
+			auto& registry = ctx.scene.registry();
+
+			m_items.clear();
+			for (uint32_t id : m_visible)
+			{
+				Scene::Entity entity = m_entities[id];
+				const auto& mesh = registry.get<Mesh>(entity);
+				const auto& material = registry.get<Material>(entity);
+				m_items.emplace_back(material.instance->materialTemplate().get(), mesh.staticMesh.get(), material.instance.get(), id);
+			}
+
+			// Material instance last, so instances sharing a material read the same record in a row
+			std::ranges::sort(m_items, [](const DrawItem& a, const DrawItem& b) {
+				if (a.matTemplate != b.matTemplate)
+					return a.matTemplate < b.matTemplate;
+				if (a.mesh != b.mesh)
+					return a.mesh < b.mesh;
+				return a.matInstance < b.matInstance;
+				});
+
+			auto& frame = m_frames[ctx.frameIndex];
+			reserveInstances(frame, static_cast<uint32_t>(m_items.size()));
+
+			auto instances = frame.instances.buffer().data<InstanceData>();
+			m_commands.clear();
+			for (uint32_t i = 0; i < static_cast<uint32_t>(m_items.size()); i++)
+			{
+				const auto& item = m_items[i];
+
+				InstanceData instance = m_transforms[item.id];
+				instance.materialIndex = item.matInstance->materialIndex();
+				instances[i] = instance;
+
+				if (!m_draws.empty() && m_draws.back().matTemplate == item.matTemplate && m_draws.back().mesh == item.mesh)
 				{
-					currentMatTemplate->bind(ctx.cmd);
-					currentMatTemplate->bindBindlessSet(ctx.cmd);
-					lastMatTemplate = currentMatTemplate;
+					m_commands.back().instanceCount++;
+					continue;
 				}
 
-				// Bind Descriptor Set
-				if (lastMatInstance != material.instance.get())
+				m_draws.emplace_back(item.matTemplate, item.mesh);
+				m_commands.emplace_back(VkDrawIndexedIndirectCommand{
+					.indexCount = item.mesh->indexCount(),
+					.instanceCount = 1,
+					.firstIndex = item.mesh->firstIndex(),
+					.vertexOffset = item.mesh->vertexOffset(),
+					.firstInstance = i,
+					});
+			}
+			frame.instances.buffer().flush(sizeof(InstanceData) * m_items.size());
+
+			reserveCommands(frame, static_cast<uint32_t>(m_commands.size()));
+			frame.commands.write(m_commands.data(), sizeof(VkDrawIndexedIndirectCommand) * m_commands.size(), 0);
+		}
+
+		/// @note Only the buffers of the current frame are replaced, their previous use has finished already
+		static void reserveInstances(FrameBuffers& frame, uint32_t count)
+		{
+			if (count <= frame.instanceCapacity)
+				return;
+
+			frame.instanceCapacity = std::max({ count, frame.instanceCapacity * 2, MIN_INSTANCE_CAPACITY });
+			frame.instances = Bindless::BindlessBuffer{ Buffer::CreateInfo{
+				.instanceSize = sizeof(InstanceData) * frame.instanceCapacity,
+				.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				.allocFlags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+			} };
+		}
+
+		static void reserveCommands(FrameBuffers& frame, uint32_t count)
+		{
+			if (count <= frame.commandCapacity)
+				return;
+
+			frame.commandCapacity = std::max({ count, frame.commandCapacity * 2, MIN_INSTANCE_CAPACITY });
+			frame.commands = Buffer{ Buffer::CreateInfo{
+				.instanceSize = sizeof(VkDrawIndexedIndirectCommand) * frame.commandCapacity,
+				.usage = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+				.allocFlags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+			} };
+		}
+
+		/// @brief Model and normal matrix of an instance, only recomputed when its transform changes
+		static auto instanceTransform(const GlobalTransform& transform) -> InstanceData
+		{
+			// Transposed since the shader reads the rows
+			glm::mat3 normalMatrix = glm::transpose(Math::normalMatrix(transform.rotation, transform.scale));
+			return InstanceData{
+				.modelMatrix = glm::rowMajor4(transform.matrix()),
+				.normalRow0 = normalMatrix[0],
+				.normalRow1 = normalMatrix[1],
+				.normalRow2 = normalMatrix[2],
+			};
+		}
+
+		static auto worldBounds(const GlobalTransform& transform, const StaticMesh& mesh) -> BoundingVolumeHierarchy::Sphere
+		{
+			const auto& bounds = mesh.bounds();
+			float maxScale = std::max({ std::abs(transform.scale.x), std::abs(transform.scale.y), std::abs(transform.scale.z) });
+			return BoundingVolumeHierarchy::Sphere{
+				.center = transform.location + transform.rotation * (transform.scale * bounds.center),
+				.radius = bounds.radius * maxScale
+			};
+		}
+
+		[[nodiscard]] auto isDrawn(const Mesh& mesh, const Material& material) const -> bool
+		{
+			if (!mesh.staticMesh || !material.instance)
+				return false;
+
+			auto matTemplate = material.instance->materialTemplate().get();
+			return matTemplate && matTemplate->type() == m_type;
+		}
+
+		/// @brief Keeps the hierarchy in sync with the scene (using the change lists of this frame)
+		void updateBounds(const RenderContext& ctx)
+		{
+			auto& registry = ctx.scene.registry();
+			bool rebuild = m_scene != &ctx.scene || registry.allTransformsChanged();
+
+			// Added, removed or retyped instances change the structure, mesh swaps only the bounds
+			for (Scene::Entity entity : ctx.drawBatcher.instanceChanges())
+			{
+				if (rebuild)
+					break;
+
+				auto it = m_ids.find(entity.id());
+				bool drawn = registry.isValid(entity) && registry.has<GlobalTransform, Mesh, Material>(entity) &&
+					isDrawn(registry.get<Mesh>(entity), registry.get<Material>(entity));
+				if (drawn != (it != m_ids.end()))
 				{
-					material.instance->updateParameters(ctx.frameIndex);
-					lastMatInstance = material.instance.get();
+					rebuild = true;
+					break;
 				}
 
-				// Push Constants
-				auto globalTransform = transform.matrix();
-				auto normalMatrix = glm::inverse(glm::mat3{ globalTransform }); // Transpose missing because of row-major storage
-				PushConstantData push{
-					.modelMatrix = glm::rowMajor4(globalTransform),
-					.normalRow0 = normalMatrix[0],
-					.globalBuffer = ctx.globalHandle,
-					.normalRow1 = normalMatrix[1],
-					.meshBuffer = mesh.staticMesh->meshDataBuffer().handle(),
-					.normalRow2 = normalMatrix[2],
-					.materialBuffer = material.instance->buffer().handle(ctx.frameIndex)
-				};
-				AGX_ASSERT_X(push.globalBuffer.isValid(), "Global buffer handle is invalid");
-				AGX_ASSERT_X(push.meshBuffer.isValid(), "Mesh buffer handle is invalid");
-				AGX_ASSERT_X(push.materialBuffer.isValid(), "Material buffer handle is invalid");
-
-				currentMatTemplate->pushConstants(ctx.cmd, &push, sizeof(push));
-				currentMatTemplate->draw(ctx.cmd, *mesh.staticMesh);
+				if (drawn)
+					m_bvh.update(it->second, worldBounds(registry.get<GlobalTransform>(entity), *registry.get<Mesh>(entity).staticMesh));
+			}
+
+			if (rebuild)
+			{
+				rebuildHierarchy(ctx.scene);
+				return;
+			}
+
+			for (Scene::Entity entity : registry.transformChanges())
+			{
+				auto it = m_ids.find(entity.id());
+				if (it == m_ids.end())
+					continue;
+
+				const auto& transform = registry.get<GlobalTransform>(entity);
+				m_bvh.update(it->second, worldBounds(transform, *registry.get<Mesh>(entity).staticMesh));
+				m_transforms[it->second] = instanceTransform(transform);
 			}
 		}
 
-	private:
+		void rebuildHierarchy(Scene::Scene& scene)
+		{
+			m_scene = &scene;
+			m_entities.clear();
+			m_ids.clear();
+			m_transforms.clear();
+
+			std::vector<BoundingVolumeHierarchy::Sphere> spheres;
+			auto view = scene.registry().view<GlobalTransform, Mesh, Material>();
+			view.use<Material>();
+			for (const auto& [entity, transform, mesh, material] : view.each())
+			{
+				if (!isDrawn(mesh, material))
+					continue;
+
+				m_ids.emplace(entity, static_cast<uint32_t>(m_entities.size()));
+				m_entities.emplace_back(entity);
+				m_transforms.emplace_back(instanceTransform(transform));
+				spheres.emplace_back(worldBounds(transform, *mesh.staticMesh));
+			}
+
+			m_bvh.build(spheres);
+		}
+
 		MaterialType m_type;
+
+		Scene::Scene* m_scene{ nullptr };
+		BoundingVolumeHierarchy m_bvh;
+		std::vector<Scene::Entity> m_entities;
+		std::vector<InstanceData> m_transforms;
+		std::unordered_map<entt::entity, uint32_t> m_ids;
+		std::vector<uint32_t> m_visible;
+
+		std::vector<DrawItem> m_items;
+		std::vector<Draw> m_draws;
+		std::vector<VkDrawIndexedIndirectCommand> m_commands;
+		std::array<FrameBuffers, MAX_FRAMES_IN_FLIGHT> m_frames;
 	};
 }
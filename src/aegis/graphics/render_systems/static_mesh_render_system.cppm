@@ -33,7 +33,6 @@ export namespace Aegis::Graphics
 			// TODO: Maybe also for opaque materials but front to back (avoid overdraw)
 
 			MaterialTemplate* lastMatTemplate = nullptr;
-			MaterialInstance* lastMatInstance = nullptr;
 
 			auto view = ctx.scene.registry().view<GlobalTransform, Mesh, Material>();
 			view.use<Material>();
@@ -54,13 +53,6 @@ export namespace Aegis::Graphics
 					lastMatTemplate = currentMatTemplate;
 				}
 
-				// Bind Descriptor Set
-				if (lastMatInstance != material.instance.get())
-				{
-					material.instance->updateParameters(ctx.frameIndex);
-					lastMatInstance = material.instance.get();
-				}
-
 				// Push Constants
 				PushConstantData push{
 					.modelMatrix = transform.matrix(),
@@ -13,6 +13,7 @@ module;
 
 #include <array>
 #include <limits>
+#include <memory>
 
 export module Aegis.Graphics.Renderer;
 
@@ -24,29 +25,37 @@ import Aegis.Graphics.Bindless;
 import Aegis.Graphics.FrameGraph;
 import Aegis.Graphics.RenderPasses.BloomPass;
 import Aegis.Graphics.RenderPasses.CullingPass;
+import Aegis.Graphics.RenderPasses.DepthPyramidPass;
 import Aegis.Graphics.RenderPasses.SceneUpdatePass;
 import Aegis.Graphics.RenderPasses.GPUDrivenGeometry;
 import Aegis.Graphics.RenderPasses.GeometryPass;
 import Aegis.Graphics.RenderPasses.SkyBoxPass;
 import Aegis.Graphics.RenderPasses.LightingPass;
+import Aegis.Graphics.RenderPasses.OffscreenPass;
 import Aegis.Graphics.RenderPasses.PresentPass;
 import Aegis.Graphics.RenderPasses.UIPass;
 import Aegis.Graphics.RenderPasses.PostProcessingPass;
 import Aegis.Graphics.RenderPasses.BloomPass;
 import Aegis.Graphics.RenderPasses.TransparentPass;
+import Aegis.Graphics.RenderPasses.TriangleCullingPass;
 import Aegis.Graphics.RenderSystems.BindlessStaticMeshRenderSystem;
 import Aegis.Graphics.RenderSystems.PointLightRenderSystem;
 import Aegis.Graphics.Globals;
 import Aegis.Graphics.GPUTimer;
+import Aegis.Graphics.OffscreenTarget;
 import Aegis.Graphics.SwapChain;
 import Aegis.Graphics.VulkanContext;
 import Aegis.Graphics.FrameInfo;
+import Aegis.Graphics.GeometryArena;
+import Aegis.Graphics.UploadContext;
 import Aegis.Graphics.MaterialTemplate;
 import Aegis.Scene;
 import Aegis.UI;
 
 export namespace Aegis::Graphics
 {
+	/// @note A headless window (see Core::Window) renders into an OffscreenTarget instead of a swap chain, frames are
+	///       submitted without presenting and can be read back to the host
 	class Renderer
 	{
 	public:
@@ -58,24 +67,42 @@ export namespace Aegis::Graphics
 		};
 
 		static constexpr bool ENABLE_GPU_DRIVEN_RENDERING{ true };
+		static constexpr uint32_t VISIBLE_TRIANGLE_BUDGET{ CullingPass::DEFAULT_VISIBLE_TRIANGLE_BUDGET }; ///< Without mesh shaders
 		static auto useGPUDrivenRendering() -> bool
 		{
-			return ENABLE_GPU_DRIVEN_RENDERING
-				&& VulkanContext::device().features().meshShaderEXT.meshShader
+			const auto& features = VulkanContext::device().features();
+			return ENABLE_GPU_DRIVEN_RENDERING && (useMeshShaders()
+				|| (features.core.features.multiDrawIndirect && features.v12.drawIndirectCount));
+		}
+
+		/// @brief Without mesh shaders the GPU driven path culls triangles in compute and draws with the vertex pipeline
+		static auto useMeshShaders() -> bool
+		{
+			return VulkanContext::device().features().meshShaderEXT.meshShader
 				&& VulkanContext::device().features().meshShaderEXT.taskShader;
 		}
 
 		Renderer(Core::Window& window) :
 			m_window{ window },
-			m_vulkanContext{ VulkanContext::initialize(m_window) },
-			m_swapChain{ VkExtent2D{ m_window.width(), m_window.height() } }
+			m_vulkanContext{ VulkanContext::initialize(m_window) }
 		{
+			VkExtent2D extent{ m_window.width(), m_window.height() };
+			if (m_window.isHeadless())
+			{
+				m_offscreenTarget = std::make_unique<OffscreenTarget>(extent);
+				ALOG::info("Rendering headless to a {}x{} offscreen target", extent.width, extent.height);
+			}
+			else
+			{
+				m_swapChain = std::make_unique<SwapChain>(extent);
+			}
+
 			createFrameContext();
 			setupUI();
 
 			if (useGPUDrivenRendering())
 			{
-				ALOG::info("Using GPU Driven Rendering");
+				ALOG::info("Using GPU Driven Rendering ({})", useMeshShaders() ? "Mesh Shaders" : "Vertex Pipeline");
 			}
 			else
 			{
@@ -98,6 +125,8 @@ export namespace Aegis::Graphics
 			ImGui_ImplGlfw_Shutdown();
 			ImGui::DestroyContext();
 
+			// Readback buffers are queued for deletion, release them before the queue is flushed
+			m_offscreenTarget.reset();
 			VulkanContext::destroy();
 		}
 
@@ -105,11 +134,31 @@ export namespace Aegis::Graphics
 		auto operator=(Renderer&&) noexcept -> Renderer & = delete;
 
 		[[nodiscard]] auto window() -> Core::Window& { return m_window; }
-		[[nodiscard]] auto swapChain() -> SwapChain& { return m_swapChain; }
+		[[nodiscard]] auto isHeadless() const -> bool { return m_offscreenTarget != nullptr; }
+		[[nodiscard]] auto swapChain() -> SwapChain&
+		{
+			AGX_ASSERT_X(m_swapChain, "Headless renderer has no swap chain");
+			return *m_swapChain;
+		}
+		[[nodiscard]] auto offscreenTarget() -> OffscreenTarget&
+		{
+			AGX_ASSERT_X(m_offscreenTarget, "Renderer is not headless");
+			return *m_offscreenTarget;
+		}
 		[[nodiscard]] auto bindlessDescriptorSet() -> Bindless::BindlessDescriptorSet& { return m_bindlessDescriptorSet; }
+		[[nodiscard]] auto geometryArena() -> GeometryArena& { return m_geometryArena; }
+		[[nodiscard]] auto uploadContext() -> UploadContext& { return m_uploadContext; }
 		[[nodiscard]] auto drawBatchRegistry() -> DrawBatchRegistry& { return m_drawBatchRegistry; }
 		[[nodiscard]] auto frameGraph() -> FrameGraph& { return m_frameGraph; }
-		[[nodiscard]] auto aspectRatio() const -> float { return m_swapChain.aspectRatio(); }
+		[[nodiscard]] auto extent() const -> VkExtent2D
+		{
+			return m_offscreenTarget ? m_offscreenTarget->extent() : m_swapChain->extent();
+		}
+		[[nodiscard]] auto aspectRatio() const -> float
+		{
+			VkExtent2D size = extent();
+			return static_cast<float>(size.width) / static_cast<float>(size.height);
+		}
 		[[nodiscard]] auto isFrameStarted() const -> bool { return m_isFrameStarted; }
 		[[nodiscard]] auto currentCommandBuffer() const -> VkCommandBuffer
 		{
@@ -128,21 +177,38 @@ export namespace Aegis::Graphics
 		/// @brief Called when the scene has changed and BEFORE it is initialized
 		void sceneChanged(Scene::Scene& scene)
 		{
+			// Resources of the previous scene (e.g. geometry arena ranges) are released before the new scene allocates
+			waitIdle();
+			VulkanContext::flushDeletionQueue();
+
 			m_drawBatchRegistry.sceneChanged(scene);
 		}
 
 		/// @brief Called when the scene has changed and AFTER it is initialized
 		void sceneInitialized(Scene::Scene& scene)
 		{
+			// Meshes of the previous scene leave holes in the geometry buffers (released in sceneChanged)
+			if (m_geometryArena.fragmentation() > GeometryArena::MAX_FRAGMENTATION)
+				m_geometryArena.defragment();
+
 			createFrameGraph();
 			m_frameGraph.compile();
+
+			// Swap chain relative images are created with the default extent
+			VkExtent2D size = extent();
+			if (size.width != Core::DEFAULT_WIDTH || size.height != Core::DEFAULT_HEIGHT)
+				m_frameGraph.swapChainResized(size.width, size.height);
+
 			m_frameGraph.sceneInitialized(scene);
+
+			// Passes have picked up the complete scene, only later changes are of interest
+			m_drawBatchRegistry.clearInstanceChanges();
 		}
 
 		/// @brief Renders the given scene
 		void renderFrame(Scene::Scene& scene, UI::UI& ui)
 		{
-			ScopeProfiler renderFrame("Render Frame");
+			ScopeProfiler renderFrame{ "Render Frame"_scope };
 			{
 				beginFrame();
 				{
@@ -154,23 +220,33 @@ export namespace Aegis::Graphics
 						.drawBatcher = m_drawBatchRegistry,
 						.cmd = currentCommandBuffer(),
 						.frameIndex = m_currentFrameIndex,
-						.swapChainExtent = m_swapChain.extent(),
-						.aspectRatio = m_swapChain.aspectRatio()
+						.swapChainExtent = extent(),
+						.aspectRatio = aspectRatio()
 					};
 
-					GPUScopeTimer gpuFrameTimer(frameInfo.cmd, "GPU Frame Time");
-					ScopeProfiler cpuFrameProfiler("CPU Frame Time");
+					GPUScopeTimer gpuFrameTimer(frameInfo.cmd, "GPU Frame Time"_scope);
+					ScopeProfiler cpuFrameProfiler{ "CPU Frame Time"_scope };
+
+					// Only changed material records are copied, before any pass reads them
+					for (const auto& batch : m_drawBatchRegistry.batches())
+					{
+						batch.materialTemplate->materialTable().upload(frameInfo.cmd, frameInfo.frameIndex);
+					}
 
 					m_frameGraph.execute(frameInfo);
+					m_drawBatchRegistry.clearInstanceChanges();
 				}
 				endFrame();
 			}
 		}
 
 		/// @brief Waits for the GPU to be idle
+		/// @note Pending offscreen readbacks are collected as well
 		void waitIdle()
 		{
 			vkDeviceWaitIdle(VulkanContext::device());
+			if (m_offscreenTarget && m_offscreenTarget->isReadbackEnabled())
+				m_offscreenTarget->flush();
 		}
 
 	private:
@@ -210,7 +286,7 @@ export namespace Aegis::Graphics
 			}
 
 			waitIdle();
-			m_swapChain.resize(extent);
+			m_swapChain->resize(extent);
 			m_frameGraph.swapChainResized(extent.width, extent.height);
 			m_window.resetResizedFlag();
 		}
@@ -253,10 +329,20 @@ export namespace Aegis::Graphics
 			// Note: They each need different shaders and pipelines (check asset_manager.cpp)
 			if (Renderer::useGPUDrivenRendering())
 			{
-				// GPU Driven Rendering Passes
-				m_frameGraph.add<CullingPass>(m_drawBatchRegistry);
-				m_frameGraph.add<SceneUpdatePass>();
-				m_frameGraph.add<GPUDrivenGeometry>();
+				// GPU Driven Rendering Passes (two-phase occlusion culling, see CullingPhase)
+				// Without mesh shaders meshlets and triangles are culled in compute and drawn with indexed draws
+				auto drawMode = useMeshShaders() ? IndirectDrawMode::MeshTasks : IndirectDrawMode::Indexed;
+				auto addCullingPasses = [this, drawMode](CullingPhase phase) {
+					m_frameGraph.add<CullingPass>(m_drawBatchRegistry, phase, drawMode, VISIBLE_TRIANGLE_BUDGET);
+					if (drawMode == IndirectDrawMode::Indexed)
+						m_frameGraph.add<TriangleCullingPass>(m_drawBatchRegistry, phase);
+					m_frameGraph.add<GPUDrivenGeometry>(phase, drawMode);
+					};
+
+				m_frameGraph.add<SceneUpdatePass>(m_drawBatchRegistry);
+				addCullingPasses(CullingPhase::Early);
+				m_frameGraph.add<DepthPyramidPass>();
+				addCullingPasses(CullingPhase::Late);
 			}
 			else
 			{
@@ -265,16 +351,24 @@ export namespace Aegis::Graphics
 					.addRenderSystem<BindlessStaticMeshRenderSystem>(MaterialType::Opaque);
 			}
 
-			m_frameGraph.add<SkyBoxPass>();
+			// Passes writing the same resource have to be added in execution order
 			m_frameGraph.add<LightingPass>();
-			m_frameGraph.add<PresentPass>(m_swapChain);
-			m_frameGraph.add<UIPass>();
-			m_frameGraph.add<PostProcessingPass>();
-			m_frameGraph.add<BloomPass>();
-
+			m_frameGraph.add<SkyBoxPass>();
 			m_frameGraph.add<TransparentPass>()
 				.addRenderSystem<PointLightRenderSystem>();
 
+			m_frameGraph.add<BloomPass>();
+			m_frameGraph.add<PostProcessingPass>();
+			m_frameGraph.add<UIPass>();
+			if (m_offscreenTarget)
+			{
+				m_frameGraph.add<OffscreenPass>(*m_offscreenTarget);
+			}
+			else
+			{
+				m_frameGraph.add<PresentPass>(*m_swapChain);
+			}
+
 			// TODO: Rework transparent rendering with GPU driven approach (need to sort transparents first)
 			// TODO: Alternatively add transparent tag component to avoid iterating all static meshes
 			//transparentPass.addRenderSystem<BindlessStaticMeshRenderSystem>(MaterialType::Transparent);
@@ -291,13 +385,22 @@ export namespace Aegis::Graphics
 			FrameContext& frame = m_frames[m_currentFrameIndex];
 			vkWaitForFences(VulkanContext::device(), 1, &frame.inFlightFence, VK_TRUE, std::numeric_limits<uint64_t>::max());
 
-			VkResult result = m_swapChain.acquireNextImage(frame.imageAvailable);
-			if (result == VK_ERROR_OUT_OF_DATE_KHR)
+			if (m_offscreenTarget)
 			{
-				recreateSwapChain();
-				result = m_swapChain.acquireNextImage(frame.imageAvailable);
+				// The frame previously rendered with this slot has finished, its readback is ready
+				if (m_offscreenTarget->isReadbackEnabled())
+					m_offscreenTarget->collect(m_currentFrameIndex);
+			}
+			else
+			{
+				VkResult result = m_swapChain->acquireNextImage(frame.imageAvailable);
+				if (result == VK_ERROR_OUT_OF_DATE_KHR)
+				{
+					recreateSwapChain();
+					result = m_swapChain->acquireNextImage(frame.imageAvailable);
+				}
+				AGX_ASSERT_X(result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR, "Failed to aquire swap chain image");
 			}
-			AGX_ASSERT_X(result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR, "Failed to aquire swap chain image");
 
 			VkCommandBufferBeginInfo beginInfo{
 				.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
@@ -320,19 +423,34 @@ export namespace Aegis::Graphics
 			FrameContext& frame = m_frames[m_currentFrameIndex];
 			VK_CHECK(vkEndCommandBuffer(frame.commandBuffer));
 
+			if (m_offscreenTarget)
 			{
-				ScopeProfiler gpuSync("GPU Sync");
+				submitOffscreen(frame);
+				return;
+			}
+
+			{
+				ScopeProfiler gpuSync{ "GPU Sync"_scope };
 
 				// Ensure the previous frame using this image has finished (for frameIndex != imageIndex)
-				m_swapChain.waitForImageInFlight(frame.inFlightFence);
+				m_swapChain->waitForImageInFlight(frame.inFlightFence);
 			}
 
-			VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-			VkSemaphore signalSemaphores[] = { m_swapChain.presentReadySemaphore() };
+			// Uploads are waited for on the GPU as well, which makes their writes visible to the frame
+			VkSemaphore waitSemaphores[] = { frame.imageAvailable, m_uploadContext.timeline() };
+			uint64_t waitValues[] = { 0, m_uploadContext.submittedValue() };
+			VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT };
+			VkSemaphore signalSemaphores[] = { m_swapChain->presentReadySemaphore() };
+			VkTimelineSemaphoreSubmitInfo timelineInfo{
+				.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+				.waitSemaphoreValueCount = 2,
+				.pWaitSemaphoreValues = waitValues,
+			};
 			VkSubmitInfo submitInfo{
 				.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-				.waitSemaphoreCount = 1,
-				.pWaitSemaphores = &frame.imageAvailable,
+				.pNext = &timelineInfo,
+				.waitSemaphoreCount = 2,
+				.pWaitSemaphores = waitSemaphores,
 				.pWaitDstStageMask = waitStages,
 				.commandBufferCount = 1,
 				.pCommandBuffers = &frame.commandBuffer,
@@ -342,13 +460,47 @@ export namespace Aegis::Graphics
 
 			vkResetFences(VulkanContext::device(), 1, &frame.inFlightFence);
 			VK_CHECK(vkQueueSubmit(VulkanContext::device().graphicsQueue(), 1, &submitInfo, frame.inFlightFence));
+			m_gpuTimerManager.submitted(m_currentFrameIndex);
 
-			auto result = m_swapChain.present();
+			auto result = m_swapChain->present();
 			if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || m_window.wasResized())
 			{
 				recreateSwapChain();
 			}
 
+			advanceFrame();
+		}
+
+		/// @brief Submits the frame without acquiring or presenting, only uploads are waited for
+		void submitOffscreen(FrameContext& frame)
+		{
+			VkSemaphore waitSemaphore = m_uploadContext.timeline();
+			uint64_t waitValue = m_uploadContext.submittedValue();
+			VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+			VkTimelineSemaphoreSubmitInfo timelineInfo{
+				.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+				.waitSemaphoreValueCount = 1,
+				.pWaitSemaphoreValues = &waitValue,
+			};
+			VkSubmitInfo submitInfo{
+				.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+				.pNext = &timelineInfo,
+				.waitSemaphoreCount = 1,
+				.pWaitSemaphores = &waitSemaphore,
+				.pWaitDstStageMask = &waitStage,
+				.commandBufferCount = 1,
+				.pCommandBuffers = &frame.commandBuffer,
+			};
+
+			vkResetFences(VulkanContext::device(), 1, &frame.inFlightFence);
+			VK_CHECK(vkQueueSubmit(VulkanContext::device().graphicsQueue(), 1, &submitInfo, frame.inFlightFence));
+			m_gpuTimerManager.submitted(m_currentFrameIndex);
+
+			advanceFrame();
+		}
+
+		void advanceFrame()
+		{
 			m_currentFrameIndex = (m_currentFrameIndex + 1) % MAX_FRAMES_IN_FLIGHT;
 			VulkanContext::flushDeletionQueue(m_currentFrameIndex);
 		}
@@ -356,12 +508,15 @@ export namespace Aegis::Graphics
 		Core::Window& m_window;
 		VulkanContext& m_vulkanContext;
 
-		SwapChain m_swapChain;
+		std::unique_ptr<SwapChain> m_swapChain;
+		std::unique_ptr<OffscreenTarget> m_offscreenTarget;
 		std::array<FrameContext, MAX_FRAMES_IN_FLIGHT> m_frames;
 		uint32_t m_currentFrameIndex{ 0 };
 		bool m_isFrameStarted{ false };
 
+		UploadContext m_uploadContext;
 		Bindless::BindlessDescriptorSet m_bindlessDescriptorSet;
+		GeometryArena m_geometryArena;
 		DrawBatchRegistry m_drawBatchRegistry;
 		FrameGraph m_frameGraph;
 
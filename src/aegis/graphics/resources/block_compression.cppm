@@ -0,0 +1,271 @@
+module;
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+export module Aegis.Graphics.BlockCompression;
+
+import Aegis.Math;
+
+export namespace Aegis::Graphics::BlockCompression
+{
+	/// @brief 4x4 texels in row major order, RGBA8
+	using Block = std::array<std::array<uint8_t, 4>, 16>;
+
+	/// @brief Single channel block, two endpoints and 3 bit indices (8 bytes)
+	/// @note Always uses the 8 value palette (endpoint0 > endpoint1), indices are the nearest palette entry
+	auto encodeBC4(const Block& block, uint32_t channel) -> std::array<std::byte, 8>
+	{
+		uint8_t minValue = 255;
+		uint8_t maxValue = 0;
+		for (const auto& texel : block)
+		{
+			minValue = std::min(minValue, texel[channel]);
+			maxValue = std::max(maxValue, texel[channel]);
+		}
+
+		uint64_t bits = static_cast<uint64_t>(maxValue) | (static_cast<uint64_t>(minValue) << 8);
+		if (maxValue != minValue)
+		{
+			std::array<int, 8> palette{ maxValue, minValue };
+			for (int i = 2; i < 8; i++)
+			{
+				palette[i] = ((8 - i) * maxValue + (i - 1) * minValue + 3) / 7;
+			}
+
+			for (uint32_t texel = 0; texel < 16; texel++)
+			{
+				int value = block[texel][channel];
+				uint64_t bestIndex = 0;
+				int bestError = std::numeric_limits<int>::max();
+				for (uint32_t i = 0; i < 8; i++)
+				{
+					int error = std::abs(palette[i] - value);
+					if (error < bestError)
+					{
+						bestError = error;
+						bestIndex = i;
+					}
+				}
+				bits |= bestIndex << (16 + 3 * texel);
+			}
+		}
+
+		std::array<std::byte, 8> result;
+		std::memcpy(result.data(), &bits, sizeof(bits));
+		return result;
+	}
+
+	/// @brief Two BC4 blocks for the red and green channel (16 bytes), used for tangent space normals
+	auto encodeBC5(const Block& block) -> std::array<std::byte, 16>
+	{
+		std::array<std::byte, 16> result;
+		auto red = encodeBC4(block, 0);
+		auto green = encodeBC4(block, 1);
+		std::memcpy(result.data(), red.data(), red.size());
+		std::memcpy(result.data() + red.size(), green.data(), green.size());
+		return result;
+	}
+
+	/// @brief RGBA block in BC7 mode 6 (one subset, 7.7.7.7 endpoints with a p-bit each, 4 bit indices)
+	/// @note Endpoints are fitted along the principal axis of the block and refined with a least squares fit. Mode 6
+	///       alone is not as good as an exhaustive encoder, but close for most photographic content and fast enough
+	///       to cook textures on the first load.
+	auto encodeBC7(const Block& block) -> std::array<std::byte, 16>
+	{
+		static constexpr std::array<int, 16> WEIGHTS{ 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+		struct Endpoint
+		{
+			std::array<int, 4> color;	// 7 bit per channel
+			int pBit;
+
+			[[nodiscard]] auto value(uint32_t channel) const -> int { return (color[channel] << 1) | pBit; }
+		};
+
+		struct Candidate
+		{
+			std::array<Endpoint, 2> endpoints;
+			std::array<uint8_t, 16> indices;
+			float error{ std::numeric_limits<float>::max() };
+		};
+
+		std::array<glm::vec4, 16> texels;
+		glm::vec4 mean{ 0.0f };
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			texels[i] = glm::vec4{ block[i][0], block[i][1], block[i][2], block[i][3] };
+			mean += texels[i];
+		}
+		mean /= 16.0f;
+
+		auto quantize = [](const glm::vec4& color) {
+			Endpoint best{};
+			float bestError = std::numeric_limits<float>::max();
+			for (int pBit = 0; pBit < 2; pBit++)
+			{
+				Endpoint endpoint{ .pBit = pBit };
+				float error = 0.0f;
+				for (uint32_t c = 0; c < 4; c++)
+				{
+					float value = std::clamp(color[c], 0.0f, 255.0f);
+					endpoint.color[c] = std::clamp(static_cast<int>(std::lround((value - static_cast<float>(pBit)) * 0.5f)), 0, 127);
+					float delta = static_cast<float>(endpoint.value(c)) - value;
+					error += delta * delta;
+				}
+				if (error < bestError)
+				{
+					bestError = error;
+					best = endpoint;
+				}
+			}
+			return best;
+			};
+
+		auto evaluate = [&](const glm::vec4& first, const glm::vec4& second) {
+			Candidate candidate{ .endpoints = { quantize(first), quantize(second) } };
+
+			std::array<glm::vec4, 16> palette;
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				for (uint32_t c = 0; c < 4; c++)
+				{
+					int e0 = candidate.endpoints[0].value(c);
+					int e1 = candidate.endpoints[1].value(c);
+					palette[i][c] = static_cast<float>(((64 - WEIGHTS[i]) * e0 + WEIGHTS[i] * e1 + 32) >> 6);
+				}
+			}
+
+			// Palette entries are ordered along the segment, project and check the neighbouring entries
+			glm::vec4 direction = palette[15] - palette[0];
+			float lengthSquared = glm::dot(direction, direction);
+			candidate.error = 0.0f;
+			for (uint32_t texel = 0; texel < 16; texel++)
+			{
+				int guess = 0;
+				if (lengthSquared > 0.0f)
+				{
+					float t = glm::dot(texels[texel] - palette[0], direction) / lengthSquared;
+					guess = std::clamp(static_cast<int>(t * 15.0f + 0.5f), 0, 15);
+				}
+
+				float bestError = std::numeric_limits<float>::max();
+				for (int i = std::max(guess - 1, 0); i <= std::min(guess + 1, 15); i++)
+				{
+					glm::vec4 delta = palette[i] - texels[texel];
+					float error = glm::dot(delta, delta);
+					if (error < bestError)
+					{
+						bestError = error;
+						candidate.indices[texel] = static_cast<uint8_t>(i);
+					}
+				}
+				candidate.error += bestError;
+			}
+			return candidate;
+			};
+
+		// Principal axis by power iteration on the covariance matrix
+		glm::mat4 covariance{ 0.0f };
+		for (const auto& texel : texels)
+		{
+			glm::vec4 delta = texel - mean;
+			for (int i = 0; i < 4; i++)
+			{
+				covariance[i] += delta * delta[i];
+			}
+		}
+
+		glm::vec4 axis{ 1.0f, 1.0f, 1.0f, 1.0f };
+		for (int iteration = 0; iteration < 8; iteration++)
+		{
+			glm::vec4 next = covariance * axis;
+			float length = glm::length(next);
+			if (length < 1e-6f)
+				break;
+
+			axis = next / length;
+		}
+
+		float minProjection = 0.0f;
+		float maxProjection = 0.0f;
+		for (const auto& texel : texels)
+		{
+			float projection = glm::dot(texel - mean, axis);
+			minProjection = std::min(minProjection, projection);
+			maxProjection = std::max(maxProjection, projection);
+		}
+
+		Candidate best = evaluate(mean + axis * minProjection, mean + axis * maxProjection);
+
+		// Least squares fit of the endpoints for the chosen indices
+		for (int iteration = 0; iteration < 2 && best.error > 0.0f; iteration++)
+		{
+			float a = 0.0f, b = 0.0f, c = 0.0f;
+			glm::vec4 d0{ 0.0f };
+			glm::vec4 d1{ 0.0f };
+			for (uint32_t texel = 0; texel < 16; texel++)
+			{
+				float w = static_cast<float>(WEIGHTS[best.indices[texel]]) / 64.0f;
+				a += (1.0f - w) * (1.0f - w);
+				b += (1.0f - w) * w;
+				c += w * w;
+				d0 += (1.0f - w) * texels[texel];
+				d1 += w * texels[texel];
+			}
+
+			float determinant = a * c - b * b;
+			if (std::abs(determinant) < 1e-6f)
+				break;
+
+			auto candidate = evaluate((c * d0 - b * d1) / determinant, (a * d1 - b * d0) / determinant);
+			if (candidate.error >= best.error)
+				break;
+
+			best = candidate;
+		}
+
+		// The most significant index bit of the first texel is implicit zero
+		if (best.indices[0] & 0x8)
+		{
+			std::swap(best.endpoints[0], best.endpoints[1]);
+			for (auto& index : best.indices)
+			{
+				index = static_cast<uint8_t>(15 - index);
+			}
+		}
+
+		std::array<uint64_t, 2> bits{ 0, 0 };
+		uint32_t position = 0;
+		auto write = [&](uint64_t value, uint32_t count) {
+			for (uint32_t i = 0; i < count; i++, position++)
+			{
+				bits[position / 64] |= ((value >> i) & 1) << (position % 64);
+			}
+			};
+
+		write(1 << 6, 7);
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			write(static_cast<uint64_t>(best.endpoints[0].color[c]), 7);
+			write(static_cast<uint64_t>(best.endpoints[1].color[c]), 7);
+		}
+		write(static_cast<uint64_t>(best.endpoints[0].pBit), 1);
+		write(static_cast<uint64_t>(best.endpoints[1].pBit), 1);
+		write(best.indices[0], 3);
+		for (uint32_t texel = 1; texel < 16; texel++)
+		{
+			write(best.indices[texel], 4);
+		}
+
+		std::array<std::byte, 16> result;
+		std::memcpy(result.data(), bits.data(), result.size());
+		return result;
+	}
+}
@@ -11,6 +11,7 @@ module;
 export module Aegis.Graphics.Buffer;
 
 import Aegis.Graphics.Globals;
+import Aegis.Graphics.UploadContext;
 import Aegis.Graphics.VulkanContext;
 import Aegis.Graphics.Vulkan.VulkanMemory;
 
@@ -89,6 +90,17 @@ export namespace Aegis::Graphics
 			};
 		}
 
+		/// @brief Host visible buffer to copy device data back to the host (see read())
+		static auto readbackBuffer(VkDeviceSize size) -> Buffer::CreateInfo
+		{
+			AGX_ASSERT_X(size > 0, "Cannot create readback buffer of size 0");
+			return Buffer::CreateInfo{
+				.instanceSize = size,
+				.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				.allocFlags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+			};
+		}
+
 		Buffer() = default;
 		explicit Buffer(const CreateInfo& info) :
 			m_instanceSize{ info.instanceSize },
@@ -245,6 +257,16 @@ export namespace Aegis::Graphics
 			VK_CHECK(vma::vmaFlushAllocation(VulkanContext::device().allocator(), m_allocation, offset, size));
 		}
 
+		/// @brief Invalidates the memory range and copies it to 'data' (device writes have to be finished)
+		/// @note Buffer MUST be mapped before calling
+		void read(void* data, VkDeviceSize size, VkDeviceSize offset = 0) const
+		{
+			AGX_ASSERT_X(m_mapped, "Called read on buffer before map");
+			AGX_ASSERT_X(offset + size <= m_bufferSize, "Read range exceeds buffer size");
+			VK_CHECK(vma::vmaInvalidateAllocation(VulkanContext::device().allocator(), m_allocation, offset, size));
+			memcpy(data, static_cast<const uint8_t*>(m_mapped) + offset, size);
+		}
+
 		/// @brief Flush the memory range at 'index * alignmentSize'
 		void flushIndex(uint32_t index)
 		{
@@ -252,13 +274,13 @@ export namespace Aegis::Graphics
 			flush(m_alignmentSize, index * m_alignmentSize);
 		}
 
-		/// @brief Uploads data to the buffer using a staging buffer (Used for device local memory)
-		void upload(const void* data, VkDeviceSize size)
+		/// @brief Uploads data to the buffer through the staging ring of the upload context (Used for device local memory)
+		/// @note Only waits for the copy outside of an UploadContext::Batch
+		void upload(const void* data, VkDeviceSize size, VkDeviceSize offset = 0)
 		{
-			// TODO: Use a global shared staging buffer (creating a new one for each upload is inefficient)
-			Buffer stagingBuffer{ Buffer::stagingBuffer(size) };
-			stagingBuffer.singleWrite(data, size, 0);
-			stagingBuffer.copyTo(*this, size);
+			AGX_ASSERT_X(data, "Data pointer is null");
+			AGX_ASSERT_X(offset + size <= m_bufferSize, "Upload exceeds buffer size");
+			UploadContext::instance().uploadBuffer(m_buffer, offset, data, size);
 		}
 
 		/// @brief Copy data into the mapped buffer at an offset of 'index * alignmentSize'
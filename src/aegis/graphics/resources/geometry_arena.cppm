@@ -0,0 +1,441 @@
+module;
+
+#include "core/assert.h"
+#include "graphics/vulkan/vulkan_include.h"
+
+#include <aegis-log/log.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <limits>
+#include <span>
+#include <vector>
+
+export module Aegis.Graphics.GeometryArena;
+
+export import Aegis.Graphics.Vertex;
+import Aegis.Math;
+import Aegis.Graphics.Bindless;
+import Aegis.Graphics.Buffer;
+import Aegis.Graphics.OffsetAllocator;
+import Aegis.Graphics.UploadContext;
+import Aegis.Graphics.Vulkan.ResourceTools;
+import Aegis.Graphics.VulkanContext;
+
+export namespace Aegis::Graphics
+{
+	struct BoundingSphere
+	{
+		glm::vec3 center;
+		float radius;
+	};
+
+	struct Meshlet
+	{
+		BoundingSphere bounds;
+		int8_t coneAxis[3];
+		int8_t coneCutoff;
+		uint32_t vertexOffset;		// Relative to the first meshlet vertex of the mesh
+		uint32_t primitiveOffset;	// Relative to the first meshlet primitive of the mesh
+		uint8_t vertexCount;
+		uint8_t primitiveCount;
+	};
+
+	/// @brief Location of a mesh in the geometry arena
+	/// @note This has to match the common::Mesh struct on the slang side (the buffer handles are the same for all meshes)
+	/// @see shaders/modules/common.slang
+	struct alignas(16) MeshData
+	{
+		Bindless::DescriptorHandle vertexBuffer;
+		Bindless::DescriptorHandle indexBuffer;
+		Bindless::DescriptorHandle meshletBuffer;
+		Bindless::DescriptorHandle meshletVertexBuffer;
+		Bindless::DescriptorHandle meshletPrimitiveBuffer;
+		uint32_t vertexOffset;
+		uint32_t indexOffset;
+		uint32_t meshletOffset;
+		uint32_t meshletVertexOffset;
+		uint32_t meshletPrimitiveOffset;
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		uint32_t meshletCount;
+		alignas(16) BoundingSphere bounds;
+	};
+	static_assert(sizeof(MeshData) == 80, "Shader expects MeshData to be 80 bytes");
+
+	/// @brief Non owning view of mesh geometry (e.g. into a memory mapped mesh cache)
+	struct MeshGeometryView
+	{
+		std::span<const Vertex> vertices;
+		std::span<const uint32_t> indices;
+		std::span<const Meshlet> meshlets;
+		std::span<const uint32_t> vertexIndices;
+		std::span<const uint8_t> primitiveIndices;
+		BoundingSphere bounds;
+	};
+
+	struct MeshGeometry
+	{
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		std::vector<Meshlet> meshlets;
+		std::vector<uint32_t> vertexIndices;
+		std::vector<uint8_t> primitiveIndices;
+		BoundingSphere bounds;
+
+		[[nodiscard]] auto view() const -> MeshGeometryView
+		{
+			return MeshGeometryView{ vertices, indices, meshlets, vertexIndices, primitiveIndices, bounds };
+		}
+	};
+
+	/// @brief Stores the geometry of all static meshes in a few large device local buffers (one per vertex stream)
+	/// @note Meshes are suballocated with an OffsetAllocator and addressed by their mesh index, shaders read the MeshData
+	///       record of the mesh from meshDataHandle(). Buffers are replaced (and the records rewritten) when they grow or
+	///       are compacted, so handles have to be queried every frame. Ranges of removed meshes are released once the
+	///       frames in flight are done with them.
+	class GeometryArena
+	{
+	public:
+		static constexpr uint32_t INVALID_MESH = std::numeric_limits<uint32_t>::max();
+		static constexpr uint32_t MIN_MESH_CAPACITY = 1024;
+		static constexpr float MAX_FRAGMENTATION = 0.25f;
+
+		enum Stream : uint32_t
+		{
+			Vertices,
+			Indices,
+			Meshlets,
+			MeshletVertices,
+			MeshletPrimitives,
+			StreamCount
+		};
+
+		GeometryArena()
+		{
+			AGX_ASSERT_X(s_instance == nullptr, "GeometryArena instance already exists!");
+			s_instance = this;
+
+			initializePool(Vertices, "Geometry Arena Vertices", sizeof(Vertex), 1 << 18, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+			initializePool(Indices, "Geometry Arena Indices", sizeof(uint32_t), 1 << 20, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+			initializePool(Meshlets, "Geometry Arena Meshlets", sizeof(Meshlet), 1 << 14);
+			initializePool(MeshletVertices, "Geometry Arena Meshlet Vertices", sizeof(uint32_t), 1 << 18);
+			initializePool(MeshletPrimitives, "Geometry Arena Meshlet Primitives", sizeof(uint8_t), 1 << 20);
+			resizeMeshData(MIN_MESH_CAPACITY);
+		}
+
+		GeometryArena(const GeometryArena&) = delete;
+		GeometryArena(GeometryArena&&) = delete;
+		~GeometryArena()
+		{
+			s_instance = nullptr;
+		}
+
+		auto operator=(const GeometryArena&) -> GeometryArena & = delete;
+		auto operator=(GeometryArena&&) -> GeometryArena & = delete;
+
+		[[nodiscard]] static auto instance() -> GeometryArena&
+		{
+			AGX_ASSERT_X(s_instance, "GeometryArena instance not initialized!");
+			return *s_instance;
+		}
+
+		[[nodiscard]] auto meshDataHandle() const -> Bindless::DescriptorHandle { return m_meshDataBuffer.handle(); }
+		[[nodiscard]] auto meshData(uint32_t mesh) const -> const MeshData& { return m_meshes[mesh].data; }
+		[[nodiscard]] auto meshCount() const -> uint32_t { return static_cast<uint32_t>(m_meshes.size() - m_freeMeshes.size()); }
+
+		/// @brief Ratio of free space that is not part of the largest free range (worst stream)
+		[[nodiscard]] auto fragmentation() const -> float
+		{
+			float fragmentation = 0.0f;
+			for (const auto& pool : m_pools)
+				fragmentation = std::max(fragmentation, pool.allocator.fragmentation());
+			return fragmentation;
+		}
+
+		/// @brief Records the upload of the geometry into the upload context and returns the mesh index
+		/// @note Inside of an UploadContext::Batch the geometry of all meshes is submitted together
+		auto addMesh(const MeshGeometryView& geometry) -> uint32_t
+		{
+			std::array<const void*, StreamCount> sources{
+				geometry.vertices.data(),
+				geometry.indices.data(),
+				geometry.meshlets.data(),
+				geometry.vertexIndices.data(),
+				geometry.primitiveIndices.data(),
+			};
+			std::array<std::size_t, StreamCount> counts{
+				geometry.vertices.size(),
+				geometry.indices.size(),
+				geometry.meshlets.size(),
+				geometry.vertexIndices.size(),
+				geometry.primitiveIndices.size(),
+			};
+
+			uint32_t mesh = allocateMeshRecord();
+			auto& record = m_meshes[mesh];
+
+			bool buffersChanged = false;
+			for (uint32_t stream = 0; stream < StreamCount; stream++)
+			{
+				if (counts[stream] > 0)
+					record.allocations[stream] = allocate(static_cast<Stream>(stream), static_cast<uint32_t>(counts[stream]), buffersChanged);
+			}
+
+			record.data = MeshData{
+				.vertexCount = static_cast<uint32_t>(geometry.vertices.size()),
+				.indexCount = static_cast<uint32_t>(geometry.indices.size()),
+				.meshletCount = static_cast<uint32_t>(geometry.meshlets.size()),
+				.bounds = geometry.bounds,
+			};
+			updateMeshData(record);
+
+			UploadContext::Batch batch;
+			for (uint32_t stream = 0; stream < StreamCount; stream++)
+			{
+				if (counts[stream] == 0)
+					continue;
+
+				auto& pool = m_pools[stream];
+				pool.buffer.buffer().upload(sources[stream], counts[stream] * pool.elementSize,
+					static_cast<VkDeviceSize>(record.allocations[stream].offset) * pool.elementSize);
+			}
+
+			// New buffers change the handles of every record
+			bool rebuildMeshData = buffersChanged || mesh >= m_meshDataCapacity;
+			if (!rebuildMeshData)
+				m_meshDataBuffer.buffer().upload(&record.data, sizeof(MeshData), static_cast<VkDeviceSize>(mesh) * sizeof(MeshData));
+			else
+				resizeMeshData(std::max(m_meshDataCapacity, static_cast<uint32_t>(m_meshes.size())));
+
+			return mesh;
+		}
+
+		/// @brief The ranges are released once the frames in flight no longer read them
+		void removeMesh(uint32_t mesh)
+		{
+			AGX_ASSERT_X(mesh < m_meshes.size() && m_meshes[mesh].used, "Geometry arena: Mesh is not in use");
+			VulkanContext::deletionQueue().schedule([this, mesh]() { releaseMesh(mesh); });
+		}
+
+		/// @brief Binds the shared vertex and index buffer (draw with the offsets of the mesh)
+		void bindBuffers(VkCommandBuffer cmd) const
+		{
+			VkBuffer vertexBuffers[] = { m_pools[Vertices].buffer.buffer() };
+			VkDeviceSize offsets[] = { 0 };
+			vkCmdBindVertexBuffers(cmd, 0, 1, vertexBuffers, offsets);
+			vkCmdBindIndexBuffer(cmd, m_pools[Indices].buffer.buffer(), 0, VK_INDEX_TYPE_UINT32);
+		}
+
+		/// @brief Moves all live ranges to the front of their buffers (into new buffers, the frames in flight keep the old ones)
+		void defragment()
+		{
+			UploadContext::Batch batch;
+			for (uint32_t stream = 0; stream < StreamCount; stream++)
+			{
+				auto& pool = m_pools[stream];
+				if (isCompact(static_cast<Stream>(stream)))
+					continue;
+
+				std::vector<uint32_t> order;
+				for (uint32_t mesh = 0; mesh < m_meshes.size(); mesh++)
+				{
+					if (m_meshes[mesh].allocations[stream].isValid())
+						order.emplace_back(mesh);
+				}
+				std::ranges::sort(order, {}, [&](uint32_t mesh) { return m_meshes[mesh].allocations[stream].offset; });
+
+				Bindless::BindlessBuffer buffer{ createPoolBuffer(pool, pool.allocator.capacity()) };
+				std::vector<VkBufferCopy> regions;
+				uint32_t offset = 0;
+				for (uint32_t mesh : order)
+				{
+					auto& allocation = m_meshes[mesh].allocations[stream];
+					regions.emplace_back(
+						static_cast<VkDeviceSize>(allocation.offset) * pool.elementSize,
+						static_cast<VkDeviceSize>(offset) * pool.elementSize,
+						static_cast<VkDeviceSize>(allocation.size) * pool.elementSize);
+					allocation.offset = offset;
+					offset += allocation.size;
+				}
+
+				UploadContext::instance().copyBuffer(pool.buffer.buffer(), buffer.buffer(), regions);
+
+				pool.allocator.reset(offset);
+				pool.buffer = std::move(buffer);
+			}
+
+			for (auto& record : m_meshes)
+			{
+				if (record.used)
+					updateMeshData(record);
+			}
+			resizeMeshData(m_meshDataCapacity);
+
+			ALOG::info("Geometry arena defragmented ({} meshes)", meshCount());
+		}
+
+	private:
+		struct Pool
+		{
+			const char* name;
+			std::size_t elementSize;
+			VkBufferUsageFlags usage;
+			OffsetAllocator allocator;
+			Bindless::BindlessBuffer buffer;
+		};
+
+		struct MeshRecord
+		{
+			std::array<OffsetAllocator::Allocation, StreamCount> allocations;
+			MeshData data;
+			bool used{ false };
+		};
+
+		static auto createPoolBuffer(const Pool& pool, uint32_t capacity) -> Bindless::BindlessBuffer
+		{
+			Bindless::BindlessBuffer buffer{ Buffer::CreateInfo{
+				.instanceSize = capacity * pool.elementSize,
+				.instanceCount = 1,
+				.usage = pool.usage | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			} };
+			Tools::setDebugUtilsObjectName(buffer.buffer(), pool.name);
+			return buffer;
+		}
+
+		void initializePool(Stream stream, const char* name, std::size_t elementSize, uint32_t capacity, VkBufferUsageFlags usage = 0)
+		{
+			auto& pool = m_pools[stream];
+			pool.name = name;
+			pool.elementSize = elementSize;
+			pool.usage = usage;
+			pool.allocator = OffsetAllocator{ capacity };
+			pool.buffer = createPoolBuffer(pool, capacity);
+		}
+
+		/// @brief Grows the buffer of the stream if no free range is large enough
+		/// @note The buffers are bound as storage buffers, so they can not grow beyond maxStorageBufferRange
+		auto allocate(Stream stream, uint32_t count, bool& buffersChanged) -> OffsetAllocator::Allocation
+		{
+			auto& pool = m_pools[stream];
+			auto allocation = pool.allocator.allocate(count);
+			if (allocation.isValid())
+				return allocation;
+
+			uint64_t maxCapacity = VulkanContext::device().properties().limits.maxStorageBufferRange / pool.elementSize;
+			uint64_t requiredCapacity = static_cast<uint64_t>(pool.allocator.capacity()) + count;
+			AGX_ASSERT_X(requiredCapacity <= maxCapacity, "Geometry arena: Stream exceeds maxStorageBufferRange");
+
+			uint32_t capacity = static_cast<uint32_t>(std::min(std::max(requiredCapacity, uint64_t{ pool.allocator.capacity() } * 2), maxCapacity));
+			Bindless::BindlessBuffer buffer{ createPoolBuffer(pool, capacity) };
+			VkBufferCopy region{
+				.srcOffset = 0,
+				.dstOffset = 0,
+				.size = pool.allocator.capacity() * pool.elementSize,
+			};
+			UploadContext::instance().copyBuffer(pool.buffer.buffer(), buffer.buffer(), std::span{ &region, 1 });
+
+			ALOG::info("Geometry arena: Growing {} to {} elements", pool.name, capacity);
+			pool.buffer = std::move(buffer);
+			pool.allocator.grow(capacity);
+			buffersChanged = true;
+
+			allocation = pool.allocator.allocate(count);
+			AGX_ASSERT_X(allocation.isValid(), "Geometry arena: Allocation failed after growing the buffer");
+			return allocation;
+		}
+
+		/// @brief Whether the live ranges of the stream are already packed at the front of the buffer
+		[[nodiscard]] auto isCompact(Stream stream) const -> bool
+		{
+			uint32_t end = 0;
+			for (const auto& record : m_meshes)
+			{
+				const auto& allocation = record.allocations[stream];
+				if (allocation.isValid())
+					end = std::max(end, allocation.offset + allocation.size);
+			}
+			return end == m_pools[stream].allocator.usedSize();
+		}
+
+		auto allocateMeshRecord() -> uint32_t
+		{
+			uint32_t mesh;
+			if (!m_freeMeshes.empty())
+			{
+				mesh = m_freeMeshes.back();
+				m_freeMeshes.pop_back();
+			}
+			else
+			{
+				mesh = static_cast<uint32_t>(m_meshes.size());
+				m_meshes.emplace_back();
+			}
+
+			m_meshes[mesh] = MeshRecord{ .used = true };
+			return mesh;
+		}
+
+		void releaseMesh(uint32_t mesh)
+		{
+			auto& record = m_meshes[mesh];
+			for (uint32_t stream = 0; stream < StreamCount; stream++)
+			{
+				if (record.allocations[stream].isValid())
+					m_pools[stream].allocator.free(record.allocations[stream]);
+			}
+
+			record = MeshRecord{};
+			m_freeMeshes.emplace_back(mesh);
+		}
+
+		/// @brief Writes the buffer handles and offsets into the record (counts and bounds are kept)
+		void updateMeshData(MeshRecord& record) const
+		{
+			auto offset = [&](Stream stream) {
+				return record.allocations[stream].isValid() ? record.allocations[stream].offset : 0;
+				};
+
+			record.data.vertexBuffer = m_pools[Vertices].buffer.handle();
+			record.data.indexBuffer = m_pools[Indices].buffer.handle();
+			record.data.meshletBuffer = m_pools[Meshlets].buffer.handle();
+			record.data.meshletVertexBuffer = m_pools[MeshletVertices].buffer.handle();
+			record.data.meshletPrimitiveBuffer = m_pools[MeshletPrimitives].buffer.handle();
+			record.data.vertexOffset = offset(Vertices);
+			record.data.indexOffset = offset(Indices);
+			record.data.meshletOffset = offset(Meshlets);
+			record.data.meshletVertexOffset = offset(MeshletVertices);
+			record.data.meshletPrimitiveOffset = offset(MeshletPrimitives);
+		}
+
+		/// @brief Replaces the mesh data buffer and uploads every record (with the current buffer handles)
+		void resizeMeshData(uint32_t capacity)
+		{
+			m_meshDataCapacity = std::max(std::bit_ceil(capacity), MIN_MESH_CAPACITY);
+
+			std::vector<MeshData> records(m_meshDataCapacity);
+			for (uint32_t mesh = 0; mesh < m_meshes.size(); mesh++)
+			{
+				if (m_meshes[mesh].used)
+				{
+					updateMeshData(m_meshes[mesh]);
+					records[mesh] = m_meshes[mesh].data;
+				}
+			}
+
+			m_meshDataBuffer = Bindless::BindlessBuffer{ Buffer::storageBuffer(sizeof(MeshData) * m_meshDataCapacity) };
+			m_meshDataBuffer.buffer().upload(records);
+			Tools::setDebugUtilsObjectName(m_meshDataBuffer.buffer(), "Geometry Arena Mesh Data");
+		}
+
+		inline static GeometryArena* s_instance{ nullptr };
+
+		std::array<Pool, StreamCount> m_pools;
+		std::vector<MeshRecord> m_meshes;
+		std::vector<uint32_t> m_freeMeshes;
+		Bindless::BindlessBuffer m_meshDataBuffer;
+		uint32_t m_meshDataCapacity{ 0 };
+	};
+}
@@ -0,0 +1,210 @@
+module;
+
+#include "core/assert.h"
+#include "graphics/vulkan/vulkan_include.h"
+
+#include <aegis-log/log.h>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <memory>
+#include <span>
+#include <vector>
+
+export module Aegis.Graphics.IBLCache;
+
+import Aegis.Core.Globals;
+import Aegis.Graphics.Buffer;
+import Aegis.Graphics.Components;
+import Aegis.Graphics.KTX2;
+import Aegis.Graphics.Texture;
+import Aegis.Graphics.UploadContext;
+import Aegis.Graphics.VulkanContext;
+import Aegis.Utils.File;
+
+export namespace Aegis::Graphics
+{
+	/// @brief Generated image based lighting maps, written to CACHE_DIR/ibl on the first load of an environment
+	/// @note The skybox, irradiance and prefiltered cube maps are keyed by the hash of the source image and the generation
+	///       parameters (sizes and IBL shader binaries), the BRDF LUT only by the parameters. A cache hit uploads all
+	///       maps in one upload batch without building any compute pipelines, missing maps are generated on their own.
+	class IBLCache
+	{
+	public:
+		/// @brief Bump when the generated maps change in a way the parameter hash does not cover
+		static constexpr uint32_t VERSION = 1;
+
+		/// @brief Skybox, irradiance, prefiltered map and BRDF LUT of an equirectangular HDR image
+		[[nodiscard]] static auto loadEnvironment(const std::filesystem::path& source) -> Environment
+		{
+			Utils::File::MappedFile file{ source };
+			if (!file.isValid())
+			{
+				ALOG::fatal("Failed to load environment: '{}'", source.string());
+				AGX_ASSERT_X(false, "Failed to load environment");
+			}
+
+			auto sourceHash = Utils::File::hash(file.bytes(), parametersHash());
+			auto path = [&](const char* map) {
+				return Core::CACHE_DIR / "ibl" / std::format("{}-{:016x}-{}.ktx2", source.stem().string(), sourceHash, map);
+				};
+			std::array<std::filesystem::path, 3> paths{ path("skybox"), path("irradiance"), path("prefiltered") };
+
+			// Valid entries are kept on a partial hit, only the missing maps are generated
+			Environment environment;
+			{
+				UploadContext::Batch batch;
+				environment.skybox = loadCached(paths[0], 6);
+				environment.irradiance = loadCached(paths[1], 6);
+				environment.prefiltered = loadCached(paths[2], 6);
+				environment.brdfLUT = brdfLUT();
+			}
+
+			if (environment.skybox && environment.irradiance && environment.prefiltered)
+				return environment;
+
+			ALOG::info("Generating image based lighting maps for '{}'", source.string());
+			if (!environment.skybox)
+			{
+				environment.skybox = Texture::loadCubemap(source);
+				write(paths[0], *environment.skybox);
+			}
+			if (!environment.irradiance)
+			{
+				environment.irradiance = Texture::irradianceMap(environment.skybox);
+				write(paths[1], *environment.irradiance);
+			}
+			if (!environment.prefiltered)
+			{
+				environment.prefiltered = Texture::prefilteredMap(environment.skybox);
+				write(paths[2], *environment.prefiltered);
+			}
+			return environment;
+		}
+
+		/// @brief BRDF integration LUT, shared by all environments while any of them is alive
+		[[nodiscard]] static auto brdfLUT() -> std::shared_ptr<Texture>
+		{
+			static std::weak_ptr<Texture> s_lut;
+			if (auto lut = s_lut.lock())
+				return lut;
+
+			auto path = Core::CACHE_DIR / "ibl" / std::format("brdf_lut-{:016x}.ktx2", parametersHash());
+			auto lut = loadCached(path, 1);
+			if (!lut)
+			{
+				lut = Texture::BRDFLUT();
+				write(path, *lut);
+			}
+
+			s_lut = lut;
+			return lut;
+		}
+
+	private:
+		/// @brief Hash of everything besides the source image that changes the generated maps
+		[[nodiscard]] static auto parametersHash() -> uint64_t
+		{
+			std::array<uint32_t, 5> parameters{
+				VERSION, Texture::IRRADIANCE_SIZE, Texture::PREFILTERED_SIZE, Texture::PREFILTERED_MIP_LEVELS, Texture::BRDF_LUT_SIZE
+			};
+			uint64_t hash = Utils::File::hash(std::as_bytes(std::span{ parameters }));
+			for (const char* shader : { "ibl/equirect_to_cube.slang.spv", "ibl/irradiance_convolution.slang.spv",
+				"ibl/prefilter_environment.slang.spv", "ibl/brdf_lut.slang.spv" })
+			{
+				Utils::File::MappedFile binary{ Core::SHADER_DIR / shader };
+				hash = Utils::File::hash(binary.bytes(), hash);
+			}
+			return hash;
+		}
+
+		/// @brief Uploads a cached map (joins the current upload batch), returns nothing if it is missing or invalid
+		[[nodiscard]] static auto loadCached(const std::filesystem::path& path, uint32_t faceCount) -> std::shared_ptr<Texture>
+		{
+			Utils::File::MappedFile file{ path };
+			if (!file.isValid())
+				return nullptr;
+
+			auto data = KTX2::read(file.bytes());
+			if (!data || data->faceCount != faceCount)
+			{
+				ALOG::warn("IBL cache '{}' is corrupt", path.string());
+				return nullptr;
+			}
+
+			auto info = faceCount == 6
+				? Texture::CreateInfo::cubeMap(data->width, data->format)
+				: Texture::CreateInfo::texture2D(data->width, data->height, data->format);
+			info.image.mipLevels = static_cast<uint32_t>(data->levelOffsets.size());
+			if (faceCount == 1)
+			{
+				info.sampler.addressMode = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			}
+
+			auto texture = std::make_shared<Texture>(info);
+			texture->image().upload(data->data.data(), data->data.size(), data->levelOffsets);
+			return texture;
+		}
+
+		/// @brief Copies all levels and layers of the texture back to the host and writes them as a KTX2 file
+		static void write(const std::filesystem::path& path, Texture& texture)
+		{
+			auto& image = texture.image();
+			std::vector<VkDeviceSize> levelOffsets(image.mipLevels());
+			std::vector<VkBufferImageCopy> regions(image.mipLevels());
+			VkDeviceSize size = 0;
+			for (uint32_t level = 0; level < image.mipLevels(); level++)
+			{
+				uint32_t width = std::max(image.width() >> level, 1u);
+				uint32_t height = std::max(image.height() >> level, 1u);
+				levelOffsets[level] = size;
+				regions[level] = VkBufferImageCopy{
+					.bufferOffset = size,
+					.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, image.layerCount() },
+					.imageExtent = { width, height, 1 },
+				};
+				size += KTX2::levelSize(image.format(), width, height) * image.layerCount();
+			}
+			AGX_ASSERT_X(size > 0, "Unsupported format for the IBL cache");
+
+			Buffer readback{ Buffer::readbackBuffer(size) };
+			VkCommandBuffer cmd = VulkanContext::device().beginSingleTimeCommands();
+			{
+				image.transitionLayout(cmd, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+				vkCmdCopyImageToBuffer(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback,
+					static_cast<uint32_t>(regions.size()), regions.data());
+
+				VkMemoryBarrier barrier{
+					.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+					.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+					.dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+				};
+				vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+					1, &barrier, 0, nullptr, 0, nullptr);
+
+				image.transitionLayout(cmd, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			}
+			VulkanContext::device().endSingleTimeCommands(cmd);
+
+			std::vector<std::byte> pixels(size);
+			readback.read(pixels.data(), size);
+
+			std::vector<std::span<const std::byte>> levels(image.mipLevels());
+			for (uint32_t level = 0; level < image.mipLevels(); level++)
+			{
+				VkDeviceSize end = level + 1 < image.mipLevels() ? levelOffsets[level + 1] : size;
+				levels[level] = std::span{ pixels }.subspan(levelOffsets[level], end - levelOffsets[level]);
+			}
+
+			auto file = KTX2::encode(image.format(), image.width(), image.height(), levels, image.layerCount());
+			if (!Utils::File::writeBinaryAtomic(path, file))
+			{
+				ALOG::warn("Failed to write IBL cache '{}'", path.string());
+			}
+		}
+	};
+}
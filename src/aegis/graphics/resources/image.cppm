@@ -1,13 +1,18 @@
 module;
 
+#include "core/assert.h"
 #include "graphics/vulkan/vulkan_include.h"
 
+#include <algorithm>
 #include <cmath>
 #include <cstdint>
+#include <span>
+#include <vector>
 
 export module Aegis.Graphics.Image;
 
 import Aegis.Graphics.Buffer;
+import Aegis.Graphics.UploadContext;
 import Aegis.Graphics.VulkanContext;
 import Aegis.Graphics.Vulkan.Tools;
 import Aegis.Graphics.Vulkan.VulkanMemory;
@@ -104,11 +109,52 @@ export namespace Aegis::Graphics
 			VulkanContext::device().endSingleTimeCommands(cmd);
 		}
 
+		/// @brief Uploads the first mip level through the upload context and generates the others
+		/// @note Recorded on the graphics queue (blits), only waits for the copy outside of an UploadContext::Batch
 		void upload(const void* data, VkDeviceSize size)
 		{
-			Buffer stagingBuffer{ Buffer::stagingBuffer(size) };
-			stagingBuffer.singleWrite(data);
-			upload(stagingBuffer);
+			auto& uploads = UploadContext::instance();
+			auto staging = uploads.stage(data, size);
+			VkCommandBuffer cmd = uploads.commands(UploadContext::Queue::Graphics);
+			{
+				Tools::vk::cmdTransitionImageLayout(cmd, m_image, m_format, m_layout, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, m_mipLevels, m_layerCount);
+				Tools::vk::cmdCopyBufferToImage(cmd, staging.buffer, staging.offset, m_image, m_extent, m_layerCount);
+				generateMipmaps(cmd, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			}
+			uploads.submitIfImmediate();
+		}
+
+		/// @brief Uploads a complete mip chain (e.g. of a block compressed texture), no mip levels are generated
+		/// @note All levels are staged together, the level offsets are relative to data and aligned to the texel block size
+		void upload(const void* data, VkDeviceSize size, std::span<const VkDeviceSize> levelOffsets)
+		{
+			AGX_ASSERT_X(levelOffsets.size() == m_mipLevels, "Mip level count does not match the image");
+
+			auto& uploads = UploadContext::instance();
+			auto staging = uploads.stage(data, size);
+			VkCommandBuffer cmd = uploads.commands(UploadContext::Queue::Graphics);
+			{
+				std::vector<VkBufferImageCopy> regions(levelOffsets.size());
+				for (uint32_t level = 0; level < regions.size(); level++)
+				{
+					regions[level] = VkBufferImageCopy{
+						.bufferOffset = staging.offset + levelOffsets[level],
+						.imageSubresource = VkImageSubresourceLayers{
+							.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+							.mipLevel = level,
+							.baseArrayLayer = 0,
+							.layerCount = m_layerCount,
+						},
+						.imageExtent = VkExtent3D{ std::max(m_extent.width >> level, 1u), std::max(m_extent.height >> level, 1u), 1 },
+					};
+				}
+
+				transitionLayout(cmd, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+				vkCmdCopyBufferToImage(cmd, staging.buffer, m_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+					static_cast<uint32_t>(regions.size()), regions.data());
+				transitionLayout(cmd, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			}
+			uploads.submitIfImmediate();
 		}
 
 		//void fill(const Buffer& buffer);
@@ -0,0 +1,314 @@
+module;
+
+#include "graphics/vulkan/vulkan_include.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <vector>
+
+export module Aegis.Graphics.KTX2;
+
+namespace Aegis::Graphics::KTX2
+{
+	constexpr std::array<uint8_t, 12> IDENTIFIER{ 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+	struct Header
+	{
+		std::array<uint8_t, 12> identifier;
+		uint32_t vkFormat;
+		uint32_t typeSize;
+		uint32_t pixelWidth;
+		uint32_t pixelHeight;
+		uint32_t pixelDepth;
+		uint32_t layerCount;
+		uint32_t faceCount;
+		uint32_t levelCount;
+		uint32_t supercompressionScheme;
+		uint32_t dfdByteOffset;
+		uint32_t dfdByteLength;
+		uint32_t kvdByteOffset;
+		uint32_t kvdByteLength;
+		uint64_t sgdByteOffset;
+		uint64_t sgdByteLength;
+	};
+	static_assert(sizeof(Header) == 80, "KTX2 header must be 80 bytes");
+
+	struct LevelIndex
+	{
+		uint64_t byteOffset;
+		uint64_t byteLength;
+		uint64_t uncompressedByteLength;
+	};
+
+	/// @brief Basic data format descriptor (Khronos Data Format Specification) of the formats written by the engine
+	auto dataFormatDescriptor(VkFormat format) -> std::vector<uint32_t>
+	{
+		constexpr uint32_t MODEL_RGBSDA = 1;
+		constexpr uint32_t MODEL_BC4 = 131;
+		constexpr uint32_t MODEL_BC5 = 132;
+		constexpr uint32_t MODEL_BC7 = 134;
+		constexpr uint32_t PRIMARIES_BT709 = 1;
+		constexpr uint32_t TRANSFER_LINEAR = 1;
+		constexpr uint32_t TRANSFER_SRGB = 2;
+
+		struct Sample
+		{
+			uint32_t bitOffset;
+			uint32_t bitLength;
+			uint32_t channel;
+			uint32_t lower;
+			uint32_t upper;
+		};
+
+		// Half floats are signed, lower and upper are the bits of -1.0f and 1.0f
+		constexpr uint32_t FLOAT_QUALIFIERS = 0x80 | 0x40;
+		constexpr uint32_t FLOAT_LOWER = 0xBF800000;
+		constexpr uint32_t FLOAT_UPPER = 0x3F800000;
+
+		uint32_t model = 0;
+		uint32_t blockDimension = 0;	// Texel block size - 1 per dimension
+		uint32_t bytesPlane0 = 0;
+		uint32_t transfer = TRANSFER_LINEAR;
+		std::vector<Sample> samples;
+		switch (format)
+		{
+		case VK_FORMAT_BC4_UNORM_BLOCK:
+			model = MODEL_BC4;
+			blockDimension = 3 | (3 << 8);
+			bytesPlane0 = 8;
+			samples = { { 0, 64, 0, 0, 0xFFFFFFFF } };
+			break;
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+			model = MODEL_BC5;
+			blockDimension = 3 | (3 << 8);
+			bytesPlane0 = 16;
+			samples = { { 0, 64, 0, 0, 0xFFFFFFFF }, { 64, 64, 1, 0, 0xFFFFFFFF } };
+			break;
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+			transfer = TRANSFER_SRGB;
+			[[fallthrough]];
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+			model = MODEL_BC7;
+			blockDimension = 3 | (3 << 8);
+			bytesPlane0 = 16;
+			samples = { { 0, 128, 0, 0, 0xFFFFFFFF } };
+			break;
+		case VK_FORMAT_R8G8B8A8_SRGB:
+			transfer = TRANSFER_SRGB;
+			[[fallthrough]];
+		case VK_FORMAT_R8G8B8A8_UNORM:
+			model = MODEL_RGBSDA;
+			bytesPlane0 = 4;
+			samples = { { 0, 8, 0, 0, 255 }, { 8, 8, 1, 0, 255 }, { 16, 8, 2, 0, 255 }, { 24, 8, 15, 0, 255 } };
+			break;
+		case VK_FORMAT_R16G16_SFLOAT:
+			model = MODEL_RGBSDA;
+			bytesPlane0 = 4;
+			samples = {
+				{ 0, 16, 0 | FLOAT_QUALIFIERS, FLOAT_LOWER, FLOAT_UPPER },
+				{ 16, 16, 1 | FLOAT_QUALIFIERS, FLOAT_LOWER, FLOAT_UPPER },
+			};
+			break;
+		case VK_FORMAT_R16G16B16A16_SFLOAT:
+			model = MODEL_RGBSDA;
+			bytesPlane0 = 8;
+			samples = {
+				{ 0, 16, 0 | FLOAT_QUALIFIERS, FLOAT_LOWER, FLOAT_UPPER },
+				{ 16, 16, 1 | FLOAT_QUALIFIERS, FLOAT_LOWER, FLOAT_UPPER },
+				{ 32, 16, 2 | FLOAT_QUALIFIERS, FLOAT_LOWER, FLOAT_UPPER },
+				{ 48, 16, 15 | FLOAT_QUALIFIERS, FLOAT_LOWER, FLOAT_UPPER },
+			};
+			break;
+		default:
+			return {};
+		}
+
+		uint32_t blockSize = 24 + 16 * static_cast<uint32_t>(samples.size());
+		std::vector<uint32_t> words{
+			4 + blockSize,											// dfdTotalSize
+			0,														// vendorId = Khronos, descriptorType = basic
+			2 | (blockSize << 16),									// versionNumber, descriptorBlockSize
+			model | (PRIMARIES_BT709 << 8) | (transfer << 16),		// flags = straight alpha
+			blockDimension,
+			bytesPlane0,
+			0,
+		};
+
+		for (const auto& sample : samples)
+		{
+			// The alpha channel of sRGB formats is always linear
+			uint32_t qualifiers = (transfer == TRANSFER_SRGB && sample.channel == 15) ? 0x10 : 0;
+			words.push_back(sample.bitOffset | ((sample.bitLength - 1) << 16) | ((sample.channel | qualifiers) << 24));
+			words.push_back(0);
+			words.push_back(sample.lower);
+			words.push_back(sample.upper);
+		}
+		return words;
+	}
+
+	auto alignTo(std::size_t value, std::size_t alignment) -> std::size_t
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+export namespace Aegis::Graphics::KTX2
+{
+	/// @brief Mip chain of a 2D texture or cube map, all levels are stored in one contiguous range
+	/// @note The faces of a cube map are stored consecutively in each level
+	struct TextureData
+	{
+		VkFormat format{ VK_FORMAT_UNDEFINED };
+		uint32_t width{ 0 };
+		uint32_t height{ 0 };
+		uint32_t faceCount{ 1 };
+		std::span<const std::byte> data;
+		std::vector<VkDeviceSize> levelOffsets;	// Relative to data, level 0 is the largest
+	};
+
+	/// @brief Bytes of one mip level (of one face), returns 0 for formats that are not supported by the reader and writer
+	[[nodiscard]] constexpr auto levelSize(VkFormat format, uint32_t width, uint32_t height) -> VkDeviceSize
+	{
+		auto blocks = [&](VkDeviceSize blockSize) {
+			return VkDeviceSize{ (width + 3) / 4 } * ((height + 3) / 4) * blockSize;
+			};
+
+		switch (format)
+		{
+		case VK_FORMAT_BC4_UNORM_BLOCK:
+			return blocks(8);
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+			return blocks(16);
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_SRGB:
+		case VK_FORMAT_R16G16_SFLOAT:
+			return VkDeviceSize{ width } * height * 4;
+		case VK_FORMAT_R16G16B16A16_SFLOAT:
+			return VkDeviceSize{ width } * height * 8;
+		default:
+			return 0;
+		}
+	}
+
+	/// @brief Whether the format is one of the BC formats (requires textureCompressionBC to be sampled)
+	[[nodiscard]] constexpr auto isBlockCompressed(VkFormat format) -> bool
+	{
+		return format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK;
+	}
+
+	[[nodiscard]] auto isKTX2(std::span<const std::byte> file) -> bool
+	{
+		return file.size() >= IDENTIFIER.size() && std::memcmp(file.data(), IDENTIFIER.data(), IDENTIFIER.size()) == 0;
+	}
+
+	/// @brief Reads an uncompressed (no supercompression) 2D texture or cube map, the result points into the file data
+	/// @note The data format descriptor is not interpreted, vkFormat alone has to describe the texel data
+	[[nodiscard]] auto read(std::span<const std::byte> file) -> std::optional<TextureData>
+	{
+		if (file.size() < sizeof(Header) || !isKTX2(file))
+			return std::nullopt;
+
+		Header header;
+		std::memcpy(&header, file.data(), sizeof(Header));
+
+		VkFormat format = static_cast<VkFormat>(header.vkFormat);
+		if (header.supercompressionScheme != 0 || header.pixelDepth > 1 || header.layerCount > 1
+			|| (header.faceCount != 1 && header.faceCount != 6))
+			return std::nullopt;
+
+		if (header.levelCount == 0 || header.pixelWidth == 0 || header.pixelHeight == 0
+			|| levelSize(format, header.pixelWidth, header.pixelHeight) == 0)
+			return std::nullopt;
+
+		std::size_t levelIndexEnd = sizeof(Header) + header.levelCount * sizeof(LevelIndex);
+		if (file.size() < levelIndexEnd)
+			return std::nullopt;
+
+		std::vector<LevelIndex> levels(header.levelCount);
+		std::memcpy(levels.data(), file.data() + sizeof(Header), levels.size() * sizeof(LevelIndex));
+
+		// Levels are stored smallest first, the range covers all of them
+		uint64_t begin = file.size();
+		uint64_t end = 0;
+		for (uint32_t level = 0; level < header.levelCount; level++)
+		{
+			uint32_t width = std::max(header.pixelWidth >> level, 1u);
+			uint32_t height = std::max(header.pixelHeight >> level, 1u);
+			const auto& index = levels[level];
+			if (index.byteLength != levelSize(format, width, height) * header.faceCount || index.byteOffset + index.byteLength > file.size())
+				return std::nullopt;
+
+			begin = std::min(begin, index.byteOffset);
+			end = std::max(end, index.byteOffset + index.byteLength);
+		}
+
+		TextureData texture{
+			.format = format,
+			.width = header.pixelWidth,
+			.height = header.pixelHeight,
+			.faceCount = header.faceCount,
+			.data = file.subspan(begin, end - begin),
+		};
+		texture.levelOffsets.reserve(levels.size());
+		for (const auto& index : levels)
+		{
+			texture.levelOffsets.push_back(index.byteOffset - begin);
+		}
+		return texture;
+	}
+
+	/// @brief Encodes a 2D texture or cube map (levels[0] is the largest mip level) into a KTX2 file
+	[[nodiscard]] auto encode(VkFormat format, uint32_t width, uint32_t height,
+		std::span<const std::span<const std::byte>> levels, uint32_t faceCount = 1) -> std::vector<std::byte>
+	{
+		auto dfd = dataFormatDescriptor(format);
+		if (dfd.empty() || levels.empty())
+			return {};
+
+		std::size_t dfdOffset = sizeof(Header) + levels.size() * sizeof(LevelIndex);
+		std::size_t dfdSize = dfd.size() * sizeof(uint32_t);
+
+		// Mip levels are aligned to lcm(texel block size, 4), stored from the smallest to the largest level
+		std::size_t alignment = std::max<std::size_t>(levelSize(format, 1, 1), 4);
+		std::vector<LevelIndex> levelIndex(levels.size());
+		std::size_t size = dfdOffset + dfdSize;
+		for (std::size_t level = levels.size(); level-- > 0;)
+		{
+			size = alignTo(size, alignment);
+			levelIndex[level] = LevelIndex{ size, levels[level].size(), levels[level].size() };
+			size += levels[level].size();
+		}
+
+		Header header{
+			.vkFormat = static_cast<uint32_t>(format),
+			.typeSize = (format == VK_FORMAT_R16G16_SFLOAT || format == VK_FORMAT_R16G16B16A16_SFLOAT) ? 2u : 1u,
+			.pixelWidth = width,
+			.pixelHeight = height,
+			.pixelDepth = 0,
+			.layerCount = 0,
+			.faceCount = faceCount,
+			.levelCount = static_cast<uint32_t>(levels.size()),
+			.supercompressionScheme = 0,
+			.dfdByteOffset = static_cast<uint32_t>(dfdOffset),
+			.dfdByteLength = static_cast<uint32_t>(dfdSize),
+		};
+		std::memcpy(header.identifier.data(), IDENTIFIER.data(), IDENTIFIER.size());
+
+		std::vector<std::byte> file(size);
+		std::memcpy(file.data(), &header, sizeof(Header));
+		std::memcpy(file.data() + sizeof(Header), levelIndex.data(), levelIndex.size() * sizeof(LevelIndex));
+		std::memcpy(file.data() + dfdOffset, dfd.data(), dfdSize);
+		for (std::size_t level = 0; level < levels.size(); level++)
+		{
+			std::memcpy(file.data() + levelIndex[level].byteOffset, levels[level].data(), levels[level].size());
+		}
+		return file;
+	}
+}
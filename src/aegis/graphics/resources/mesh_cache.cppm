@@ -0,0 +1,233 @@
+module;
+
+#include "core/assert.h"
+
+#include <aegis-log/log.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <system_error>
+#include <vector>
+
+export module Aegis.Graphics.MeshCache;
+
+import Aegis.Core.Globals;
+import Aegis.Graphics.GeometryArena;
+import Aegis.Graphics.MeshPreprocessor;
+import Aegis.Utils.File;
+
+export namespace Aegis::Graphics
+{
+	/// @brief Cooked meshes of one source asset, written on the first import and memory mapped on later loads
+	/// @note Layout: Header, one Entry per mesh, then the streams of every mesh (16 byte aligned). The cache is only used
+	///       if the hash of the source content and the preprocessing options match, the views returned by mesh() point
+	///       directly into the mapping and are uploaded from there.
+	class MeshCache
+	{
+	public:
+		static constexpr uint32_t MAGIC = 0x4D584741; // "AGXM"
+		static constexpr uint32_t VERSION = 1;
+		static constexpr std::size_t STREAM_ALIGNMENT = 16;
+
+		struct Header
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint64_t sourceHash;
+			uint64_t optionsHash;
+			uint32_t meshCount;
+			uint32_t reserved;
+		};
+
+		struct Entry
+		{
+			std::array<uint64_t, GeometryArena::StreamCount> offsets;	// In bytes from the start of the file
+			std::array<uint32_t, GeometryArena::StreamCount> counts;
+			uint32_t reserved;
+			BoundingSphere bounds;
+		};
+
+		/// @brief Location of the cooked meshes of a source asset in the cache directory
+		[[nodiscard]] static auto cachePath(const std::filesystem::path& source) -> std::filesystem::path
+		{
+			std::error_code error;
+			auto absolute = std::filesystem::absolute(source, error);
+			auto pathHash = std::hash<std::string>{}((error ? source : absolute).string());
+			return Core::CACHE_DIR / "meshes" / std::format("{}-{:016x}.agxmesh", source.stem().string(), pathHash);
+		}
+
+		/// @brief Hash of everything that changes the output of MeshPreprocessor::process (besides the source data)
+		[[nodiscard]] static auto optionsHash(const MeshPreprocessor::Input& options = {}) -> uint64_t
+		{
+			struct Options
+			{
+				uint64_t version;
+				uint64_t vertexSize;
+				uint64_t meshletSize;
+				uint64_t maxVerticesPerMeshlet;
+				uint64_t maxTrianglesPerMeshlet;
+				float overdrawThreshold;
+				float coneWeight;
+			} values{
+				.version = VERSION,
+				.vertexSize = sizeof(Vertex),
+				.meshletSize = sizeof(Meshlet),
+				.maxVerticesPerMeshlet = options.maxVerticesPerMeshlet,
+				.maxTrianglesPerMeshlet = options.maxTrianglesPerMeshlet,
+				.overdrawThreshold = options.overdrawThreshold,
+				.coneWeight = options.coneWeight,
+			};
+			return Utils::File::hash(std::as_bytes(std::span{ &values, 1 }));
+		}
+
+		/// @brief Maps the cache file, returns nothing if it is missing, corrupt or out of date
+		[[nodiscard]] static auto open(const std::filesystem::path& path, uint64_t sourceHash, uint64_t optionsHash) -> std::optional<MeshCache>
+		{
+			Utils::File::MappedFile file{ path };
+			if (!file.isValid() || file.size() < sizeof(Header))
+				return std::nullopt;
+
+			const auto* header = reinterpret_cast<const Header*>(file.data());
+			if (header->magic != MAGIC || header->version != VERSION)
+			{
+				ALOG::warn("Mesh cache '{}' has an unsupported format", path.string());
+				return std::nullopt;
+			}
+
+			if (header->sourceHash != sourceHash || header->optionsHash != optionsHash)
+			{
+				ALOG::info("Mesh cache '{}' is out of date", path.string());
+				return std::nullopt;
+			}
+
+			std::size_t entriesEnd = sizeof(Header) + static_cast<std::size_t>(header->meshCount) * sizeof(Entry);
+			if (file.size() < entriesEnd)
+				return std::nullopt;
+
+			MeshCache cache{ std::move(file) };
+			for (uint32_t mesh = 0; mesh < cache.meshCount(); mesh++)
+			{
+				const auto& entry = cache.entries()[mesh];
+				for (uint32_t stream = 0; stream < GeometryArena::StreamCount; stream++)
+				{
+					uint64_t end = entry.offsets[stream] + static_cast<uint64_t>(entry.counts[stream]) * STREAM_SIZES[stream];
+					if (entry.offsets[stream] % STREAM_ALIGNMENT != 0 || end > cache.m_file.size())
+					{
+						ALOG::warn("Mesh cache '{}' is corrupt", path.string());
+						return std::nullopt;
+					}
+				}
+			}
+
+			return cache;
+		}
+
+		/// @brief Writes the cooked meshes (replaces an existing cache file), returns false if it could not be written
+		static auto write(const std::filesystem::path& path, uint64_t sourceHash, uint64_t optionsHash,
+			std::span<const MeshGeometry> meshes) -> bool
+		{
+			std::vector<Entry> entries(meshes.size());
+			std::size_t size = alignTo(sizeof(Header) + entries.size() * sizeof(Entry));
+			for (std::size_t mesh = 0; mesh < meshes.size(); mesh++)
+			{
+				auto streams = streamsOf(meshes[mesh].view());
+				for (uint32_t stream = 0; stream < GeometryArena::StreamCount; stream++)
+				{
+					entries[mesh].offsets[stream] = size;
+					entries[mesh].counts[stream] = static_cast<uint32_t>(streams[stream].size() / STREAM_SIZES[stream]);
+					size = alignTo(size + streams[stream].size());
+				}
+				entries[mesh].bounds = meshes[mesh].bounds;
+			}
+
+			std::vector<std::byte> data(size);
+			Header header{
+				.magic = MAGIC,
+				.version = VERSION,
+				.sourceHash = sourceHash,
+				.optionsHash = optionsHash,
+				.meshCount = static_cast<uint32_t>(meshes.size()),
+			};
+			std::memcpy(data.data(), &header, sizeof(header));
+			std::memcpy(data.data() + sizeof(Header), entries.data(), entries.size() * sizeof(Entry));
+			for (std::size_t mesh = 0; mesh < meshes.size(); mesh++)
+			{
+				auto streams = streamsOf(meshes[mesh].view());
+				for (uint32_t stream = 0; stream < GeometryArena::StreamCount; stream++)
+				{
+					if (!streams[stream].empty())
+						std::memcpy(data.data() + entries[mesh].offsets[stream], streams[stream].data(), streams[stream].size());
+				}
+			}
+
+			if (!Utils::File::writeBinaryAtomic(path, data))
+			{
+				ALOG::warn("Failed to write mesh cache '{}'", path.string());
+				return false;
+			}
+			return true;
+		}
+
+		[[nodiscard]] auto meshCount() const -> uint32_t { return header().meshCount; }
+
+		/// @brief Geometry of the mesh inside the mapping (valid as long as the cache lives)
+		[[nodiscard]] auto mesh(uint32_t index) const -> MeshGeometryView
+		{
+			AGX_ASSERT_X(index < meshCount(), "Mesh cache index out of range");
+			const auto& entry = entries()[index];
+			return MeshGeometryView{
+				.vertices = stream<Vertex>(entry, GeometryArena::Vertices),
+				.indices = stream<uint32_t>(entry, GeometryArena::Indices),
+				.meshlets = stream<Meshlet>(entry, GeometryArena::Meshlets),
+				.vertexIndices = stream<uint32_t>(entry, GeometryArena::MeshletVertices),
+				.primitiveIndices = stream<uint8_t>(entry, GeometryArena::MeshletPrimitives),
+				.bounds = entry.bounds,
+			};
+		}
+
+	private:
+		static constexpr std::array<std::size_t, GeometryArena::StreamCount> STREAM_SIZES{
+			sizeof(Vertex), sizeof(uint32_t), sizeof(Meshlet), sizeof(uint32_t), sizeof(uint8_t)
+		};
+
+		explicit MeshCache(Utils::File::MappedFile file) : m_file{ std::move(file) } {}
+
+		[[nodiscard]] static constexpr auto alignTo(std::size_t size) -> std::size_t
+		{
+			return (size + STREAM_ALIGNMENT - 1) & ~(STREAM_ALIGNMENT - 1);
+		}
+
+		[[nodiscard]] static auto streamsOf(const MeshGeometryView& geometry) -> std::array<std::span<const std::byte>, GeometryArena::StreamCount>
+		{
+			return {
+				std::as_bytes(geometry.vertices),
+				std::as_bytes(geometry.indices),
+				std::as_bytes(geometry.meshlets),
+				std::as_bytes(geometry.vertexIndices),
+				std::as_bytes(geometry.primitiveIndices),
+			};
+		}
+
+		[[nodiscard]] auto header() const -> const Header& { return *reinterpret_cast<const Header*>(m_file.data()); }
+		[[nodiscard]] auto entries() const -> const Entry*
+		{
+			return reinterpret_cast<const Entry*>(m_file.data() + sizeof(Header));
+		}
+
+		template<typename T>
+		[[nodiscard]] auto stream(const Entry& entry, GeometryArena::Stream stream) const -> std::span<const T>
+		{
+			return { reinterpret_cast<const T*>(m_file.data() + entry.offsets[stream]), entry.counts[stream] };
+		}
+
+		Utils::File::MappedFile m_file;
+	};
+}
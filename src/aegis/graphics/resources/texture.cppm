@@ -25,12 +25,20 @@ import Aegis.Graphics.Pipeline;
 import Aegis.Graphics.Bindless.DescriptorHandle;
 import Aegis.Graphics.Bindless.BindlessDescriptorSet;
 import Aegis.Graphics.Buffer;
+import Aegis.Graphics.KTX2;
+import Aegis.Utils.File;
 
 export namespace Aegis::Graphics
 {
 	class Texture : public Core::Asset
 	{
 	public:
+		/// @brief Sizes of the generated image based lighting maps (see irradianceMap, prefilteredMap and BRDFLUT)
+		static constexpr uint32_t IRRADIANCE_SIZE = 32;
+		static constexpr uint32_t PREFILTERED_SIZE = 128;
+		static constexpr uint32_t PREFILTERED_MIP_LEVELS = 5;
+		static constexpr uint32_t BRDF_LUT_SIZE = 512;
+
 		struct CreateInfo
 		{
 			static auto texture2D(uint32_t width, uint32_t height, VkFormat format) -> CreateInfo
@@ -80,6 +88,11 @@ export namespace Aegis::Graphics
 				return Texture::loadCubemap(file);
 			}
 
+			if (file.extension() == ".ktx2")
+			{
+				return Texture::loadKTX2(file);
+			}
+
 			return Texture::loadTextur2D(file, format);
 		}
 
@@ -107,11 +120,40 @@ export namespace Aegis::Graphics
 			return texture;
 		}
 
+		/// @brief Uploads the mip chain of a KTX2 file (e.g. cooked by the TextureCooker) directly from the file mapping
+		static auto loadKTX2(const std::filesystem::path& file) -> std::shared_ptr<Texture>
+		{
+			Utils::File::MappedFile mapping{ file };
+			auto data = KTX2::read(mapping.bytes());
+			if (!data)
+			{
+				ALOG::fatal("Failed to load KTX2 texture: '{}'", file.string());
+				AGX_ASSERT_X(false, "Failed to load KTX2 texture");
+			}
+
+			auto info = Texture::CreateInfo::texture2D(data->width, data->height, data->format);
+			info.image.mipLevels = static_cast<uint32_t>(data->levelOffsets.size());
+			auto texture = std::make_shared<Texture>(info);
+			texture->image().upload(data->data.data(), data->data.size(), data->levelOffsets);
+			return texture;
+		}
+
 		static auto loadCubemap(const std::filesystem::path& file) -> std::shared_ptr<Texture>
 		{
 			// HDR environment maps are stored as equirectangular images (longitude/latitude 2D image)
 			// To convert it to a cubemap, the image is sampled in a compute shader and written to the cubemap
 
+			// The pipeline compiles on the job system while the image is decoded
+			auto descriptorSetLayout = DescriptorSetLayout::Builder{}
+				.addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+				.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)
+				.build();
+
+			auto pipeline = Pipeline::ComputeBuilder{}
+				.addDescriptorSetLayout(descriptorSetLayout)
+				.setShaderStage(Core::SHADER_DIR / "ibl/equirect_to_cube.slang.spv")
+				.buildAsync();
+
 			int stbWidth = 0;
 			int stbHeight = 0;
 			int stbChannels = 0;
@@ -143,11 +185,6 @@ export namespace Aegis::Graphics
 			auto cubeMap = std::make_shared<Texture>(cubeInfo);
 
 			// Create pipeline resources
-			auto descriptorSetLayout = DescriptorSetLayout::Builder{}
-				.addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
-				.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)
-				.build();
-
 			DescriptorSet descriptorSet{ descriptorSetLayout };
 
 			ImageView arrayImageView{ ImageView::CreateInfo{.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY }, cubeMap->image() };
@@ -163,11 +200,6 @@ export namespace Aegis::Graphics
 				//.writeImage(1, cubeMap->descriptorImageInfo(VK_IMAGE_LAYOUT_GENERAL))
 				.update(descriptorSet);
 
-			auto pipeline = Pipeline::ComputeBuilder{}
-				.addDescriptorSetLayout(descriptorSetLayout)
-				.setShaderStage(Core::SHADER_DIR / "ibl/equirect_to_cube.slang.spv")
-				.build();
-
 			// Convert spherical image to cubemap
 			VkCommandBuffer cmd = VulkanContext::device().beginSingleTimeCommands();
 			Tools::vk::cmdBeginDebugUtilsLabel(cmd, "Equirectangular to Cubemap");
@@ -175,8 +207,8 @@ export namespace Aegis::Graphics
 				spherialImage.image().copyFrom(cmd, stagingBuffer);
 				cubeMap->image().transitionLayout(cmd, VK_IMAGE_LAYOUT_GENERAL);
 
-				pipeline.bind(cmd);
-				pipeline.bindDescriptorSet(cmd, 0, descriptorSet);
+				pipeline->bind(cmd);
+				pipeline->bindDescriptorSet(cmd, 0, descriptorSet);
 
 				constexpr uint32_t groupSize = 16;
 				uint32_t groupCountX = (width + groupSize - 1) / groupSize;
@@ -231,11 +263,9 @@ export namespace Aegis::Graphics
 
 		static auto irradianceMap(const std::shared_ptr<Texture>& skybox) -> std::shared_ptr<Texture>
 		{
-			// Create irradiance map
-			constexpr uint32_t irradianceSize = 32;
-
-			auto textureInfo = Texture::CreateInfo::cubeMap(irradianceSize, VK_FORMAT_R16G16B16A16_SFLOAT);
-			textureInfo.image.usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+			// Create irradiance map (transfer source to write it to the IBL cache)
+			auto textureInfo = Texture::CreateInfo::cubeMap(IRRADIANCE_SIZE, VK_FORMAT_R16G16B16A16_SFLOAT);
+			textureInfo.image.usage |= VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 			textureInfo.image.mipLevels = 1;
 			auto irradiance = std::make_shared<Texture>(textureInfo);
 
@@ -289,10 +319,9 @@ export namespace Aegis::Graphics
 		static auto prefilteredMap(const std::shared_ptr<Texture>& skybox) -> std::shared_ptr<Texture>
 		{
 			// Create prefiltered map
-			constexpr uint32_t prefilteredSize = 128;
-			constexpr uint32_t mipLevelCount = 5;
+			constexpr uint32_t mipLevelCount = PREFILTERED_MIP_LEVELS;
 
-			auto textureInfo = Texture::CreateInfo::cubeMap(prefilteredSize, VK_FORMAT_R16G16B16A16_SFLOAT);
+			auto textureInfo = Texture::CreateInfo::cubeMap(PREFILTERED_SIZE, VK_FORMAT_R16G16B16A16_SFLOAT);
 			textureInfo.image.usage |= VK_IMAGE_USAGE_STORAGE_BIT;
 			textureInfo.image.mipLevels = mipLevelCount;
 			auto prefiltered = std::make_shared<Texture>(textureInfo);
@@ -372,12 +401,12 @@ export namespace Aegis::Graphics
 
 		static auto BRDFLUT() -> std::shared_ptr<Texture>
 		{
-			// Create BRDF LUT
-			constexpr uint32_t lutSize = 512;
+			// Create BRDF LUT (transfer source to write it to the IBL cache)
+			constexpr uint32_t lutSize = BRDF_LUT_SIZE;
 
 			auto textureInfo = Texture::CreateInfo::texture2D(lutSize, lutSize, VK_FORMAT_R16G16_SFLOAT);
 			textureInfo.image.mipLevels = 1;
-			textureInfo.image.usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+			textureInfo.image.usage |= VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 			textureInfo.sampler.addressMode = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
 			auto lut = std::make_shared<Texture>(textureInfo);
 
@@ -422,12 +451,7 @@ export namespace Aegis::Graphics
 			m_view{ info.view, m_image },
 			m_sampler{ info.sampler, m_image.mipLevels() }
 		{
-			auto& bindlessSet = Bindless::BindlessDescriptorSet::instance();
-			if (info.image.usage & VK_IMAGE_USAGE_SAMPLED_BIT)
-				m_sampledHandle = bindlessSet.allocateSampledImage(descriptorImageInfo(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL));
-
-			if (info.image.usage & VK_IMAGE_USAGE_STORAGE_BIT)
-				m_storageHandle = bindlessSet.allocateStorageImage(descriptorImageInfo(VK_IMAGE_LAYOUT_GENERAL));
+			allocateDescriptorHandles(info.image.usage);
 		}
 
 		Texture(const Texture&) = delete;
@@ -489,7 +513,8 @@ export namespace Aegis::Graphics
 			};
 		}
 
-		void resize(VkExtent3D newSize, VkImageUsageFlags usage)
+		/// @note Use Image::CreateInfo::CALCULATE_MIP_LEVELS to create a full mip chain for the new size
+		void resize(VkExtent3D newSize, VkImageUsageFlags usage, uint32_t mipLevels)
 		{
 			// TODO: Rework this, does not work for all textures (e.g. cube maps)
 			// TODO: This does not preserve existing data or layouts
@@ -497,7 +522,7 @@ export namespace Aegis::Graphics
 			Image::CreateInfo imageInfo{
 				.format = m_image.format(),
 				.extent = newSize,
-				.mipLevels = m_image.mipLevels(),
+				.mipLevels = mipLevels,
 				.layerCount = m_image.layerCount(),
 				.usage = usage,
 				.imageType = VK_IMAGE_TYPE_2D,
@@ -512,13 +537,27 @@ export namespace Aegis::Graphics
 				.viewType = VK_IMAGE_VIEW_TYPE_2D,
 			};
 			m_view = ImageView{ viewInfo, m_image };
+
+			// Bindless descriptors still point to the old view
+			destroy();
+			allocateDescriptorHandles(usage);
 		}
 
 	private:
+		void allocateDescriptorHandles(VkImageUsageFlags usage)
+		{
+			auto& bindlessSet = Bindless::BindlessDescriptorSet::instance();
+			if (usage & VK_IMAGE_USAGE_SAMPLED_BIT)
+				m_sampledHandle = bindlessSet.allocateSampledImage(descriptorImageInfo(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL));
+
+			if (usage & VK_IMAGE_USAGE_STORAGE_BIT)
+				m_storageHandle = bindlessSet.allocateStorageImage(descriptorImageInfo(VK_IMAGE_LAYOUT_GENERAL));
+		}
+
 		void destroy()
 		{
-			Bindless::BindlessDescriptorSet::instance().freeHandle(m_storageHandle);
-			Bindless::BindlessDescriptorSet::instance().freeHandle(m_sampledHandle);
+			Bindless::BindlessDescriptorSet::instance().freeHandleDeferred(m_storageHandle);
+			Bindless::BindlessDescriptorSet::instance().freeHandleDeferred(m_sampledHandle);
 		}
 
 		Image m_image;
@@ -0,0 +1,238 @@
+module;
+
+#include "graphics/vulkan/vulkan_include.h"
+
+#include <aegis-log/log.h>
+#include <stb/stb_image.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <memory>
+#include <span>
+#include <vector>
+
+export module Aegis.Graphics.TextureCooker;
+
+import Aegis.Math;
+import Aegis.Core.Globals;
+import Aegis.Core.JobSystem;
+import Aegis.Graphics.BlockCompression;
+import Aegis.Graphics.KTX2;
+import Aegis.Utils.File;
+
+export namespace Aegis::Graphics
+{
+	/// @brief Generates the mip chain of a texture and block compresses it into a KTX2 file
+	/// @note Used by the texture importer to cook textures on their first load (cached in CACHE_DIR/textures) and by
+	///       tools to cook textures ahead of time, KTX2 files are loaded without any processing.
+	class TextureCooker
+	{
+	public:
+		/// @brief Bump when the output of cook() changes to invalidate cached textures
+		static constexpr uint32_t VERSION = 1;
+
+		enum class Kind : uint8_t
+		{
+			Color,		// sRGB color (albedo, emissive) -> BC7 sRGB
+			Normal,		// Tangent space normal, z is reconstructed in the shader -> BC5
+			Packed,		// Linear data in multiple channels (e.g. occlusion, roughness, metallic) -> BC7
+			Grayscale,	// Linear data in the red channel (e.g. occlusion) -> BC4
+		};
+
+		[[nodiscard]] static constexpr auto compressedFormat(Kind kind) -> VkFormat
+		{
+			switch (kind)
+			{
+			case Kind::Color:
+				return VK_FORMAT_BC7_SRGB_BLOCK;
+			case Kind::Normal:
+				return VK_FORMAT_BC5_UNORM_BLOCK;
+			case Kind::Grayscale:
+				return VK_FORMAT_BC4_UNORM_BLOCK;
+			default:
+				return VK_FORMAT_BC7_UNORM_BLOCK;
+			}
+		}
+
+		/// @brief Format of the decoded texture if block compression is not available
+		[[nodiscard]] static constexpr auto uncompressedFormat(Kind kind) -> VkFormat
+		{
+			return kind == Kind::Color ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+		}
+
+		/// @brief Location of the cooked texture for an encoded source image (png, jpg, ...) in the cache directory
+		[[nodiscard]] static auto cachePath(std::span<const std::byte> encoded, Kind kind) -> std::filesystem::path
+		{
+			auto name = std::format("{:016x}-{}-v{}.ktx2", Utils::File::hash(encoded), static_cast<uint32_t>(kind), VERSION);
+			return Core::CACHE_DIR / "textures" / name;
+		}
+
+		/// @brief Generates all mip levels of the RGBA8 pixels and encodes them, returns the contents of a KTX2 file
+		/// @note Blocks are encoded on the job system
+		[[nodiscard]] static auto cook(const uint8_t* pixels, uint32_t width, uint32_t height, Kind kind) -> std::vector<std::byte>
+		{
+			std::vector<std::vector<uint8_t>> mips;
+			mips.emplace_back(pixels, pixels + 4 * static_cast<std::size_t>(width) * height);
+			for (uint32_t w = width, h = height; w > 1 || h > 1; w = std::max(w / 2, 1u), h = std::max(h / 2, 1u))
+			{
+				mips.emplace_back(downsample(mips.back(), w, h, kind));
+			}
+
+			VkFormat format = compressedFormat(kind);
+			std::vector<std::vector<std::byte>> levels(mips.size());
+			std::vector<std::span<const std::byte>> levelViews(mips.size());
+			for (uint32_t level = 0; level < mips.size(); level++)
+			{
+				uint32_t levelWidth = std::max(width >> level, 1u);
+				uint32_t levelHeight = std::max(height >> level, 1u);
+				levels[level].resize(KTX2::levelSize(format, levelWidth, levelHeight));
+				encodeLevel(mips[level], levelWidth, levelHeight, kind, levels[level]);
+				levelViews[level] = levels[level];
+			}
+
+			return KTX2::encode(format, width, height, levelViews);
+		}
+
+		/// @brief Cooks an image file (png, jpg, ...) into a KTX2 file, returns false if either file failed
+		static auto cookFile(const std::filesystem::path& source, const std::filesystem::path& destination, Kind kind) -> bool
+		{
+			Utils::File::MappedFile file{ source };
+			int width = 0;
+			int height = 0;
+			int channels = 0;
+			std::unique_ptr<stbi_uc, decltype(&stbi_image_free)> pixels{ file.isValid()
+				? stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(file.data()), static_cast<int>(file.size()),
+					&width, &height, &channels, STBI_rgb_alpha)
+				: nullptr, &stbi_image_free };
+			if (!pixels)
+			{
+				ALOG::warn("Failed to decode texture '{}'", source.string());
+				return false;
+			}
+
+			auto cooked = cook(pixels.get(), static_cast<uint32_t>(width), static_cast<uint32_t>(height), kind);
+			if (!Utils::File::writeBinaryAtomic(destination, cooked))
+			{
+				ALOG::warn("Failed to write cooked texture '{}'", destination.string());
+				return false;
+			}
+			return true;
+		}
+
+	private:
+		/// @brief Box filter, color is filtered in linear space and normals are renormalized
+		[[nodiscard]] static auto downsample(const std::vector<uint8_t>& src, uint32_t width, uint32_t height, Kind kind) -> std::vector<uint8_t>
+		{
+			static const auto SRGB_TO_LINEAR = []() {
+				std::array<float, 256> table;
+				for (uint32_t i = 0; i < 256; i++)
+				{
+					float c = static_cast<float>(i) / 255.0f;
+					table[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+				}
+				return table;
+				}();
+
+			auto linearToSrgb = [](float c) {
+				return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+				};
+
+			auto toByte = [](float value) {
+				return static_cast<uint8_t>(std::clamp(value * 255.0f + 0.5f, 0.0f, 255.0f));
+				};
+
+			uint32_t dstWidth = std::max(width / 2, 1u);
+			uint32_t dstHeight = std::max(height / 2, 1u);
+			std::vector<uint8_t> dst(4 * static_cast<std::size_t>(dstWidth) * dstHeight);
+			for (uint32_t y = 0; y < dstHeight; y++)
+			{
+				for (uint32_t x = 0; x < dstWidth; x++)
+				{
+					glm::vec4 sum{ 0.0f };
+					for (uint32_t i = 0; i < 4; i++)
+					{
+						uint32_t srcX = std::min(2 * x + (i & 1), width - 1);
+						uint32_t srcY = std::min(2 * y + (i >> 1), height - 1);
+						const uint8_t* texel = &src[4 * (static_cast<std::size_t>(srcY) * width + srcX)];
+
+						glm::vec4 value{ texel[0], texel[1], texel[2], texel[3] };
+						value /= 255.0f;
+						if (kind == Kind::Color)
+						{
+							value = glm::vec4{ SRGB_TO_LINEAR[texel[0]], SRGB_TO_LINEAR[texel[1]], SRGB_TO_LINEAR[texel[2]], value.a };
+						}
+						else if (kind == Kind::Normal)
+						{
+							value = glm::vec4{ glm::vec3{ value } * 2.0f - 1.0f, value.a };
+						}
+						sum += value;
+					}
+
+					glm::vec4 average = sum * 0.25f;
+					if (kind == Kind::Color)
+					{
+						average = glm::vec4{ linearToSrgb(average.r), linearToSrgb(average.g), linearToSrgb(average.b), average.a };
+					}
+					else if (kind == Kind::Normal)
+					{
+						glm::vec3 normal{ average };
+						float length = glm::length(normal);
+						normal = length > 1e-6f ? normal / length : glm::vec3{ 0.0f, 0.0f, 1.0f };
+						average = glm::vec4{ normal * 0.5f + 0.5f, average.a };
+					}
+
+					uint8_t* out = &dst[4 * (static_cast<std::size_t>(y) * dstWidth + x)];
+					for (uint32_t c = 0; c < 4; c++)
+					{
+						out[c] = toByte(average[c]);
+					}
+				}
+			}
+			return dst;
+		}
+
+		static void encodeLevel(const std::vector<uint8_t>& pixels, uint32_t width, uint32_t height, Kind kind, std::vector<std::byte>& out)
+		{
+			uint32_t blocksX = (width + 3) / 4;
+			uint32_t blocksY = (height + 3) / 4;
+			std::size_t blockSize = kind == Kind::Grayscale ? 8 : 16;
+
+			Core::JobSystem::instance().parallelFor(blocksY, 1, [&](std::size_t begin, std::size_t end) {
+				BlockCompression::Block block;
+				for (std::size_t blockY = begin; blockY < end; blockY++)
+				{
+					for (uint32_t blockX = 0; blockX < blocksX; blockX++)
+					{
+						// Texels outside of the image repeat the edge
+						for (uint32_t i = 0; i < 16; i++)
+						{
+							uint32_t x = std::min(blockX * 4 + (i % 4), width - 1);
+							uint32_t y = std::min(static_cast<uint32_t>(blockY) * 4 + (i / 4), height - 1);
+							std::memcpy(block[i].data(), &pixels[4 * (static_cast<std::size_t>(y) * width + x)], 4);
+						}
+
+						std::byte* dst = out.data() + (blockY * blocksX + blockX) * blockSize;
+						switch (kind)
+						{
+						case Kind::Normal:
+							std::memcpy(dst, BlockCompression::encodeBC5(block).data(), blockSize);
+							break;
+						case Kind::Grayscale:
+							std::memcpy(dst, BlockCompression::encodeBC4(block, 0).data(), blockSize);
+							break;
+						default:
+							std::memcpy(dst, BlockCompression::encodeBC7(block).data(), blockSize);
+							break;
+						}
+					}
+				}
+				});
+		}
+	};
+}
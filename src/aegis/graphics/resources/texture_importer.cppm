@@ -0,0 +1,309 @@
+module;
+
+#include "core/assert.h"
+#include "graphics/vulkan/vulkan_include.h"
+
+#include <aegis-log/log.h>
+#include <stb/stb_image.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <thread>
+#include <variant>
+#include <vector>
+
+export module Aegis.Graphics.TextureImporter;
+
+import Aegis.Core.JobSystem;
+import Aegis.Graphics.KTX2;
+import Aegis.Graphics.Texture;
+import Aegis.Graphics.TextureCooker;
+import Aegis.Graphics.UploadContext;
+import Aegis.Graphics.VulkanContext;
+import Aegis.Utils.File;
+
+export namespace Aegis::Graphics
+{
+	/// @brief Decodes 2D textures on the job system and uploads them in one upload batch
+	/// @note The loading thread creates the textures and records their copies into the upload context while the workers
+	///       keep decoding. Decoding only runs a few images ahead of the uploads, pixels are freed as soon as they are in
+	///       the staging ring.
+	///       If the device supports BC compression, textures are cooked by the TextureCooker on their first import and
+	///       later uploaded straight from the memory mapped KTX2 file in the cache (mip chain included). KTX2 sources
+	///       are uploaded as they are, BC compressed ones are rejected (null) without BC support since there is no
+	///       decoder for them. Otherwise textures are uploaded as RGBA8 and mips are generated on the GPU.
+	class TextureImporter
+	{
+	public:
+		struct Progress
+		{
+			uint32_t total{ 0 };
+			uint32_t decoded{ 0 };
+			uint32_t uploaded{ 0 };
+
+			[[nodiscard]] auto fraction() const -> float
+			{
+				return total > 0 ? static_cast<float>(uploaded) / static_cast<float>(total) : 1.0f;
+			}
+		};
+
+		using ProgressCallback = std::function<void(const Progress&)>;
+
+		TextureImporter() = default;
+		TextureImporter(const TextureImporter&) = delete;
+		TextureImporter(TextureImporter&&) = delete;
+		~TextureImporter() = default;
+
+		auto operator=(const TextureImporter&) -> TextureImporter & = delete;
+		auto operator=(TextureImporter&&) -> TextureImporter & = delete;
+
+		/// @brief Returns the index of the texture in the result of import()
+		auto add(std::filesystem::path file, TextureCooker::Kind kind) -> std::size_t
+		{
+			return addRequest(std::move(file), kind);
+		}
+
+		/// @brief The encoded data (png, jpg, ktx2, ...) has to stay alive until import() returns
+		auto add(std::span<const std::byte> encoded, TextureCooker::Kind kind) -> std::size_t
+		{
+			return addRequest(encoded, kind);
+		}
+
+		/// @brief Can be queried from any thread while import() is running
+		[[nodiscard]] auto progress() const -> Progress
+		{
+			return Progress{
+				.total = static_cast<uint32_t>(m_requests.size()),
+				.decoded = m_decodedCount.load(std::memory_order_relaxed),
+				.uploaded = m_uploadedCount.load(std::memory_order_relaxed),
+			};
+		}
+
+		/// @brief Decodes and uploads all added textures, blocks until all of them are recorded into the upload context
+		/// @note Textures are returned in the order they were added, textures that failed to decode are null
+		auto import(const ProgressCallback& onProgress = {}) -> std::vector<std::shared_ptr<Texture>>
+		{
+			auto& jobs = Core::JobSystem::instance();
+			UploadContext::Batch uploads;
+			m_compress = VulkanContext::device().features().core.features.textureCompressionBC;
+
+			std::vector<std::shared_ptr<Texture>> textures(m_requests.size());
+			const std::size_t maxDecodesAhead = static_cast<std::size_t>(jobs.threadCount()) * 2;
+
+			Core::JobCounter counter;
+			std::size_t nextDecode = 0;
+			std::size_t uploaded = 0;
+			auto submitDecodes = [&]() {
+				while (nextDecode < m_requests.size() && nextDecode - uploaded < maxDecodesAhead)
+				{
+					auto* request = m_requests[nextDecode++].get();
+					jobs.submit([this, request]() { decode(*request); }, &counter);
+				}
+				};
+
+			submitDecodes();
+			while (uploaded < m_requests.size())
+			{
+				std::size_t index = popDecoded();
+				if (index == NONE)
+				{
+					// Take a decode job instead of idling
+					if (!jobs.tryExecute())
+						std::this_thread::yield();
+					continue;
+				}
+
+				textures[index] = upload(*m_requests[index]);
+				m_uploadedCount.store(static_cast<uint32_t>(++uploaded), std::memory_order_relaxed);
+				submitDecodes();
+
+				if (onProgress)
+					onProgress(progress());
+			}
+
+			jobs.wait(counter);
+			return textures;
+		}
+
+	private:
+		static constexpr std::size_t NONE = static_cast<std::size_t>(-1);
+
+		struct Request
+		{
+			using Source = std::variant<std::filesystem::path, std::span<const std::byte>>;
+
+			Request(std::size_t index, Source source, TextureCooker::Kind kind) :
+				index{ index }, source{ std::move(source) }, kind{ kind }
+			{}
+
+			std::size_t index;
+			Source source;
+			TextureCooker::Kind kind;
+
+			// Result of the decode, either a KTX2 mip chain (pointing into the mapping or the cooked data) or pixels
+			std::optional<KTX2::TextureData> compressed;
+			Utils::File::MappedFile mapping;
+			std::vector<std::byte> cooked;
+			std::unique_ptr<stbi_uc, decltype(&stbi_image_free)> pixels{ nullptr, &stbi_image_free };
+			uint32_t width{ 0 };
+			uint32_t height{ 0 };
+			bool unsupported{ false };
+		};
+
+		auto addRequest(Request::Source source, TextureCooker::Kind kind) -> std::size_t
+		{
+			std::size_t index = m_requests.size();
+			m_requests.emplace_back(std::make_unique<Request>(index, std::move(source), kind));
+			return index;
+		}
+
+		/// @brief Runs on a worker
+		void decode(Request& request)
+		{
+			Utils::File::MappedFile file;
+			std::span<const std::byte> encoded;
+			if (const auto* path = std::get_if<std::filesystem::path>(&request.source))
+			{
+				file = Utils::File::MappedFile{ *path };
+				encoded = file.bytes();
+			}
+			else
+			{
+				encoded = std::get<std::span<const std::byte>>(request.source);
+			}
+
+			if (KTX2::isKTX2(encoded))
+			{
+				// Moving the mapping keeps the address, the texture data stays valid
+				request.compressed = KTX2::read(encoded);
+				request.mapping = std::move(file);
+				if (request.compressed && KTX2::isBlockCompressed(request.compressed->format) && !m_compress)
+				{
+					request.compressed.reset();
+					request.mapping = {};
+					request.unsupported = true;
+				}
+			}
+			else if (m_compress)
+			{
+				loadCooked(request, encoded);
+			}
+			else
+			{
+				decodePixels(request, encoded);
+			}
+
+			std::lock_guard lock{ m_decodedMutex };
+			m_decoded.emplace_back(request.index);
+			m_decodedCount.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		/// @brief Maps the cooked texture from the cache, cooks and caches it on a miss
+		void loadCooked(Request& request, std::span<const std::byte> encoded)
+		{
+			auto cachePath = TextureCooker::cachePath(encoded, request.kind);
+			Utils::File::MappedFile cached{ cachePath };
+			auto texture = KTX2::read(cached.bytes());
+			if (texture && texture->format == TextureCooker::compressedFormat(request.kind))
+			{
+				request.compressed = std::move(texture);
+				request.mapping = std::move(cached);
+				return;
+			}
+
+			decodePixels(request, encoded);
+			if (!request.pixels)
+				return;
+
+			request.cooked = TextureCooker::cook(request.pixels.get(), request.width, request.height, request.kind);
+			request.compressed = KTX2::read(request.cooked);
+			request.pixels.reset();
+
+			if (!Utils::File::writeBinaryAtomic(cachePath, request.cooked))
+				ALOG::warn("Failed to write cooked texture '{}'", cachePath.string());
+		}
+
+		/// @brief Always decodes to 4 channels (3 channel formats are rarely supported for sampling)
+		static void decodePixels(Request& request, std::span<const std::byte> encoded)
+		{
+			if (encoded.empty())
+				return;
+
+			int width = 0;
+			int height = 0;
+			int channels = 0;
+			request.pixels.reset(stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(encoded.data()),
+				static_cast<int>(encoded.size()), &width, &height, &channels, STBI_rgb_alpha));
+			request.width = static_cast<uint32_t>(width);
+			request.height = static_cast<uint32_t>(height);
+		}
+
+		/// @brief Runs on the loading thread (textures register bindless descriptors)
+		auto upload(Request& request) -> std::shared_ptr<Texture>
+		{
+			if (request.compressed)
+			{
+				const auto& data = *request.compressed;
+				auto info = Texture::CreateInfo::texture2D(data.width, data.height, data.format);
+				info.image.mipLevels = static_cast<uint32_t>(data.levelOffsets.size());
+				auto texture = std::make_shared<Texture>(info);
+				texture->image().upload(data.data.data(), data.data.size(), data.levelOffsets);
+
+				request.compressed.reset();
+				request.mapping = {};
+				request.cooked = {};
+				return texture;
+			}
+
+			if (request.unsupported)
+			{
+				if (const auto* file = std::get_if<std::filesystem::path>(&request.source))
+					ALOG::warn("Texture '{}' is BC compressed, which the device does not support", file->string());
+				else
+					ALOG::warn("Embedded texture {} is BC compressed, which the device does not support", request.index);
+				return nullptr;
+			}
+
+			if (!request.pixels)
+			{
+				if (const auto* file = std::get_if<std::filesystem::path>(&request.source))
+					ALOG::warn("Failed to decode texture '{}'", file->string());
+				else
+					ALOG::warn("Failed to decode embedded texture {}", request.index);
+				return nullptr;
+			}
+
+			auto info = Texture::CreateInfo::texture2D(request.width, request.height, TextureCooker::uncompressedFormat(request.kind));
+			auto texture = std::make_shared<Texture>(info);
+			texture->image().upload(request.pixels.get(), 4 * static_cast<VkDeviceSize>(request.width) * request.height);
+
+			request.pixels.reset();
+			return texture;
+		}
+
+		auto popDecoded() -> std::size_t
+		{
+			std::lock_guard lock{ m_decodedMutex };
+			if (m_decoded.empty())
+				return NONE;
+
+			std::size_t index = m_decoded.back();
+			m_decoded.pop_back();
+			return index;
+		}
+
+		std::vector<std::unique_ptr<Request>> m_requests;
+		std::vector<std::size_t> m_decoded;
+		std::mutex m_decodedMutex;
+		std::atomic<uint32_t> m_decodedCount{ 0 };
+		std::atomic<uint32_t> m_uploadedCount{ 0 };
+		bool m_compress{ false };
+	};
+}
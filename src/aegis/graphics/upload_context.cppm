@@ -0,0 +1,464 @@
+module;
+
+#include "core/assert.h"
+#include "graphics/vulkan/vulkan_include.h"
+
+#include <aegis-log/log.h>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <span>
+#include <utility>
+#include <vector>
+
+export module Aegis.Graphics.UploadContext;
+
+import Aegis.Graphics.VulkanContext;
+
+export namespace Aegis::Graphics
+{
+	/// @brief Records uploads to device local memory from a persistently mapped staging ring
+	/// @note All copies of a batch are recorded into one command buffer per queue and submitted together. Buffer copies
+	///       run on the dedicated transfer queue if the device has one (buffers are shared concurrently, see
+	///       VulkanDevice::createBuffer), image copies and mip generation need the graphics queue. Every submission
+	///       signals a timeline semaphore, the ring space of a submission is reused once its value is reached.
+	///       Outside of a Batch uploads are submitted and waited for right away (like the old single time commands).
+	class UploadContext
+	{
+	public:
+		static constexpr VkDeviceSize STAGING_RING_SIZE = 64 * 1024 * 1024;
+		static constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+
+		enum class Queue
+		{
+			Transfer,
+			Graphics,
+		};
+
+		struct Staging
+		{
+			VkBuffer buffer{ VK_NULL_HANDLE };
+			VkDeviceSize offset{ 0 };
+		};
+
+		/// @brief Defers the submission of all uploads until the outermost batch goes out of scope
+		/// @note Loaders open a batch per scene, so all meshes and textures are uploaded in a few submissions. Single time
+		///       commands recorded while a batch is open do not see its uploads yet.
+		class Batch
+		{
+		public:
+			Batch() { UploadContext::instance().m_batchDepth++; }
+			Batch(const Batch&) = delete;
+			Batch(Batch&&) = delete;
+			~Batch()
+			{
+				auto& uploads = UploadContext::instance();
+				AGX_ASSERT_X(uploads.m_batchDepth > 0, "Upload batch depth mismatch");
+				if (--uploads.m_batchDepth == 0)
+					uploads.finish();
+			}
+
+			auto operator=(const Batch&) -> Batch & = delete;
+			auto operator=(Batch&&) -> Batch & = delete;
+		};
+
+		UploadContext()
+		{
+			AGX_ASSERT_X(s_instance == nullptr, "UploadContext instance already exists!");
+			s_instance = this;
+
+			auto& device = VulkanContext::device();
+			const auto& families = device.queueFamilies();
+			m_dedicatedTransfer = families.hasDedicatedTransfer();
+			m_queues[static_cast<std::size_t>(Queue::Graphics)].queue = device.graphicsQueue();
+			m_queues[static_cast<std::size_t>(Queue::Graphics)].pool = createCommandPool(families.graphicsFamily.value());
+			if (m_dedicatedTransfer)
+			{
+				m_queues[static_cast<std::size_t>(Queue::Transfer)].queue = device.transferQueue();
+				m_queues[static_cast<std::size_t>(Queue::Transfer)].pool = createCommandPool(families.transferFamily.value());
+			}
+
+			VkSemaphoreTypeCreateInfo typeInfo{
+				.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+				.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+				.initialValue = 0,
+			};
+			VkSemaphoreCreateInfo semaphoreInfo{
+				.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+				.pNext = &typeInfo,
+			};
+			VK_CHECK(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &m_timeline));
+
+			m_ring = createStagingBuffer(STAGING_RING_SIZE);
+		}
+
+		UploadContext(const UploadContext&) = delete;
+		UploadContext(UploadContext&&) = delete;
+		~UploadContext()
+		{
+			finish();
+
+			auto& device = VulkanContext::device();
+			destroyStagingBuffer(m_ring);
+			vkDestroySemaphore(device, m_timeline, nullptr);
+			for (auto& queue : m_queues)
+			{
+				if (queue.pool)
+					vkDestroyCommandPool(device, queue.pool, nullptr);
+			}
+
+			s_instance = nullptr;
+		}
+
+		auto operator=(const UploadContext&) -> UploadContext & = delete;
+		auto operator=(UploadContext&&) -> UploadContext & = delete;
+
+		[[nodiscard]] static auto instance() -> UploadContext&
+		{
+			AGX_ASSERT_X(s_instance, "UploadContext instance not initialized!");
+			return *s_instance;
+		}
+
+		[[nodiscard]] auto isBatching() const -> bool { return m_batchDepth > 0; }
+		[[nodiscard]] auto timeline() const -> VkSemaphore { return m_timeline; }
+
+		/// @brief Value the timeline semaphore reaches once everything submitted so far is done
+		[[nodiscard]] auto submittedValue() const -> uint64_t { return m_submittedValue; }
+
+		/// @brief Copies the data into the staging memory, the returned range is valid until the batch is submitted
+		/// @note Stage before calling commands(), a full ring submits the current batch. Data larger than the ring gets a
+		///       dedicated staging buffer (released with the submission).
+		auto stage(const void* data, VkDeviceSize size) -> Staging
+		{
+			AGX_ASSERT_X(data && size > 0, "Cannot stage empty data");
+
+			StagingBuffer* target = &m_ring;
+			VkDeviceSize offset = 0;
+			if (size > STAGING_RING_SIZE)
+			{
+				target = &m_dedicatedStaging.emplace_back(createStagingBuffer(size));
+			}
+			else
+			{
+				offset = allocateRing(size);
+			}
+
+			std::memcpy(target->mapped + offset, data, size);
+			VK_CHECK(vma::vmaFlushAllocation(VulkanContext::device().allocator(), target->allocation, offset, size));
+			return Staging{ target->buffer, offset };
+		}
+
+		/// @brief Command buffer of the current batch (the transfer queue falls back to the graphics queue)
+		auto commands(Queue queue) -> VkCommandBuffer
+		{
+			auto& state = queueState(queue);
+			if (!state.recording)
+			{
+				state.recording = acquireCommandBuffer(state);
+				VkCommandBufferBeginInfo beginInfo{
+					.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+					.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+				};
+				VK_CHECK(vkBeginCommandBuffer(state.recording, &beginInfo));
+			}
+			return state.recording;
+		}
+
+		/// @brief Uploads data to a device local buffer (split into chunks if it does not fit into the ring)
+		void uploadBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+		{
+			AGX_ASSERT_X(dst, "Upload destination is null");
+
+			constexpr VkDeviceSize MAX_CHUNK_SIZE = STAGING_RING_SIZE / 4;
+			const auto* bytes = static_cast<const std::byte*>(data);
+			for (VkDeviceSize chunkOffset = 0; chunkOffset < size; chunkOffset += MAX_CHUNK_SIZE)
+			{
+				VkDeviceSize chunkSize = std::min(MAX_CHUNK_SIZE, size - chunkOffset);
+				auto staging = stage(bytes + chunkOffset, chunkSize);
+				VkBufferCopy region{
+					.srcOffset = staging.offset,
+					.dstOffset = dstOffset + chunkOffset,
+					.size = chunkSize,
+				};
+				vkCmdCopyBuffer(commands(Queue::Transfer), staging.buffer, dst, 1, &region);
+			}
+
+			submitIfImmediate();
+		}
+
+		/// @brief Copies between device local buffers in the order of the recorded uploads
+		/// @note Used to move data that may have been uploaded earlier in the same batch (e.g. when a buffer grows)
+		void copyBuffer(VkBuffer src, VkBuffer dst, std::span<const VkBufferCopy> regions)
+		{
+			if (regions.empty())
+				return;
+
+			auto cmd = commands(Queue::Transfer);
+			transferBarrier(cmd);
+			vkCmdCopyBuffer(cmd, src, dst, static_cast<uint32_t>(regions.size()), regions.data());
+			transferBarrier(cmd);
+
+			submitIfImmediate();
+		}
+
+		/// @brief Submits immediately unless a batch is open (call after recording into commands())
+		void submitIfImmediate()
+		{
+			if (!isBatching())
+				finish();
+		}
+
+		/// @brief Submits everything recorded so far without waiting, returns the value to wait for
+		auto flush() -> uint64_t
+		{
+			std::array<VkCommandBuffer, QUEUE_COUNT> commandBuffers{};
+			for (std::size_t i = 0; i < QUEUE_COUNT; i++)
+				commandBuffers[i] = std::exchange(m_queues[i].recording, VK_NULL_HANDLE);
+
+			if (std::ranges::all_of(commandBuffers, [](VkCommandBuffer cmd) { return cmd == VK_NULL_HANDLE; }))
+				return m_submittedValue;
+
+			// Image uploads are submitted after (and wait for) the buffer uploads of the same batch
+			uint64_t waitValue = 0;
+			for (std::size_t i = 0; i < QUEUE_COUNT; i++)
+			{
+				if (!commandBuffers[i])
+					continue;
+
+				VK_CHECK(vkEndCommandBuffer(commandBuffers[i]));
+
+				uint64_t signalValue = ++m_submittedValue;
+				VkTimelineSemaphoreSubmitInfo timelineInfo{
+					.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+					.waitSemaphoreValueCount = waitValue > 0 ? 1u : 0u,
+					.pWaitSemaphoreValues = &waitValue,
+					.signalSemaphoreValueCount = 1,
+					.pSignalSemaphoreValues = &signalValue,
+				};
+				VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+				VkSubmitInfo submitInfo{
+					.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+					.pNext = &timelineInfo,
+					.waitSemaphoreCount = waitValue > 0 ? 1u : 0u,
+					.pWaitSemaphores = &m_timeline,
+					.pWaitDstStageMask = &waitStage,
+					.commandBufferCount = 1,
+					.pCommandBuffers = &commandBuffers[i],
+					.signalSemaphoreCount = 1,
+					.pSignalSemaphores = &m_timeline,
+				};
+				VK_CHECK(vkQueueSubmit(m_queues[i].queue, 1, &submitInfo, VK_NULL_HANDLE));
+				waitValue = signalValue;
+			}
+
+			m_submissions.emplace_back(Submission{
+				.value = m_submittedValue,
+				.ringEnd = m_ringHead,
+				.commandBuffers = commandBuffers,
+				.dedicatedStaging = std::move(m_dedicatedStaging),
+				});
+			m_dedicatedStaging.clear();
+
+			return m_submittedValue;
+		}
+
+		/// @brief Blocks until the timeline semaphore reached the value and recycles the finished submissions
+		void wait(uint64_t value)
+		{
+			if (value == 0)
+				return;
+
+			VkSemaphoreWaitInfo waitInfo{
+				.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+				.semaphoreCount = 1,
+				.pSemaphores = &m_timeline,
+				.pValues = &value,
+			};
+			VK_CHECK(vkWaitSemaphores(VulkanContext::device(), &waitInfo, std::numeric_limits<uint64_t>::max()));
+
+			while (!m_submissions.empty() && m_submissions.front().value <= value)
+				retire(m_submissions.front());
+		}
+
+		/// @brief Submits everything recorded so far and waits for it
+		void finish()
+		{
+			wait(flush());
+		}
+
+	private:
+		static constexpr std::size_t QUEUE_COUNT = 2;
+
+		struct StagingBuffer
+		{
+			VkBuffer buffer{ VK_NULL_HANDLE };
+			vma::Allocation allocation{ VK_NULL_HANDLE };
+			std::byte* mapped{ nullptr };
+		};
+
+		struct QueueState
+		{
+			VkQueue queue{ VK_NULL_HANDLE };
+			VkCommandPool pool{ VK_NULL_HANDLE };
+			VkCommandBuffer recording{ VK_NULL_HANDLE };
+			std::vector<VkCommandBuffer> freeCommandBuffers;
+		};
+
+		struct Submission
+		{
+			uint64_t value;
+			VkDeviceSize ringEnd;
+			std::array<VkCommandBuffer, QUEUE_COUNT> commandBuffers;
+			std::vector<StagingBuffer> dedicatedStaging;
+		};
+
+		static auto createCommandPool(uint32_t queueFamily) -> VkCommandPool
+		{
+			VkCommandPoolCreateInfo poolInfo{
+				.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+				.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+				.queueFamilyIndex = queueFamily,
+			};
+
+			VkCommandPool pool;
+			VK_CHECK(vkCreateCommandPool(VulkanContext::device(), &poolInfo, nullptr, &pool));
+			return pool;
+		}
+
+		static auto createStagingBuffer(VkDeviceSize size) -> StagingBuffer
+		{
+			auto& device = VulkanContext::device();
+
+			StagingBuffer staging;
+			device.createBuffer(staging.buffer, staging.allocation, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT, VMA_MEMORY_USAGE_AUTO);
+
+			vma::AllocationInfo allocInfo;
+			vma::vmaGetAllocationInfo(device.allocator(), staging.allocation, &allocInfo);
+			staging.mapped = static_cast<std::byte*>(allocInfo.pMappedData);
+			AGX_ASSERT_X(staging.mapped, "Staging buffer is not mapped");
+			return staging;
+		}
+
+		static void destroyStagingBuffer(StagingBuffer& staging)
+		{
+			vma::vmaDestroyBuffer(VulkanContext::device().allocator(), staging.buffer, staging.allocation);
+			staging = StagingBuffer{};
+		}
+
+		/// @brief Makes copies recorded before visible to the ones recorded after
+		static void transferBarrier(VkCommandBuffer cmd)
+		{
+			VkMemoryBarrier barrier{
+				.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+				.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+				.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+			};
+			vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+				1, &barrier, 0, nullptr, 0, nullptr);
+		}
+
+		auto queueState(Queue queue) -> QueueState&
+		{
+			if (!m_dedicatedTransfer)
+				queue = Queue::Graphics;
+			return m_queues[static_cast<std::size_t>(queue)];
+		}
+
+		auto acquireCommandBuffer(QueueState& state) -> VkCommandBuffer
+		{
+			if (!state.freeCommandBuffers.empty())
+			{
+				auto cmd = state.freeCommandBuffers.back();
+				state.freeCommandBuffers.pop_back();
+				return cmd;
+			}
+
+			VkCommandBufferAllocateInfo allocInfo{
+				.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+				.commandPool = state.pool,
+				.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+				.commandBufferCount = 1,
+			};
+
+			VkCommandBuffer cmd;
+			VK_CHECK(vkAllocateCommandBuffers(VulkanContext::device(), &allocInfo, &cmd));
+			return cmd;
+		}
+
+		/// @brief Returns the offset of 'size' contiguous bytes in the ring, waits for old submissions if it is full
+		/// @note Ring positions only grow, the offset in the buffer is the position modulo the ring size
+		auto allocateRing(VkDeviceSize size) -> VkDeviceSize
+		{
+			while (true)
+			{
+				VkDeviceSize begin = alignTo(m_ringHead, STAGING_ALIGNMENT);
+				if (begin % STAGING_RING_SIZE + size > STAGING_RING_SIZE)
+					begin = alignTo(begin, STAGING_RING_SIZE);	// Wrap around instead of splitting the range
+
+				if (begin + size - m_ringTail <= STAGING_RING_SIZE)
+				{
+					m_ringHead = begin + size;
+					return begin % STAGING_RING_SIZE;
+				}
+
+				// The current batch uses up the free space, submit it to make it reclaimable
+				if (m_submissions.empty() || m_submissions.back().ringEnd != m_ringHead)
+					flush();
+
+				if (m_submissions.empty())
+				{
+					// Nothing in flight and nothing recorded, start over at the beginning of the ring
+					m_ringHead = m_ringTail = 0;
+					continue;
+				}
+
+				ALOG::trace("Upload context: Staging ring is full, waiting for the oldest submission");
+				wait(m_submissions.front().value);
+			}
+		}
+
+		void retire(Submission& submission)
+		{
+			for (std::size_t i = 0; i < QUEUE_COUNT; i++)
+			{
+				if (auto cmd = submission.commandBuffers[i])
+				{
+					VK_CHECK(vkResetCommandBuffer(cmd, 0));
+					m_queues[i].freeCommandBuffers.emplace_back(cmd);
+				}
+			}
+
+			for (auto& staging : submission.dedicatedStaging)
+				destroyStagingBuffer(staging);
+
+			m_ringTail = submission.ringEnd;
+			m_submissions.pop_front();
+		}
+
+		[[nodiscard]] static constexpr auto alignTo(VkDeviceSize value, VkDeviceSize alignment) -> VkDeviceSize
+		{
+			return (value + alignment - 1) & ~(alignment - 1);
+		}
+
+		inline static UploadContext* s_instance{ nullptr };
+
+		std::array<QueueState, QUEUE_COUNT> m_queues;
+		bool m_dedicatedTransfer{ false };
+
+		StagingBuffer m_ring;
+		VkDeviceSize m_ringHead{ 0 };
+		VkDeviceSize m_ringTail{ 0 };
+		std::vector<StagingBuffer> m_dedicatedStaging;
+
+		VkSemaphore m_timeline{ VK_NULL_HANDLE };
+		uint64_t m_submittedValue{ 0 };
+		std::deque<Submission> m_submissions;
+		uint32_t m_batchDepth{ 0 };
+	};
+}
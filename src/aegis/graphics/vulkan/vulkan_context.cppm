@@ -9,6 +9,8 @@ export import Aegis.Graphics.Vulkan.Device;
 export import Aegis.Graphics.Vulkan.VulkanMemory;
 export import Aegis.Graphics.DeletionQueue;
 export import Aegis.Graphics.DescriptorPool;
+export import Aegis.Graphics.PipelineCache;
+import Aegis.Core.Globals;
 import Aegis.Core.Window;
 
 export namespace Aegis::Graphics
@@ -32,11 +34,14 @@ export namespace Aegis::Graphics
 		[[nodiscard]] static auto device() -> VulkanDevice& { return instance().m_device; }
 		[[nodiscard]] static auto descriptorPool() -> DescriptorPool& { return instance().m_descriptorPool; }
 		[[nodiscard]] static auto deletionQueue() -> DeletionQueue& { return instance().m_deletionQueue; }
+		[[nodiscard]] static auto pipelineCache() -> PipelineCache& { return instance().m_pipelineCache; }
 
 		static auto initialize(Core::Window& window) -> VulkanContext&
 		{
 			auto& context = instance();
 			context.m_device.initialize(window);
+			context.m_pipelineCache.initialize(context.m_device.device(), context.m_device.properties(),
+				Core::CACHE_DIR / "pipelines.bin");
 
 			// TODO: Let the pool grow dynamically (see: https://vkguide.dev/docs/extra-chapter/abstracting_descriptors/)
 			context.m_descriptorPool = DescriptorPool::Builder{}
@@ -64,6 +69,7 @@ export namespace Aegis::Graphics
 			auto& context = instance();
 			context.m_deletionQueue.flushAll();
 			context.m_descriptorPool.destroy(context.m_device);
+			context.m_pipelineCache.destroy(context.m_device.device());
 		}
 
 		static void destroy(VkBuffer buffer, vma::Allocation allocation)
@@ -139,6 +145,12 @@ export namespace Aegis::Graphics
 			VulkanContext::instance().m_deletionQueue.flush(frameIndex);
 		}
 
+		/// @brief Runs every pending deletion immediately (the GPU has to be idle)
+		static void flushDeletionQueue()
+		{
+			VulkanContext::instance().m_deletionQueue.flushAll();
+		}
+
 	private:
 		VulkanContext() = default;
 
@@ -151,5 +163,6 @@ export namespace Aegis::Graphics
 		VulkanDevice m_device{};
 		DescriptorPool m_descriptorPool{};
 		DeletionQueue m_deletionQueue{};
+		PipelineCache m_pipelineCache{};
 	};
 }
@@ -29,6 +29,7 @@ export namespace vma
 	using ::vmaUnmapMemory;
 	using ::vmaCopyMemoryToAllocation;
 	using ::vmaFlushAllocation;
+	using ::vmaInvalidateAllocation;
 	using ::vmaImportVulkanFunctionsFromVolk;
 }
 
@@ -272,9 +272,14 @@ export namespace Aegis::Graphics::Tools
 		}
 
 		void cmdCopyBufferToImage(VkCommandBuffer cmd, VkBuffer buffer, VkImage image, VkExtent3D extent, uint32_t layerCount)
+		{
+			cmdCopyBufferToImage(cmd, buffer, 0, image, extent, layerCount);
+		}
+
+		void cmdCopyBufferToImage(VkCommandBuffer cmd, VkBuffer buffer, VkDeviceSize bufferOffset, VkImage image, VkExtent3D extent, uint32_t layerCount)
 		{
 			VkBufferImageCopy region{};
-			region.bufferOffset = 0;
+			region.bufferOffset = bufferOffset;
 			region.bufferRowLength = 0;
 			region.bufferImageHeight = 0;
 			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -12,6 +12,16 @@ export namespace Aegis::Math
 		return a + t * (b - a);
 	}
 
+	/// @brief Catmull-Rom spline between b and c (t in [0, 1]), a and d are the neighbouring control points
+	template <typename T>
+	T catmullRom(const T& a, const T& b, const T& c, const T& d, float t)
+	{
+		float t2 = t * t;
+		float t3 = t2 * t;
+		return 0.5f * ((2.0f * b) + (c - a) * t + (2.0f * a - 5.0f * b + 4.0f * c - d) * t2
+			+ (3.0f * b - a - 3.0f * c + d) * t3);
+	}
+
 
 	/// @brief Returns the percentage of a value between a min and max value
 	auto percentage(float value, float min, float max) -> float
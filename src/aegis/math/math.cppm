@@ -6,6 +6,7 @@ module;
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
 #include <glm/gtc/matrix_access.hpp>
+#include <glm/gtc/packing.hpp>
 #include <glm/gtc/quaternion.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/euler_angles.hpp>
@@ -13,6 +14,7 @@ module;
 #include <glm/gtx/vector_angle.hpp>
 
 #include <cmath>
+#include <cstdint>
 
 export module Aegis.Math;
 export import :Interpolation;
@@ -50,9 +52,13 @@ export namespace glm
 	using glm::make_vec3;
 	using glm::mod;
 	using glm::normalize;
+	using glm::packHalf1x16;
+	using glm::packHalf2x16;
 	using glm::radians;
 	using glm::row;
 	using glm::rowMajor4;
+	using glm::slerp;
+	using glm::transpose;
 	using glm::two_pi;
 	using glm::value_ptr;
 
@@ -233,6 +239,41 @@ export namespace Aegis::Math
 		rotation = glm::quat_cast(rotationMat);
 	}
 
+	/// @brief Packs a rotation into 32 bits using the 'smallest three' encoding
+	/// @note Layout: | 2 bits index of largest component | 3 x 10 bits remaining components (x, y, z, w order) |
+	///       The largest component is reconstructed from the unit length, precision is about 0.1 degrees
+	auto packQuaternion(const glm::quat& rotation) -> uint32_t
+	{
+		constexpr float COMPONENT_RANGE = 0.70710678f; // Remaining components are within [-1/sqrt(2), 1/sqrt(2)]
+		constexpr float MAX_VALUE = 1023.0f;
+
+		glm::quat q = glm::normalize(rotation);
+		const float components[4] = { q.x, q.y, q.z, q.w };
+
+		uint32_t largest = 0;
+		for (uint32_t i = 1; i < 4; i++)
+		{
+			if (std::abs(components[i]) > std::abs(components[largest]))
+				largest = i;
+		}
+
+		// q and -q are the same rotation -> flip so the dropped component is positive
+		const float sign = components[largest] < 0.0f ? -1.0f : 1.0f;
+
+		uint32_t packed = largest << 30;
+		uint32_t shift = 20;
+		for (uint32_t i = 0; i < 4; i++)
+		{
+			if (i == largest)
+				continue;
+
+			float normalized = glm::clamp(sign * components[i] / COMPONENT_RANGE, -1.0f, 1.0f) * 0.5f + 0.5f;
+			packed |= static_cast<uint32_t>(std::lround(normalized * MAX_VALUE)) << shift;
+			shift -= 10;
+		}
+		return packed;
+	}
+
 	/// @brief Checks if the target is in the field of view of the view direction
 	auto inFOV(const glm::vec3& viewDirection, const glm::vec3& targetDirection, float fov) -> bool
 	{
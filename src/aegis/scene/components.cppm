@@ -92,11 +92,8 @@ export namespace Aegis
 
 	struct DynamicTag
 	{
-		// Used to tag an entity as dynamic (updated every frame)
-		// IMPORTANT: This component can ONLY be added/removed during scene initialization
-		// 
-		// TODO: Add runtime moving of objects between static and dynamic instance buffers 
-		// TODO: Handle fragmentation of instance buffers when moving objects
+		// Used to tag an entity as dynamic (transform is checked for changes every frame)
+		// Can be added/removed at runtime, the renderer moves the instance between the static and dynamic instance buffers
 	};
 
 	struct AmbientLight
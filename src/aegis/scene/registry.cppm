@@ -2,6 +2,7 @@ module;
 
 #include "core/assert.h"
 
+#include <cstdint>
 #include <string>
 #include <utility>
 #include <vector>
@@ -14,9 +15,19 @@ export import Aegis.Scene.Components;
 
 export namespace Aegis::Scene
 {
+	/// @brief Entity that was created, destroyed or got a new parent
+	struct HierarchyChange
+	{
+		Entity entity;
+		bool destroyed{ false };
+	};
+
 	class Registry
 	{
 	public:
+		/// @brief Past this many pending changes only a full rebuild is requested (e.g. while loading a scene)
+		static constexpr std::size_t MAX_HIERARCHY_CHANGES = 1 << 16;
+
 		Registry() = default;
 		Registry(const Registry&) = delete;
 		Registry(Registry&&) = delete;
@@ -26,6 +37,34 @@ export namespace Aegis::Scene
 
 		[[nodiscard]] auto entityCount() const -> std::size_t { return m_registry.storage<entt::entity>()->size(); }
 
+		/// @brief Entities created, destroyed or reparented since the changes were last cleared (in order)
+		/// @note Consumed by the system that caches the hierarchy (see TransformSystem). If hierarchyRebuildRequired() is
+		///       true the list is incomplete and the hierarchy has to be rebuilt from scratch.
+		[[nodiscard]] auto hierarchyChanges() const -> const std::vector<HierarchyChange>& { return m_hierarchyChanges; }
+		[[nodiscard]] auto hierarchyRebuildRequired() const -> bool { return m_hierarchyRebuild; }
+
+		void clearHierarchyChanges()
+		{
+			m_hierarchyChanges.clear();
+			m_hierarchyRebuild = false;
+		}
+
+		/// @brief Entities whose GlobalTransform changed during the last Scene::update
+		/// @note If allTransformsChanged() is true the list is incomplete and every GlobalTransform must be treated as changed
+		[[nodiscard]] auto transformChanges() const -> const std::vector<Entity>& { return m_transformChanges; }
+		[[nodiscard]] auto allTransformsChanged() const -> bool { return m_allTransformsChanged; }
+
+		void markTransformChanged(Entity entity) { m_transformChanges.emplace_back(entity); }
+		void markAllTransformsChanged() { m_allTransformsChanged = true; }
+
+		void clearTransformChanges()
+		{
+			m_transformChanges.clear();
+			m_allTransformsChanged = false;
+		}
+
+		[[nodiscard]] auto isValid(Entity entity) const -> bool { return m_registry.valid(entity.id()); }
+
 		/// @brief Creates an entity with a NameComponent and TransformComponent
 		/// @note Scene::Entity can be passed by value
 		auto create(const std::string& name = std::string{}, const glm::vec3& location = glm::vec3{ 0.0f },
@@ -38,6 +77,7 @@ export namespace Aegis::Scene
 			add<Parent>(entity);
 			add<Siblings>(entity);
 			add<Children>(entity);
+			recordHierarchyChange(entity);
 			return entity;
 		}
 
@@ -49,6 +89,7 @@ export namespace Aegis::Scene
 			removeChildren(entity);
 
 			m_registry.destroy(entity.id());
+			recordHierarchyChange(entity, true);
 		}
 
 		/// @brief Checks if the entity has all components of type T...
@@ -99,6 +140,14 @@ export namespace Aegis::Scene
 			m_registry.remove<T>(entity.id());
 		}
 
+		/// @brief Notifies onUpdate listeners that the component of the entity was modified in place
+		template<typename T>
+		void patch(Entity entity)
+		{
+			AGX_ASSERT_X(has<T>(entity), "Cannot patch Component: Entity does not have the component");
+			m_registry.patch<T>(entity.id());
+		}
+
 		template<typename... Components, typename... Exclude>
 		auto view(entt::exclude_t<Exclude...> exclusion = entt::exclude_t{})
 		{
@@ -151,6 +200,7 @@ export namespace Aegis::Scene
 			}
 			children.last = child;
 			children.count++;
+			recordHierarchyChange(child);
 		}
 
 		void removeChild(Entity entity, Entity child)
@@ -189,6 +239,8 @@ export namespace Aegis::Scene
 
 			// Remove parent at the end
 			get<Parent>(child) = Parent{};
+			get<Siblings>(child) = Siblings{};
+			recordHierarchyChange(child);
 		}
 
 		void removeChildren(Entity entity)
@@ -214,6 +266,7 @@ export namespace Aegis::Scene
 			{
 				get<Parent>(child) = Parent{};
 				get<Siblings>(child) = Siblings{};
+				recordHierarchyChange(child);
 			}
 		}
 
@@ -223,6 +276,12 @@ export namespace Aegis::Scene
 			return m_registry.on_construct<Component>();
 		}
 
+		template<typename Component>
+		auto onUpdate()
+		{
+			return m_registry.on_update<Component>();
+		}
+
 		template<typename Component>
 		auto onDestroy()
 		{
@@ -230,6 +289,24 @@ export namespace Aegis::Scene
 		}
 
 	private:
+		void recordHierarchyChange(Entity entity, bool destroyed = false)
+		{
+			if (m_hierarchyRebuild)
+				return;
+
+			if (m_hierarchyChanges.size() >= MAX_HIERARCHY_CHANGES)
+			{
+				m_hierarchyChanges.clear();
+				m_hierarchyRebuild = true;
+				return;
+			}
+			m_hierarchyChanges.emplace_back(entity, destroyed);
+		}
+
 		entt::registry m_registry;
+		std::vector<HierarchyChange> m_hierarchyChanges;
+		bool m_hierarchyRebuild{ true };
+		std::vector<Entity> m_transformChanges;
+		bool m_allTransformsChanged{ true };
 	};
 }
\ No newline at end of file
@@ -4,6 +4,7 @@ module;
 
 #include <entt/entt.hpp>
 
+#include <algorithm>
 #include <filesystem>
 #include <memory>
 #include <string>
@@ -13,6 +14,7 @@ export module Aegis.Scene;
 
 export import Aegis.Scene.Registry;
 import Aegis.Math;
+import Aegis.Core.JobSystem;
 import Aegis.Core.Profiler;
 import Aegis.Scene.System;
 
@@ -46,6 +48,7 @@ export namespace Aegis::Scene
 		void addSystem(Args&&... args)
 		{
 			m_systems.emplace_back(std::make_unique<T>(std::forward<Args>(args)...));
+			m_scheduleDirty = true;
 		}
 
 		void begin()
@@ -58,11 +61,30 @@ export namespace Aegis::Scene
 
 		void update(float deltaSeconds)
 		{
-			Aegis::ScopeProfiler profiler("Scene Update");
+			Aegis::ScopeProfiler profiler{ "Scene Update"_scope };
 
-			for (auto& system : m_systems)
+			if (m_scheduleDirty)
+				buildSchedule();
+
+			m_registry.clearTransformChanges();
+
+			for (const auto& stage : m_stages)
 			{
-				system->onUpdate(m_registry, deltaSeconds);
+				if (stage.size() == 1)
+				{
+					m_systems[stage.front()]->onUpdate(m_registry, deltaSeconds);
+					continue;
+				}
+
+				auto& jobSystem = Core::JobSystem::instance();
+				Core::JobCounter counter;
+				for (std::size_t index : stage)
+				{
+					jobSystem.submit([this, index, deltaSeconds]() {
+						m_systems[index]->onUpdate(m_registry, deltaSeconds);
+						}, &counter);
+				}
+				jobSystem.wait(counter);
 			}
 		}
 
@@ -72,8 +94,46 @@ export namespace Aegis::Scene
 		}
 
 	private:
+		/// @brief Groups systems into stages of non-conflicting systems which run in parallel
+		/// @note A system is placed in the first stage after the last stage it conflicts with, so conflicting systems
+		///       keep the order in which they were added while independent systems share a stage
+		void buildSchedule()
+		{
+			m_stages.clear();
+
+			std::vector<std::vector<SystemAccess>> stageAccess;
+			for (std::size_t i = 0; i < m_systems.size(); i++)
+			{
+				auto access = m_systems[i]->access();
+				for (auto prepare : access.prepare)
+				{
+					prepare(m_registry);
+				}
+
+				std::size_t stage = stageAccess.size();
+				while (stage > 0 && std::ranges::none_of(stageAccess[stage - 1],
+					[&access](const SystemAccess& other) { return access.conflictsWith(other); }))
+				{
+					stage--;
+				}
+
+				if (stage == stageAccess.size())
+				{
+					m_stages.emplace_back();
+					stageAccess.emplace_back();
+				}
+
+				m_stages[stage].emplace_back(i);
+				stageAccess[stage].emplace_back(std::move(access));
+			}
+
+			m_scheduleDirty = false;
+		}
+
 		Registry m_registry;
 		std::vector<std::unique_ptr<System>> m_systems;
+		std::vector<std::vector<std::size_t>> m_stages;
+		bool m_scheduleDirty{ true };
 
 		Entity m_mainCamera;
 		Entity m_ambientLight;
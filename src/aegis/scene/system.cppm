@@ -1,6 +1,9 @@
 module;
 
+#include <algorithm>
 #include <concepts>
+#include <typeindex>
+#include <vector>
 
 export module Aegis.Scene.System;
 
@@ -8,6 +11,58 @@ export import Aegis.Scene.Registry;
 
 export namespace Aegis::Scene
 {
+	/// @brief Describes which components a system reads and writes during onUpdate
+	/// @note Systems without declared access are treated as exclusive and never run in parallel with other systems
+	struct SystemAccess
+	{
+		using Prepare = void(*)(Registry&);
+
+		std::vector<std::type_index> reads;
+		std::vector<std::type_index> writes;
+		std::vector<Prepare> prepare;
+		bool exclusive{ false };
+
+		[[nodiscard]] static auto exclusiveAccess() -> SystemAccess { return SystemAccess{ .exclusive = true }; }
+
+		template<typename... T>
+		auto read() -> SystemAccess&
+		{
+			(addType<T>(reads), ...);
+			return *this;
+		}
+
+		template<typename... T>
+		auto write() -> SystemAccess&
+		{
+			(addType<T>(writes), ...);
+			return *this;
+		}
+
+		/// @brief Two systems conflict if one writes a component the other one reads or writes
+		[[nodiscard]] auto conflictsWith(const SystemAccess& other) const -> bool
+		{
+			if (exclusive || other.exclusive)
+				return true;
+
+			auto intersects = [](const std::vector<std::type_index>& a, const std::vector<std::type_index>& b) {
+				return std::ranges::any_of(a, [&b](const auto& type) { return std::ranges::find(b, type) != b.end(); });
+				};
+
+			return intersects(writes, other.writes) || intersects(writes, other.reads) || intersects(reads, other.writes);
+		}
+
+	private:
+		template<typename T>
+		void addType(std::vector<std::type_index>& types)
+		{
+			types.emplace_back(typeid(T));
+
+			// Component storages are created lazily, which is not thread safe -> create them before running in parallel
+			prepare.emplace_back([](Registry& registry) { registry.view<T>(); });
+		}
+	};
+
+
 	class System
 	{
 	public:
@@ -18,8 +73,11 @@ export namespace Aegis::Scene
 		virtual void onDetach() {}
 		virtual void onBegin(Registry& registry) {}
 		virtual void onUpdate(Registry& registry, float deltaSeconds) {}
+
+		/// @brief Components accessed in onUpdate, used to run non-conflicting systems in parallel
+		virtual auto access() const -> SystemAccess { return SystemAccess::exclusiveAccess(); }
 	};
 
 	template <typename T>
 	concept SystemDerived = std::derived_from<T, System>;
-}
\ No newline at end of file
+}
@@ -17,6 +17,13 @@ export namespace Aegis::Scene
 	class CameraSystem : public System
 	{
 	public:
+		auto access() const -> SystemAccess override
+		{
+			return SystemAccess{}
+				.read<GlobalTransform>()
+				.write<Camera>();
+		}
+
 		virtual void onUpdate(Registry& registry, float deltaSeconds) override
 		{
 			auto view = registry.view<GlobalTransform, Camera>();
@@ -1,67 +1,417 @@
 module;
 
+#include <entt/entt.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <limits>
 #include <vector>
-#include <ranges>
 
 export module Aegis.Scene.Systems.TransformSystem;
 
+import Aegis.Core.JobSystem;
 import Aegis.Scene.Registry;
 import Aegis.Scene.System;
 
 export namespace Aegis::Scene
 {
+	/// @brief Computes the GlobalTransform of all entities from their local Transform and parent hierarchy
+	/// @note Entities are kept in per depth level lists, so parents are always updated before their children. Only
+	///       subtrees of entities whose Transform changed are propagated and each depth level is split across threads.
+	///       Created, destroyed and reparented entities are moved between the levels incrementally (see
+	///       Registry::hierarchyChanges), the hierarchy is only rebuilt from scratch for bulk changes.
 	class TransformSystem : public System
 	{
 	public:
+		static constexpr uint32_t INVALID_INDEX = std::numeric_limits<uint32_t>::max();
+		static constexpr std::size_t PARALLEL_THRESHOLD = 1024;
+
+		/// @brief More pending changes than this ratio of the nodes are handled with a full rebuild
+		static constexpr float REBUILD_RATIO = 0.25f;
+
 		TransformSystem() = default;
 		~TransformSystem() = default;
 
 		void onBegin(Registry& registry) override
 		{
-			// Calculate initial global transforms for all entities
-			std::vector<Entity> hierarchy;
-			auto view = registry.view<GlobalTransform>();
-			for (auto&& [entity, globalTransform] : view.each())
+			rebuildHierarchy(registry);
+			updateAll(registry);
+			registry.markAllTransformsChanged();
+		}
+
+		void onUpdate(Registry& registry, float deltaSeconds) override
+		{
+			const auto& changes = registry.hierarchyChanges();
+			if (registry.hierarchyRebuildRequired() || static_cast<float>(changes.size()) > REBUILD_RATIO * static_cast<float>(nodeCount()))
+			{
+				rebuildHierarchy(registry);
+				updateAll(registry);
+				registry.markAllTransformsChanged();
+				return;
+			}
+
+			m_frame++;
+			for (auto& level : m_dirtyLevels)
+			{
+				level.clear();
+			}
+
+			applyHierarchyChanges(registry);
+
+			// Only dynamic entities are allowed to move, so only those need to be checked for changes
+			// The check is split across threads, changed nodes are queued afterwards (queueing is not thread safe)
+			auto view = registry.view<Transform, DynamicTag>();
+			m_changed.resize(view.size_hint());
+			std::atomic<uint32_t> changedCount{ 0 };
+			Core::JobSystem::instance().parallelEach(view, [this, &changedCount](entt::entity entity, const Transform& transform) {
+				uint32_t index = nodeIndex(entity);
+				if (index == INVALID_INDEX)
+					return;
+
+				auto& node = m_nodes[index];
+				if (std::memcmp(&node.local, &transform, sizeof(Transform)) == 0)
+					return;
+
+				node.local = transform;
+				m_changed[changedCount.fetch_add(1, std::memory_order_relaxed)] = index;
+				}, PARALLEL_THRESHOLD);
+
+			for (uint32_t i = 0; i < changedCount.load(std::memory_order_relaxed); i++)
 			{
-				// Find hierarchy of all parents
-				hierarchy.clear();
-				Entity current = Entity{ entity };
-				while (current)
+				enqueue(m_changed[i]);
+			}
+
+			propagateDirty(registry);
+		}
+
+		auto access() const -> SystemAccess override
+		{
+			return SystemAccess{}
+				.read<Transform, Parent, Children, Siblings, DynamicTag>()
+				.write<GlobalTransform>();
+		}
+
+		[[nodiscard]] auto nodeCount() const -> std::size_t { return m_nodes.size() - m_freeNodes.size(); }
+		[[nodiscard]] auto depth() const -> std::size_t { return m_levels.size(); }
+
+	private:
+		struct Node
+		{
+			Entity entity;
+			uint32_t parent{ INVALID_INDEX };
+			uint32_t level{ 0 };
+			uint32_t levelSlot{ 0 };	// Position in the list of the level
+			uint64_t queuedFrame{ 0 };
+			Transform local;
+		};
+
+		static void combine(GlobalTransform& global, const GlobalTransform& parent, const Transform& local)
+		{
+			global.location = parent.location + local.location;
+			global.rotation = parent.rotation * local.rotation;
+			global.scale = parent.scale * local.scale;
+		}
+
+		static void assign(GlobalTransform& global, const Transform& local)
+		{
+			global.location = local.location;
+			global.rotation = local.rotation;
+			global.scale = local.scale;
+		}
+
+		/// @brief Runs func for every element, splitting large ranges across the job system workers
+		template<typename Range, typename Func>
+		static void forEach(Range& range, Func&& func)
+		{
+			if (range.size() < PARALLEL_THRESHOLD)
+			{
+				std::for_each(range.begin(), range.end(), func);
+				return;
+			}
+
+			Core::JobSystem::instance().parallelFor(range.size(), PARALLEL_THRESHOLD / 4,
+				[&range, &func](std::size_t begin, std::size_t end) {
+					std::for_each(range.begin() + begin, range.begin() + end, func);
+				});
+		}
+
+		[[nodiscard]] auto nodeIndex(entt::entity entity) const -> uint32_t
+		{
+			auto slot = static_cast<std::size_t>(entt::to_entity(entity));
+			if (slot >= m_lookup.size())
+				return INVALID_INDEX;
+
+			uint32_t index = m_lookup[slot];
+			if (index == INVALID_INDEX || m_nodes[index].entity.id() != entity)
+				return INVALID_INDEX;
+
+			return index;
+		}
+
+		/// @brief Calls func(childIndex) for every child of the node which is part of the hierarchy
+		template<typename Func>
+		void forEachChild(Registry& registry, uint32_t index, Func&& func) const
+		{
+			Entity child = registry.get<Children>(m_nodes[index].entity).first;
+			while (child)
+			{
+				uint32_t childIndex = nodeIndex(child.id());
+				if (childIndex != INVALID_INDEX)
+					func(childIndex);
+
+				child = registry.get<Siblings>(child).next;
+			}
+		}
+
+		/// @brief Sorts all entities in breadth-first order (children of a node are stored next to each other)
+		void rebuildHierarchy(Registry& registry)
+		{
+			registry.clearHierarchyChanges();
+			m_nodes.clear();
+			m_freeNodes.clear();
+			m_levels.clear();
+			m_lookup.clear();
+
+			auto view = registry.view<Transform, Parent>();
+			m_nodes.reserve(view.size_hint());
+
+			// Roots first
+			for (auto&& [entity, transform, parent] : view.each())
+			{
+				if (parent.entity && registry.has<GlobalTransform>(parent.entity))
+					continue;
+
+				addNode(Entity{ entity }, INVALID_INDEX, 0, transform);
+			}
+
+			// Append the children of each level (the level lists grow while iterating, so they are accessed by index)
+			for (uint32_t level = 0; level < static_cast<uint32_t>(m_levels.size()); level++)
+			{
+				for (uint32_t i = 0; i < static_cast<uint32_t>(m_levels[level].size()); i++)
 				{
-					hierarchy.emplace_back(current);
-					current = registry.get<Parent>(current).entity;
+					uint32_t index = m_levels[level][i];
+					Entity child = registry.get<Children>(m_nodes[index].entity).first;
+					while (child)
+					{
+						addNode(child, index, level + 1, registry.get<Transform>(child));
+						child = registry.get<Siblings>(child).next;
+					}
 				}
+			}
+
+			m_dirtyLevels.resize(m_levels.size());
+		}
+
+		/// @brief Moves created, destroyed and reparented entities to their current depth and queues their subtrees
+		/// @note Changes are applied with the final parent links of this frame, so the order of the changes only matters
+		///       for entities that were destroyed and whose slot was reused
+		void applyHierarchyChanges(Registry& registry)
+		{
+			const auto& changes = registry.hierarchyChanges();
+			if (changes.empty())
+				return;
 
-				globalTransform = GlobalTransform{};
-				for (auto e : std::ranges::views::reverse(hierarchy))
+			m_placed.clear();
+			for (const auto& change : changes)
+			{
+				if (change.destroyed)
 				{
-					auto& localTransform = registry.get<Transform>(e);
-					globalTransform.location = globalTransform.location + localTransform.location;
-					globalTransform.rotation = globalTransform.rotation * localTransform.rotation;
-					globalTransform.scale = globalTransform.scale * localTransform.scale;
+					removeNode(nodeIndex(change.entity.id()));
+					continue;
 				}
+
+				if (!registry.isValid(change.entity) || !registry.has<Transform, Parent>(change.entity))
+					continue;
+
+				placeNode(registry, change.entity);
+				m_placed.emplace_back(change.entity);
+			}
+			registry.clearHierarchyChanges();
+
+			while (!m_levels.empty() && m_levels.back().empty())
+			{
+				m_levels.pop_back();
+			}
+			if (m_dirtyLevels.size() < m_levels.size())
+				m_dirtyLevels.resize(m_levels.size());
+
+			// Queued once all levels are final, propagation updates the subtrees
+			for (Entity entity : m_placed)
+			{
+				uint32_t index = nodeIndex(entity.id());
+				if (index != INVALID_INDEX)
+					enqueue(index);
 			}
 		}
 
-		void onUpdate(Registry& registry, float deltaSeconds) override
+		/// @brief Adds the node of the entity or moves it below its current parent (the subtree keeps its relative depth)
+		void placeNode(Registry& registry, Entity entity)
 		{
-			// Note: This lags 1 frame per parent behind the actual local transform (but this is fine :)
-			auto view = registry.view<Transform, GlobalTransform, Parent, DynamicTag>();
-			for (auto&& [entity, transform, globalTransform, parent] : view.each())
+			Entity parentEntity = registry.get<Parent>(entity).entity;
+			uint32_t parent = parentEntity ? nodeIndex(parentEntity.id()) : INVALID_INDEX;
+			uint32_t level = parent == INVALID_INDEX ? 0 : m_nodes[parent].level + 1;
+
+			uint32_t index = nodeIndex(entity.id());
+			if (index == INVALID_INDEX)
 			{
-				if (!parent.entity || !registry.has<GlobalTransform>(parent.entity))
-				{
-					globalTransform.location = transform.location;
-					globalTransform.rotation = transform.rotation;
-					globalTransform.scale = transform.scale;
+				index = addNode(entity, parent, level, registry.get<Transform>(entity));
+			}
+			else
+			{
+				m_nodes[index].parent = parent;
+				m_nodes[index].local = registry.get<Transform>(entity);
+				moveNode(index, level);
+			}
+
+			// Only subtrees whose depth changed have to be walked
+			m_stack.clear();
+			m_stack.emplace_back(index);
+			while (!m_stack.empty())
+			{
+				uint32_t current = m_stack.back();
+				m_stack.pop_back();
+
+				forEachChild(registry, current, [this, current](uint32_t child) {
+					m_nodes[child].parent = current;
+					if (m_nodes[child].level == m_nodes[current].level + 1)
+						return;
+
+					moveNode(child, m_nodes[current].level + 1);
+					m_stack.emplace_back(child);
+					});
+			}
+		}
+
+		auto addNode(Entity entity, uint32_t parent, uint32_t level, const Transform& local) -> uint32_t
+		{
+			uint32_t index;
+			if (!m_freeNodes.empty())
+			{
+				index = m_freeNodes.back();
+				m_freeNodes.pop_back();
+			}
+			else
+			{
+				index = static_cast<uint32_t>(m_nodes.size());
+				m_nodes.emplace_back();
+			}
+
+			m_nodes[index] = Node{ .entity = entity, .parent = parent, .local = local };
+			insertIntoLevel(index, level);
+
+			auto slot = static_cast<std::size_t>(entt::to_entity(entity.id()));
+			if (slot >= m_lookup.size())
+				m_lookup.resize(slot + 1, INVALID_INDEX);
+
+			m_lookup[slot] = index;
+			return index;
+		}
+
+		void removeNode(uint32_t index)
+		{
+			if (index == INVALID_INDEX)
+				return;
+
+			removeFromLevel(index);
+			m_lookup[static_cast<std::size_t>(entt::to_entity(m_nodes[index].entity.id()))] = INVALID_INDEX;
+			m_nodes[index] = Node{};
+			m_freeNodes.emplace_back(index);
+		}
+
+		void moveNode(uint32_t index, uint32_t level)
+		{
+			if (m_nodes[index].level == level)
+				return;
+
+			removeFromLevel(index);
+			insertIntoLevel(index, level);
+		}
+
+		void insertIntoLevel(uint32_t index, uint32_t level)
+		{
+			if (level >= m_levels.size())
+				m_levels.resize(level + 1);
+
+			m_nodes[index].level = level;
+			m_nodes[index].levelSlot = static_cast<uint32_t>(m_levels[level].size());
+			m_levels[level].emplace_back(index);
+		}
+
+		/// @brief Swaps the last node of the level into the slot
+		void removeFromLevel(uint32_t index)
+		{
+			auto& level = m_levels[m_nodes[index].level];
+			uint32_t slot = m_nodes[index].levelSlot;
+			uint32_t last = level.back();
+			level[slot] = last;
+			m_nodes[last].levelSlot = slot;
+			level.pop_back();
+		}
+
+		/// @brief Recomputes the global transform of every entity level by level
+		void updateAll(Registry& registry)
+		{
+			for (auto& level : m_levels)
+			{
+				forEach(level, [this, &registry](uint32_t index) {
+					updateNode(registry, m_nodes[index]);
+					});
+			}
+		}
+
+		void enqueue(uint32_t index)
+		{
+			auto& node = m_nodes[index];
+			if (node.queuedFrame == m_frame)
+				return;
+
+			node.queuedFrame = m_frame;
+			m_dirtyLevels[node.level].emplace_back(index);
+		}
+
+		/// @brief Updates all dirty nodes level by level and marks their children dirty
+		void propagateDirty(Registry& registry)
+		{
+			for (auto& dirty : m_dirtyLevels)
+			{
+				if (dirty.empty())
 					continue;
+
+				forEach(dirty, [this, &registry](uint32_t index) {
+					updateNode(registry, m_nodes[index]);
+					});
+
+				for (uint32_t index : dirty)
+				{
+					registry.markTransformChanged(m_nodes[index].entity);
+					forEachChild(registry, index, [this](uint32_t child) { enqueue(child); });
 				}
+			}
+		}
 
-				auto& parentGlobal = registry.get<GlobalTransform>(parent.entity);
-				globalTransform.location = parentGlobal.location + transform.location;
-				globalTransform.rotation = parentGlobal.rotation * transform.rotation;
-				globalTransform.scale = parentGlobal.scale * transform.scale;
+		void updateNode(Registry& registry, const Node& node)
+		{
+			auto& global = registry.get<GlobalTransform>(node.entity);
+			if (node.parent == INVALID_INDEX)
+			{
+				assign(global, node.local);
+				return;
 			}
+
+			const auto& parentGlobal = registry.get<GlobalTransform>(m_nodes[node.parent].entity);
+			combine(global, parentGlobal, node.local);
 		}
+
+		std::vector<Node> m_nodes;
+		std::vector<uint32_t> m_freeNodes;
+		std::vector<std::vector<uint32_t>> m_levels;	// Node indices per depth
+		std::vector<uint32_t> m_lookup;
+		std::vector<std::vector<uint32_t>> m_dirtyLevels;
+		std::vector<Entity> m_placed;
+		std::vector<uint32_t> m_changed;
+		std::vector<uint32_t> m_stack;
+		uint64_t m_frame{ 0 };
 	};
-}
\ No newline at end of file
+}
@@ -4,6 +4,7 @@ import Aegis.Scene;
 import Aegis.Scene.Systems.CameraSystem;
 import Aegis.Scene.Systems.TransformSystem;
 import Aegis.Graphics.Components;
+import Aegis.Graphics.IBLCache;
 import Aegis.Core.AssetManager;
 import Aegis.Scripting.ScriptManager;
 import Aegis.Scripting.Movement.KinematicMovementController;
@@ -13,8 +14,10 @@ export namespace Aegis
 {
 	void createDefaultScene(Scene::Scene& scene, Scripting::ScriptManager& scriptManager)
 	{
-		scene.addSystem<Scene::CameraSystem>();
+		// The camera reads the global transforms of the current frame, systems added later that do not touch them
+		// (e.g. moving entities) share its stage and run in parallel to it
 		scene.addSystem<Scene::TransformSystem>();
+		scene.addSystem<Scene::CameraSystem>();
 
 		auto& registry = scene.registry();
 
@@ -42,7 +45,7 @@ export namespace Aegis
 		env.skybox = Core::AssetManager::instance().get<Graphics::Texture>("default/cubemap_black");
 		env.irradiance = env.skybox;
 		env.prefiltered = env.skybox;
-		env.brdfLUT = Graphics::Texture::BRDFLUT();
+		env.brdfLUT = Graphics::IBLCache::brdfLUT();
 		scene.setEnvironment(skybox);
 	}
 }
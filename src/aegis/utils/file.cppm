@@ -1,9 +1,29 @@
 module;
 
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <filesystem>
+#include <format>
 #include <fstream>
+#include <functional>
+#include <span>
+#include <system_error>
+#include <thread>
+#include <utility>
 #include <vector>
 
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 export module Aegis.Utils.File;
 
 export namespace Aegis::Utils::File
@@ -44,4 +64,152 @@ export namespace Aegis::Utils::File
 
 		return buffer;
 	}
+
+	/// @brief Writes the data to the file (replacing it), returns false if the file could not be written
+	auto writeBinary(const std::filesystem::path& filePath, std::span<const std::byte> data) -> bool
+	{
+		std::ofstream file{ filePath, std::ios::binary | std::ios::trunc };
+		if (!file.is_open())
+			return false;
+
+		file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+		return file.good();
+	}
+
+	/// @brief Writes the data to a temporary file and renames it, readers never see a partially written file
+	/// @note Creates missing parent directories, safe to call from multiple threads for the same path
+	auto writeBinaryAtomic(const std::filesystem::path& filePath, std::span<const std::byte> data) -> bool
+	{
+		std::error_code error;
+		std::filesystem::create_directories(filePath.parent_path(), error);
+
+		auto threadId = std::hash<std::thread::id>{}(std::this_thread::get_id());
+		auto tempPath = std::filesystem::path{ filePath }.concat(std::format(".{:x}.tmp", threadId));
+		if (!writeBinary(tempPath, data))
+		{
+			std::filesystem::remove(tempPath, error);
+			return false;
+		}
+
+		std::filesystem::rename(tempPath, filePath, error);
+		if (error)
+		{
+			std::filesystem::remove(tempPath, error);
+			return false;
+		}
+		return true;
+	}
+
+	/// @brief 64 bit FNV-1a over 8 byte words, used to detect changed source files (not cryptographic)
+	[[nodiscard]] auto hash(std::span<const std::byte> data, uint64_t seed = 0xcbf29ce484222325ull) -> uint64_t
+	{
+		constexpr uint64_t PRIME = 0x100000001b3ull;
+
+		uint64_t hash = seed;
+		std::size_t i = 0;
+		for (; i + sizeof(uint64_t) <= data.size(); i += sizeof(uint64_t))
+		{
+			uint64_t word;
+			std::memcpy(&word, data.data() + i, sizeof(word));
+			hash = (hash ^ word) * PRIME;
+		}
+		for (; i < data.size(); i++)
+		{
+			hash = (hash ^ static_cast<uint64_t>(data[i])) * PRIME;
+		}
+		return hash;
+	}
+
+	/// @brief Read only memory mapping of a whole file
+	/// @note The mapping stays valid as long as the object lives, an empty or missing file results in an invalid mapping
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+		explicit MappedFile(const std::filesystem::path& filePath)
+		{
+#if defined(_WIN32)
+			HANDLE file = CreateFileW(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+				FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			if (file == INVALID_HANDLE_VALUE)
+				return;
+
+			LARGE_INTEGER size{};
+			if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+			{
+				HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+				if (mapping)
+				{
+					m_data = static_cast<const std::byte*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+					m_size = m_data ? static_cast<std::size_t>(size.QuadPart) : 0;
+					CloseHandle(mapping);
+				}
+			}
+			CloseHandle(file);
+#else
+			int file = ::open(filePath.c_str(), O_RDONLY);
+			if (file < 0)
+				return;
+
+			struct stat info{};
+			if (fstat(file, &info) == 0 && info.st_size > 0)
+			{
+				void* data = mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+				if (data != MAP_FAILED)
+				{
+					m_data = static_cast<const std::byte*>(data);
+					m_size = static_cast<std::size_t>(info.st_size);
+				}
+			}
+			::close(file);
+#endif
+		}
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile(MappedFile&& other) noexcept :
+			m_data{ std::exchange(other.m_data, nullptr) },
+			m_size{ std::exchange(other.m_size, 0) }
+		{
+		}
+
+		~MappedFile()
+		{
+			unmap();
+		}
+
+		auto operator=(const MappedFile&) -> MappedFile & = delete;
+		auto operator=(MappedFile&& other) noexcept -> MappedFile&
+		{
+			if (this != &other)
+			{
+				unmap();
+				m_data = std::exchange(other.m_data, nullptr);
+				m_size = std::exchange(other.m_size, 0);
+			}
+			return *this;
+		}
+
+		[[nodiscard]] auto isValid() const -> bool { return m_data != nullptr; }
+		[[nodiscard]] auto data() const -> const std::byte* { return m_data; }
+		[[nodiscard]] auto size() const -> std::size_t { return m_size; }
+		[[nodiscard]] auto bytes() const -> std::span<const std::byte> { return { m_data, m_size }; }
+
+	private:
+		void unmap()
+		{
+			if (!m_data)
+				return;
+
+#if defined(_WIN32)
+			UnmapViewOfFile(m_data);
+#else
+			munmap(const_cast<std::byte*>(m_data), m_size);
+#endif
+			m_data = nullptr;
+			m_size = 0;
+		}
+
+		const std::byte* m_data{ nullptr };
+		std::size_t m_size{ 0 };
+	};
 }
@@ -0,0 +1,24 @@
+module;
+
+#include <string>
+#include <string_view>
+
+export module Aegis.Utils.Json;
+
+export namespace Aegis::Utils::Json
+{
+	/// @brief Escapes quotes and backslashes for use in a JSON string, control characters are dropped
+	auto escape(std::string_view text) -> std::string
+	{
+		std::string result;
+		result.reserve(text.size());
+		for (char c : text)
+		{
+			if (c == '"' || c == '\\')
+				result += '\\';
+			if (static_cast<unsigned char>(c) >= 0x20)
+				result += c;
+		}
+		return result;
+	}
+}
@@ -0,0 +1,104 @@
+#include "test.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+import Aegis.Benchmark;
+import Aegis.Math;
+
+using Aegis::CameraPath;
+using Aegis::TimingStatistics;
+
+namespace
+{
+	constexpr float EPSILON = 1e-5f;
+
+	void statistics()
+	{
+		AGX_CHECK(TimingStatistics::compute({}).count == 0);
+
+		std::vector<double> samples;
+		for (int i = 1; i <= 100; i++)
+			samples.push_back(static_cast<double>(i));
+		std::ranges::shuffle(samples, std::mt19937{ 42 });
+
+		auto stats = TimingStatistics::compute(samples);
+		AGX_CHECK(stats.count == 100);
+		AGX_CHECK(stats.min == 1.0);
+		AGX_CHECK(stats.max == 100.0);
+		AGX_CHECK_NEAR(stats.mean, 50.5, 1e-9);
+		AGX_CHECK(stats.p50 == 50.0);
+		AGX_CHECK(stats.p95 == 95.0);
+		AGX_CHECK(stats.p99 == 99.0);
+
+		// Nearest rank: the percentile is always one of the samples
+		auto few = TimingStatistics::compute({ 4.0, 1.0, 3.0, 2.0 });
+		AGX_CHECK(few.p50 == 2.0);
+		AGX_CHECK(few.p95 == 4.0);
+		AGX_CHECK(few.p99 == 4.0);
+
+		auto single = TimingStatistics::compute({ 7.0 });
+		AGX_CHECK(single.min == 7.0 && single.max == 7.0 && single.p50 == 7.0 && single.p99 == 7.0);
+	}
+
+	auto distance(const glm::vec3& a, const glm::vec3& b) -> float
+	{
+		return glm::length(a - b);
+	}
+
+	/// @brief Whether both quaternions describe the same rotation
+	auto sameRotation(const glm::quat& a, const glm::quat& b) -> bool
+	{
+		return std::abs(std::abs(glm::dot(a, b)) - 1.0f) < EPSILON;
+	}
+
+	void cameraPath()
+	{
+		glm::quat quarterTurn = glm::angleAxis(glm::radians(90.0f), Aegis::Math::World::UP);
+		CameraPath path{
+			.keys = {
+				{ .location = { 0.0f, 0.0f, 0.0f } },
+				{ .location = { 1.0f, 0.0f, 0.0f }, .rotation = quarterTurn },
+				{ .location = { 2.0f, 0.0f, 0.0f }, .rotation = quarterTurn },
+				{ .location = { 3.0f, 0.0f, 0.0f }, .rotation = quarterTurn },
+			},
+			.duration = 3.0f,
+		};
+
+		// Passes through the keys, one segment per second
+		for (int key = 0; key < 3; key++)
+		{
+			auto transform = path.evaluate(static_cast<float>(key));
+			AGX_CHECK(distance(transform.location, path.keys[key].location) < EPSILON);
+			AGX_CHECK(sameRotation(transform.rotation, path.keys[key].rotation));
+		}
+
+		// Evenly spaced keys on a line stay on the line
+		auto middle = path.evaluate(1.5f);
+		AGX_CHECK(distance(middle.location, { 1.5f, 0.0f, 0.0f }) < EPSILON);
+
+		auto halfway = path.evaluate(0.5f);
+		AGX_CHECK(sameRotation(halfway.rotation, glm::angleAxis(glm::radians(45.0f), Aegis::Math::World::UP)));
+
+		auto last = path.evaluate(2.5f);
+		AGX_CHECK(last.location.x > 2.0f && last.location.x < 3.0f);
+
+		// Restarts after the duration
+		AGX_CHECK(distance(path.evaluate(3.0f).location, path.keys[0].location) < EPSILON);
+		AGX_CHECK(distance(path.evaluate(4.5f).location, middle.location) < EPSILON);
+
+		CameraPath single{ .keys = { { .location = { 5.0f, 6.0f, 7.0f }, .rotation = quarterTurn } } };
+		auto fixed = single.evaluate(12.3f);
+		AGX_CHECK(distance(fixed.location, { 5.0f, 6.0f, 7.0f }) < EPSILON);
+		AGX_CHECK(sameRotation(fixed.rotation, quarterTurn));
+	}
+}
+
+auto main() -> int
+{
+	statistics();
+	cameraPath();
+	return Aegis::Test::result();
+}
@@ -0,0 +1,175 @@
+#include "test.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <span>
+
+import Aegis.Graphics.BlockCompression;
+
+using namespace Aegis::Graphics::BlockCompression;
+
+namespace
+{
+	using Texels = std::array<std::array<int, 4>, 16>;
+
+	/// @brief Reads 'count' bits starting at bit 'position' (LSB first)
+	auto readBits(std::span<const std::byte> data, uint32_t position, uint32_t count) -> uint32_t
+	{
+		uint32_t value = 0;
+		for (uint32_t i = 0; i < count; i++, position++)
+		{
+			uint32_t bit = (static_cast<uint32_t>(data[position / 8]) >> (position % 8)) & 1;
+			value |= bit << i;
+		}
+		return value;
+	}
+
+	/// @brief Reference BC4 decoder (both palette modes), returns the values of one channel
+	auto decodeBC4(std::span<const std::byte> data) -> std::array<int, 16>
+	{
+		int r0 = static_cast<int>(data[0]);
+		int r1 = static_cast<int>(data[1]);
+		std::array<int, 8> palette{ r0, r1 };
+		if (r0 > r1)
+		{
+			for (int i = 2; i < 8; i++)
+				palette[i] = ((8 - i) * r0 + (i - 1) * r1) / 7;
+		}
+		else
+		{
+			for (int i = 2; i < 6; i++)
+				palette[i] = ((6 - i) * r0 + (i - 1) * r1) / 5;
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+
+		std::array<int, 16> values;
+		for (uint32_t texel = 0; texel < 16; texel++)
+			values[texel] = palette[readBits(data, 16 + 3 * texel, 3)];
+		return values;
+	}
+
+	/// @brief Reference BC7 decoder for mode 6 blocks
+	auto decodeBC7Mode6(std::span<const std::byte> data) -> Texels
+	{
+		static constexpr std::array<int, 16> WEIGHTS{ 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+		std::array<std::array<int, 4>, 2> endpoints;
+		uint32_t position = 7;
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			for (auto& endpoint : endpoints)
+			{
+				endpoint[c] = static_cast<int>(readBits(data, position, 7));
+				position += 7;
+			}
+		}
+		for (auto& endpoint : endpoints)
+		{
+			int pBit = static_cast<int>(readBits(data, position++, 1));
+			for (auto& value : endpoint)
+				value = (value << 1) | pBit;
+		}
+
+		Texels texels;
+		for (uint32_t texel = 0; texel < 16; texel++)
+		{
+			uint32_t bits = texel == 0 ? 3 : 4;
+			int weight = WEIGHTS[readBits(data, position, bits)];
+			position += bits;
+			for (uint32_t c = 0; c < 4; c++)
+				texels[texel][c] = ((64 - weight) * endpoints[0][c] + weight * endpoints[1][c] + 32) >> 6;
+		}
+		return texels;
+	}
+
+	auto makeBlock(auto&& texel) -> Block
+	{
+		Block block;
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			for (uint32_t c = 0; c < 4; c++)
+				block[i][c] = static_cast<uint8_t>(std::clamp(texel(i, c), 0, 255));
+		}
+		return block;
+	}
+
+	auto maxError(const Block& block, const Texels& decoded) -> int
+	{
+		int error = 0;
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			for (uint32_t c = 0; c < 4; c++)
+				error = std::max(error, std::abs(decoded[i][c] - block[i][c]));
+		}
+		return error;
+	}
+
+	void bc4()
+	{
+		auto constant = makeBlock([](uint32_t, uint32_t c) { return c == 0 ? 77 : 0; });
+		auto encoded = encodeBC4(constant, 0);
+		AGX_CHECK(static_cast<int>(encoded[0]) == 77 && static_cast<int>(encoded[1]) == 77);
+		AGX_CHECK(std::ranges::all_of(decodeBC4(encoded), [](int value) { return value == 77; }));
+
+		// Two values are the endpoints and decode exactly
+		auto twoValues = makeBlock([](uint32_t i, uint32_t) { return i % 2 == 0 ? 10 : 200; });
+		encoded = encodeBC4(twoValues, 2);
+		AGX_CHECK(encoded[0] > encoded[1]);
+		auto decoded = decodeBC4(encoded);
+		for (uint32_t i = 0; i < 16; i++)
+			AGX_CHECK(decoded[i] == twoValues[i][2]);
+
+		// Full range ramp, within half a palette step (255 / 7 / 2) plus rounding
+		auto ramp = makeBlock([](uint32_t i, uint32_t) { return static_cast<int>(i) * 17; });
+		decoded = decodeBC4(encodeBC4(ramp, 1));
+		for (uint32_t i = 0; i < 16; i++)
+			AGX_CHECK(std::abs(decoded[i] - ramp[i][1]) <= 19);
+		AGX_CHECK(decoded[0] == 0 && decoded[15] == 255);
+	}
+
+	void bc5()
+	{
+		auto block = makeBlock([](uint32_t i, uint32_t c) { return c == 0 ? static_cast<int>(i) * 16 : 255 - static_cast<int>(i) * 8; });
+		auto encoded = encodeBC5(block);
+		auto red = encodeBC4(block, 0);
+		auto green = encodeBC4(block, 1);
+		AGX_CHECK(std::memcmp(encoded.data(), red.data(), red.size()) == 0);
+		AGX_CHECK(std::memcmp(encoded.data() + red.size(), green.data(), green.size()) == 0);
+	}
+
+	void bc7()
+	{
+		auto constant = makeBlock([](uint32_t, uint32_t c) { return std::array{ 13, 201, 99, 255 }[c]; });
+		auto encoded = encodeBC7(constant);
+		AGX_CHECK(readBits(encoded, 0, 7) == 1 << 6);
+		AGX_CHECK(maxError(constant, decodeBC7Mode6(encoded)) == 0);
+
+		// The p-bit is shared by the channels of an endpoint, mixed parities are off by one
+		auto mixedParity = makeBlock([](uint32_t, uint32_t c) { return std::array{ 12, 201, 98, 255 }[c]; });
+		AGX_CHECK(maxError(mixedParity, decodeBC7Mode6(encodeBC7(mixedParity))) <= 1);
+
+		// Black and white checker with alpha, 0 and 255 are representable endpoints
+		auto checker = makeBlock([](uint32_t i, uint32_t) { return (i + i / 4) % 2 == 0 ? 0 : 255; });
+		AGX_CHECK(maxError(checker, decodeBC7Mode6(encodeBC7(checker))) == 0);
+
+		// Smooth gradient along one axis through the colour space
+		auto gradient = makeBlock([](uint32_t i, uint32_t c) {
+			int t = static_cast<int>(i % 4 + i / 4);
+			return std::array{ 40 + 20 * t, 200 - 15 * t, 90 + 5 * t, 255 }[c];
+			});
+		AGX_CHECK(maxError(gradient, decodeBC7Mode6(encodeBC7(gradient))) <= 4);
+	}
+}
+
+auto main() -> int
+{
+	bc4();
+	bc5();
+	bc7();
+	return Aegis::Test::result();
+}
@@ -0,0 +1,145 @@
+#include "test.h"
+#include "graphics/vulkan/vulkan_include.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <vector>
+
+import Aegis.Graphics.KTX2;
+
+using namespace Aegis::Graphics;
+
+namespace
+{
+	// Byte offsets in the KTX2 header and the first level index entry
+	constexpr std::size_t FORMAT_OFFSET = 12;
+	constexpr std::size_t WIDTH_OFFSET = 20;
+	constexpr std::size_t LAYER_COUNT_OFFSET = 32;
+	constexpr std::size_t FACE_COUNT_OFFSET = 36;
+	constexpr std::size_t LEVEL_COUNT_OFFSET = 40;
+	constexpr std::size_t SUPERCOMPRESSION_OFFSET = 44;
+	constexpr std::size_t LEVEL0_LENGTH_OFFSET = 80 + 8;
+
+	void patch(std::vector<std::byte>& file, std::size_t offset, uint32_t value)
+	{
+		std::memcpy(file.data() + offset, &value, sizeof(value));
+	}
+
+	/// @brief Level data with a distinct byte pattern per level
+	auto makeLevels(VkFormat format, uint32_t width, uint32_t height, uint32_t levelCount, uint32_t faceCount)
+		-> std::vector<std::vector<std::byte>>
+	{
+		std::vector<std::vector<std::byte>> levels;
+		for (uint32_t level = 0; level < levelCount; level++)
+		{
+			auto size = KTX2::levelSize(format, std::max(width >> level, 1u), std::max(height >> level, 1u)) * faceCount;
+			auto& data = levels.emplace_back(size);
+			for (std::size_t i = 0; i < data.size(); i++)
+				data[i] = static_cast<std::byte>(level * 31 + i);
+		}
+		return levels;
+	}
+
+	auto encode(VkFormat format, uint32_t width, uint32_t height, const std::vector<std::vector<std::byte>>& levels,
+		uint32_t faceCount = 1) -> std::vector<std::byte>
+	{
+		std::vector<std::span<const std::byte>> spans(levels.begin(), levels.end());
+		return KTX2::encode(format, width, height, spans, faceCount);
+	}
+
+	void levelSize()
+	{
+		AGX_CHECK(KTX2::levelSize(VK_FORMAT_BC4_UNORM_BLOCK, 8, 8) == 4 * 8);
+		AGX_CHECK(KTX2::levelSize(VK_FORMAT_BC7_SRGB_BLOCK, 5, 3) == 2 * 16);
+		AGX_CHECK(KTX2::levelSize(VK_FORMAT_BC5_UNORM_BLOCK, 1, 1) == 16);
+		AGX_CHECK(KTX2::levelSize(VK_FORMAT_R8G8B8A8_SRGB, 5, 3) == 5 * 3 * 4);
+		AGX_CHECK(KTX2::levelSize(VK_FORMAT_R16G16B16A16_SFLOAT, 2, 2) == 2 * 2 * 8);
+		AGX_CHECK(KTX2::levelSize(VK_FORMAT_R8_UNORM, 4, 4) == 0);
+		AGX_CHECK(KTX2::isBlockCompressed(VK_FORMAT_BC7_UNORM_BLOCK));
+		AGX_CHECK(!KTX2::isBlockCompressed(VK_FORMAT_R8G8B8A8_UNORM));
+	}
+
+	void roundTrip()
+	{
+		auto levels = makeLevels(VK_FORMAT_BC7_SRGB_BLOCK, 16, 8, 5, 1);
+		auto file = encode(VK_FORMAT_BC7_SRGB_BLOCK, 16, 8, levels);
+		AGX_CHECK(KTX2::isKTX2(file));
+
+		auto texture = KTX2::read(file);
+		AGX_CHECK(texture.has_value());
+		if (!texture)
+			return;
+
+		AGX_CHECK(texture->format == VK_FORMAT_BC7_SRGB_BLOCK);
+		AGX_CHECK(texture->width == 16 && texture->height == 8);
+		AGX_CHECK(texture->faceCount == 1);
+		AGX_CHECK(texture->levelOffsets.size() == levels.size());
+		for (std::size_t level = 0; level < levels.size() && level < texture->levelOffsets.size(); level++)
+		{
+			auto offset = texture->levelOffsets[level];
+			AGX_CHECK(offset % 16 == 0);
+			AGX_CHECK(offset + levels[level].size() <= texture->data.size());
+			AGX_CHECK(std::memcmp(texture->data.data() + offset, levels[level].data(), levels[level].size()) == 0);
+		}
+
+		// Smallest level first
+		AGX_CHECK(texture->levelOffsets.back() < texture->levelOffsets.front());
+	}
+
+	void cubeMap()
+	{
+		auto levels = makeLevels(VK_FORMAT_R16G16B16A16_SFLOAT, 4, 4, 3, 6);
+		auto file = encode(VK_FORMAT_R16G16B16A16_SFLOAT, 4, 4, levels, 6);
+		auto texture = KTX2::read(file);
+		AGX_CHECK(texture.has_value() && texture->faceCount == 6);
+		if (texture)
+			AGX_CHECK(std::memcmp(texture->data.data() + texture->levelOffsets[0], levels[0].data(), levels[0].size()) == 0);
+	}
+
+	void rejectsInvalidFiles()
+	{
+		auto levels = makeLevels(VK_FORMAT_R8G8B8A8_UNORM, 4, 4, 1, 1);
+		const auto valid = encode(VK_FORMAT_R8G8B8A8_UNORM, 4, 4, levels);
+		AGX_CHECK(KTX2::read(valid).has_value());
+
+		AGX_CHECK(!KTX2::read({}).has_value());
+		AGX_CHECK(!KTX2::read(std::span{ valid }.first(79)).has_value());
+
+		auto file = valid;
+		file[0] = std::byte{ 0 };
+		AGX_CHECK(!KTX2::isKTX2(file));
+		AGX_CHECK(!KTX2::read(file).has_value());
+
+		auto patched = [&](std::size_t offset, uint32_t value) {
+			auto copy = valid;
+			patch(copy, offset, value);
+			return KTX2::read(copy).has_value();
+			};
+
+		AGX_CHECK(!patched(SUPERCOMPRESSION_OFFSET, 1));
+		AGX_CHECK(!patched(LAYER_COUNT_OFFSET, 2));
+		AGX_CHECK(!patched(FACE_COUNT_OFFSET, 2));
+		AGX_CHECK(!patched(LEVEL_COUNT_OFFSET, 0));
+		AGX_CHECK(!patched(WIDTH_OFFSET, 0));
+		AGX_CHECK(!patched(FORMAT_OFFSET, VK_FORMAT_R8_UNORM));
+		AGX_CHECK(!patched(LEVEL0_LENGTH_OFFSET, static_cast<uint32_t>(levels[0].size() + 4)));
+
+		// More levels than the level index holds
+		AGX_CHECK(!patched(LEVEL_COUNT_OFFSET, 1000));
+
+		// Level data cut off
+		AGX_CHECK(!KTX2::read(std::span{ valid }.first(valid.size() - 1)).has_value());
+	}
+}
+
+auto main() -> int
+{
+	levelSize();
+	roundTrip();
+	cubeMap();
+	rejectsInvalidFiles();
+	return Aegis::Test::result();
+}
@@ -0,0 +1,134 @@
+#include "test.h"
+
+#include <cstdint>
+#include <vector>
+
+import Aegis.Graphics.OffsetAllocator;
+
+using Aegis::Graphics::OffsetAllocator;
+
+namespace
+{
+	void allocateAndFree()
+	{
+		OffsetAllocator allocator{ 100 };
+		AGX_CHECK(allocator.capacity() == 100);
+		AGX_CHECK(allocator.freeSize() == 100);
+		AGX_CHECK(allocator.freeRangeCount() == 1);
+
+		auto a = allocator.allocate(10);
+		auto b = allocator.allocate(20);
+		auto c = allocator.allocate(30);
+		AGX_CHECK(a.isValid() && a.offset == 0 && a.size == 10);
+		AGX_CHECK(b.isValid() && b.offset == 10 && b.size == 20);
+		AGX_CHECK(c.isValid() && c.offset == 30 && c.size == 30);
+		AGX_CHECK(allocator.usedSize() == 60);
+		AGX_CHECK(allocator.largestFreeRange() == 40);
+
+		// Too large for the remaining space
+		AGX_CHECK(!allocator.allocate(41).isValid());
+		AGX_CHECK(allocator.usedSize() == 60);
+
+		allocator.free(b);
+		AGX_CHECK(allocator.usedSize() == 40);
+		AGX_CHECK(allocator.freeRangeCount() == 2);
+
+		// Merged with the preceding and the following range
+		allocator.free(a);
+		AGX_CHECK(allocator.freeRangeCount() == 2);
+		AGX_CHECK(allocator.largestFreeRange() == 40);
+		allocator.free(c);
+		AGX_CHECK(allocator.freeRangeCount() == 1);
+		AGX_CHECK(allocator.largestFreeRange() == 100);
+		AGX_CHECK(allocator.usedSize() == 0);
+	}
+
+	void bestFit()
+	{
+		OffsetAllocator allocator{ 100 };
+		auto a = allocator.allocate(30);
+		auto gap0 = allocator.allocate(10);
+		auto b = allocator.allocate(10);
+		auto gap1 = allocator.allocate(5);
+		auto c = allocator.allocate(45);
+		AGX_CHECK(allocator.freeSize() == 0);
+
+		// Free ranges of 10 and 5 elements
+		allocator.free(gap0);
+		allocator.free(gap1);
+		AGX_CHECK(allocator.freeRangeCount() == 2);
+
+		auto small = allocator.allocate(4);
+		AGX_CHECK(small.offset == gap1.offset);
+		auto exact = allocator.allocate(10);
+		AGX_CHECK(exact.offset == gap0.offset);
+		AGX_CHECK(allocator.freeRangeCount() == 1);
+		AGX_CHECK(allocator.largestFreeRange() == 1);
+
+		allocator.free(a);
+		allocator.free(b);
+		allocator.free(c);
+		allocator.free(small);
+		allocator.free(exact);
+		AGX_CHECK(allocator.freeRangeCount() == 1);
+		AGX_CHECK(allocator.usedSize() == 0);
+	}
+
+	void fragmentation()
+	{
+		OffsetAllocator allocator{ 100 };
+		AGX_CHECK(allocator.fragmentation() == 0.0f);
+
+		std::vector<OffsetAllocator::Allocation> allocations;
+		for (int i = 0; i < 10; i++)
+			allocations.push_back(allocator.allocate(10));
+		AGX_CHECK(allocator.fragmentation() == 0.0f);
+
+		// Every other range free: 50 free elements in ranges of 10
+		for (std::size_t i = 0; i < allocations.size(); i += 2)
+			allocator.free(allocations[i]);
+		AGX_CHECK(allocator.freeRangeCount() == 5);
+		AGX_CHECK_NEAR(allocator.fragmentation(), 0.8f, 1e-6f);
+		AGX_CHECK(!allocator.allocate(11).isValid());
+	}
+
+	void growAndReset()
+	{
+		OffsetAllocator allocator{ 10 };
+		auto a = allocator.allocate(6);
+		auto b = allocator.allocate(4);
+		AGX_CHECK(!allocator.allocate(1).isValid());
+
+		// New space is merged with a free range at the end
+		allocator.free(b);
+		allocator.grow(20);
+		AGX_CHECK(allocator.capacity() == 20);
+		AGX_CHECK(allocator.freeRangeCount() == 1);
+		AGX_CHECK(allocator.largestFreeRange() == 14);
+		auto c = allocator.allocate(14);
+		AGX_CHECK(c.offset == 6);
+
+		allocator.free(a);
+		AGX_CHECK(allocator.freeRangeCount() == 1);
+
+		// Compacted: the 14 live elements moved to the front
+		allocator.reset(14);
+		AGX_CHECK(allocator.usedSize() == 14);
+		AGX_CHECK(allocator.freeRangeCount() == 1);
+		AGX_CHECK(allocator.largestFreeRange() == 6);
+		AGX_CHECK(allocator.allocate(6).offset == 14);
+
+		allocator.reset(20);
+		AGX_CHECK(allocator.freeRangeCount() == 0);
+		AGX_CHECK(allocator.fragmentation() == 0.0f);
+	}
+}
+
+auto main() -> int
+{
+	allocateAndFree();
+	bestFit();
+	fragmentation();
+	growAndReset();
+	return Aegis::Test::result();
+}
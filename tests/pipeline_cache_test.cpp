@@ -0,0 +1,105 @@
+#include "test.h"
+#include "graphics/vulkan/vulkan_include.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <vector>
+
+import Aegis.Graphics.PipelineCache;
+import Aegis.Utils.File;
+
+using Aegis::Graphics::PipelineCache;
+
+namespace
+{
+	auto deviceProperties() -> VkPhysicalDeviceProperties
+	{
+		VkPhysicalDeviceProperties properties{};
+		properties.vendorID = 0x10DE;
+		properties.deviceID = 0x2684;
+		properties.driverVersion = 0x87654321;
+		for (uint32_t i = 0; i < VK_UUID_SIZE; i++)
+			properties.pipelineCacheUUID[i] = static_cast<uint8_t>(i * 7 + 1);
+		return properties;
+	}
+
+	/// @brief Cache file as written by PipelineCache::save
+	auto cacheFile(PipelineCache::Header header, std::size_t dataSize) -> std::vector<std::byte>
+	{
+		std::vector<std::byte> file(sizeof(header) + dataSize);
+		for (std::size_t i = sizeof(header); i < file.size(); i++)
+			file[i] = static_cast<std::byte>(i * 13);
+
+		auto data = std::span{ file }.subspan(sizeof(header));
+		header.dataSize = data.size();
+		header.dataHash = Aegis::Utils::File::hash(data);
+		std::memcpy(file.data(), &header, sizeof(header));
+		return file;
+	}
+
+	void deviceHeader()
+	{
+		auto properties = deviceProperties();
+		auto header = PipelineCache::deviceHeader(properties);
+		AGX_CHECK(header.magic == PipelineCache::MAGIC);
+		AGX_CHECK(header.version == PipelineCache::VERSION);
+		AGX_CHECK(header.vendorID == properties.vendorID);
+		AGX_CHECK(header.deviceID == properties.deviceID);
+		AGX_CHECK(header.driverVersion == properties.driverVersion);
+		AGX_CHECK(std::memcmp(header.uuid, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0);
+	}
+
+	void validFile()
+	{
+		auto device = PipelineCache::deviceHeader(deviceProperties());
+		AGX_CHECK(PipelineCache::validate(cacheFile(device, 1000), device) == PipelineCache::Validation::Valid);
+		AGX_CHECK(PipelineCache::validate(cacheFile(device, 0), device) == PipelineCache::Validation::Valid);
+	}
+
+	void otherDevice()
+	{
+		auto device = PipelineCache::deviceHeader(deviceProperties());
+		auto written = [&](auto&& change) {
+			auto header = device;
+			change(header);
+			return PipelineCache::validate(cacheFile(header, 64), device);
+			};
+
+		using enum PipelineCache::Validation;
+		AGX_CHECK(written([](auto& header) { header.magic = 0; }) == OtherDevice);
+		AGX_CHECK(written([](auto& header) { header.version = PipelineCache::VERSION + 1; }) == OtherDevice);
+		AGX_CHECK(written([](auto& header) { header.vendorID++; }) == OtherDevice);
+		AGX_CHECK(written([](auto& header) { header.deviceID++; }) == OtherDevice);
+		AGX_CHECK(written([](auto& header) { header.driverVersion++; }) == OtherDevice);
+		AGX_CHECK(written([](auto& header) { header.uuid[VK_UUID_SIZE - 1] ^= 1; }) == OtherDevice);
+	}
+
+	void corruptFile()
+	{
+		using enum PipelineCache::Validation;
+		auto device = PipelineCache::deviceHeader(deviceProperties());
+		auto file = cacheFile(device, 256);
+
+		AGX_CHECK(PipelineCache::validate({}, device) == Corrupt);
+		AGX_CHECK(PipelineCache::validate(std::span{ file }.first(sizeof(PipelineCache::Header) - 1), device) == Corrupt);
+
+		// Truncated driver data
+		AGX_CHECK(PipelineCache::validate(std::span{ file }.first(file.size() - 1), device) == Corrupt);
+
+		// Data changed after the hash was written
+		auto modified = file;
+		modified.back() ^= std::byte{ 1 };
+		AGX_CHECK(PipelineCache::validate(modified, device) == Corrupt);
+	}
+}
+
+auto main() -> int
+{
+	deviceHeader();
+	validFile();
+	otherDevice();
+	corruptFile();
+	return Aegis::Test::result();
+}
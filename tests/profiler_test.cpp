@@ -0,0 +1,111 @@
+#include "test.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+import Aegis.Core.Profiler;
+
+using Aegis::Profiler;
+
+namespace
+{
+	constexpr uint64_t EVENT_TICKS = 1'000'000;
+	constexpr std::size_t N = Profiler::EVENT_BUFFER_SIZE;
+
+	void recordEvents(Aegis::ScopeID id, std::size_t count)
+	{
+		auto& profiler = Profiler::instance();
+		uint64_t begin = Profiler::now();
+		for (std::size_t i = 0; i < count; i++)
+			profiler.record(id, begin, begin + EVENT_TICKS);
+	}
+
+	/// @brief Events and time of the scope collected by the next frame
+	struct Frame
+	{
+		uint64_t dropped;
+		double time;
+		bool recorded;
+	};
+
+	auto collectFrame(Aegis::ScopeID id) -> Frame
+	{
+		auto& profiler = Profiler::instance();
+		uint64_t dropped = profiler.droppedEvents();
+		profiler.beginFrame();
+
+		const auto& stats = profiler.scopes()[id];
+		bool recorded = profiler.recordedLastFrame(stats);
+		return Frame{ profiler.droppedEvents() - dropped, recorded ? stats.times.last() : 0.0, recorded };
+	}
+
+	void ringBuffer()
+	{
+		auto& profiler = Profiler::instance();
+		auto id = profiler.registerScope("Profiler test");
+		profiler.beginFrame();
+
+		// Time of a single event, frame times are the sum of the collected events
+		recordEvents(id, 1);
+		auto single = collectFrame(id);
+		AGX_CHECK(single.recorded && single.dropped == 0 && single.time > 0.0);
+		// Ticks are converted with a tick rate that is refined every frame, compare counts with a relative tolerance
+		auto sameCount = [&](const Frame& frame, std::size_t count) {
+			return std::abs(frame.time / (single.time * static_cast<double>(count)) - 1.0) < 0.01;
+			};
+
+		auto empty = collectFrame(id);
+		AGX_CHECK(!empty.recorded && empty.dropped == 0);
+
+		// The slot of the oldest event may be written while collecting, N - 1 events fit between two frames
+		recordEvents(id, N - 1);
+		auto full = collectFrame(id);
+		AGX_CHECK(full.dropped == 0);
+		AGX_CHECK(sameCount(full, N - 1));
+
+		recordEvents(id, N);
+		auto overflow = collectFrame(id);
+		AGX_CHECK(overflow.dropped == 1);
+		AGX_CHECK(sameCount(overflow, N - 1));
+
+		recordEvents(id, N + 100);
+		overflow = collectFrame(id);
+		AGX_CHECK(overflow.dropped == 101);
+		AGX_CHECK(sameCount(overflow, N - 1));
+
+		// Dropped events do not carry over
+		recordEvents(id, 10);
+		auto next = collectFrame(id);
+		AGX_CHECK(next.dropped == 0);
+		AGX_CHECK(sameCount(next, 10));
+	}
+
+	void workerThreads()
+	{
+		auto& profiler = Profiler::instance();
+		auto id = profiler.registerScope("Profiler test worker");
+		profiler.beginFrame();
+
+		std::thread first{ [id] { recordEvents(id, 10); } };
+		std::thread second{ [id] { recordEvents(id, 20); } };
+		first.join();
+		second.join();
+		recordEvents(id, 1);
+
+		auto frame = collectFrame(id);
+		AGX_CHECK(frame.recorded && frame.dropped == 0);
+
+		recordEvents(id, 1);
+		auto single = collectFrame(id);
+		AGX_CHECK(std::abs(frame.time / (single.time * 31.0) - 1.0) < 0.01);
+	}
+}
+
+auto main() -> int
+{
+	ringBuffer();
+	workerThreads();
+	return Aegis::Test::result();
+}
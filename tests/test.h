@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cmath>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+
+#define AGX_CHECK(expr)						\
+	((expr) ? static_cast<void>(0) :		\
+	Aegis::Test::checkFailed(#expr, __FILE__, __LINE__))
+#define AGX_CHECK_NEAR(a, b, eps)			\
+	AGX_CHECK(std::abs((a) - (b)) <= (eps))
+
+namespace Aegis::Test
+{
+	inline int g_failures = 0;
+
+	inline void checkFailed(const char* expr, const char* file, int line)
+	{
+		std::cout << std::format("Check failed: '{}'\n\tFile: {}, Line: {}\n", expr, file, line);
+		g_failures++;
+	}
+
+	/// @brief Exit code of the test executable
+	[[nodiscard]] inline auto result() -> int
+	{
+		if (g_failures > 0)
+		{
+			std::cout << std::format("{} check(s) failed\n", g_failures);
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+}